@@ -61,7 +61,7 @@ int main() {
   graph.makeConnection(a5, a6);
   graph.setOutput(a5, output);
   graph.inference();
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> tmp_output = softmax<float>(*output.as<float>());
   for (float i : tmp) {
     std::cout << i << " ";
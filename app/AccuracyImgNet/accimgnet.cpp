@@ -84,7 +84,7 @@ void process_image(Tensor& input, const std::string& file) {
   }
   if (input.get_shape().dims() > 0) {
     Shape sh({input.get_shape()[0] + 1, width, width, 3});
-    std::vector<float> cur_input(*input.as<float>());
+    std::vector<float> cur_input(input.begin<float>(), input.end<float>());
     cur_input.insert(cur_input.end(), res.begin(), res.end());
     input = make_tensor<float>(cur_input, sh);
   } else {
@@ -0,0 +1,288 @@
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "layers/BinaryOpLayer.hpp"
+#include "layers/ConcatLayer.hpp"
+#include "layers/ConvLayer.hpp"
+#include "layers/CpuFeatures.hpp"
+#include "layers/EWLayer.hpp"
+#include "layers/FCLayer.hpp"
+#include "layers/FlattenLayer.hpp"
+#include "layers/PoolingLayer.hpp"
+#include "layers/ReduceLayer.hpp"
+#include "layers/SplitLayer.hpp"
+#include "layers/TransposeLayer.hpp"
+#include "oneapi/tbb/task_arena.h"
+#include "perf/benchmarking.hpp"
+
+using namespace it_lab_ai;
+
+namespace {
+
+// one layer on the shapes of one network
+struct Case {
+  std::string name;
+  std::shared_ptr<Layer> layer;
+  std::vector<Tensor> inputs;
+  std::vector<Tensor> outputs;
+  // layers with extra arguments (Reduce axes) replace run_multi
+  std::function<void(Case&)> run = [](Case& c) {
+    c.layer->run_multi(c.inputs, c.outputs);
+  };
+};
+
+Tensor random_tensor(const Shape& shape, std::mt19937& gen) {
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> values(shape.count());
+  for (float& value : values) {
+    value = dist(gen);
+  }
+  return make_tensor(values, shape);
+}
+
+std::string shape_string(const Shape& shape) {
+  std::string res;
+  for (size_t i = 0; i < shape.dims(); i++) {
+    res += (i == 0 ? "" : "x") + std::to_string(shape[i]);
+  }
+  return res;
+}
+
+// shapes of the MNIST net of app/Graph, AlexNet at 227x227 as in
+// app/AccuracyImgNet and ResNet-50 stages, with a few from GoogLeNet and
+// DenseNet where those nets are the ones using a layer
+std::vector<Case> make_cases() {
+  std::mt19937 gen(42);
+  std::vector<Case> cases;
+  auto add = [&](const std::string& name, std::shared_ptr<Layer> layer,
+                 const std::vector<Shape>& input_shapes) {
+    Case c;
+    c.name = name;
+    c.layer = std::move(layer);
+    for (const Shape& shape : input_shapes) {
+      c.inputs.push_back(random_tensor(shape, gen));
+    }
+    cases.push_back(std::move(c));
+    return &cases.back();
+  };
+  auto conv = [&](const std::string& name, const Shape& input,
+                  const Shape& kernel, size_t stride, size_t pads,
+                  size_t group = 1) {
+    add("conv/" + name,
+        std::make_shared<ConvolutionalLayer>(
+            stride, pads, 1, random_tensor(kernel, gen),
+            random_tensor(Shape({kernel[3]}), gen), kDefault, group),
+        {input});
+  };
+  conv("mnist_5x5", Shape({1, 1, 28, 28}), Shape({5, 5, 1, 32}), 1, 2);
+  conv("alexnet_conv1", Shape({1, 3, 227, 227}), Shape({11, 11, 3, 96}), 4,
+       0);
+  conv("alexnet_conv3", Shape({1, 256, 13, 13}), Shape({3, 3, 256, 384}), 1,
+       1);
+  conv("resnet_3x3", Shape({1, 64, 56, 56}), Shape({3, 3, 64, 64}), 1, 1);
+  conv("resnet_1x1", Shape({1, 256, 56, 56}), Shape({1, 1, 256, 64}), 1, 0);
+  conv("mobilenet_depthwise", Shape({1, 128, 56, 56}),
+       Shape({3, 3, 1, 128}), 1, 1, 128);
+
+  auto fc = [&](const std::string& name, size_t batch, size_t in,
+                size_t out) {
+    add("fc/" + name,
+        std::make_shared<FCLayer>(random_tensor(Shape({out, in}), gen),
+                                  random_tensor(Shape({out}), gen)),
+        {Shape({batch, in})});
+  };
+  fc("mnist", 1, 3136, 128);
+  fc("alexnet_fc6", 1, 9216, 4096);
+  fc("alexnet_fc8", 1, 4096, 1000);
+  fc("alexnet_fc7_batch32", 32, 4096, 4096);
+
+  add("pooling/mnist_max2x2",
+      std::make_shared<PoolingLayer>(Shape({2, 2}), "max"),
+      {Shape({1, 32, 28, 28})});
+  add("pooling/alexnet_max3x3",
+      std::make_shared<PoolingLayer>(Shape({3, 3}), "max"),
+      {Shape({1, 96, 55, 55})});
+  add("pooling/resnet_avg2x2",
+      std::make_shared<PoolingLayer>(Shape({2, 2}), "average"),
+      {Shape({1, 64, 112, 112})});
+
+  add("ew/alexnet_relu", std::make_shared<EWLayer>("relu"),
+      {Shape({1, 96, 55, 55})});
+  add("ew/resnet_relu", std::make_shared<EWLayer>("relu"),
+      {Shape({1, 64, 112, 112})});
+  add("ew/resnet_sigmoid", std::make_shared<EWLayer>("sigmoid"),
+      {Shape({1, 256, 56, 56})});
+
+  add("binaryop/resnet_add",
+      std::make_shared<BinaryOpLayer>(BinaryOpLayer::Operation::kAdd),
+      {Shape({1, 256, 56, 56}), Shape({1, 256, 56, 56})});
+  add("binaryop/resnet_mul",
+      std::make_shared<BinaryOpLayer>(BinaryOpLayer::Operation::kMul),
+      {Shape({1, 256, 56, 56}), Shape({1, 256, 56, 56})});
+
+  auto reduce = [&](const std::string& name, ReduceLayer::Operation op,
+                    const Shape& input, const std::vector<int>& axes) {
+    Case* c = add("reduce/" + name, std::make_shared<ReduceLayer>(op, 1),
+                  {input});
+    Tensor axes_tensor = make_tensor(axes);
+    c->run = [axes_tensor](Case& self) {
+      self.outputs.resize(1);
+      static_cast<ReduceLayer&>(*self.layer)
+          .run(self.inputs[0], axes_tensor, self.outputs[0]);
+    };
+  };
+  reduce("resnet_global_mean", ReduceLayer::Operation::kMean,
+         Shape({1, 2048, 7, 7}), {2, 3});
+  reduce("resnet_channel_sum", ReduceLayer::Operation::kSum,
+         Shape({1, 256, 56, 56}), {1});
+
+  add("concat/googlenet_inception", std::make_shared<ConcatLayer>(1),
+      {Shape({1, 64, 28, 28}), Shape({1, 128, 28, 28}),
+       Shape({1, 32, 28, 28}), Shape({1, 32, 28, 28})});
+  add("concat/densenet_block", std::make_shared<ConcatLayer>(1),
+      {Shape({1, 128, 56, 56}), Shape({1, 32, 56, 56})});
+
+  add("split/resnet_halves", std::make_shared<SplitLayer>(1, 2),
+      {Shape({1, 256, 56, 56})});
+
+  std::vector<int64_t> to_nhwc = {0, 2, 3, 1};
+  add("transpose/resnet_nhwc", std::make_shared<TransposeLayer>(to_nhwc),
+      {Shape({1, 64, 56, 56})});
+  add("transpose/alexnet_nhwc", std::make_shared<TransposeLayer>(to_nhwc),
+      {Shape({1, 256, 13, 13})});
+
+  add("flatten/mnist", std::make_shared<FlattenLayer>(),
+      {Shape({1, 64, 7, 7})});
+  add("flatten/alexnet", std::make_shared<FlattenLayer>(),
+      {Shape({1, 256, 6, 6})});
+  return cases;
+}
+
+}  // namespace
+
+// Times every layer kernel on realistic shapes: median and p99 latency of
+// the runs after warm-up and outlier rejection, GFLOP/s from Layer::flops
+// and GB/s of the inputs, weights and outputs. Flags:
+//   --filter <text>   only the cases whose name contains text
+//   --warmup <n>      untimed runs first, 5 by default
+//   --iters <n>       timed runs, by default as many as --min-time takes
+//   --min-time <ms>   time of the timed runs of a case, 200 by default
+//   --flush           evict the caches before every run
+//   --cpu <n>         pin the main thread to CPU n
+//   --json <file>     also write the results there for regression tracking
+int main(int argc, char* argv[]) {
+  std::string filter;
+  std::string json_path;
+  BenchmarkOptions options;
+  options.warmup = 5;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--flush") {
+      options.flush_cache = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value of " << arg << std::endl;
+      return 1;
+    }
+    if (arg == "--filter") {
+      filter = argv[++i];
+    } else if (arg == "--json") {
+      json_path = argv[++i];
+    } else if (arg == "--warmup") {
+      options.warmup = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--iters") {
+      options.iterations = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--min-time") {
+      options.min_time_ms = std::strtod(argv[++i], nullptr);
+    } else if (arg == "--cpu") {
+      options.cpu = std::atoi(argv[++i]);
+    } else {
+      std::cerr << "Unknown argument " << arg << std::endl;
+      return 1;
+    }
+  }
+
+  nlohmann::json results = nlohmann::json::array();
+  bool pinned = false;
+  std::cout << std::left << std::setw(34) << "benchmark" << std::setw(20)
+            << "input" << std::right << std::setw(11) << "median ms"
+            << std::setw(11) << "p99 ms" << std::setw(10) << "GFLOP/s"
+            << std::setw(10) << "GB/s" << '\n'
+            << std::fixed;
+  for (Case& c : make_cases()) {
+    if (c.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    BenchmarkResult result = run_benchmark(options, [&c]() { c.run(c); });
+    const SampleStats& stats = result.stats;
+    pinned = result.pinned;
+    size_t bytes = c.layer->weight_bytes();
+    for (const Tensor& input : c.inputs) {
+      bytes += input.get_values().size();
+    }
+    for (const Tensor& output : c.outputs) {
+      bytes += output.get_values().size();
+    }
+    uint64_t flops = c.layer->flops(c.inputs[0].get_shape(),
+                                    c.outputs[0].get_shape());
+    // per ms, so 1e6 rather than 1e9
+    double gflops = static_cast<double>(flops) / stats.median / 1e6;
+    double gbps = static_cast<double>(bytes) / stats.median / 1e6;
+    std::string input = shape_string(c.inputs[0].get_shape());
+    std::cout << std::left << std::setw(34) << c.name << std::setw(20)
+              << input << std::right << std::setprecision(3)
+              << std::setw(11) << stats.median << std::setw(11) << stats.p99
+              << std::setprecision(2) << std::setw(10);
+    if (flops > 0) {
+      std::cout << gflops;
+    } else {
+      std::cout << "-";
+    }
+    std::cout << std::setw(10) << gbps << std::endl;
+    results.push_back({{"name", c.name},
+                       {"layer", c.layer->name()},
+                       {"input", input},
+                       {"output", shape_string(c.outputs[0].get_shape())},
+                       {"iterations", result.samples.size()},
+                       {"samples", stats.samples},
+                       {"outliers", stats.outliers},
+                       {"min_ms", stats.min},
+                       {"median_ms", stats.median},
+                       {"mean_ms", stats.mean},
+                       {"stddev_ms", stats.stddev},
+                       {"p90_ms", stats.p90},
+                       {"p99_ms", stats.p99},
+                       {"max_ms", stats.max},
+                       {"flops", flops},
+                       {"bytes", bytes},
+                       {"gflops", gflops},
+                       {"gbps", gbps}});
+  }
+  if (!json_path.empty()) {
+    nlohmann::json report = {
+        {"context",
+         {{"isa", isa_name(max_isa())},
+          {"threads", tbb::this_task_arena::max_concurrency()},
+          {"warmup", options.warmup},
+          {"min_time_ms", options.min_time_ms},
+          {"flush_cache", options.flush_cache},
+          {"cpu", pinned ? options.cpu : -1}}},
+        {"benchmarks", results}};
+    std::ofstream out(json_path);
+    out << report.dump(2) << std::endl;
+    if (!out) {
+      std::cerr << "Cannot write " << json_path << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
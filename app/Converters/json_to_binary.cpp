@@ -0,0 +1,20 @@
+#include <iostream>
+#include <string>
+
+#include "Weights_Reader/binary_weights.hpp"
+
+// Json_to_binary [model.json] [model.bin]
+int main(int argc, char* argv[]) {
+  std::string json_file = argc > 1 ? argv[1] : MODEL_PATH_H5;
+  std::string binary_file =
+      argc > 2 ? argv[2] : it_lab_ai::binary_weights_path(json_file);
+  try {
+    it_lab_ai::json model_data = it_lab_ai::read_json(json_file);
+    it_lab_ai::write_binary_weights(model_data, binary_file);
+  } catch (const std::exception& e) {
+    std::cerr << "Conversion failed: " << e.what() << std::endl;
+    return 1;
+  }
+  std::cout << json_file << " -> " << binary_file << std::endl;
+  return 0;
+}
@@ -23,6 +23,9 @@ MODEL_DATA_PATH = os.path.join(BASE_DIR, 'docs/jsons', 'model_data_alexnet_1.jso
 
 model = load_model(MODEL_PATH, custom_objects={'GlorotUniform': CustomGlorotUniform, 'Zeros': CustomZeros})
 
+# DepthwiseConv2D doesn't derive from Conv2D in every Keras version
+CONV_LAYERS = (tf.keras.layers.Conv2D, tf.keras.layers.DepthwiseConv2D)
+
 layer_info = []
 for index, layer in enumerate(model.layers):
     layer_name = layer.name
@@ -38,10 +41,16 @@ for index, layer in enumerate(model.layers):
         'bias': []
     }
 
-    if isinstance(layer, tf.keras.layers.Conv2D):
+    if isinstance(layer, CONV_LAYERS):
         layer_data['padding'] = layer_config.get('padding', None)
+        layer_data['group'] = layer_config.get('groups', 1)
         layer_activation = layer_config.get('activation', None)
 
+        if isinstance(layer, tf.keras.layers.DepthwiseConv2D) and len(weights) > 0:
+            # HW x channels x multiplier -> HWIO with one input channel per group
+            kernel = weights[0]
+            layer_data['group'] = int(kernel.shape[2])
+            weights[0] = kernel.reshape(kernel.shape[0], kernel.shape[1], 1, -1)
         if len(weights) > 0:
             layer_data['weights'] = weights[0].tolist()
         if len(weights) > 1:
@@ -59,7 +68,7 @@ for index, layer in enumerate(model.layers):
 
     layer_info.append(layer_data)
 
-    if isinstance(layer, (tf.keras.layers.Conv2D)) and layer_activation:
+    if isinstance(layer, CONV_LAYERS) and layer_activation:
         activation_layer = {
             'index': len(layer_info),
             'name': f"activation_{layer_name}",
@@ -66,6 +66,8 @@ def onnx_to_json(model_path, output_json_path):
                 layer_data["kernel_size"] = attr_value
             elif attr.name == "strides":
                 layer_data["strides"] = attr_value
+            elif attr.name == "group":
+                layer_data["group"] = attr_value
 
         node_init = []
         for input_name in node.input:
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iomanip>
 #include <numeric>
 #include <sstream>
@@ -9,13 +10,17 @@ using namespace it_lab_ai;
 
 int main(int argc, char* argv[]) {
   bool parallel = false;
-  if (argc > 1 && std::string(argv[1]) == "--parallel") {
-    std::cout << "Parallel mode" << std::endl;
-    parallel = true;
+  bool int8 = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--parallel") {
+      std::cout << "Parallel mode" << std::endl;
+      parallel = true;
+    } else if (std::string(argv[i]) == "--int8") {
+      int8 = true;
+    }
   }
   std::vector<size_t> counts = {979, 1134, 1031, 1009, 981,
                                 891, 957,  1027, 973,  1008};
-  int stat = 0;
   size_t sum = std::accumulate(counts.begin(), counts.end(), size_t{0});
   int count_pic = static_cast<int>(sum) + 10;
   std::vector<float> res(count_pic * 28 * 28);
@@ -55,27 +60,50 @@ int main(int argc, char* argv[]) {
   Shape sh({static_cast<size_t>(count_pic), 1, 28, 28});
   Tensor t = make_tensor<float>(res, sh);
   input = t;
-  build_graph(input, output, false, parallel);
-  std::vector<std::vector<float>> tmp_output =
-      softmax<float>(*output.as<float>(), 10);
-  std::vector<size_t> indices;
-  for (const auto& row : tmp_output) {
-    for (size_t j = 0; j < row.size(); ++j) {
-      if (row[j] >= 1e-6) {
-        indices.push_back(j);
-        break;
+  auto accuracy = [&](Tensor& result) {
+    std::vector<std::vector<float>> tmp_output =
+        softmax<float>(*result.as<float>(), 10);
+    std::vector<size_t> indices;
+    for (const auto& row : tmp_output) {
+      for (size_t j = 0; j < row.size(); ++j) {
+        if (row[j] >= 1e-6) {
+          indices.push_back(j);
+          break;
+        }
       }
     }
-  }
-  for (size_t name = 0; name < 10; name++) {
-    for (size_t ind = 0; ind < counts[name] + 1; ind++) {
-      size_t a = ind;
-      for (size_t n = 0; n < name; n++) a += counts[n] + 1;
-      if (name == indices[a]) stat++;
+    int stat = 0;
+    for (size_t name = 0; name < 10; name++) {
+      for (size_t ind = 0; ind < counts[name] + 1; ind++) {
+        size_t a = ind;
+        for (size_t n = 0; n < name; n++) a += counts[n] + 1;
+        if (name == indices[a]) stat++;
+      }
     }
-  }
-  double percentage =
-      (static_cast<double>(stat) / static_cast<double>(sum + 10)) * 100;
+    return (static_cast<double>(stat) / static_cast<double>(sum + 10)) * 100;
+  };
+  double fp32_time = build_graph(input, output, false, parallel);
+  double percentage = accuracy(output);
   std::cout << "Stat: " << std::fixed << std::setprecision(2) << percentage
             << "%" << std::endl;
+  if (int8) {
+    // every 20th image of the test set calibrates the activation ranges
+    size_t calibration_count = static_cast<size_t>(count_pic) / 20;
+    std::vector<float> calibration_images(calibration_count * 28 * 28);
+    for (size_t i = 0; i < calibration_count; i++) {
+      std::copy(res.begin() + i * 20 * 28 * 28,
+                res.begin() + (i * 20 + 1) * 28 * 28,
+                calibration_images.begin() + i * 28 * 28);
+    }
+    Tensor calibration = make_tensor<float>(
+        calibration_images, Shape({calibration_count, 1, 28, 28}));
+    Tensor int8_output;
+    double int8_time =
+        build_graph(input, int8_output, false, parallel, calibration);
+    double int8_percentage = accuracy(int8_output);
+    std::cout << "Int8 stat: " << int8_percentage << "% (delta "
+              << int8_percentage - percentage << "%)" << std::endl;
+    std::cout << "Inference: fp32 " << fp32_time << " ms, int8 " << int8_time
+              << " ms, speedup " << fp32_time / int8_time << "x" << std::endl;
+  }
 }
@@ -1,7 +1,8 @@
 #include "build.hpp"
 
-void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
-                 bool comments, bool parallel = false) {
+double build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
+                   bool comments, bool parallel = false,
+                   const it_lab_ai::Tensor& calibration = it_lab_ai::Tensor()) {
   if (comments) {
     for (size_t i = 0; i < input.get_shape().dims(); i++) {
       std::cout << input.get_shape()[i] << ' ';
@@ -21,23 +22,33 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
       std::cout << std::endl << std::endl;
     }
   }
-  it_lab_ai::ImplType impl1 = parallel ? it_lab_ai::kTBB : it_lab_ai::kDefault;
-  it_lab_ai::ImplType impl2 = parallel ? it_lab_ai::kSTL : it_lab_ai::kDefault;
+  // --parallel forces the threaded implementations, otherwise the layers
+  // pick the fastest one for this CPU (see KernelRegistry), or the one
+  // timed for each shape with ITLAB_AI_TUNE=1 (see ConvTuner)
+  it_lab_ai::ImplType impl1 = parallel ? it_lab_ai::kTBB : it_lab_ai::kAuto;
+  it_lab_ai::ImplType impl2 = parallel ? it_lab_ai::kSTL : it_lab_ai::kAuto;
   std::vector<std::shared_ptr<it_lab_ai::Layer>> layers;
   std::vector<bool> layerpostop;
 
   std::string json_file = MODEL_PATH_H5;
-  it_lab_ai::json model_data = it_lab_ai::read_json(json_file);
-
-  if (comments) std::cout << "Loaded model data from JSON." << std::endl;
+  // the binary model made by Json_to_binary loads without parsing text
+  std::string binary_file = it_lab_ai::binary_weights_path(json_file);
+  std::vector<it_lab_ai::LayerRecord> model_data;
+  if (std::filesystem::exists(binary_file)) {
+    model_data = it_lab_ai::read_binary_weights(binary_file);
+    if (comments) std::cout << "Loaded model data from binary." << std::endl;
+  } else {
+    model_data =
+        it_lab_ai::read_layers_from_json(it_lab_ai::read_json(json_file));
+    if (comments) std::cout << "Loaded model data from JSON." << std::endl;
+  }
 
   for (const auto& layer_data : model_data) {
-    std::string layer_type = layer_data["type"];
+    const std::string& layer_type = layer_data.type;
     if (comments)
       std::cout << "Processing layer of type: " << layer_type << std::endl;
 
-    it_lab_ai::Tensor tensor =
-        it_lab_ai::create_tensor_from_json(layer_data, it_lab_ai::Type::kFloat);
+    it_lab_ai::Tensor tensor = layer_data.tensor;
 
     if (layer_type.find("Conv") != std::string::npos) {
       it_lab_ai::Tensor tmp_tensor = tensor;
@@ -56,8 +67,9 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
       tensor = tmp_tensor;
       it_lab_ai::Shape shape = tensor.get_shape();
       size_t pads = (tensor.get_shape()[0] - 1) / 2;
-      if (layer_data.contains("padding")) {
-        if (layer_data["padding"] == "valid") {
+      auto padding = layer_data.attributes.find("padding");
+      if (padding != layer_data.attributes.end()) {
+        if (padding->second == "valid") {
           pads = 0;
         }
       }
@@ -69,10 +81,16 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
         std::cout << std::endl;
       }
 
+      size_t group = 1;
+      auto group_attribute = layer_data.attributes.find("group");
+      if (group_attribute != layer_data.attributes.end()) {
+        group = std::stoul(group_attribute->second);
+      }
+
       it_lab_ai::Tensor tmp_values = tensor;
       it_lab_ai::Tensor tmp_bias = it_lab_ai::make_tensor(tensor.get_bias());
       auto conv_layer = std::make_shared<it_lab_ai::ConvolutionalLayer>(
-          1, pads, 1, tmp_values, tmp_bias, impl2);
+          1, pads, 1, tmp_values, tmp_bias, impl2, group);
       conv_layer->setName(it_lab_ai::kConvolution);
       layers.push_back(conv_layer);
       layerpostop.push_back(false);
@@ -175,8 +193,20 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
   graph.setOutput(*layers.back(), output);
   if (comments) std::cout << "Output set in graph." << std::endl;
 
+  graph.fuse();
+  it_lab_ai::LayoutStats layouts = graph.propagate_layouts();
+  if (comments)
+    std::cout << "NHWC layers: " << layouts.nhwc_layers
+              << ", reorders: " << layouts.reorders << " ("
+              << layouts.reorders_eliminated << " eliminated)" << std::endl;
+  if (calibration.get_shape().dims() != 0) {
+    size_t quantized = graph.quantize({calibration});
+    if (comments) std::cout << "Int8 layers: " << quantized << std::endl;
+  }
   if (comments) std::cout << "Starting inference..." << std::endl;
+  auto start = std::chrono::high_resolution_clock::now();
   graph.inference();
+  auto end = std::chrono::high_resolution_clock::now();
 #ifdef ENABLE_STATISTIC_TIME
   std::vector<std::string> times = graph.getTimeInfo();
   std::cout << "!INFERENCE TIME INFO START!" << std::endl;
@@ -188,7 +218,20 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
   std::cout << "Elapsed inference time:" << sum << std::endl;
   std::cout << "!INFERENCE TIME INFO END!" << std::endl;
 #endif
+  const it_lab_ai::Profiler& profiler = graph.profiler();
+  if (profiler.enabled()) {
+    profiler.write_summary(std::cout);
+    if (!profiler.trace_path().empty()) {
+      std::ofstream trace(profiler.trace_path());
+      profiler.write_chrome_trace(trace);
+      std::cout << "Chrome trace written to " << profiler.trace_path()
+                << std::endl;
+    }
+  }
   if (comments) std::cout << "Inference completed." << std::endl;
+  if (comments)
+    std::cout << "Peak intermediate memory: " << graph.getPeakMemory()
+              << " bytes" << std::endl;
   if (comments) {
     std::vector<float> tmp_output =
         it_lab_ai::softmax<float>(*output.as<float>());
@@ -200,4 +243,5 @@ void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
       }
     }
   }
-}
\ No newline at end of file
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
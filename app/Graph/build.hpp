@@ -1,10 +1,13 @@
+#include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include <stdexcept>
 #include <variant>
 #include <vector>
 
+#include "Weights_Reader/binary_weights.hpp"
 #include "Weights_Reader/reader_weights.hpp"
 #include "graph/graph.hpp"
 #include "layers/ConvLayer.hpp"
@@ -16,5 +19,8 @@
 #include "layers/OutputLayer.hpp"
 #include "layers/PoolingLayer.hpp"
 
-void build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
-                 bool comments, bool parallel);
+// returns the time of the inference in ms. With a calibration tensor the
+// graph is quantized to int8 before (see Graph::quantize)
+double build_graph(it_lab_ai::Tensor& input, it_lab_ai::Tensor& output,
+                   bool comments, bool parallel,
+                   const it_lab_ai::Tensor& calibration);
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Weights_Reader/reader_weights.hpp"
+#include "layers/Tensor.hpp"
+
+namespace it_lab_ai {
+
+// Binary model container written by the Json_to_binary converter:
+//   "ITLABWTS", uint32 version, uint32 layer count, uint64 data offset,
+//   layer records (index, name, type, attributes, weights shape, offsets
+//   and sizes of the weights and bias blobs), then raw little-endian float
+//   blobs, each aligned to kTensorAlignment.
+// Loading reads the records, then every blob straight into the storage of
+// its tensor, no text is parsed.
+constexpr char kBinaryWeightsMagic[8] = {'I', 'T', 'L', 'A',
+                                         'B', 'W', 'T', 'S'};
+constexpr uint32_t kBinaryWeightsVersion = 1;
+
+struct LayerRecord {
+  int64_t index = 0;
+  std::string name;
+  std::string type;
+  // other scalar fields of the layer (e.g. padding) as strings
+  std::map<std::string, std::string> attributes;
+  // weights with bias, as made by create_tensor_from_json
+  Tensor tensor;
+};
+
+// layers of a JSON model produced by app/Converters
+std::vector<LayerRecord> read_layers_from_json(const json& model_data);
+void write_binary_weights(const json& model_data, const std::string& filename);
+std::vector<LayerRecord> read_binary_weights(const std::string& filename);
+// path of the binary model next to a JSON one (extension replaced by .bin)
+std::string binary_weights_path(const std::string& json_filename);
+
+}  // namespace it_lab_ai
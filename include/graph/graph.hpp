@@ -1,38 +1,568 @@
 
 #pragma once
 #include <algorithm>
-#include <chrono>
+#include <functional>
+#include <memory>
 #include <queue>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "graph/memory_planner.hpp"
+#include "graph/profiler.hpp"
 #include "layers/Layer.hpp"
+#include "oneapi/tbb/flow_graph.h"
 
 namespace it_lab_ai {
 
+// what Graph::propagate_layouts() did: the layers switched to kNhwc, the
+// reorders left at the borders of their regions and how many fewer these
+// are than with every layer preferring kNhwc running in it on its own
+struct LayoutStats {
+  size_t nhwc_layers = 0;
+  size_t reorders = 0;
+  size_t reorders_eliminated = 0;
+};
+
 class Graph {
   int BiggestSize_;
   int V_;
   std::vector<Layer*> layers_;
   std::vector<int> arrayV_;
   std::vector<int> arrayE_;
+  // predecessors of every vertex in connection order, it is the order of
+  // the inputs of multi-input layers
+  std::vector<std::vector<int>> inputs_;
   Tensor inten_;
   Tensor* outten_;
   int start_;
   int end_;
+  // vertices on the paths from start_ to end_ in topological order,
+  // end_ is the last one
+  std::vector<int> order_;
+  // position of every vertex in order_, -1 if it isn't executed
+  std::vector<int> position_;
+  // ancestors_[k][j] is set when the vertex at position j runs before the
+  // one at position k along the data edges
+  std::vector<std::vector<bool>> ancestors_;
+  // outputs of the vertex at position k live in a planned buffer from
+  // step k until its last consumer, the output of end_ is not planned
+  std::vector<TensorLifetime> lifetimes_;
+  std::vector<size_t> output_bytes_;
+  // position of the vertex whose output storage the output at a position
+  // took over (fused and in-place vertices), -1 if it has its own
+  std::vector<int> aliases_;
+  std::vector<int> planned_aliases_;
+  MemoryPlan memory_plan_;
+  // the planned buffers are ranges of the arena, a vertex is handed the
+  // range of its buffer as output storage when nothing else holds it
+  std::shared_ptr<TensorStorage> arena_;
+  std::vector<std::shared_ptr<AllocationRegion>> regions_;
+  std::vector<std::vector<Tensor>> buffers_;
+  // bytes of the output at a position that its layer allocated outside of
+  // the arena, and the peak memory they and the arena took
+  std::vector<size_t> outside_bytes_;
+  size_t peak_memory_ = 0;
+  std::vector<Tensor> end_outputs_;
+  // vertices folded into their producer by fuse() pass its output on
+  std::vector<bool> fused_;
+  Profiler profiler_;
+  // records of the vertex at every position in the running inference
+  std::vector<std::vector<LayerProfile>> vertex_profiles_;
 #ifdef ENABLE_STATISTIC_TENSORS
   std::vector<Tensor> tensors_;
+  std::vector<std::vector<Tensor>> vertex_tensors_;
 #endif
 #ifdef ENABLE_STATISTIC_TIME
   std::vector<int> time_;
-  std::vector<LayerType> time_layer_;
+  std::vector<std::string> time_layer_;
 #endif
 #ifdef ENABLE_STATISTIC_WEIGHTS
   std::vector<Tensor> weights_;
 #endif
 
+  std::vector<bool> reachable(int from, bool forward) const {
+    std::vector<bool> visited(V_, false);
+    std::queue<int> q;
+    q.push(from);
+    visited[from] = true;
+    while (!q.empty()) {
+      int current = q.front();
+      q.pop();
+      std::vector<int> next;
+      if (forward) {
+        next.assign(arrayE_.begin() + arrayV_[current],
+                    arrayE_.begin() + arrayV_[current + 1]);
+      } else {
+        next = inputs_[current];
+      }
+      for (int neighbor : next) {
+        if (!visited[neighbor]) {
+          q.push(neighbor);
+          visited[neighbor] = true;
+        }
+      }
+    }
+    return visited;
+  }
+  // executed successors of a vertex in connection order
+  std::vector<int> consumers(int vertex) const {
+    std::vector<int> res;
+    for (int ind = arrayV_[vertex]; ind < arrayV_[vertex + 1]; ind++) {
+      if (position_[arrayE_[ind]] >= 0) {
+        res.push_back(arrayE_[ind]);
+      }
+    }
+    return res;
+  }
+  // edges between live vertices of different layouts, plus the graph
+  // input and output if an NHWC vertex reads or writes them
+  size_t count_reorders(const std::vector<bool>& nhwc,
+                        const std::vector<bool>& live) const {
+    size_t reorders = (nhwc[start_] ? 1 : 0) + (nhwc[end_] ? 1 : 0);
+    for (int v = 0; v < V_; v++) {
+      if (!live[v]) {
+        continue;
+      }
+      for (int ind = arrayV_[v]; ind < arrayV_[v + 1]; ind++) {
+        if (live[arrayE_[ind]] && nhwc[arrayE_[ind]] != nhwc[v]) {
+          reorders++;
+        }
+      }
+    }
+    return reorders;
+  }
+  // first vertex of a chain of fused vertices ending at vertex
+  int fusion_root(int vertex) const {
+    while (fused_[vertex]) {
+      vertex = inputs_[vertex][0];
+    }
+    return vertex;
+  }
+  // true if the layer of root may take over the work of vertex fed by the
+  // chain from root: nobody else reads the values in between and the
+  // layer has no postops, which would run before the fused work
+  bool can_fold(int root, int vertex) const {
+    for (int v = inputs_[vertex][0]; v != root; v = inputs_[v][0]) {
+      if (arrayV_[v + 1] - arrayV_[v] != 1) {
+        return false;
+      }
+    }
+    return root != start_ && arrayV_[root + 1] - arrayV_[root] == 1 &&
+           layers_[root]->postops.count == 0;
+  }
+  // vertex = add(inputs_[vertex][operand], residual), the residual edge is
+  // moved to the root of the operand in place, so a multi-output producer
+  // of the residual keeps its output order
+  bool fold_residual_add(int vertex, size_t operand) {
+    int producer = inputs_[vertex][operand];
+    int residual = inputs_[vertex][1 - operand];
+    int root = fusion_root(producer);
+    if (!can_fold(root, vertex) || inputs_[root].size() != 1 ||
+        residual == root ||
+        std::find(inputs_[root].begin(), inputs_[root].end(), residual) !=
+            inputs_[root].end() ||
+        reachable(root, true)[residual] ||
+        !layers_[root]->fuse_residual_add()) {
+      return false;
+    }
+    auto first = arrayE_.begin() + arrayV_[residual];
+    auto last = arrayE_.begin() + arrayV_[residual + 1];
+    *std::find(first, last, vertex) = root;
+    inputs_[root].push_back(residual);
+    inputs_[vertex] = {producer};
+    return true;
+  }
+  // keeps the vertices lying on a path from start_ to end_ and sorts them
+  // topologically, returns true if the set or the order changed
+  bool build_order() {
+    std::vector<bool> from_start = reachable(start_, true);
+    std::vector<bool> to_end = reachable(end_, false);
+    std::vector<int> in_degree(V_, 0);
+    std::vector<int> order;
+    std::queue<int> q;
+    for (int v = 0; v < V_; v++) {
+      if (!from_start[v] || !to_end[v]) {
+        continue;
+      }
+      for (int pred : inputs_[v]) {
+        if (from_start[pred] && to_end[pred]) {
+          in_degree[v]++;
+        }
+      }
+      if (in_degree[v] == 0) {
+        q.push(v);
+      }
+    }
+    while (!q.empty()) {
+      int current = q.front();
+      q.pop();
+      order.push_back(current);
+      for (int ind = arrayV_[current]; ind < arrayV_[current + 1]; ind++) {
+        int neighbor = arrayE_[ind];
+        if (from_start[neighbor] && to_end[neighbor] &&
+            --in_degree[neighbor] == 0) {
+          q.push(neighbor);
+        }
+      }
+    }
+    if (std::any_of(in_degree.begin(), in_degree.end(),
+                    [](int degree) { return degree > 0; })) {
+      throw std::runtime_error("Graph has a cycle");
+    }
+    if (order == order_) {
+      return false;
+    }
+    order_ = order;
+    position_.assign(V_, -1);
+    ancestors_.assign(order_.size(), std::vector<bool>(order_.size()));
+    for (size_t pos = 0; pos < order_.size(); pos++) {
+      position_[order_[pos]] = static_cast<int>(pos);
+      for (int pred : inputs_[order_[pos]]) {
+        if (position_[pred] >= 0) {
+          std::vector<bool>& ancestors = ancestors_[pos];
+          const std::vector<bool>& inherited = ancestors_[position_[pred]];
+          for (size_t j = 0; j < pos; j++) {
+            ancestors[j] = ancestors[j] || inherited[j];
+          }
+          ancestors[position_[pred]] = true;
+        }
+      }
+    }
+    return true;
+  }
+  // an output taken over by a later vertex lives until the last use of
+  // that vertex's output, which is not counted again. A buffer goes to a
+  // later vertex only once its previous tenant and all readers of that are
+  // ancestors of the vertex, so no extra edges are needed to keep them from
+  // overlapping and independent branches keep running in parallel.
+  void plan_buffers() {
+    std::vector<TensorLifetime> lifetimes(lifetimes_.size());
+    for (size_t pos = lifetimes_.size(); pos-- > 0;) {
+      lifetimes_[pos].bytes = output_bytes_[pos];
+      lifetimes[pos].first_use = lifetimes_[pos].first_use;
+      lifetimes[pos].last_use =
+          std::max(lifetimes_[pos].last_use, lifetimes[pos].last_use);
+      lifetimes[pos].bytes = aliases_[pos] >= 0 ? 0 : output_bytes_[pos];
+      if (aliases_[pos] >= 0) {
+        TensorLifetime& owner = lifetimes[aliases_[pos]];
+        owner.last_use = std::max(owner.last_use, lifetimes[pos].last_use);
+      }
+    }
+    planned_aliases_ = aliases_;
+    memory_plan_ = plan_memory(lifetimes, [this](size_t previous, size_t pos) {
+      if (!ancestors_[pos][previous]) {
+        return false;
+      }
+      std::vector<int> readers = consumers(order_[previous]);
+      return std::all_of(readers.begin(), readers.end(), [&](int reader) {
+        return ancestors_[pos][position_[reader]];
+      });
+    });
+    // tensors still in the old arena keep it alive until they are dropped
+    buffers_.assign(memory_plan_.buffer_sizes.size(), std::vector<Tensor>());
+    arena_ = std::make_shared<TensorStorage>(memory_plan_.arena_size);
+    regions_.clear();
+    for (size_t b = 0; b < memory_plan_.buffer_sizes.size(); b++) {
+      auto region = std::make_shared<AllocationRegion>();
+      region->data = arena_->data() + memory_plan_.buffer_offsets[b];
+      region->bytes = memory_plan_.buffer_sizes[b];
+      region->owner = arena_;
+      regions_.push_back(std::move(region));
+    }
+  }
+  bool in_arena(const Tensor& tensor) const {
+    const TensorStorage& values = tensor.get_values();
+    std::less_equal<const uint8_t*> not_after;
+    return arena_ && !values.empty() &&
+           not_after(arena_->data(), values.data()) &&
+           not_after(values.data() + values.size(),
+                     arena_->data() + arena_->size());
+  }
+  // the arena and, by the planned lifetimes, the intermediates that were
+  // allocated outside of it
+  size_t measure_peak_memory() const {
+    size_t planned = lifetimes_.size();
+    std::vector<size_t> last_use(planned);
+    for (size_t pos = planned; pos-- > 0;) {
+      last_use[pos] = std::max(last_use[pos], lifetimes_[pos].last_use);
+      if (aliases_[pos] >= 0) {
+        size_t& owner = last_use[aliases_[pos]];
+        owner = std::max(owner, last_use[pos]);
+      }
+    }
+    size_t outside_peak = 0;
+    for (size_t step = 0; step < planned; step++) {
+      size_t live = 0;
+      for (size_t pos = 0; pos <= step; pos++) {
+        if (step <= last_use[pos]) {
+          live += outside_bytes_[pos];
+        }
+      }
+      outside_peak = std::max(outside_peak, live);
+    }
+    return memory_plan_.arena_size + outside_peak;
+  }
+  std::vector<Tensor>& vertex_outputs(int vertex) {
+    if (vertex == end_) {
+      return end_outputs_;
+    }
+    return buffers_[memory_plan_.buffers[position_[vertex]]];
+  }
+  // output of producer read by consumer, the successors of a multi-output
+  // layer get its outputs in connection order
+  const Tensor& vertex_output(int producer, int consumer) {
+    if (producer == -1) {
+      return inten_;
+    }
+    const std::vector<Tensor>& outputs = vertex_outputs(producer);
+    if (outputs.size() == 1) {
+      return outputs[0];
+    }
+    auto first = arrayE_.begin() + arrayV_[producer];
+    auto last = arrayE_.begin() + arrayV_[producer + 1];
+    auto index = static_cast<size_t>(std::find(first, last, consumer) - first);
+    if (index >= outputs.size()) {
+      throw std::runtime_error("Layer has fewer outputs than successors");
+    }
+    return outputs[index];
+  }
+  // output of producer for its only reader consumer is moved out of the
+  // producer's buffer, so an in-place consumer owns its storage alone
+  Tensor take_output(int producer, int consumer) {
+    if (producer == -1 || consumers(producer).size() != 1 ||
+        vertex_outputs(producer).size() != 1) {
+      return vertex_output(producer, consumer);
+    }
+    return std::move(vertex_outputs(producer)[0]);
+  }
+  // a permuted view is materialized here unless the layer reads strides
+  static Tensor layer_input(const Layer& layer, const Tensor& input) {
+    if (input.is_contiguous() || layer.accepts_strided_input()) {
+      return input;
+    }
+    return input.contiguous();
+  }
+  static void run_layer(Layer& layer, const Tensor& input, Tensor& output) {
+    if (input.is_contiguous() || layer.accepts_strided_input()) {
+      layer.run(input, output);
+    } else {
+      layer.run(input.contiguous(), output);
+    }
+  }
+  // counters_start is null when the profiler doesn't count
+  LayerProfile profile(const Layer& layer, int vertex, int postop,
+                       int64_t start,
+                       const CounterValues* counters_start) const {
+    LayerProfile record;
+    record.name = layer.name();
+    record.vertex = vertex;
+    record.postop = postop;
+    record.start_ns = start;
+    record.duration_ns = profiler_.now() - start;
+    record.thread = tbb::this_task_arena::current_thread_index();
+    record.threads = tbb::this_task_arena::max_concurrency();
+    if (counters_start != nullptr) {
+      record.counted = profiler_.counter_mask();
+      record.counters = profiler_.read_counters() - *counters_start;
+    }
+    return record;
+  }
+  // every vertex of order_ as a node that waits for its inputs
+  void run_flow_graph() {
+    using FlowNode = tbb::flow::continue_node<tbb::flow::continue_msg>;
+    tbb::flow::graph flow;
+    std::vector<std::unique_ptr<FlowNode>> nodes;
+    for (int vertex : order_) {
+      nodes.push_back(std::make_unique<FlowNode>(
+          flow,
+          [this, vertex](const tbb::flow::continue_msg&) {
+            run_vertex(vertex);
+          }));
+    }
+    for (size_t pos = 0; pos < order_.size(); pos++) {
+      for (int pred : inputs_[order_[pos]]) {
+        if (position_[pred] >= 0) {
+          tbb::flow::make_edge(*nodes[position_[pred]], *nodes[pos]);
+        }
+      }
+    }
+    nodes.front()->try_put(tbb::flow::continue_msg());
+    flow.wait_for_all();
+  }
+  void run_vertex(int vertex) {
+    bool profiling = profiler_.enabled();
+    bool counting = profiling && profiler_.counting();
+    CounterValues counters_start;
+    if (counting) {
+      counters_start = profiler_.read_counters();
+    }
+    int64_t start = profiling ? profiler_.now() : 0;
+    Layer& layer = *layers_[vertex];
+    std::vector<int> producers;
+    if (vertex == start_) {
+      producers.push_back(-1);
+    }
+    for (int pred : inputs_[vertex]) {
+      if (position_[pred] >= 0) {
+        producers.push_back(pred);
+      }
+    }
+#ifdef ENABLE_STATISTIC_TENSORS
+    // taken before in-place layers overwrite the inputs
+    std::vector<Tensor>& stat = vertex_tensors_[position_[vertex]];
+    stat.clear();
+    for (int producer : producers) {
+      stat.push_back(vertex_output(producer, vertex));
+    }
+#endif
+    std::vector<Tensor>& outputs = vertex_outputs(vertex);
+    bool folded = fused_[vertex];
+    bool in_place = !folded && layer.supports_inplace();
+    if (vertex != end_ && !folded && !in_place) {
+      const std::shared_ptr<AllocationRegion>& region =
+          regions_[memory_plan_.buffers[position_[vertex]]];
+      if (region->bytes > 0 && !region->in_use) {
+        outputs.assign(1, Tensor(region->bytes,
+                                 AlignedAllocator<uint8_t>(region)));
+      }
+    }
+    bool multi_io = !folded && (producers.size() != 1 ||
+                                arrayV_[vertex + 1] - arrayV_[vertex] > 1);
+    // storage of the first input, an output in it was made in place
+    const uint8_t* input_storage = nullptr;
+    // for the profile, taken before in-place layers overwrite the inputs
+    size_t bytes_read = 0;
+    Shape input_shape;
+    auto note_inputs = [&](const std::vector<Tensor>& inputs) {
+      if (!profiling) {
+        return;
+      }
+      for (const Tensor& input : inputs) {
+        bytes_read += input.get_values().size();
+      }
+      input_shape = inputs[0].get_shape();
+    };
+    Tensor* main_output;
+    if (folded) {
+      // the producer already did the work, its storage is passed on
+      outputs.resize(1);
+      main_output = vertex == end_ ? outten_ : outputs.data();
+      *main_output = take_output(producers[0], vertex);
+      input_storage = main_output->get_values().data();
+    } else if (in_place) {
+      std::vector<Tensor> inputs;
+      for (int producer : producers) {
+        inputs.push_back(layer_input(layer, take_output(producer, vertex)));
+      }
+      input_storage = inputs[0].get_values().data();
+      note_inputs(inputs);
+      layer.run_multi_inplace(inputs, outputs);
+      main_output = outputs.data();
+    } else if (multi_io) {
+      std::vector<Tensor> inputs;
+      for (int producer : producers) {
+        inputs.push_back(layer_input(layer, vertex_output(producer, vertex)));
+      }
+      note_inputs(inputs);
+      layer.run_multi(inputs, outputs);
+      main_output = outputs.data();
+    } else {
+      outputs.resize(1);
+      main_output = vertex == end_ ? outten_ : outputs.data();
+      const Tensor& input = vertex_output(producers[0], vertex);
+      if (profiling) {
+        bytes_read = input.get_values().size();
+        input_shape = input.get_shape();
+      }
+      run_layer(layer, input, *main_output);
+    }
+    std::vector<LayerProfile>* records = nullptr;
+    if (profiling) {
+      records = &vertex_profiles_[position_[vertex]];
+      records->clear();
+      LayerProfile record = profile(layer, vertex, -1, start,
+                                    counting ? &counters_start : nullptr);
+      if (!folded) {
+        record.bytes_read = bytes_read + layer.weight_bytes();
+        if (main_output == outputs.data()) {
+          for (const Tensor& output : outputs) {
+            record.bytes_written += output.get_values().size();
+          }
+        } else {
+          record.bytes_written = main_output->get_values().size();
+        }
+        record.flops = layer.flops(input_shape, main_output->get_shape());
+      }
+      records->push_back(std::move(record));
+    }
+#ifdef ENABLE_STATISTIC_TENSORS
+    stat.push_back(*main_output);
+#endif
+    if (layer.postops.count > 0) {
+      if (outputs.size() != 1) {
+        throw std::runtime_error("Postops need a single output layer");
+      }
+      Tensor tmp;
+      for (unsigned int j = 0; j < layer.postops.count; j++) {
+        const Layer& postop = *layer.postops.layers[j];
+        if (counting) {
+          counters_start = profiler_.read_counters();
+        }
+        int64_t postop_start = profiling ? profiler_.now() : 0;
+        run_layer(*layer.postops.layers[j], *main_output, tmp);
+        if (profiling) {
+          LayerProfile record =
+              profile(postop, vertex, static_cast<int>(j), postop_start,
+                      counting ? &counters_start : nullptr);
+          record.bytes_read =
+              main_output->get_values().size() + postop.weight_bytes();
+          record.bytes_written = tmp.get_values().size();
+          record.flops =
+              postop.flops(main_output->get_shape(), tmp.get_shape());
+          records->push_back(std::move(record));
+        }
+        std::swap(*main_output, tmp);
+      }
+    }
+    if (vertex == end_) {
+      if (in_place || multi_io) {
+        *outten_ = std::move(outputs[0]);
+      }
+      // NHWC views of the kNhwc layers, see propagate_layouts()
+      if (!outten_->is_contiguous()) {
+        *outten_ = outten_->contiguous();
+      }
+      // storage taken over from a buffer of the arena is copied, the
+      // buffer would be missing from the next inference otherwise
+      if (in_arena(*outten_)) {
+        Tensor copy;
+        const TensorStorage& values = outten_->get_values();
+        std::copy(values.begin(), values.end(),
+                  copy.reset(outten_->get_shape(), outten_->get_type())
+                      .begin());
+        *outten_ = std::move(copy);
+      }
+    } else {
+      size_t bytes = 0;
+      size_t outside = 0;
+      for (const Tensor& output : outputs) {
+        bytes += output.get_values().size();
+        if (!in_arena(output)) {
+          outside += output.get_values().size();
+        }
+      }
+      int pos = position_[vertex];
+      output_bytes_[pos] = bytes;
+      bool alias = outputs.size() == 1 && input_storage != nullptr &&
+                   producers[0] != -1 &&
+                   outputs[0].get_values().data() == input_storage;
+      aliases_[pos] = alias ? position_[producers[0]] : -1;
+      outside_bytes_[pos] = alias ? 0 : outside;
+    }
+  }
+
  public:
   Graph(int vertices) : BiggestSize_(vertices) {
     if (BiggestSize_ < 0) {
@@ -40,29 +570,40 @@ class Graph {
     }
     arrayV_.push_back(0);
     V_ = 0;
+#ifdef ENABLE_STATISTIC_TIME
+    profiler_.enable(true);
+#endif
   }
   void setInput(Layer& lay, Tensor& vec) {
     lay.setID(0);
     layers_.push_back(&lay);
     arrayV_.push_back(0);
+    inputs_.emplace_back();
+    fused_.push_back(false);
     inten_ = vec;
     start_ = lay.getID();
     V_++;
   }
+  // a layer connected again gets one more input instead of a new vertex
   void makeConnection(const Layer& layPrev, Layer& layNext) {
-    layNext.setID(V_);
-    layers_.push_back(&layNext);
-    arrayV_[V_] = arrayV_[V_ - 1];
-    arrayV_.push_back(static_cast<int>(arrayE_.size()));
-    if (layPrev.getID() == layNext.getID()) {
+    if (&layPrev == &layNext) {
       throw std::out_of_range("i=j cant add edge");
     }
-    for (int ind = 1;
-         ind < static_cast<int>(arrayV_.size()) - layPrev.getID() - 1; ind++)
-      arrayV_[layPrev.getID() + ind]++;
-    arrayE_.insert(arrayE_.begin() + arrayV_[layPrev.getID()], layNext.getID());
-    V_++;
-    arrayV_[V_] = static_cast<int>(arrayE_.size());
+    if (std::find(layers_.begin(), layers_.end(), &layNext) ==
+        layers_.end()) {
+      layNext.setID(V_);
+      layers_.push_back(&layNext);
+      arrayV_.push_back(static_cast<int>(arrayE_.size()));
+      inputs_.emplace_back();
+      fused_.push_back(false);
+      V_++;
+    }
+    arrayE_.insert(arrayE_.begin() + arrayV_[layPrev.getID() + 1],
+                   layNext.getID());
+    for (int ind = layPrev.getID() + 1; ind <= V_; ind++) {
+      arrayV_[ind]++;
+    }
+    inputs_[layNext.getID()].push_back(layPrev.getID());
   }
   bool areLayerNext(const Layer& layPrev, const Layer& layNext) {
     for (int i = arrayV_[layPrev.getID()]; i < arrayV_[layPrev.getID() + 1];
@@ -73,78 +614,247 @@ class Graph {
     }
     return false;
   }
-  void inference() {
-    std::queue<int> q;
+  // Operator fusion pass, run once before inference. Element-wise layers
+  // (also postops) and elementwise adds are folded into the layer producing
+  // their input when it can apply them to its output tiles while storing
+  // them: Conv/FC + activation and Conv + residual add (+ activation).
+  // Folded vertices stay in the graph and pass the fused output on.
+  // The layers are changed, they keep computing the fused function.
+  void fuse() {
+    for (int vertex = 0; vertex < V_; vertex++) {
+      Layer& layer = *layers_[vertex];
+      while (layer.postops.count > 0) {
+        Activation activation = layer.postops.layers[0]->fusable_activation();
+        if (activation.empty() || !layer.fuse_activation(activation)) {
+          break;
+        }
+        layer.postops.layers.erase(layer.postops.layers.begin());
+        layer.postops.count--;
+      }
+    }
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int vertex = 0; vertex < V_; vertex++) {
+        Layer& layer = *layers_[vertex];
+        if (fused_[vertex] || vertex == start_ || layer.postops.count > 0) {
+          continue;
+        }
+        Activation activation = layer.fusable_activation();
+        if (!activation.empty() && inputs_[vertex].size() == 1) {
+          int root = fusion_root(inputs_[vertex][0]);
+          if (can_fold(root, vertex) &&
+              layers_[root]->fuse_activation(activation)) {
+            fused_[vertex] = true;
+          }
+        } else if (layer.is_elementwise_add() &&
+                   inputs_[vertex].size() == 2) {
+          fused_[vertex] =
+              fold_residual_add(vertex, 0) || fold_residual_add(vertex, 1);
+        }
+        changed = changed || fused_[vertex];
+      }
+    }
+    order_.clear();
+  }
+  // Layout pass, run after fuse() and before the first inference. Layers
+  // that support kNhwc and are connected by edges form regions (folded
+  // vertices go with their producer), the regions with a layer preferring
+  // kNhwc are switched to it. Inside a region the 4D data stays in NHWC
+  // order, it is reordered once at every edge crossing the border and
+  // before the graph output.
+  LayoutStats propagate_layouts() {
+    std::vector<bool> from_start = reachable(start_, true);
+    std::vector<bool> to_end = reachable(end_, false);
+    std::vector<bool> live(V_);
+    std::vector<bool> supported(V_);
+    std::vector<bool> preferred(V_);
+    for (int v = 0; v < V_; v++) {
+      int root = fusion_root(v);
+      live[v] = from_start[v] && to_end[v];
+      supported[v] = live[v] && layers_[root]->supports_layout(kNhwc);
+      preferred[v] = supported[v] && layers_[root]->prefers_layout(kNhwc);
+    }
+    std::vector<bool> nhwc(V_, false);
     std::vector<bool> visited(V_, false);
-    std::vector<int> parent(V_, -1);
-    std::vector<int> traversal;
-    q.push(start_);
-    visited[start_] = true;
-    while (!q.empty()) {
-      int current = q.front();
-      q.pop();
-      if (current == end_) {
-        int node = current;
-        while (node != -1) {
-          traversal.push_back(node);
-          node = parent[node];
+    for (int first = 0; first < V_; first++) {
+      if (!supported[first] || visited[first]) {
+        continue;
+      }
+      std::vector<int> region = {first};
+      visited[first] = true;
+      bool keep = false;
+      for (size_t k = 0; k < region.size(); k++) {
+        int current = region[k];
+        keep = keep || preferred[current];
+        std::vector<int> next(arrayE_.begin() + arrayV_[current],
+                              arrayE_.begin() + arrayV_[current + 1]);
+        next.insert(next.end(), inputs_[current].begin(),
+                    inputs_[current].end());
+        for (int neighbor : next) {
+          if (supported[neighbor] && !visited[neighbor]) {
+            visited[neighbor] = true;
+            region.push_back(neighbor);
+          }
         }
-        std::reverse(traversal.begin(), traversal.end());
-        break;
       }
-      for (int ind = arrayV_[current]; ind < arrayV_[current + 1]; ind++) {
-        int neighbor = arrayE_[ind];
-        if (!visited[neighbor]) {
-          q.push(neighbor);
-          visited[neighbor] = true;
-          parent[neighbor] = current;
+      for (int v : region) {
+        nhwc[v] = keep;
+      }
+    }
+    LayoutStats stats;
+    for (int v = 0; v < V_; v++) {
+      if (nhwc[v] && !fused_[v]) {
+        layers_[v]->set_layout(kNhwc);
+        stats.nhwc_layers++;
+      }
+    }
+    stats.reorders = count_reorders(nhwc, live);
+    // the same layers in NHWC each with only its own folded vertices
+    size_t isolated = count_reorders(preferred, live);
+    if (isolated > stats.reorders) {
+      stats.reorders_eliminated = isolated - stats.reorders;
+    }
+    return stats;
+  }
+  // Post-training int8 quantization, run after fuse() and
+  // propagate_layouts(). Every calibration input goes through inference()
+  // while the layers with int8 kernels record the range of their inputs,
+  // then they switch to those kernels (see Layer::quantize). The graph
+  // input is restored, the output is the one of the last calibration
+  // input. Returns the number of layers now running in int8.
+  size_t quantize(const std::vector<Tensor>& calibration_inputs) {
+    std::vector<Layer*> calibrating;
+    for (Layer* layer : layers_) {
+      if (layer->start_calibration()) {
+        calibrating.push_back(layer);
+      }
+    }
+    Tensor input = inten_;
+    for (const Tensor& calibration_input : calibration_inputs) {
+      inten_ = calibration_input;
+      inference();
+    }
+    inten_ = input;
+    size_t quantized = 0;
+    for (Layer* layer : calibrating) {
+      if (layer->quantize()) {
+        quantized++;
+      }
+    }
+    return quantized;
+  }
+  // Stores the float weights of the layers that support it as kFloat16 or
+  // kBFloat16, halving their memory and the bandwidth of reading them,
+  // while the layers keep computing in float (see Layer::compress_weights).
+  // Returns the number of layers that did.
+  size_t compress_weights(Type type) {
+    size_t compressed = 0;
+    for (Layer* layer : layers_) {
+      if (layer->compress_weights(type)) {
+        compressed++;
+      }
+    }
+    return compressed;
+  }
+  // Runs every layer on a path from the input to the output layer as a
+  // node of a oneTBB flow graph, so independent branches run in parallel,
+  // unless the profiler counts hardware events, then one at a time.
+  // The nodes only wait for their inputs, the buffer plan keeps reused
+  // buffers to vertices that follow every reader of the previous tenant.
+  void inference() {
+    bool order_changed = build_order();
+    if (order_.empty()) {
+      return;
+    }
+    if (order_changed) {
+      size_t planned = order_.size() - 1;
+      lifetimes_.assign(planned, TensorLifetime());
+      output_bytes_.assign(planned, 0);
+      outside_bytes_.assign(planned, 0);
+      aliases_.assign(planned, -1);
+      for (size_t pos = 0; pos < planned; pos++) {
+        lifetimes_[pos].first_use = pos;
+        for (int consumer : consumers(order_[pos])) {
+          lifetimes_[pos].last_use =
+              std::max(lifetimes_[pos].last_use,
+                       static_cast<size_t>(position_[consumer]));
         }
       }
+      plan_buffers();
     }
-    for (int i : traversal) {
-#ifdef ENABLE_STATISTIC_TIME
-      auto start = std::chrono::high_resolution_clock::now();
+#ifdef ENABLE_STATISTIC_TENSORS
+    vertex_tensors_.assign(order_.size(), std::vector<Tensor>());
 #endif
-      layers_[i]->run(inten_, *outten_);
+    bool profiling = profiler_.enabled();
+    if (profiling) {
+      vertex_profiles_.assign(order_.size(), std::vector<LayerProfile>());
+    }
+    if (profiling && profiler_.counting()) {
+      // the counters sum over all threads (see PerfCounters), so a record
+      // only covers its own layer when no other layer runs beside it
+      for (int vertex : order_) {
+        run_vertex(vertex);
+      }
+    } else {
+      run_flow_graph();
+    }
+    if (profiling) {
+      std::vector<LayerProfile> records;
+      for (const std::vector<LayerProfile>& vertex_records : vertex_profiles_) {
+        records.insert(records.end(), vertex_records.begin(),
+                       vertex_records.end());
+      }
+      profiler_.add_iteration(std::move(records));
+    }
+    for (size_t pos = 0; pos < order_.size(); pos++) {
 #ifdef ENABLE_STATISTIC_TENSORS
-      tensors_.push_back(inten_);
-      tensors_.push_back(*outten_);
+      tensors_.insert(tensors_.end(), vertex_tensors_[pos].begin(),
+                      vertex_tensors_[pos].end());
 #endif
 #ifdef ENABLE_STATISTIC_WEIGHTS
-      weights_.push_back(layers_[i]->get_weights());
+      weights_.push_back(layers_[order_[pos]]->get_weights());
 #endif
-      inten_ = *outten_;
-      if (layers_[i]->postops.count > 0) {
-        for (unsigned int j = 0; j < layers_[i]->postops.count; j++) {
-          layers_[i]->postops.layers[j]->run(inten_, *outten_);
+#ifdef ENABLE_STATISTIC_TIME
+      if (profiling) {
+        int64_t ns = 0;
+        for (const LayerProfile& record : vertex_profiles_[pos]) {
+          ns += record.duration_ns;
         }
-        inten_ = *outten_;
+        time_.push_back(static_cast<int>(ns / 1000000));
+        time_layer_.push_back(layers_[order_[pos]]->name());
       }
-#ifdef ENABLE_STATISTIC_TIME
-      auto end = std::chrono::high_resolution_clock::now();
-      auto elapsed =
-          std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-      time_.push_back(static_cast<int>(elapsed.count()));
-      time_layer_.push_back(layers_[i]->getName());
 #endif
     }
+    peak_memory_ = measure_peak_memory();
+    for (size_t pos = 0; pos < lifetimes_.size(); pos++) {
+      if (lifetimes_[pos].bytes != output_bytes_[pos] ||
+          planned_aliases_[pos] != aliases_[pos]) {
+        plan_buffers();
+        break;
+      }
+    }
   }
   void setOutput(const Layer& lay, Tensor& vec) {
     end_ = lay.getID();
     outten_ = &vec;
   }
+  // peak memory of the intermediates of the last inference in bytes: the
+  // arena and the outputs of layers that allocated their own rather than
+  // writing into their buffer, the graph input and output are not counted
+  size_t getPeakMemory() const { return peak_memory_; }
+  const MemoryPlan& getMemoryPlan() const { return memory_plan_; }
+  // per-layer timings of the inferences while enabled, see Profiler
+  Profiler& profiler() { return profiler_; }
+  const Profiler& profiler() const { return profiler_; }
 #ifdef ENABLE_STATISTIC_TENSORS
   std::vector<Tensor> getTensors() { return tensors_; }
 #endif
 #ifdef ENABLE_STATISTIC_TIME
   std::vector<std::string> getTimeInfo() {
     std::vector<std::string> res;
-    std::vector<std::string> labels = {
-        "Input",       "Pooling", "Normalization", "Dropout", "Element-wise",
-        "Convolution", "Dense",   "Flatten",       "Output"};
     for (size_t i = 0; i < time_.size(); i++) {
-      res.push_back(labels[static_cast<size_t>(time_layer_[i])] + ':' +
-                    std::to_string(time_[i]));
+      res.push_back(time_layer_[i] + ':' + std::to_string(time_[i]));
     }
     return res;
   }
@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace it_lab_ai {
+
+// buffers are laid out in the arena on cache line boundaries
+constexpr size_t kArenaAlignment = 64;
+
+// intermediate tensor produced at step first_use and read for the last time
+// at step last_use (inclusive)
+struct TensorLifetime {
+  size_t bytes = 0;
+  size_t first_use = 0;
+  size_t last_use = 0;
+};
+
+// Buffer assignment of the intermediates. Graph allocates an arena of
+// arena_size bytes and gives every buffer its range of it as the storage
+// layers write their outputs into (see Tensor::reset).
+struct MemoryPlan {
+  // buffer assigned to every tensor, tensors with disjoint lifetimes share
+  std::vector<size_t> buffers;
+  // size and offset in the arena of every buffer
+  std::vector<size_t> buffer_sizes;
+  std::vector<size_t> buffer_offsets;
+  // peak memory of all intermediates with buffer reuse
+  size_t arena_size = 0;
+  // memory of all intermediates if every tensor had its own buffer
+  size_t total_size = 0;
+};
+
+inline size_t align_arena_offset(size_t bytes) {
+  return (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+// Assigns tensors to shared buffers in order of their first use. A tensor
+// takes a free buffer (its previous tenant is dead) whose size fits best:
+// the smallest one that is big enough, otherwise the biggest one, which
+// then grows. Buffers are placed one after another in the arena.
+// may_reuse(previous, tensor) can further refuse a free buffer, Graph
+// refuses it when the steps are not ordered by the data edges, so that
+// parallel branches don't share one.
+template <typename MayReuse>
+MemoryPlan plan_memory(const std::vector<TensorLifetime>& tensors,
+                       MayReuse may_reuse) {
+  MemoryPlan plan;
+  plan.buffers.resize(tensors.size());
+  std::vector<size_t> order(tensors.size());
+  std::iota(order.begin(), order.end(), size_t(0));
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return tensors[a].first_use < tensors[b].first_use;
+  });
+  // step after which every buffer is free again and its last tenant
+  std::vector<size_t> free_after;
+  std::vector<size_t> tenants;
+  for (size_t t : order) {
+    const TensorLifetime& tensor = tensors[t];
+    if (tensor.last_use < tensor.first_use) {
+      throw std::invalid_argument("Tensor is read before it is produced");
+    }
+    size_t bytes = align_arena_offset(tensor.bytes);
+    plan.total_size += bytes;
+    size_t best = free_after.size();
+    for (size_t b = 0; b < free_after.size(); ++b) {
+      if (free_after[b] >= tensor.first_use || !may_reuse(tenants[b], t)) {
+        continue;
+      }
+      if (best == free_after.size()) {
+        best = b;
+        continue;
+      }
+      bool fits = plan.buffer_sizes[b] >= bytes;
+      bool best_fits = plan.buffer_sizes[best] >= bytes;
+      if ((fits && (!best_fits ||
+                    plan.buffer_sizes[b] < plan.buffer_sizes[best])) ||
+          (!fits && !best_fits &&
+           plan.buffer_sizes[b] > plan.buffer_sizes[best])) {
+        best = b;
+      }
+    }
+    if (best == free_after.size()) {
+      free_after.push_back(tensor.last_use);
+      tenants.push_back(t);
+      plan.buffer_sizes.push_back(bytes);
+    } else {
+      free_after[best] = tensor.last_use;
+      tenants[best] = t;
+      plan.buffer_sizes[best] = std::max(plan.buffer_sizes[best], bytes);
+    }
+    plan.buffers[t] = best;
+  }
+  plan.buffer_offsets.resize(plan.buffer_sizes.size());
+  for (size_t b = 0; b < plan.buffer_sizes.size(); ++b) {
+    plan.buffer_offsets[b] = plan.arena_size;
+    plan.arena_size += plan.buffer_sizes[b];
+  }
+  return plan;
+}
+
+inline MemoryPlan plan_memory(const std::vector<TensorLifetime>& tensors) {
+  return plan_memory(tensors, [](size_t, size_t) { return true; });
+}
+
+}  // namespace it_lab_ai
@@ -0,0 +1,184 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "oneapi/tbb/task_scheduler_observer.h"
+
+namespace it_lab_ai {
+
+// hardware events counted by PerfCounters, summed over the threads
+struct CounterValues {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  // PERF_COUNT_HW_CACHE_MISSES, the last level cache on x86
+  uint64_t llc_misses = 0;
+  uint64_t branch_misses = 0;
+  // the PMU was shared with other events and the counts are estimates,
+  // scaled by the time the events were enabled over the time they ran
+  bool multiplexed = false;
+
+  CounterValues operator-(const CounterValues& other) const {
+    CounterValues res;
+    res.cycles = cycles - other.cycles;
+    res.instructions = instructions - other.instructions;
+    res.llc_misses = llc_misses - other.llc_misses;
+    res.branch_misses = branch_misses - other.branch_misses;
+    res.multiplexed = multiplexed || other.multiplexed;
+    return res;
+  }
+};
+
+// Hardware counters read with Linux perf_event_open. Counters are opened
+// for the thread that makes the object and for every TBB worker joining
+// its arena, read() sums them: the counts are process-wide, the difference
+// of two reads covers the workers a kernel spreads over and also anything
+// that ran concurrently, which is why Graph runs one layer at a time while
+// counting.
+// The events of a thread form one group led by cycles (the first event
+// that opens when cycles does not), so they all count over the same time
+// and are read at once. When more events are active than the PMU has
+// counters the kernel multiplexes the groups: their counts are then
+// scaled by time enabled over time running and flagged multiplexed.
+// Events the system does not give (other OSes, virtual machines without a
+// PMU, perf_event_paranoid above 2) are left out, mask() tells which
+// ones count. Only user-space work is counted.
+class PerfCounters : public tbb::task_scheduler_observer {
+ public:
+  enum Event { kCycles, kInstructions, kLlcMisses, kBranchMisses, kEvents };
+  static constexpr unsigned kAllEvents = (1U << kEvents) - 1;
+
+  PerfCounters() {
+    attach();
+    if (mask() != 0) {
+      observe(true);
+    }
+  }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+  ~PerfCounters() override {
+    observe(false);
+#ifdef __linux__
+    for (const Group& group : groups_) {
+      for (int fd : group.fds) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  // bit 1 << event for every event that counts, 0 if none does
+  unsigned mask() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mask_;
+  }
+  CounterValues read() const {
+    std::array<uint64_t, kEvents> totals = {};
+    bool multiplexed = false;
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Group& group : groups_) {
+      // PERF_FORMAT_GROUP layout: the number of events, the times enabled
+      // and running, then the value of every event in opening order
+      std::array<uint64_t, 3 + kEvents> data;
+      ssize_t bytes = ::read(group.fds[0], data.data(), sizeof(data));
+      size_t count = group.fds.size();
+      if (bytes != static_cast<ssize_t>((3 + count) * sizeof(uint64_t)) ||
+          data[0] != count || data[2] == 0) {
+        // unreadable, or the group never got on the PMU
+        continue;
+      }
+      uint64_t enabled = data[1];
+      uint64_t running = data[2];
+      for (size_t i = 0; i < count; i++) {
+        uint64_t value = data[3 + i];
+        if (running < enabled) {
+          value = static_cast<uint64_t>(static_cast<double>(value) *
+                                        static_cast<double>(enabled) /
+                                        static_cast<double>(running));
+        }
+        totals[group.events[i]] += value;
+      }
+      multiplexed = multiplexed || running < enabled;
+    }
+#endif
+    CounterValues res;
+    res.cycles = totals[kCycles];
+    res.instructions = totals[kInstructions];
+    res.llc_misses = totals[kLlcMisses];
+    res.branch_misses = totals[kBranchMisses];
+    res.multiplexed = multiplexed;
+    return res;
+  }
+
+  void on_scheduler_entry(bool /*is_worker*/) override { attach(); }
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_set<std::thread::id> attached_;
+  // counters of an attached thread, fds[0] leads the group
+  struct Group {
+    std::vector<int> fds;
+    // event counted by every fd
+    std::vector<size_t> events;
+  };
+  std::vector<Group> groups_;
+  unsigned mask_ = 0;
+
+  void attach() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!attached_.insert(std::this_thread::get_id()).second) {
+      return;
+    }
+    Group group;
+    for (size_t event = 0; event < kEvents; event++) {
+      int fd = open_event(event, group.fds.empty() ? -1 : group.fds[0]);
+      if (fd >= 0) {
+        group.fds.push_back(fd);
+        group.events.push_back(event);
+        mask_ |= 1U << event;
+      }
+    }
+    if (!group.fds.empty()) {
+      groups_.push_back(std::move(group));
+    }
+  }
+  // counter of the calling thread on any CPU, in the group of leader (a
+  // new group for -1). The kernel refuses an event the PMU cannot
+  // schedule together with the group
+  static int open_event(size_t event, int leader) {
+#ifdef __linux__
+    static const uint64_t kConfigs[kEvents] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = kConfigs[event];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                    leader, PERF_FLAG_FD_CLOEXEC));
+#else
+    static_cast<void>(event);
+    static_cast<void>(leader);
+    return -1;
+#endif
+  }
+};
+
+}  // namespace it_lab_ai
@@ -0,0 +1,310 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "graph/perf_counters.hpp"
+
+namespace it_lab_ai {
+
+// one run of a layer, or of one of its postops, during Graph::inference
+struct LayerProfile {
+  // name of the layer (Layer::name) and its vertex in the graph
+  std::string name;
+  int vertex = 0;
+  // index of the postop, -1 for the layer itself
+  int postop = -1;
+  // inference() call of the run, counted from 0 since the last clear()
+  size_t iteration = 0;
+  // since the profiler was enabled or cleared
+  int64_t start_ns = 0;
+  int64_t duration_ns = 0;
+  // inputs and weights read, outputs written
+  size_t bytes_read = 0;
+  size_t bytes_written = 0;
+  // estimate of Layer::flops, 0 if the layer has none
+  uint64_t flops = 0;
+  // TBB slot of the thread that ran the layer and the threads its kernels
+  // may spread over
+  int thread = 0;
+  int threads = 1;
+  // hardware counters over the run, bit 1 << PerfCounters::Event is set in
+  // counted for the events that were counted
+  unsigned counted = 0;
+  CounterValues counters;
+};
+
+// Per-layer timings of Graph::inference, off unless enabled at run time:
+// with enable() or by setting ITLAB_AI_PROFILE (to 1, or to the file the
+// apps write the Chrome trace to). Graph fills it, records accumulate over
+// inferences until clear(). Hardware counters are added with
+// count_hardware() or ITLAB_AI_PROFILE_COUNTERS=1, they are process-wide
+// and Graph gives up running branches in parallel while they count.
+class Profiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  Profiler() {
+    const char* env = std::getenv("ITLAB_AI_PROFILE");
+    if (env != nullptr && *env != '\0' && std::string(env) != "0") {
+      trace_path_ = std::string(env) == "1" ? "" : env;
+      enable(true);
+    }
+    env = std::getenv("ITLAB_AI_PROFILE_COUNTERS");
+    if (env != nullptr && std::string(env) == "1") {
+      count_hardware(true);
+    }
+  }
+
+  bool enabled() const { return enabled_; }
+  void enable(bool on) {
+    if (on && !enabled_) {
+      clear();
+    }
+    enabled_ = on;
+  }
+  void clear() {
+    records_.clear();
+    iterations_ = 0;
+    epoch_ = Clock::now();
+  }
+  // opens the counters of PerfCounters, false if none of them counts
+  bool count_hardware(bool on) {
+    if (!on) {
+      counters_.reset();
+    } else if (!counters_) {
+      counters_ = std::make_unique<PerfCounters>();
+    }
+    return counting();
+  }
+  bool counting() const { return counters_ && counters_->mask() != 0; }
+  unsigned counter_mask() const { return counters_ ? counters_->mask() : 0; }
+  CounterValues read_counters() const {
+    return counters_ ? counters_->read() : CounterValues();
+  }
+  // ns since the epoch
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                epoch_)
+        .count();
+  }
+  // records of one inference, in execution order
+  void add_iteration(std::vector<LayerProfile> records) {
+    for (LayerProfile& record : records) {
+      record.iteration = iterations_;
+      records_.push_back(std::move(record));
+    }
+    iterations_++;
+  }
+  const std::vector<LayerProfile>& records() const { return records_; }
+  size_t iterations() const { return iterations_; }
+  // file named by ITLAB_AI_PROFILE, empty if none
+  const std::string& trace_path() const { return trace_path_; }
+
+  // trace-event JSON for chrome://tracing or ui.perfetto.dev: a complete
+  // event per record on the timeline of its thread
+  void write_chrome_trace(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < records_.size(); i++) {
+      const LayerProfile& record = records_[i];
+      out << (i == 0 ? "\n" : ",\n") << "{\"name\":\""
+          << escape(label(record)) << "\",\"cat\":\""
+          << (record.postop < 0 ? "layer" : "postop")
+          << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << record.thread
+          << std::fixed << std::setprecision(3)
+          << ",\"ts\":" << static_cast<double>(record.start_ns) / 1000.0
+          << ",\"dur\":" << static_cast<double>(record.duration_ns) / 1000.0
+          << ",\"args\":{\"vertex\":" << record.vertex
+          << ",\"iteration\":" << record.iteration
+          << ",\"bytes_read\":" << record.bytes_read
+          << ",\"bytes_written\":" << record.bytes_written
+          << ",\"flops\":" << record.flops
+          << ",\"threads\":" << record.threads;
+      if (record.counters.multiplexed) {
+        out << ",\"multiplexed\":true";
+      }
+      for (size_t event = 0; event < PerfCounters::kEvents; event++) {
+        if ((record.counted & (1U << event)) != 0) {
+          out << ",\"" << kCounterNames[event]
+              << "\":" << counter(record.counters, event);
+        }
+      }
+      out << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+  // one line per layer and postop with its time over all iterations,
+  // slowest first, with the rates its estimates give
+  void write_summary(std::ostream& out) const {
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    struct Total {
+      std::string label;
+      size_t calls = 0;
+      int64_t ns = 0;
+      size_t bytes = 0;
+      uint64_t flops = 0;
+      unsigned counted = PerfCounters::kAllEvents;
+      CounterValues counters;
+    };
+    std::map<std::pair<int, int>, Total> totals;
+    int64_t all_ns = 0;
+    unsigned counted = 0;
+    bool multiplexed = false;
+    for (const LayerProfile& record : records_) {
+      Total& total = totals[{record.vertex, record.postop}];
+      total.label = label(record);
+      total.calls++;
+      total.ns += record.duration_ns;
+      total.bytes += record.bytes_read + record.bytes_written;
+      total.flops += record.flops;
+      total.counted &= record.counted;
+      total.counters.cycles += record.counters.cycles;
+      total.counters.instructions += record.counters.instructions;
+      total.counters.llc_misses += record.counters.llc_misses;
+      total.counters.branch_misses += record.counters.branch_misses;
+      counted |= record.counted;
+      multiplexed = multiplexed || record.counters.multiplexed;
+      all_ns += record.duration_ns;
+    }
+    std::vector<Total> sorted;
+    for (const auto& entry : totals) {
+      sorted.push_back(entry.second);
+    }
+    std::stable_sort(
+        sorted.begin(), sorted.end(),
+        [](const Total& a, const Total& b) { return a.ns > b.ns; });
+    out << std::left << std::setw(40) << "layer" << std::right
+        << std::setw(7) << "calls" << std::setw(12) << "total ms"
+        << std::setw(12) << "avg us" << std::setw(8) << "%"
+        << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s";
+    if (counted != 0) {
+      // misses per thousand instructions
+      out << std::setw(10) << "Mcycles" << std::setw(7) << "IPC"
+          << std::setw(10) << "LLC MPKI" << std::setw(10) << "br MPKI";
+    }
+    out << '\n';
+    out << std::fixed;
+    for (const Total& total : sorted) {
+      // bytes and flops per ns are GB/s and GFLOP/s
+      double ns = std::max<double>(1.0, static_cast<double>(total.ns));
+      out << std::left << std::setw(40) << total.label << std::right
+          << std::setw(7) << total.calls << std::setprecision(3)
+          << std::setw(12) << static_cast<double>(total.ns) / 1e6
+          << std::setw(12)
+          << static_cast<double>(total.ns) / 1e3 /
+                 static_cast<double>(total.calls)
+          << std::setprecision(1) << std::setw(8)
+          << 100.0 * static_cast<double>(total.ns) /
+                 std::max<double>(1.0, static_cast<double>(all_ns))
+          << std::setprecision(2) << std::setw(10);
+      if (total.flops > 0) {
+        out << static_cast<double>(total.flops) / ns;
+      } else {
+        out << "-";
+      }
+      out << std::setw(10) << static_cast<double>(total.bytes) / ns;
+      if (counted != 0) {
+        write_counters(out, total.counters, total.counted);
+      }
+      out << '\n';
+    }
+    out << std::setprecision(3) << "total "
+        << static_cast<double>(all_ns) / 1e6 << " ms over " << iterations_
+        << " inference(s)\n";
+    if (counted != 0) {
+      out << "counters are process-wide, layers ran one at a time\n";
+    }
+    if (multiplexed) {
+      out << "counters were multiplexed, counts are scaled estimates\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+  }
+
+ private:
+  bool enabled_ = false;
+  std::string trace_path_;
+  Clock::time_point epoch_ = Clock::now();
+  size_t iterations_ = 0;
+  std::vector<LayerProfile> records_;
+  std::unique_ptr<PerfCounters> counters_;
+
+  static constexpr const char* kCounterNames[PerfCounters::kEvents] = {
+      "cycles", "instructions", "llc_misses", "branch_misses"};
+
+  static uint64_t counter(const CounterValues& values, size_t event) {
+    switch (event) {
+      case PerfCounters::kCycles:
+        return values.cycles;
+      case PerfCounters::kInstructions:
+        return values.instructions;
+      case PerfCounters::kLlcMisses:
+        return values.llc_misses;
+      default:
+        return values.branch_misses;
+    }
+  }
+  // the counter columns of the summary, "-" where an event was missing
+  static void write_counters(std::ostream& out, const CounterValues& values,
+                             unsigned counted) {
+    auto has = [counted](PerfCounters::Event event) {
+      return (counted & (1U << event)) != 0;
+    };
+    double instructions = static_cast<double>(values.instructions);
+    auto column = [&out](int width, bool known, double value) {
+      out << std::setw(width);
+      if (known) {
+        out << value;
+      } else {
+        out << "-";
+      }
+    };
+    column(10, has(PerfCounters::kCycles),
+           static_cast<double>(values.cycles) / 1e6);
+    column(7,
+           has(PerfCounters::kCycles) && has(PerfCounters::kInstructions) &&
+               values.cycles > 0,
+           instructions / static_cast<double>(std::max<uint64_t>(
+                              1, values.cycles)));
+    column(10, has(PerfCounters::kLlcMisses) && instructions > 0,
+           1e3 * static_cast<double>(values.llc_misses) /
+               std::max(1.0, instructions));
+    column(10, has(PerfCounters::kBranchMisses) && instructions > 0,
+           1e3 * static_cast<double>(values.branch_misses) /
+               std::max(1.0, instructions));
+  }
+
+  static std::string label(const LayerProfile& record) {
+    std::string res = record.name + " #" + std::to_string(record.vertex);
+    if (record.postop >= 0) {
+      res += " postop " + std::to_string(record.postop);
+    }
+    return res;
+  }
+  static std::string escape(const std::string& text) {
+    std::string res;
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        res += '\\';
+      }
+      res += c;
+    }
+    return res;
+  }
+};
+
+}  // namespace it_lab_ai
@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "layers/CpuFeatures.hpp"
+
+namespace it_lab_ai {
+
+template <typename T>
+T relu(const T& value) {
+  if (value > T(0)) {
+    return value;
+  }
+  return T(0);
+}
+
+enum class ActivationType : uint8_t {
+  kNone,
+  kRelu,
+  kTanh,
+  kSin,
+  kMinus,
+  kLinear,
+  kSigmoid,
+  kLeakyRelu,
+  kGelu,
+  kSilu,
+  kHardSigmoid,
+  kClip
+};
+
+// Function of EWLayer, resolved from its name once, so it can also be
+// applied by a fused producer to each value it stores. alpha and beta are
+// the parameters of:
+//   linear        alpha * x + beta
+//   leaky_relu    x > 0 ? x : alpha * x
+//   hard_sigmoid  clamp(alpha * x + beta, 0, 1)
+//   clip          clamp(x, alpha, beta)
+// gelu is the exact erf form, silu (also "swish") is x * sigmoid(x).
+struct Activation {
+  ActivationType type = ActivationType::kNone;
+  float alpha = 0.0F;
+  float beta = 0.0F;
+
+  Activation() = default;
+  explicit Activation(const std::string& function, float alpha_ = 0.0F,
+                      float beta_ = 0.0F)
+      : alpha(alpha_), beta(beta_) {
+    if (!parse(function, type)) {
+      throw std::invalid_argument("No such function for EWLayer");
+    }
+  }
+  // false for names EWLayer doesn't know
+  static bool parse(const std::string& function, ActivationType& type) {
+    static const std::pair<const char*, ActivationType> kNames[] = {
+        {"relu", ActivationType::kRelu},
+        {"tanh", ActivationType::kTanh},
+        {"sin", ActivationType::kSin},
+        {"minus", ActivationType::kMinus},
+        {"linear", ActivationType::kLinear},
+        {"sigmoid", ActivationType::kSigmoid},
+        {"leaky_relu", ActivationType::kLeakyRelu},
+        {"gelu", ActivationType::kGelu},
+        {"silu", ActivationType::kSilu},
+        {"swish", ActivationType::kSilu},
+        {"hard_sigmoid", ActivationType::kHardSigmoid},
+        {"clip", ActivationType::kClip}};
+    for (const auto& name : kNames) {
+      if (function == name.first) {
+        type = name.second;
+        return true;
+      }
+    }
+    return false;
+  }
+  bool empty() const { return type == ActivationType::kNone; }
+
+  // output[i] = (*this)(input[i]) with the kernel best_activation_isa()
+  // picks: AVX-512 or AVX2 polynomial approximations on x86-64,
+  // operator() elsewhere. Inputs of more than kActivationParallelGrain
+  // values are split between TBB threads. The largest errors of the vector
+  // kernels against the double precision functions, checked in test_ewlayer:
+  //   sigmoid, silu  2e-7 relative, 1e-36 absolute for results below 1e-30
+  //   tanh           2e-7 relative
+  //   sin            2e-7 absolute, |x| > 1e5 is computed by std::sin
+  //   gelu           3e-7 * max(1, |x|) absolute
+  // the other functions are off by one float rounding at most.
+  void apply(const float* input, float* output, size_t count) const;
+  // same with a given instruction set (kScalar, kAvx2 or kAvx512) on the
+  // calling thread, false if the CPU or the build doesn't support it
+  bool apply(Isa isa, const float* input, float* output,
+             size_t count) const;
+
+  template <typename ValueType>
+  ValueType operator()(ValueType value) const {
+    switch (type) {
+      case ActivationType::kRelu:
+        return relu(value);
+      case ActivationType::kTanh:
+        return static_cast<ValueType>(std::tanh(value));
+      case ActivationType::kSin:
+        return static_cast<ValueType>(std::sin(value));
+      case ActivationType::kMinus:
+        return -value;
+      case ActivationType::kLinear:
+        return value * static_cast<ValueType>(alpha) +
+               static_cast<ValueType>(beta);
+      case ActivationType::kSigmoid:
+        return sigmoid(value);
+      case ActivationType::kLeakyRelu:
+        return value > ValueType(0) ? value
+                                    : static_cast<ValueType>(alpha * value);
+      case ActivationType::kGelu:
+        return static_cast<ValueType>(
+            0.5 * value * (1.0 + std::erf(value * 0.70710678118654752)));
+      case ActivationType::kSilu:
+        return static_cast<ValueType>(value * sigmoid(double(value)));
+      case ActivationType::kHardSigmoid:
+        return static_cast<ValueType>(std::min(
+            std::max(alpha * static_cast<float>(value) + beta, 0.0F), 1.0F));
+      case ActivationType::kClip:
+        return std::min(std::max(value, static_cast<ValueType>(alpha)),
+                        static_cast<ValueType>(beta));
+      default:
+        return value;
+    }
+  }
+
+ private:
+  template <typename ValueType>
+  static ValueType sigmoid(ValueType x) {
+    if constexpr (std::is_integral_v<ValueType>) {
+      auto x_float = static_cast<float>(x);
+      float result = 1.0F / (1.0F + std::exp(-x_float));
+      return static_cast<ValueType>(std::round(result));
+    } else {
+      if (x >= ValueType(0)) {
+        ValueType z = std::exp(-x);
+        return ValueType(1) / (ValueType(1) + z);
+      }
+      ValueType z = std::exp(x);
+      return z / (ValueType(1) + z);
+    }
+  }
+};
+
+// instruction set of the first kElementWise kernel in KernelRegistry that
+// this CPU and build support
+Isa best_activation_isa();
+// values per TBB task of Activation::apply
+constexpr size_t kActivationParallelGrain = size_t(1) << 14;
+
+// what a producer with fused successors does to a value before storing it:
+// adds the residual (laid out like the output) and applies the activation
+template <typename ValueType>
+struct OutputEpilogue {
+  Activation activation;
+  const ValueType* residual = nullptr;
+
+  bool empty() const { return activation.empty() && residual == nullptr; }
+  ValueType operator()(size_t index, ValueType value) const {
+    if (residual != nullptr) {
+      value += residual[index];
+    }
+    return activation(value);
+  }
+};
+
+}  // namespace it_lab_ai
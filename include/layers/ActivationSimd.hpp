@@ -0,0 +1,200 @@
+#pragma once
+#include <cstddef>
+
+#include "layers/Activation.hpp"
+
+namespace it_lab_ai {
+
+// Kernels of Activation::apply, defined in translation units built for one
+// instruction set each. They return false when the build has no support.
+// Those units are run only on CPUs with the instruction set, so they must
+// not call inline functions shared with the rest of the library (the
+// linker may keep their copy), only their own code and the ones below.
+bool activation_avx2(ActivationType type, float alpha, float beta,
+                     const float* input, float* output, size_t count);
+bool activation_avx512(ActivationType type, float alpha, float beta,
+                       const float* input, float* output, size_t count);
+// std::sin for the arguments the vector range reduction can't handle
+float activation_scalar_sin(float value);
+
+// Algorithms written once over the vector operations of an instruction set
+// (Ops, see the kernel units). The unnamed namespace gives every kernel
+// unit its own copy.
+namespace {
+
+constexpr float kSimdSinMaxArgument = 1e5F;
+
+// Cephes expf: 2^n * e^r with |r| <= ln(2) / 2, inputs are clamped to the
+// range of normal floats
+template <class Ops>
+typename Ops::Reg simd_exp(typename Ops::Reg x) {
+  using Reg = typename Ops::Reg;
+  x = Ops::min(Ops::max(x, Ops::set1(-87.3365F)), Ops::set1(88.0F));
+  Reg n = Ops::round(Ops::mul(x, Ops::set1(1.44269504088896341F)));
+  Reg r = Ops::fmadd(n, Ops::set1(-0.693359375F), x);
+  r = Ops::fmadd(n, Ops::set1(2.12194440e-4F), r);
+  Reg p = Ops::set1(1.9875691500e-4F);
+  p = Ops::fmadd(p, r, Ops::set1(1.3981999507e-3F));
+  p = Ops::fmadd(p, r, Ops::set1(8.3334519073e-3F));
+  p = Ops::fmadd(p, r, Ops::set1(4.1665795894e-2F));
+  p = Ops::fmadd(p, r, Ops::set1(1.6666665459e-1F));
+  p = Ops::fmadd(p, r, Ops::set1(5.0000001201e-1F));
+  Reg y = Ops::fmadd(Ops::mul(p, r), r, Ops::add(r, Ops::set1(1.0F)));
+  return Ops::mul(y, Ops::pow2(n));
+}
+
+template <class Ops>
+typename Ops::Reg simd_sigmoid(typename Ops::Reg x) {
+  typename Ops::Reg one = Ops::set1(1.0F);
+  return Ops::div(one, Ops::add(one, simd_exp<Ops>(Ops::negate(x))));
+}
+
+// odd Taylor polynomial below 0.25, (1 - e^-2|x|) / (1 + e^-2|x|) above
+template <class Ops>
+typename Ops::Reg simd_tanh(typename Ops::Reg x) {
+  using Reg = typename Ops::Reg;
+  Reg one = Ops::set1(1.0F);
+  Reg a = Ops::abs(x);
+  Reg e = simd_exp<Ops>(Ops::mul(a, Ops::set1(-2.0F)));
+  Reg large = Ops::div(Ops::sub(one, e), Ops::add(one, e));
+  large = Ops::copysign(large, x);
+  Reg x2 = Ops::mul(x, x);
+  Reg p = Ops::set1(62.0F / 2835.0F);
+  p = Ops::fmadd(p, x2, Ops::set1(-17.0F / 315.0F));
+  p = Ops::fmadd(p, x2, Ops::set1(2.0F / 15.0F));
+  p = Ops::fmadd(p, x2, Ops::set1(-1.0F / 3.0F));
+  Reg small = Ops::fmadd(Ops::mul(p, x2), x, x);
+  return Ops::select(Ops::less(a, Ops::set1(0.25F)), small, large);
+}
+
+// x = k * pi + r with |r| <= pi / 2 (two fma steps), sin(x) = (-1)^k sin(r)
+// with sin(r) from its Taylor polynomial up to r^11
+template <class Ops>
+typename Ops::Reg simd_sin(typename Ops::Reg x) {
+  using Reg = typename Ops::Reg;
+  Reg k = Ops::round(Ops::mul(x, Ops::set1(0.318309886183790672F)));
+  Reg r = Ops::fmadd(k, Ops::set1(-3.14159274101257324F), x);
+  r = Ops::fmadd(k, Ops::set1(8.74227800037248795e-8F), r);
+  Reg r2 = Ops::mul(r, r);
+  Reg p = Ops::set1(-2.50521083854417188e-8F);
+  p = Ops::fmadd(p, r2, Ops::set1(2.75573192239858907e-6F));
+  p = Ops::fmadd(p, r2, Ops::set1(-1.98412698412698413e-4F));
+  p = Ops::fmadd(p, r2, Ops::set1(8.33333333333333333e-3F));
+  p = Ops::fmadd(p, r2, Ops::set1(-1.66666666666666667e-1F));
+  Reg s = Ops::fmadd(Ops::mul(p, r2), r, r);
+  return Ops::flip_sign_if_odd(s, k);
+}
+
+// 0.5 x (1 + erf(x / sqrt(2))), erf from Abramowitz and Stegun 7.1.26:
+// 1 - erf(z) = q(t) e^(-z^2), which is used directly for negative x
+template <class Ops>
+typename Ops::Reg simd_gelu(typename Ops::Reg x) {
+  using Reg = typename Ops::Reg;
+  Reg one = Ops::set1(1.0F);
+  Reg z = Ops::mul(Ops::abs(x), Ops::set1(0.70710678118654752F));
+  Reg t = Ops::div(one, Ops::fmadd(z, Ops::set1(0.3275911F), one));
+  Reg p = Ops::set1(1.061405429F);
+  p = Ops::fmadd(p, t, Ops::set1(-1.453152027F));
+  p = Ops::fmadd(p, t, Ops::set1(1.421413741F));
+  p = Ops::fmadd(p, t, Ops::set1(-0.284496736F));
+  p = Ops::fmadd(p, t, Ops::set1(0.254829592F));
+  Reg q = Ops::mul(Ops::mul(p, t), simd_exp<Ops>(Ops::negate(Ops::mul(z, z))));
+  Reg factor = Ops::select(Ops::less(x, Ops::set1(0.0F)), q,
+                           Ops::sub(Ops::set1(2.0F), q));
+  return Ops::mul(Ops::mul(x, Ops::set1(0.5F)), factor);
+}
+
+// output[i] = f(input[i]), the tail goes through a zero-padded register
+template <class Ops, class Function>
+void simd_map(const float* input, float* output, size_t count, Function f) {
+  size_t i = 0;
+  for (; i + Ops::kWidth <= count; i += Ops::kWidth) {
+    Ops::store(output + i, f(Ops::load(input + i)));
+  }
+  if (i < count) {
+    float tail[Ops::kWidth] = {};
+    for (size_t j = i; j < count; ++j) {
+      tail[j - i] = input[j];
+    }
+    Ops::store(tail, f(Ops::load(tail)));
+    for (size_t j = i; j < count; ++j) {
+      output[j] = tail[j - i];
+    }
+  }
+}
+
+template <class Ops>
+void simd_activation(ActivationType type, float alpha, float beta,
+                     const float* input, float* output, size_t count) {
+  using Reg = typename Ops::Reg;
+  Reg zero = Ops::set1(0.0F);
+  Reg one = Ops::set1(1.0F);
+  Reg va = Ops::set1(alpha);
+  Reg vb = Ops::set1(beta);
+  switch (type) {
+    case ActivationType::kRelu:
+      simd_map<Ops>(input, output, count,
+                    [&](Reg x) { return Ops::max(x, zero); });
+      break;
+    case ActivationType::kTanh:
+      simd_map<Ops>(input, output, count, simd_tanh<Ops>);
+      break;
+    case ActivationType::kSin: {
+      bool out_of_range = false;
+      simd_map<Ops>(input, output, count, [&](Reg x) {
+        out_of_range = out_of_range ||
+                       Ops::any(Ops::less(Ops::set1(kSimdSinMaxArgument),
+                                          Ops::abs(x)));
+        return simd_sin<Ops>(x);
+      });
+      if (out_of_range) {
+        for (size_t i = 0; i < count; ++i) {
+          if (!(input[i] >= -kSimdSinMaxArgument &&
+                input[i] <= kSimdSinMaxArgument)) {
+            output[i] = activation_scalar_sin(input[i]);
+          }
+        }
+      }
+      break;
+    }
+    case ActivationType::kMinus:
+      simd_map<Ops>(input, output, count, Ops::negate);
+      break;
+    case ActivationType::kLinear:
+      simd_map<Ops>(input, output, count,
+                    [&](Reg x) { return Ops::fmadd(x, va, vb); });
+      break;
+    case ActivationType::kSigmoid:
+      simd_map<Ops>(input, output, count, simd_sigmoid<Ops>);
+      break;
+    case ActivationType::kLeakyRelu:
+      simd_map<Ops>(input, output, count, [&](Reg x) {
+        return Ops::fmadd(Ops::min(x, zero), va, Ops::max(x, zero));
+      });
+      break;
+    case ActivationType::kGelu:
+      simd_map<Ops>(input, output, count, simd_gelu<Ops>);
+      break;
+    case ActivationType::kSilu:
+      simd_map<Ops>(input, output, count, [&](Reg x) {
+        return Ops::div(x, Ops::add(one, simd_exp<Ops>(Ops::negate(x))));
+      });
+      break;
+    case ActivationType::kHardSigmoid:
+      simd_map<Ops>(input, output, count, [&](Reg x) {
+        return Ops::min(Ops::max(Ops::fmadd(x, va, vb), zero), one);
+      });
+      break;
+    case ActivationType::kClip:
+      simd_map<Ops>(input, output, count,
+                    [&](Reg x) { return Ops::min(Ops::max(x, va), vb); });
+      break;
+    default:
+      simd_map<Ops>(input, output, count, [](Reg x) { return x; });
+      break;
+  }
+}
+
+}  // namespace
+
+}  // namespace it_lab_ai
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace it_lab_ai {
+
+// tensor storage starts on a cache line, which also fits AVX-512 loads
+constexpr size_t kTensorAlignment = 64;
+constexpr size_t kHugePageSize = size_t(2) << 20;
+// buffers of at least this size (big weights) are aligned to huge pages
+constexpr size_t kHugePageThreshold = size_t(4) << 20;
+
+inline std::atomic<bool>& huge_pages_flag() {
+  static std::atomic<bool> enabled{false};
+  return enabled;
+}
+
+// asks the kernel to back buffers of at least kHugePageThreshold bytes
+// allocated from now on with transparent huge pages, Linux only
+inline void set_huge_pages(bool enabled) { huge_pages_flag() = enabled; }
+
+inline size_t aligned_allocation_alignment(size_t bytes) {
+  return bytes >= kHugePageThreshold ? kHugePageSize : kTensorAlignment;
+}
+
+// Preallocated memory an AlignedAllocator hands out instead of allocating,
+// a buffer of the arena Graph places its intermediates in. It goes to one
+// allocation at a time and only if that fits, owner keeps the memory alive
+// while an allocation uses it.
+struct AllocationRegion {
+  void* data = nullptr;
+  size_t bytes = 0;
+  std::shared_ptr<void> owner;
+  std::atomic<bool> in_use{false};
+};
+
+// Allocates on kTensorAlignment (huge pages for big buffers), or from its
+// AllocationRegion if it was given one. Copies of a vector allocate on
+// their own, the region moves with the vector that holds it.
+template <typename T>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  AlignedAllocator() noexcept = default;
+  explicit AlignedAllocator(std::shared_ptr<AllocationRegion> region) noexcept
+      : region_(std::move(region)) {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U>& other) noexcept
+      : region_(other.region()) {}
+
+  const std::shared_ptr<AllocationRegion>& region() const noexcept {
+    return region_;
+  }
+  AlignedAllocator select_on_container_copy_construction() const noexcept {
+    return AlignedAllocator();
+  }
+
+  T* allocate(size_t n) {
+    if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    size_t bytes = n * sizeof(T);
+    if (region_ && bytes <= region_->bytes &&
+        !region_->in_use.exchange(true)) {
+      return static_cast<T*>(region_->data);
+    }
+    size_t alignment = aligned_allocation_alignment(bytes);
+    void* p = ::operator new(bytes, std::align_val_t(alignment));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (alignment == kHugePageSize && huge_pages_flag()) {
+      madvise(p, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return static_cast<T*>(p);
+  }
+
+  void deallocate(T* p, size_t n) noexcept {
+    if (region_ && p == region_->data) {
+      region_->in_use = false;
+      return;
+    }
+    ::operator delete(p, std::align_val_t(
+                             aligned_allocation_alignment(n * sizeof(T))));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U>& other) const noexcept {
+    return region_ == other.region();
+  }
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U>& other) const noexcept {
+    return !(*this == other);
+  }
+
+ private:
+  std::shared_ptr<AllocationRegion> region_;
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// tensor storage (see Tensor::as) compares with plain vectors elementwise
+template <typename T, typename Alloc,
+          typename = std::enable_if_t<
+              !std::is_same_v<Alloc, AlignedAllocator<T>>>>
+bool operator==(const AlignedVector<T>& a, const std::vector<T, Alloc>& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+template <typename T, typename Alloc,
+          typename = std::enable_if_t<
+              !std::is_same_v<Alloc, AlignedAllocator<T>>>>
+bool operator==(const std::vector<T, Alloc>& a, const AlignedVector<T>& b) {
+  return b == a;
+}
+template <typename T, typename Alloc,
+          typename = std::enable_if_t<
+              !std::is_same_v<Alloc, AlignedAllocator<T>>>>
+bool operator!=(const AlignedVector<T>& a, const std::vector<T, Alloc>& b) {
+  return !(a == b);
+}
+template <typename T, typename Alloc,
+          typename = std::enable_if_t<
+              !std::is_same_v<Alloc, AlignedAllocator<T>>>>
+bool operator!=(const std::vector<T, Alloc>& a, const AlignedVector<T>& b) {
+  return !(b == a);
+}
+
+}  // namespace it_lab_ai
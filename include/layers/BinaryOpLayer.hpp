@@ -18,9 +18,21 @@ class BinaryOpLayer : public Layer {
   explicit BinaryOpLayer(Operation op) : op_(op) {}
 
   static std::string get_name() { return "Binary Operation Layer"; }
+  std::string name() const override { return get_name(); }
+  uint64_t flops(const Shape& input, const Shape& output) const override {
+    (void)input;
+    return output.count();
+  }
   void run(const Tensor& input, Tensor& output) override;
   void run(const Tensor& A, const Tensor& B, Tensor& output);
+  void run_multi(const std::vector<Tensor>& inputs,
+                 std::vector<Tensor>& outputs) override;
+  // a scalar operand is applied in place to the other operand
+  bool supports_inplace() const override { return true; }
+  void run_multi_inplace(std::vector<Tensor>& inputs,
+                         std::vector<Tensor>& outputs) override;
   static bool is_scalar_tensor(const Tensor& t);
+  bool is_elementwise_add() const override { return op_ == Operation::kAdd; }
 
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override {
@@ -15,8 +15,11 @@ class ConcatLayer : public Layer {
 
   void run(const Tensor& input, Tensor& output) override;
   void run(const std::vector<Tensor>& inputs, Tensor& output);
+  void run_multi(const std::vector<Tensor>& inputs,
+                 std::vector<Tensor>& outputs) override;
 
   static std::string get_name() { return "ConcatLayer"; }
+  std::string name() const override { return get_name(); }
 
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
@@ -1,10 +1,20 @@
 #pragma once
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
 #include <stdexcept>
-#include <thread>
+#include <string>
 #include <vector>
 
+#include "layers/Activation.hpp"
+#include "layers/ConvTuner.hpp"
+#include "layers/Gemm.hpp"
+#include "layers/KernelRegistry.hpp"
 #include "layers/Layer.hpp"
+#include "layers/Layout.hpp"
+#include "layers/Quantization.hpp"
+#include "layers/Winograd.hpp"
 
 namespace it_lab_ai {
 
@@ -13,24 +23,146 @@ class ConvolutionalLayer : public Layer {
   size_t stride_;
   size_t pads_;
   size_t dilations_;
+  // int or float, or kFloat16/kBFloat16 for float layers. 16-bit kernels
+  // only run the gemm of kIm2col, whose packed form is then kept in 16 bits
+  // too and widened a block at a time (see prepare_kernel and fits)
   Tensor kernel_;
   Tensor bias_;
   ImplType implType_;
+  // input and output channels are split into group_ groups convolved
+  // separately, the kernel's I is the input channels of one group
+  size_t group_ = 1;
+  // built with kAuto: the algorithm is chosen for each input shape, see
+  // choose
+  bool auto_tune_ = false;
+  // algorithm of the last input shape
+  ConvChoice choice_;
+  Shape choice_shape_;
+  // kernel_ in the layouts of the implementations, built by prepare_kernel
+  // before one is used: F(4x4, 3x3) transformed, packed for kIm2col,
+  // dilated for the others
+  Tensor winograd_kernel_;
+  Tensor im2col_kernel_;
+  Tensor dilated_kernel_;
+  // fused by Graph::fuse: output = activation_(conv + bias + residual)
+  Activation activation_;
+  bool residual_add_ = false;
+  // set by Graph::quantize: the input range seen while calibrating, then
+  // the int8 kernel (as the (kh * kw * I) x O right operand) of Conv4DInt8
+  bool calibrating_ = false;
+  ValueRange input_range_;
+  QuantParams input_params_;
+  std::shared_ptr<const QuantizedMatrix> int8_kernel_;
+
+  void prepare_kernel(ImplType impl);
+  // all of them, or all but keep
+  void drop_prepared_kernels(const Tensor* keep = nullptr);
+  // the form of kernel_ that runs of the implementation read
+  const Tensor& kernel_form(ImplType impl) const;
+  // type the kernels compute in
+  Type compute_type() const {
+    return is_16bit_float(kernel_.get_type()) ? Type::kFloat
+                                              : kernel_.get_type();
+  }
+  bool fits(ImplType impl) const;
+  bool uses_winograd(ImplType impl) const;
+  bool depthwise() const;
+  bool pointwise() const;
+  Shape output_shape(const Shape& input_shape) const;
+  std::string tuning_key(const Shape& input_shape) const;
+  const ConvChoice& choose(const Tensor& input);
+  template <typename ValueType>
+  void run_conv4d(const Tensor& input, const ConvChoice& choice,
+                  const OutputEpilogue<ValueType>& epilogue, Tensor& output);
+  // im2col_kernel_ is stored in KernelType
+  template <typename ValueType, typename KernelType>
+  void run_im2col(const Tensor& input, size_t row_tile,
+                  const OutputEpilogue<ValueType>& epilogue,
+                  Tensor& output) const;
+  void run_fused(const Tensor& input, const Tensor* residual, Tensor& output);
 
  public:
   ConvolutionalLayer() = default;
   ConvolutionalLayer(size_t step, size_t pads, size_t dilations,
                      const Tensor& kernel, const Tensor& bias = Tensor(),
-                     ImplType implType = kDefault) {
+                     ImplType implType = kDefault, size_t group = 1) {
     stride_ = step;
     pads_ = pads;
     dilations_ = dilations;
     kernel_ = kernel;
     bias_ = bias;
     implType_ = implType;
+    group_ = group;
+    if (group_ == 0 || (group_ > 1 && (kernel_.get_shape().dims() != 4 ||
+                                       kernel_.get_shape()[3] % group_ != 0))) {
+      throw std::invalid_argument(
+          "Output channels must split into the convolution groups");
+    }
+    // depthwise and 2D kernels have no im2col form
+    if (is_16bit_float(kernel_.get_type()) &&
+        (kernel_.get_shape().dims() != 4 || depthwise())) {
+      kernel_ = convert_precision(kernel_, Type::kFloat);
+    }
+    if (implType_ == kAuto) {
+      auto_tune_ = true;
+      implType_ = KernelRegistry::instance().select(
+          kConvolution, compute_type(),
+          [this](ImplType impl) { return fits(impl); });
+    }
+    if (is_16bit_float(kernel_.get_type()) && !fits(implType_)) {
+      implType_ = kIm2col;
+    }
+    choice_.impl = implType_;
+    if (kernel_.get_shape().dims() == 4) {
+      prepare_kernel(implType_);
+    }
   }
 
+  static std::string get_name() { return "Convolutional layer"; }
+  std::string name() const override { return get_name(); }
+  uint64_t flops(const Shape& input, const Shape& output) const override;
+  size_t weight_bytes() const override;
+  // registry choice of a kAuto layer, ConvTuner may pick another one for
+  // each input shape
+  ImplType impl_type() const { return implType_; }
+  size_t group() const { return group_; }
+  // algorithm the last input shape ran with
+  const ConvChoice& choice() const { return choice_; }
+  // warm-up of a kAuto layer: times the algorithms for the shape of input
+  // and keeps the fastest in ConvTuner, even if on-the-fly tuning is off.
+  // Only the kernel form of the fastest is kept
+  void tune(const Tensor& input);
   void run(const Tensor& input, Tensor& output) override;
+  // with a fused residual add the inputs are the input and the residual
+  void run_multi(const std::vector<Tensor>& inputs,
+                 std::vector<Tensor>& outputs) override;
+  // kNhwc runs ConvDepthwise or Conv4DNHWC, see the .cpp for which layers
+  bool supports_layout(LayInOut layout) const override;
+  bool prefers_layout(LayInOut layout) const override {
+    return layout == kNhwc && depthwise() && supports_layout(kNhwc);
+  }
+  bool fuse_activation(const Activation& activation) override {
+    if (!activation_.empty()) {
+      return false;
+    }
+    activation_ = activation;
+    return true;
+  }
+  // float layers without groups, with the usual stride semantics (see
+  // supports_layout)
+  bool start_calibration() override;
+  bool quantize() override;
+  bool quantized() const { return int8_kernel_ != nullptr; }
+  // float layers that aren't quantized
+  bool compress_weights(Type type) override;
+  // the residual is added before the activation, so not after fusing one
+  bool fuse_residual_add() override {
+    if (residual_add_ || !activation_.empty()) {
+      return false;
+    }
+    residual_add_ = true;
+    return true;
+  }
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return kernel_; }
 #endif
@@ -64,13 +196,12 @@ class ConvImpl : public LayerImpl<ValueType> {
 
   ConvImpl(const ConvImpl& c) = default;
 
-  std::vector<ValueType> run(
-      const std::vector<ValueType>& input) const override {
-    return input;
+  std::vector<ValueType> run(Span<const ValueType> input) const override {
+    return std::vector<ValueType>(input.begin(), input.end());
   }
 
-  std::vector<ValueType> run(std::vector<ValueType> startmatrix, int new_rows,
-                             int new_cols, std::vector<ValueType> startkernel,
+  std::vector<ValueType> run(Span<const ValueType> startmatrix, int new_rows,
+                             int new_cols, Span<const ValueType> startkernel,
                              size_t start_kernel_size, size_t kernel_size,
                              int center_distance) const {
     std::vector<ValueType> matrix(new_rows * new_cols * input_flow_, 0);
@@ -128,19 +259,43 @@ class ConvImpl : public LayerImpl<ValueType> {
   }
 };
 
-// NCHW -> NCHW only
+// HWIO kernel -> dilated HWIO kernel, holes between the taps are zeroes
 template <typename ValueType>
-void Conv4D(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
-            Tensor& output, size_t stride_, size_t pads_, size_t dilations_) {
+std::vector<ValueType> DilateKernel(const Tensor& kernel_, size_t dilations_) {
+  size_t kernel_height = kernel_.get_shape()[0];
+  size_t kernel_width = kernel_.get_shape()[1];
+  size_t channels = kernel_.get_shape()[2] * kernel_.get_shape()[3];
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  const AlignedVector<ValueType>& kernel_data = *kernel_.as<ValueType>();
+  std::vector<ValueType> dil_kernel(
+      (kernel_height * dilations_ + 1 - dilations_) * dil_width * channels, 0);
+  for (size_t h = 0; h < kernel_height; ++h) {
+    for (size_t w = 0; w < kernel_width; ++w) {
+      std::copy_n(kernel_data.begin() + (h * kernel_width + w) * channels,
+                  channels,
+                  dil_kernel.begin() +
+                      (h * dilations_ * dil_width + w * dilations_) * channels);
+    }
+  }
+  return dil_kernel;
+}
+
+// NCHW -> NCHW only, dil_kernel comes from DilateKernel
+template <typename ValueType>
+void Conv4D(const Tensor& input, const Shape& kernel_shape,
+            Span<const ValueType> dil_kernel, const Tensor& bias_,
+            Tensor& output, size_t stride_, size_t pads_, size_t dilations_,
+            const OutputEpilogue<ValueType>& epilogue =
+                OutputEpilogue<ValueType>()) {
   size_t batch_size = input.get_shape()[0];
   size_t in_height = input.get_shape()[2];
   size_t in_width = input.get_shape()[3];
   size_t in_channels = input.get_shape()[1];
 
-  size_t kernel_height = kernel_.get_shape()[0];
-  size_t kernel_width = kernel_.get_shape()[1];
-  size_t kernel_in_channels = kernel_.get_shape()[2];
-  size_t kernel_out_channels = kernel_.get_shape()[3];
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t kernel_in_channels = kernel_shape[2];
+  size_t kernel_out_channels = kernel_shape[3];
 
   std::vector<std::vector<std::vector<std::vector<ValueType>>>> padded_input =
       std::vector<std::vector<std::vector<std::vector<ValueType>>>>(
@@ -159,23 +314,11 @@ void Conv4D(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
       }
     }
   }
-  std::vector<std::vector<std::vector<std::vector<ValueType>>>> dil_kernel =
-      std::vector<std::vector<std::vector<std::vector<ValueType>>>>(
-          kernel_height * dilations_ + 1 - dilations_,
-          std::vector<std::vector<std::vector<ValueType>>>(
-              kernel_width * dilations_ + 1 - dilations_,
-              std::vector<std::vector<ValueType>>(
-                  kernel_in_channels,
-                  std::vector<ValueType>(kernel_out_channels, 0))));
-  for (size_t b = 0; b < kernel_out_channels; ++b) {
-    for (size_t h = 0; h < kernel_height; ++h) {
-      for (size_t w = 0; w < kernel_width; ++w) {
-        for (size_t c = 0; c < kernel_in_channels; ++c) {
-          dil_kernel[h * dilations_][w * dilations_][c][b] =
-              kernel_.get<ValueType>({h, w, c, b});
-        }
-      }
-    }
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  if (dil_kernel.size() !=
+      (kernel_height * dilations_ + 1 - dilations_) * dil_width *
+          kernel_in_channels * kernel_out_channels) {
+    throw std::invalid_argument("Dilated kernel doesn't fit the kernel shape");
   }
 
   size_t crat = 0;
@@ -208,16 +351,20 @@ void Conv4D(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
                  ++h) {
               for (size_t w = 0; w < kernel_width * dilations_ + 1 - dilations_;
                    ++w) {
-                value +=
-                    padded_input[b][i + h][j + w][ic] * dil_kernel[h][w][ic][c];
+                value += padded_input[b][i + h][j + w][ic] *
+                         dil_kernel[((h * dil_width + w) * kernel_in_channels +
+                                     ic) *
+                                        kernel_out_channels +
+                                    c];
               }
             }
           }
           if (!bias_.empty()) {
-            output_tensor[b][c][i][j] = value + (*bias_.as<ValueType>())[c];
-          } else {
-            output_tensor[b][c][i][j] = value;
+            value += (*bias_.as<ValueType>())[c];
           }
+          output_tensor[b][c][i][j] = epilogue(
+              ((b * kernel_out_channels + c) * out_height + i) * out_width + j,
+              value);
         }
       }
     }
@@ -241,81 +388,86 @@ void Conv4D(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
 
 // NCHW -> NCHW only
 template <typename ValueType>
-void Conv4DSTL(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
-               Tensor& output, size_t stride_, size_t pads_,
-               size_t dilations_) {
+void Conv4D(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
+            Tensor& output, size_t stride_, size_t pads_, size_t dilations_) {
+  Conv4D<ValueType>(input, kernel_.get_shape(),
+                    DilateKernel<ValueType>(kernel_, dilations_), bias_,
+                    output, stride_, pads_, dilations_);
+}
+
+// NCHW input or NHWC view (see Layout.hpp) -> NHWC copy with pads zeroes
+// around every image, rows are filled in parallel
+template <typename ValueType>
+std::vector<ValueType> PadToNHWC(const Tensor& input, size_t pads_) {
   size_t batch_size = input.get_shape()[0];
+  size_t channels = input.get_shape()[1];
   size_t in_height = input.get_shape()[2];
   size_t in_width = input.get_shape()[3];
-  size_t in_channels = input.get_shape()[1];
+  size_t padded_height = in_height + 2 * pads_;
+  size_t padded_width = in_width + 2 * pads_;
+  bool nhwc = is_nhwc(input);
+  const Tensor source = nhwc ? to_nhwc(input) : input;
+  const ValueType* input_data = source.as<ValueType>()->data();
+  std::vector<ValueType> padded_input(
+      batch_size * padded_height * padded_width * channels, ValueType(0));
+  oneapi::tbb::parallel_for(
+      size_t(0), batch_size * in_height, [&](size_t row) {
+        size_t b = row / in_height;
+        size_t h = row % in_height;
+        ValueType* padded =
+            padded_input.data() +
+            ((b * padded_height + h + pads_) * padded_width + pads_) *
+                channels;
+        if (nhwc) {
+          const ValueType* source_row =
+              input_data + row * in_width * channels;
+          std::copy(source_row, source_row + in_width * channels, padded);
+          return;
+        }
+        for (size_t c = 0; c < channels; ++c) {
+          const ValueType* channel =
+              input_data + ((b * channels + c) * in_height + h) * in_width;
+          for (size_t w = 0; w < in_width; ++w) {
+            padded[w * channels + c] = channel[w];
+          }
+        }
+      });
+  return padded_input;
+}
 
-  size_t kernel_height = kernel_.get_shape()[0];
-  size_t kernel_width = kernel_.get_shape()[1];
-  size_t kernel_in_channels = kernel_.get_shape()[2];
-  size_t kernel_out_channels = kernel_.get_shape()[3];
+// output rows per task of Conv4DSTL
+constexpr size_t kConvParallelRows = 4;
 
-  unsigned num_threads = std::thread::hardware_concurrency();
-  std::vector<std::thread> threads;
-  size_t chunk_size = batch_size / num_threads;
+// NCHW -> NCHW only, dil_kernel comes from DilateKernel. Same results as
+// Conv4D with (image, output channel) x row tiles split between the TBB
+// workers, so one image also uses every core
+template <typename ValueType>
+void Conv4DSTL(const Tensor& input, const Shape& kernel_shape,
+               Span<const ValueType> dil_kernel, const Tensor& bias_,
+               Tensor& output, size_t stride_, size_t pads_,
+               size_t dilations_,
+               const OutputEpilogue<ValueType>& epilogue =
+                   OutputEpilogue<ValueType>()) {
+  size_t batch_size = input.get_shape()[0];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+  size_t in_channels = input.get_shape()[1];
 
-  std::vector<std::vector<std::vector<std::vector<ValueType>>>> padded_input =
-      std::vector<std::vector<std::vector<std::vector<ValueType>>>>(
-          batch_size, std::vector<std::vector<std::vector<ValueType>>>(
-                          in_height + 2 * pads_,
-                          std::vector<std::vector<ValueType>>(
-                              in_width + 2 * pads_,
-                              std::vector<ValueType>(in_channels, 0))));
-  auto pad_input = [&](size_t start_b, size_t end_b) {
-    for (size_t b = start_b; b < end_b; ++b) {
-      for (size_t h = 0; h < in_height; ++h) {
-        for (size_t w = 0; w < in_width; ++w) {
-          for (size_t c = 0; c < in_channels; ++c) {
-            padded_input[b][h + pads_][w + pads_][c] =
-                input.get<ValueType>({b, c, h, w});
-          }
-        }
-      }
-    }
-  };
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t kernel_in_channels = kernel_shape[2];
+  size_t kernel_out_channels = kernel_shape[3];
 
-  for (unsigned i = 0; i < num_threads; ++i) {
-    size_t start = i * chunk_size;
-    size_t end = (i == num_threads - 1) ? batch_size : start + chunk_size;
-    threads.emplace_back(pad_input, start, end);
-  }
-  for (auto& t : threads) t.join();
-  threads.clear();
-  std::vector<std::vector<std::vector<std::vector<ValueType>>>> dil_kernel =
-      std::vector<std::vector<std::vector<std::vector<ValueType>>>>(
-          kernel_height * dilations_ + 1 - dilations_,
-          std::vector<std::vector<std::vector<ValueType>>>(
-              kernel_width * dilations_ + 1 - dilations_,
-              std::vector<std::vector<ValueType>>(
-                  kernel_in_channels,
-                  std::vector<ValueType>(kernel_out_channels, 0))));
-
-  auto dilate_kernel = [&](size_t start_b, size_t end_b) {
-    for (size_t b = start_b; b < end_b; ++b) {
-      for (size_t h = 0; h < kernel_height; ++h) {
-        for (size_t w = 0; w < kernel_width; ++w) {
-          for (size_t c = 0; c < kernel_in_channels; ++c) {
-            dil_kernel[h * dilations_][w * dilations_][c][b] =
-                kernel_.get<ValueType>({h, w, c, b});
-          }
-        }
-      }
-    }
-  };
-
-  chunk_size = kernel_out_channels / num_threads;
-  for (unsigned i = 0; i < num_threads; ++i) {
-    size_t start = i * chunk_size;
-    size_t end =
-        (i == num_threads - 1) ? kernel_out_channels : start + chunk_size;
-    threads.emplace_back(dilate_kernel, start, end);
+  size_t dil_height = kernel_height * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  if (dil_kernel.size() !=
+      dil_height * dil_width * kernel_in_channels * kernel_out_channels) {
+    throw std::invalid_argument("Dilated kernel doesn't fit the kernel shape");
   }
-  for (auto& t : threads) t.join();
-  threads.clear();
+
+  size_t padded_height = in_height + 2 * pads_;
+  size_t padded_width = in_width + 2 * pads_;
+  std::vector<ValueType> padded_input = PadToNHWC<ValueType>(input, pads_);
 
   size_t crat = 0;
   if ((in_height + 2 * pads_ - dilations_ * (kernel_height - 1)) % stride_ != 0)
@@ -332,74 +484,479 @@ void Conv4DSTL(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
   size_t out_width =
       (in_width + 2 * pads_ - dilations_ * (kernel_width - 1)) / stride_ + crat;
 
-  std::vector<std::vector<std::vector<std::vector<ValueType>>>> output_tensor(
-      batch_size, std::vector<std::vector<std::vector<ValueType>>>(
-                      kernel_out_channels,
-                      std::vector<std::vector<ValueType>>(
-                          out_height, std::vector<ValueType>(out_width, 0))));
-
-  auto compute_conv = [&](size_t start_b, size_t end_b) {
-    for (size_t b = start_b; b < end_b; ++b) {
-      for (size_t c = 0; c < kernel_out_channels; ++c) {
-        for (size_t i = 0; i < out_height; i += stride_) {
-          for (size_t j = 0; j < out_width; j += stride_) {
-            ValueType value = 0;
-            for (size_t ic = 0; ic < in_channels; ++ic) {
-              for (size_t h = 0;
-                   h < kernel_height * dilations_ + 1 - dilations_; ++h) {
-                for (size_t w = 0;
-                     w < kernel_width * dilations_ + 1 - dilations_; ++w) {
-                  value += padded_input[b][i + h][j + w][ic] *
-                           dil_kernel[h][w][ic][c];
+  const ValueType* bias_data =
+      bias_.empty() ? nullptr : bias_.as<ValueType>()->data();
+  Shape sh({batch_size, kernel_out_channels, out_height, out_width});
+  // the values off the stride grid stay 0
+  AlignedVector<ValueType>& one_d_vector = output.reset<ValueType>(sh);
+  std::fill(one_d_vector.begin(), one_d_vector.end(), ValueType(0));
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range2d<size_t>(0, batch_size * kernel_out_channels,
+                                           1, 0, out_height,
+                                           kConvParallelRows),
+      [&](const oneapi::tbb::blocked_range2d<size_t>& range) {
+        for (size_t bc = range.rows().begin(); bc < range.rows().end();
+             ++bc) {
+          size_t b = bc / kernel_out_channels;
+          size_t c = bc % kernel_out_channels;
+          // the rows of the tile on the stride grid
+          size_t first = (range.cols().begin() + stride_ - 1) / stride_ *
+                         stride_;
+          for (size_t i = first; i < range.cols().end(); i += stride_) {
+            for (size_t j = 0; j < out_width; j += stride_) {
+              ValueType value = 0;
+              for (size_t ic = 0; ic < in_channels; ++ic) {
+                for (size_t h = 0; h < dil_height; ++h) {
+                  const ValueType* padded =
+                      padded_input.data() +
+                      ((b * padded_height + i + h) * padded_width + j) *
+                          in_channels +
+                      ic;
+                  const ValueType* taps =
+                      dil_kernel.data() +
+                      (h * dil_width * kernel_in_channels + ic) *
+                          kernel_out_channels +
+                      c;
+                  for (size_t w = 0; w < dil_width; ++w) {
+                    value += padded[w * in_channels] *
+                             taps[w * kernel_in_channels * kernel_out_channels];
+                  }
                 }
               }
+              if (bias_data != nullptr) {
+                value += bias_data[c];
+              }
+              size_t index = (bc * out_height + i) * out_width + j;
+              one_d_vector[index] = epilogue(index, value);
             }
-            if (!bias_.empty()) {
-              output_tensor[b][c][i][j] = value + (*bias_.as<ValueType>())[c];
+          }
+        }
+      });
+}
+
+// NCHW -> NCHW only
+template <typename ValueType>
+void Conv4DSTL(const Tensor& input, const Tensor& kernel_, const Tensor& bias_,
+               Tensor& output, size_t stride_, size_t pads_,
+               size_t dilations_) {
+  Conv4DSTL<ValueType>(input, kernel_.get_shape(),
+                       DilateKernel<ValueType>(kernel_, dilations_), bias_,
+                       output, stride_, pads_, dilations_);
+}
+
+// one NCHW image -> columns matrix (in_channels * kh * kw) x (oh * ow),
+// or only the columns of output rows [row_begin, row_end)
+template <typename ValueType>
+void Im2col(const ValueType* image, size_t in_channels, size_t in_height,
+            size_t in_width, size_t kernel_height, size_t kernel_width,
+            size_t out_height, size_t out_width, size_t stride_, size_t pads_,
+            size_t dilations_, ValueType* columns, size_t row_begin = 0,
+            size_t row_end = std::numeric_limits<size_t>::max()) {
+  row_end = std::min(row_end, out_height);
+  for (size_t ic = 0; ic < in_channels; ++ic) {
+    const ValueType* channel = image + ic * in_height * in_width;
+    for (size_t h = 0; h < kernel_height; ++h) {
+      for (size_t w = 0; w < kernel_width; ++w) {
+        for (size_t i = row_begin; i < row_end; ++i) {
+          // coordinates in the unpadded input, may leave the image
+          size_t row = i * stride_ + h * dilations_;
+          bool row_inside = row >= pads_ && row - pads_ < in_height;
+          for (size_t j = 0; j < out_width; ++j) {
+            size_t col = j * stride_ + w * dilations_;
+            if (row_inside && col >= pads_ && col - pads_ < in_width) {
+              columns[j] = channel[(row - pads_) * in_width + col - pads_];
             } else {
-              output_tensor[b][c][i][j] = value;
+              columns[j] = ValueType(0);
             }
           }
+          columns += out_width;
         }
       }
     }
-  };
+  }
+}
 
-  chunk_size = batch_size / num_threads;
-  for (unsigned i = 0; i < num_threads; ++i) {
-    size_t start = i * chunk_size;
-    size_t end = (i == num_threads - 1) ? batch_size : start + chunk_size;
-    threads.emplace_back(compute_conv, start, end);
+// HWIO kernel -> O x (I * H * W) gemm operand packed by gemm_pack_a_matrix.
+// With groups the O / group rows of every group are packed one after
+// another, I is the input channels of a group
+template <typename ValueType>
+std::vector<ValueType> Im2colPackKernel(const Tensor& kernel_,
+                                        size_t group = 1) {
+  size_t kernel_height = kernel_.get_shape()[0];
+  size_t kernel_width = kernel_.get_shape()[1];
+  size_t in_channels = kernel_.get_shape()[2];
+  size_t kernel_out_channels = kernel_.get_shape()[3];
+  size_t group_out_channels = kernel_out_channels / group;
+  size_t col_rows = in_channels * kernel_height * kernel_width;
+  const AlignedVector<ValueType>& kernel_data = *kernel_.as<ValueType>();
+  std::vector<ValueType> weights(kernel_out_channels * col_rows);
+  for (size_t oc = 0; oc < kernel_out_channels; ++oc) {
+    for (size_t ic = 0; ic < in_channels; ++ic) {
+      for (size_t h = 0; h < kernel_height; ++h) {
+        for (size_t w = 0; w < kernel_width; ++w) {
+          size_t hwio = ((h * kernel_width + w) * in_channels + ic) *
+                            kernel_out_channels +
+                        oc;
+          size_t oihw =
+              oc * col_rows + (ic * kernel_height + h) * kernel_width + w;
+          weights[oihw] = kernel_data[hwio];
+        }
+      }
+    }
+  }
+  size_t group_size = gemm_packed_a_size(group_out_channels, col_rows);
+  std::vector<ValueType> packed(group * group_size);
+  for (size_t g = 0; g < group; ++g) {
+    gemm_pack_a_matrix(group_out_channels, col_rows,
+                       weights.data() + g * group_out_channels * col_rows,
+                       col_rows, size_t(1), packed.data() + g * group_size);
   }
-  for (auto& t : threads) t.join();
-  threads.clear();
+  return packed;
+}
 
-  Shape sh({batch_size, kernel_out_channels, out_height, out_width});
-  std::vector<ValueType> one_d_vector(batch_size * out_height * out_width *
-                                      kernel_out_channels);
+// NCHW -> NCHW only, convolution lowered to im2col + blocked gemm.
+// packed_kernel comes from Im2colPackKernel, bias and epilogue are applied
+// by the gemm micro-kernel. With row_tile > 0 the columns are built and
+// multiplied row_tile output rows at a time, so they stay in cache. With
+// groups every group of input channels is multiplied by its own rows of
+// the kernel. 1x1 kernels with stride 1 and no padding skip im2col: the
+// gemm reads the channels x pixels matrix of the image in place and its
+// column tiles run in parallel. A packed kernel in a 16-bit float type is
+// widened by the gemm a block at a time
+template <typename ValueType, typename KernelType>
+void Conv4DIm2col(const Tensor& input, const Shape& kernel_shape,
+                  Span<const KernelType> packed_kernel,
+                  const Tensor& bias_, Tensor& output, size_t stride_,
+                  size_t pads_, size_t dilations_,
+                  const OutputEpilogue<ValueType>& epilogue =
+                      OutputEpilogue<ValueType>(),
+                  size_t row_tile = 0, size_t group = 1) {
+  size_t batch_size = input.get_shape()[0];
+  size_t in_channels = input.get_shape()[1];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t kernel_in_channels = kernel_shape[2];
+  size_t kernel_out_channels = kernel_shape[3];
+  if (kernel_in_channels * group != in_channels) {
+    throw std::invalid_argument("Kernel and input channels don't match");
+  }
+  size_t group_out_channels = kernel_out_channels / group;
+
+  size_t dil_height = kernel_height * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  size_t out_height = (in_height + 2 * pads_ - dil_height + stride_) / stride_;
+  size_t out_width = (in_width + 2 * pads_ - dil_width + stride_) / stride_;
+
+  size_t col_rows = kernel_in_channels * kernel_height * kernel_width;
+  size_t col_cols = out_height * out_width;
+  size_t group_size = gemm_packed_a_size(group_out_channels, col_rows);
+  if (packed_kernel.size() != group * group_size) {
+    throw std::invalid_argument("Packed kernel doesn't fit the kernel shape");
+  }
+
+  bool pointwise = kernel_height == 1 && kernel_width == 1 && stride_ == 1 &&
+                   pads_ == 0;
+  if (row_tile == 0 || row_tile > out_height || pointwise) {
+    row_tile = out_height;
+  }
 
-  auto flatten_output = [&](size_t start_b, size_t end_b) {
-    size_t index_1d = start_b * kernel_out_channels * out_height * out_width;
-    for (size_t i = start_b; i < end_b; ++i) {
-      for (size_t l = 0; l < kernel_out_channels; ++l) {
-        for (size_t j = 0; j < out_height; ++j) {
-          for (size_t k = 0; k < out_width; ++k) {
-            one_d_vector[index_1d++] = output_tensor[i][l][j][k];
+  const AlignedVector<ValueType>& input_data = *input.as<ValueType>();
+  const ValueType* bias_data =
+      bias_.empty() ? nullptr : bias_.as<ValueType>()->data();
+  std::vector<ValueType> columns(pointwise ? 0
+                                           : col_rows * row_tile * out_width);
+  AlignedVector<ValueType>& one_d_vector = output.reset<ValueType>(
+      {batch_size, kernel_out_channels, out_height, out_width});
+  for (size_t b = 0; b < batch_size; ++b) {
+    for (size_t g = 0; g < group; ++g) {
+      size_t first_oc = g * group_out_channels;
+      const ValueType* group_bias =
+          bias_data == nullptr ? nullptr : bias_data + first_oc;
+      const KernelType* group_kernel = packed_kernel.data() + g * group_size;
+      if (pointwise) {
+        const ValueType* image =
+            input_data.data() + (b * in_channels + g * kernel_in_channels) *
+                                    col_cols;
+        size_t offset = (b * kernel_out_channels + first_oc) * col_cols;
+        auto fused = [&](size_t oc, size_t p, ValueType value) {
+          if (group_bias != nullptr) {
+            value += group_bias[oc];
           }
+          return epilogue.empty() ? value
+                                  : epilogue(offset + oc * col_cols + p, value);
+        };
+        gemm_prepacked_a_parallel(group_out_channels, col_cols, col_rows,
+                                  group_kernel, image, col_cols, size_t(1),
+                                  one_d_vector.data() + offset, col_cols,
+                                  fused);
+        continue;
+      }
+      for (size_t row = 0; row < out_height; row += row_tile) {
+        size_t row_end = std::min(out_height, row + row_tile);
+        size_t tile_cols = (row_end - row) * out_width;
+        Im2col(input_data.data() +
+                   (b * in_channels + g * kernel_in_channels) * in_height *
+                       in_width,
+               kernel_in_channels, in_height, in_width, kernel_height,
+               kernel_width, out_height, out_width, stride_, pads_,
+               dilations_, columns.data(), row, row_end);
+        size_t tile_offset =
+            (b * kernel_out_channels + first_oc) * col_cols + row * out_width;
+        ValueType* result = one_d_vector.data() + tile_offset;
+        if (epilogue.empty()) {
+          auto add_bias = [&](size_t oc, size_t, ValueType value) {
+            return group_bias == nullptr ? value : value + group_bias[oc];
+          };
+          gemm_prepacked_a(group_out_channels, tile_cols, col_rows,
+                           group_kernel, columns.data(), tile_cols, size_t(1),
+                           result, col_cols, add_bias);
+        } else {
+          auto fused = [&](size_t oc, size_t p, ValueType value) {
+            if (group_bias != nullptr) {
+              value += group_bias[oc];
+            }
+            return epilogue(tile_offset + oc * col_cols + p, value);
+          };
+          gemm_prepacked_a(group_out_channels, tile_cols, col_rows,
+                           group_kernel, columns.data(), tile_cols, size_t(1),
+                           result, col_cols, fused);
         }
       }
     }
-  };
+  }
+}
+
+// Conv4DIm2col with the kernel packed in the type of the values
+template <typename ValueType>
+void Conv4DIm2col(const Tensor& input, const Shape& kernel_shape,
+                  Span<const ValueType> packed_kernel,
+                  const Tensor& bias_, Tensor& output, size_t stride_,
+                  size_t pads_, size_t dilations_,
+                  const OutputEpilogue<ValueType>& epilogue =
+                      OutputEpilogue<ValueType>(),
+                  size_t row_tile = 0, size_t group = 1) {
+  Conv4DIm2col<ValueType, ValueType>(input, kernel_shape, packed_kernel,
+                                     bias_, output, stride_, pads_,
+                                     dilations_, epilogue, row_tile, group);
+}
+
+// NCHW -> NCHW depthwise convolution: one input channel per group, the
+// HWIO kernel has I = 1 and O = channels * multiplier, output channel oc
+// reads input channel oc / multiplier. Each step reads few values per
+// multiply, so the input is padded into NHWC rows and every output row is
+// accumulated in a small NHWC buffer with the channels innermost, which
+// vectorizes over channels, then stored to NCHW, or as is with layout
+// kNhwc (the output is then an NHWC view). Tasks are output rows
+template <typename ValueType>
+void ConvDepthwise(const Tensor& input, const Shape& kernel_shape,
+                   Span<const ValueType> kernel, const Tensor& bias_,
+                   Tensor& output, size_t stride_, size_t pads_,
+                   size_t dilations_,
+                   const OutputEpilogue<ValueType>& epilogue =
+                       OutputEpilogue<ValueType>(),
+                   LayInOut layout = kNchw) {
+  size_t batch_size = input.get_shape()[0];
+  size_t channels = input.get_shape()[1];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t out_channels = kernel_shape[3];
+  if (kernel_shape[2] != 1 || out_channels % channels != 0) {
+    throw std::invalid_argument("Kernel isn't a depthwise kernel of input");
+  }
+  size_t multiplier = out_channels / channels;
+
+  size_t dil_height = kernel_height * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  size_t out_height = (in_height + 2 * pads_ - dil_height + stride_) / stride_;
+  size_t out_width = (in_width + 2 * pads_ - dil_width + stride_) / stride_;
+
+  size_t padded_height = in_height + 2 * pads_;
+  size_t padded_width = in_width + 2 * pads_;
+  std::vector<ValueType> padded_input = PadToNHWC<ValueType>(input, pads_);
+
+  const ValueType* bias_data =
+      bias_.empty() ? nullptr : bias_.as<ValueType>()->data();
+  AlignedVector<ValueType>& one_d_vector = output.reset<ValueType>(
+      layout == kNhwc
+          ? Shape({batch_size, out_height, out_width, out_channels})
+          : Shape({batch_size, out_channels, out_height, out_width}));
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range<size_t>(0, batch_size * out_height),
+      [&](const oneapi::tbb::blocked_range<size_t>& range) {
+        std::vector<ValueType> row(out_width * out_channels);
+        for (size_t bi = range.begin(); bi < range.end(); ++bi) {
+          size_t b = bi / out_height;
+          size_t i = bi % out_height;
+          for (size_t j = 0; j < out_width; ++j) {
+            for (size_t oc = 0; oc < out_channels; ++oc) {
+              row[j * out_channels + oc] =
+                  bias_data == nullptr ? ValueType(0) : bias_data[oc];
+            }
+          }
+          for (size_t h = 0; h < kernel_height; ++h) {
+            const ValueType* source =
+                padded_input.data() +
+                (b * padded_height + i * stride_ + h * dilations_) *
+                    padded_width * channels;
+            for (size_t w = 0; w < kernel_width; ++w) {
+              const ValueType* taps =
+                  kernel.data() + (h * kernel_width + w) * out_channels;
+              for (size_t j = 0; j < out_width; ++j) {
+                const ValueType* in =
+                    source + (j * stride_ + w * dilations_) * channels;
+                ValueType* acc = row.data() + j * out_channels;
+                if (multiplier == 1) {
+                  for (size_t c = 0; c < channels; ++c) {
+                    acc[c] += in[c] * taps[c];
+                  }
+                } else {
+                  for (size_t c = 0; c < channels; ++c) {
+                    for (size_t m = 0; m < multiplier; ++m) {
+                      acc[c * multiplier + m] +=
+                          in[c] * taps[c * multiplier + m];
+                    }
+                  }
+                }
+              }
+            }
+          }
+          if (layout == kNhwc) {
+            size_t index = bi * out_width * out_channels;
+            for (size_t k = 0; k < row.size(); ++k) {
+              one_d_vector[index + k] = epilogue(index + k, row[k]);
+            }
+            continue;
+          }
+          for (size_t oc = 0; oc < out_channels; ++oc) {
+            size_t index = ((b * out_channels + oc) * out_height + i) *
+                           out_width;
+            for (size_t j = 0; j < out_width; ++j) {
+              one_d_vector[index + j] =
+                  epilogue(index + j, row[j * out_channels + oc]);
+            }
+          }
+        }
+      });
 
-  chunk_size = batch_size / num_threads;
-  for (unsigned i = 0; i < num_threads; ++i) {
-    size_t start = i * chunk_size;
-    size_t end = (i == num_threads - 1) ? batch_size : start + chunk_size;
-    threads.emplace_back(flatten_output, start, end);
+  if (layout == kNhwc) {
+    output = nhwc_view(output);
   }
-  for (auto& t : threads) t.join();
+}
 
-  output = make_tensor<ValueType>(one_d_vector, sh);
+// NCHW input or NHWC view -> NCHW, or NHWC view with layout kNhwc. Groups
+// of 1 with the kernel quantized by Graph::quantize: the input is
+// quantized into a padded NHWC buffer (the padding is the zero point of
+// input_params), tiles of output pixels gather their uint8 im2col rows
+// for gemm_u8s8s32 and the int32 sums are dequantized with the bias
+void Conv4DInt8(const Tensor& input, const Shape& kernel_shape,
+                const QuantizedMatrix& kernel, const QuantParams& input_params,
+                const Tensor& bias_, Tensor& output, size_t stride_,
+                size_t pads_, size_t dilations_,
+                const OutputEpilogue<float>& epilogue, LayInOut layout);
+
+// NCHW input or NHWC view -> NHWC view, groups of 1 only. The output
+// pixels are the rows of a gemm by the HWIO kernel, a (kh * kw * I) x O
+// matrix as it is stored: tiles of kGemmMc pixels gather their im2col rows
+// (runs of I channels copied whole) and are multiplied in parallel. 1x1
+// kernels with stride 1 and no padding multiply the input in place. The
+// epilogue index is the NHWC one
+template <typename ValueType>
+void Conv4DNHWC(const Tensor& input, const Shape& kernel_shape,
+                Span<const ValueType> kernel, const Tensor& bias_,
+                Tensor& output, size_t stride_, size_t pads_,
+                size_t dilations_,
+                const OutputEpilogue<ValueType>& epilogue =
+                    OutputEpilogue<ValueType>()) {
+  size_t batch_size = input.get_shape()[0];
+  size_t channels = input.get_shape()[1];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t out_channels = kernel_shape[3];
+  if (kernel_shape[2] != channels) {
+    throw std::invalid_argument("Kernel and input channels don't match");
+  }
+  size_t dil_height = kernel_height * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  size_t out_height = (in_height + 2 * pads_ - dil_height + stride_) / stride_;
+  size_t out_width = (in_width + 2 * pads_ - dil_width + stride_) / stride_;
+  size_t pixels = batch_size * out_height * out_width;
+  size_t depth = kernel_height * kernel_width * channels;
+  bool in_place = kernel_height == 1 && kernel_width == 1 && stride_ == 1 &&
+                  pads_ == 0;
+
+  const Tensor source = to_nhwc(input);
+  const ValueType* input_data = source.as<ValueType>()->data();
+  const ValueType* bias_data =
+      bias_.empty() ? nullptr : bias_.as<ValueType>()->data();
+  AlignedVector<ValueType>& one_d_vector = output.reset<ValueType>(
+      {batch_size, out_height, out_width, out_channels});
+  size_t tiles = (pixels + kGemmMc - 1) / kGemmMc;
+  oneapi::tbb::parallel_for(size_t(0), tiles, [&](size_t tile) {
+    size_t first = tile * kGemmMc;
+    size_t rows = std::min(kGemmMc, pixels - first);
+    const ValueType* a = input_data + first * channels;
+    std::vector<ValueType> columns;
+    if (!in_place) {
+      columns.assign(rows * depth, ValueType(0));
+      for (size_t r = 0; r < rows; ++r) {
+        size_t p = first + r;
+        size_t b = p / (out_height * out_width);
+        size_t i = p / out_width % out_height;
+        size_t j = p % out_width;
+        for (size_t h = 0; h < kernel_height; ++h) {
+          size_t y = i * stride_ + h * dilations_;
+          if (y < pads_ || y >= in_height + pads_) {
+            continue;
+          }
+          for (size_t w = 0; w < kernel_width; ++w) {
+            size_t x = j * stride_ + w * dilations_;
+            if (x < pads_ || x >= in_width + pads_) {
+              continue;
+            }
+            const ValueType* pixel =
+                input_data +
+                ((b * in_height + y - pads_) * in_width + x - pads_) *
+                    channels;
+            std::copy(pixel, pixel + channels,
+                      columns.data() + r * depth +
+                          (h * kernel_width + w) * channels);
+          }
+        }
+      }
+      a = columns.data();
+    }
+    gemm_blocked(rows, out_channels, depth, a, depth, size_t(1),
+                 static_cast<const ValueType*>(nullptr), size_t(0), rows,
+                 kernel.data(), out_channels, size_t(1),
+                 one_d_vector.data() + first * out_channels, out_channels,
+                 [&](size_t r, size_t oc, ValueType value) {
+                   if (bias_data != nullptr) {
+                     value += bias_data[oc];
+                   }
+                   return epilogue((first + r) * out_channels + oc, value);
+                 });
+  });
+
+  output = nhwc_view(output);
+}
+
+// NCHW -> NCHW only, convolution lowered to im2col + blocked gemm
+template <typename ValueType>
+void Conv4DIm2col(const Tensor& input, const Tensor& kernel_,
+                  const Tensor& bias_, Tensor& output, size_t stride_,
+                  size_t pads_, size_t dilations_) {
+  Conv4DIm2col<ValueType>(input, kernel_.get_shape(),
+                          Im2colPackKernel<ValueType>(kernel_), bias_, output,
+                          stride_, pads_, dilations_);
 }
 
 }  // namespace it_lab_ai
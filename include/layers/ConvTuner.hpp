@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "layers/Layer.hpp"
+
+namespace it_lab_ai {
+
+// convolution algorithm and, for kIm2col, output rows per im2col tile
+// (0 for the whole image)
+struct ConvChoice {
+  ImplType impl = kDefault;
+  size_t row_tile = 0;
+};
+
+// Remembers the fastest convolution algorithm of every concrete layer
+// shape (the key). ConvolutionalLayer built with kAuto runs a choice stored
+// for its shape, otherwise the one of the registry. Timing the candidates
+// on the first run of a new shape is opt-in: ITLAB_AI_TUNE=1 or
+// set_enabled(true), or an explicit ConvolutionalLayer::tune. Choices can
+// be kept in a text file, one "key<TAB>algorithm<TAB>row tile" line per
+// shape: ITLAB_AI_TUNING_FILE names one that is loaded on first use and
+// rewritten after every new measurement.
+class ConvTuner {
+ public:
+  static ConvTuner& instance();
+  bool enabled() const { return enabled_; }
+  void set_enabled(bool enabled) { enabled_ = enabled; }
+  // false if the shape wasn't tuned
+  bool find(const std::string& key, ConvChoice& choice) const;
+  // runs every candidate repeats times and keeps the fastest
+  ConvChoice tune(const std::string& key,
+                  const std::vector<ConvChoice>& candidates,
+                  const std::function<void(const ConvChoice&)>& run,
+                  int repeats = 2);
+  void set(const std::string& key, const ConvChoice& choice);
+  void clear();
+  // malformed lines are skipped, false if the file can't be opened
+  bool load(const std::string& path);
+  bool save(const std::string& path) const;
+
+ private:
+  ConvTuner();
+  mutable std::mutex mutex_;
+  std::map<std::string, ConvChoice> choices_;
+  std::string file_;
+  bool enabled_ = false;
+};
+
+}  // namespace it_lab_ai
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace it_lab_ai {
+
+// instruction set levels of the kernels, each one includes the ones
+// before it (kSse4 is SSE4.2, kAvx2 comes with FMA, kAvx512 is AVX-512F)
+enum class Isa : uint8_t { kScalar, kSse4, kAvx2, kAvx512 };
+
+// features of the CPU running the library (and enabled by its OS)
+struct CpuFeatures {
+  bool sse4_2 = false;
+  bool avx = false;
+  bool avx2 = false;
+  bool fma = false;
+  bool avx512f = false;
+  // int8 dot products (vpdpbusd) of the quantized kernels
+  bool avx512vnni = false;
+  // conversions of the 16-bit float types (see Float16.hpp)
+  bool f16c = false;
+  bool avx512bf16 = false;
+};
+
+// detected once, false everywhere on other architectures
+const CpuFeatures& cpu_features();
+// highest level of this CPU, ITLAB_AI_ISA=scalar|sse4|avx2|avx512 lowers
+// it to compare kernels
+Isa max_isa();
+bool isa_supported(Isa isa);
+const char* isa_name(Isa isa);
+// false for unknown names
+bool parse_isa(const std::string& name, Isa& isa);
+
+}  // namespace it_lab_ai
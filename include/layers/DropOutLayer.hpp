@@ -13,10 +13,15 @@ class DropOutLayer : public Layer {
   DropOutLayer() = default;
   DropOutLayer(double drop_rate) { drop_rate_ = drop_rate; }
   static std::string get_name() { return "DropOut layer"; }
+  std::string name() const override { return get_name(); }
   void run(const Tensor& input, Tensor& output) override;
+  bool supports_inplace() const override { return true; }
+  void run_inplace(Tensor& tensor) override;
+  // values are independent, NHWC views are computed in storage order
+  bool supports_layout(LayInOut) const override { return true; }
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
 #endif
 };
 
-}  // namespace it_lab_ai
\ No newline at end of file
+}  // namespace it_lab_ai
\ No newline at end of file
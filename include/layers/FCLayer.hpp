@@ -1,34 +1,83 @@
 #pragma once
 #include <algorithm>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include "layers/Gemm.hpp"
 #include "layers/Layer.hpp"
+#include "layers/Quantization.hpp"
 
 namespace it_lab_ai {
 
+template <typename ValueType>
+class FCLayerImpl;
+
 class FCLayer : public Layer {
  private:
+  // out x in, float or int, or kFloat16/kBFloat16 with float inputs and
+  // bias. The weights are kept in one form: the gemm panels of int_impl_ or
+  // float_impl_, or else weights_
+  Shape weights_shape_;
+  Type weights_type_ = Type::kUnknown;
+  // 16-bit weights, which run_compressed widens as it goes, or weights no
+  // impl was built from (run() then throws)
   Tensor weights_;
   Tensor bias_;
+  // built once from the given weights and bias_, so run() does no weight
+  // copying
+  std::shared_ptr<const FCLayerImpl<int>> int_impl_;
+  std::shared_ptr<const FCLayerImpl<float>> float_impl_;
+  // fused by Graph::fuse, applied together with the bias
+  Activation activation_;
+  // set by Graph::quantize: the input range seen while calibrating, then
+  // the int8 weights (as the in x out right operand) the layer runs with
+  bool calibrating_ = false;
+  ValueRange input_range_;
+  QuantParams input_params_;
+  std::shared_ptr<const QuantizedMatrix> int8_weights_;
+
+  void prepare_impl();
+  void run_int8(const Tensor& input, Tensor& output) const;
+  void run_compressed(const Tensor& input, Tensor& output) const;
 
  public:
   FCLayer() = default;
   FCLayer(Tensor weights, const Tensor& bias)
-      : weights_(std::move(weights)), bias_(bias) {}
+      : weights_(std::move(weights)), bias_(bias) {
+    prepare_impl();
+  }
   static std::string get_name() { return "Fully-connected layer"; }
+  std::string name() const override { return get_name(); }
+  uint64_t flops(const Shape& input, const Shape& output) const override;
+  size_t weight_bytes() const override;
   void run(const Tensor& input, Tensor& output) override;
+  bool fuse_activation(const Activation& activation) override {
+    if (!activation_.empty()) {
+      return false;
+    }
+    activation_ = activation;
+    return true;
+  }
+  // float layers only
+  bool start_calibration() override;
+  bool quantize() override;
+  bool quantized() const { return int8_weights_ != nullptr; }
+  // float layers that aren't quantized
+  bool compress_weights(Type type) override;
 #ifdef ENABLE_STATISTIC_WEIGHTS
-  Tensor get_weights() override { return weights_; }
+  Tensor get_weights() override;
 #endif
 };
 
-template <typename ValueType>
-std::vector<ValueType> mat_vec_mul(const std::vector<ValueType>& mat,
-                                   const Shape& mat_shape,
-                                   const std::vector<ValueType>& vec) {
+// Matrix and Vector are std::vector, AlignedVector or Span
+template <typename Matrix, typename Vector>
+std::vector<typename Vector::value_type> mat_vec_mul(const Matrix& mat,
+                                                     const Shape& mat_shape,
+                                                     const Vector& vec) {
+  using ValueType = typename Vector::value_type;
   size_t c = vec.size() / mat_shape[1];
   if (mat_shape.dims() != 2) {
     throw std::invalid_argument("Not a matrix in argument");
@@ -54,22 +103,40 @@ template <typename ValueType>
 class FCLayerImpl : public LayerImpl<ValueType> {
  public:
   FCLayerImpl() = delete;
-  FCLayerImpl(const std::vector<ValueType>& input_weights,
+  FCLayerImpl(Span<const ValueType> input_weights,
               const Shape& input_weights_shape,
-              const std::vector<ValueType>& input_bias);
+              Span<const ValueType> input_bias);
   FCLayerImpl(const FCLayerImpl& c) = default;
   FCLayerImpl& operator=(const FCLayerImpl& sec) = default;
   void set_weight(size_t i, size_t j, const ValueType& value) {
     if (i >= this->outputShape_[0] || j >= this->inputShape_[0]) {
       throw std::out_of_range("Invalid weight index");
     }
-    weights_[i * this->inputShape_[0] + j] = value;
+    packed_weights_[gemm_packed_a_index(this->outputShape_[0],
+                                        this->inputShape_[0], i, j)] = value;
   }
   ValueType get_weight(size_t i, size_t j) const {
     if (i >= this->outputShape_[0] || j >= this->inputShape_[0]) {
       throw std::out_of_range("Invalid weight index");
     }
-    return weights_[i * this->inputShape_[0] + j];
+    return packed_weights_[gemm_packed_a_index(this->outputShape_[0],
+                                               this->inputShape_[0], i, j)];
+  }
+  // out x in row-major weights read back from the panels
+  std::vector<ValueType> get_weights() const {
+    size_t out_size = this->outputShape_[0];
+    size_t in_size = this->inputShape_[0];
+    std::vector<ValueType> weights(out_size * in_size);
+    for (size_t i = 0; i < out_size; ++i) {
+      for (size_t j = 0; j < in_size; ++j) {
+        weights[i * in_size + j] = get_weight(i, j);
+      }
+    }
+    return weights;
+  }
+  // the panels a run reads
+  size_t weight_bytes() const {
+    return packed_weights_.size() * sizeof(ValueType);
   }
   void set_bias(size_t i, const ValueType& value) {
     if (i >= this->outputShape_[0]) {
@@ -83,11 +150,25 @@ class FCLayerImpl : public LayerImpl<ValueType> {
     }
     return bias_[i];
   }
-  std::vector<ValueType> run(
-      const std::vector<ValueType>& input) const override;
+  std::vector<ValueType> run(Span<const ValueType> input) const override {
+    return run(input, Activation());
+  }
+  // activation(weights * input + bias)
+  std::vector<ValueType> run(Span<const ValueType> input,
+                             const Activation& activation) const {
+    std::vector<ValueType> output(input.size() / this->inputShape_[0] *
+                                  this->outputShape_[0]);
+    run(input, activation, output.data());
+    return output;
+  }
+  // the same written to output, batch x out values
+  void run(Span<const ValueType> input, const Activation& activation,
+           ValueType* output) const;
 
  private:
-  std::vector<ValueType> weights_;
+  // the only copy of the weights, in the gemm panel layout. FCLayer builds
+  // the int8 and 16-bit forms from get_weights()
+  AlignedVector<ValueType> packed_weights_;
   std::vector<ValueType> bias_;
 };
 
@@ -95,10 +176,10 @@ class FCLayerImpl : public LayerImpl<ValueType> {
 
 // constructor for FCLayer
 template <typename ValueType>
-FCLayerImpl<ValueType>::FCLayerImpl(const std::vector<ValueType>& input_weights,
+FCLayerImpl<ValueType>::FCLayerImpl(Span<const ValueType> input_weights,
                                     const Shape& input_weights_shape,
-                                    const std::vector<ValueType>& input_bias)
-    : LayerImpl<ValueType>(1, 1), weights_(input_weights), bias_(input_bias) {
+                                    Span<const ValueType> input_bias)
+    : LayerImpl<ValueType>(1, 1), bias_(input_bias.begin(), input_bias.end()) {
   if (input_weights.empty()) {
     throw std::invalid_argument("Empty weights for FCLayer");
   }
@@ -111,21 +192,50 @@ FCLayerImpl<ValueType>::FCLayerImpl(const std::vector<ValueType>& input_weights,
   if (this->inputShape_[0] == 0 || this->outputShape_[0] == 0) {
     throw std::invalid_argument("Invalid weights/bias size for FCLayer");
   }
-  weights_.resize(input_weights_shape.count(), ValueType(0));
+  // missing weights are zeroes
+  std::vector<ValueType> padded;
+  const ValueType* weights = input_weights.data();
+  if (input_weights.size() < input_weights_shape.count()) {
+    padded.assign(input_weights.begin(), input_weights.end());
+    padded.resize(input_weights_shape.count(), ValueType(0));
+    weights = padded.data();
+  }
+  packed_weights_.resize(
+      gemm_packed_a_size(this->outputShape_[0], this->inputShape_[0]));
+  gemm_pack_a_matrix(this->outputShape_[0], this->inputShape_[0], weights,
+                     this->inputShape_[0], size_t(1), packed_weights_.data());
 }
 
 template <typename ValueType>
-std::vector<ValueType> FCLayerImpl<ValueType>::run(
-    const std::vector<ValueType>& input) const {
-  Shape cur_w_shape({this->outputShape_[0], this->inputShape_[0]});
-  std::vector<ValueType> output_values =
-      mat_vec_mul(weights_, cur_w_shape, input);
-  for (size_t p = 0; p < output_values.size() / bias_.size(); ++p) {
-    for (size_t i = 0; i < bias_.size(); ++i) {
-      output_values[p * bias_.size() + i] += bias_[i];
+void FCLayerImpl<ValueType>::run(Span<const ValueType> input,
+                                 const Activation& activation,
+                                 ValueType* output_values) const {
+  size_t out_size = this->outputShape_[0];
+  size_t in_size = this->inputShape_[0];
+  size_t batch = input.size() / in_size;
+  if (batch == 1) {
+    gemv_prepacked_a(out_size, in_size, packed_weights_.data(), input.data(),
+                     output_values);
+    for (size_t i = 0; i < out_size; ++i) {
+      output_values[i] = activation(output_values[i] + bias_[i]);
+    }
+  } else {
+    // weights (out x in) * input^T (in x batch), every weight is loaded
+    // once per tile of samples instead of once per sample. Bias and
+    // activation are applied to the tiles of the product in registers
+    std::vector<ValueType> transposed(out_size * batch);
+    auto epilogue = [&](size_t i, size_t, ValueType value) {
+      return activation(value + bias_[i]);
+    };
+    gemm_prepacked_a_parallel(out_size, batch, in_size,
+                              packed_weights_.data(), input.data(), size_t(1),
+                              in_size, transposed.data(), batch, epilogue);
+    for (size_t p = 0; p < batch; ++p) {
+      for (size_t i = 0; i < out_size; ++i) {
+        output_values[p * out_size + i] = transposed[i * batch + p];
+      }
     }
   }
-  return output_values;
 }
 
 }  // namespace it_lab_ai
@@ -16,6 +16,7 @@ class FlattenLayer : public Layer {
   FlattenLayer() : order_({0, 1, 2, 3}) {}
   FlattenLayer(const std::vector<size_t>& order) : order_(order) {}
   static std::string get_name() { return "Flatten layer"; }
+  std::string name() const override { return get_name(); }
   void run(const Tensor& input, Tensor& output) override;
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace it_lab_ai {
+
+// 16-bit float storage types: weights kept in them take half the memory
+// and bandwidth of float ones, kernels widen them and compute in float
+// (see Layer::compress_weights)
+
+// IEEE 754 binary16: 5-bit exponent, 10-bit mantissa, largest 65504
+struct Float16 {
+  uint16_t bits = 0;
+};
+
+// upper half of a float: its 8-bit exponent and range, 7-bit mantissa
+struct BFloat16 {
+  uint16_t bits = 0;
+};
+
+static_assert(sizeof(Float16) == 2 && sizeof(BFloat16) == 2,
+              "16-bit floats are stored as their bits");
+
+// the conversions round to nearest even, overflow to infinity and keep
+// NaNs quiet
+inline Float16 to_float16(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint32_t sign = bits & 0x80000000U;
+  bits ^= sign;
+  uint32_t result;
+  if (bits >= 0x47800000U) {
+    // 2^16 and above, infinities and NaNs
+    result = bits > 0x7f800000U ? 0x7e00U : 0x7c00U;
+  } else if (bits < 0x38800000U) {
+    // below 2^-14 the result is subnormal: adding 0.5 aligns its 10
+    // mantissa bits at the bottom and the float addition rounds them
+    const uint32_t magic_bits = 0x3f000000U;
+    float magic;
+    std::memcpy(&magic, &magic_bits, sizeof(magic));
+    float shifted;
+    std::memcpy(&shifted, &bits, sizeof(shifted));
+    shifted += magic;
+    std::memcpy(&result, &shifted, sizeof(result));
+    result -= magic_bits;
+  } else {
+    uint32_t odd = (bits >> 13) & 1U;
+    // rebias the exponent from 127 to 15 and round the 13 dropped bits
+    bits += 0xc8000fffU + odd;
+    result = bits >> 13;
+  }
+  return Float16{static_cast<uint16_t>(result | (sign >> 16))};
+}
+
+inline float to_float(Float16 value) {
+  uint32_t bits = static_cast<uint32_t>(value.bits & 0x7fffU) << 13;
+  uint32_t exponent = bits & 0x0f800000U;
+  // rebias the exponent from 15 to 127
+  bits += 0x38000000U;
+  if (exponent == 0x0f800000U) {
+    // infinities and NaNs
+    bits += 0x38000000U;
+  } else if (exponent == 0) {
+    // zeroes and subnormals, renormalized by the float subtraction
+    bits += 0x00800000U;
+    float renormalized;
+    std::memcpy(&renormalized, &bits, sizeof(renormalized));
+    renormalized -= 6.103515625e-05F;
+    std::memcpy(&bits, &renormalized, sizeof(bits));
+  }
+  bits |= static_cast<uint32_t>(value.bits & 0x8000U) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+inline BFloat16 to_bfloat16(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffffU) > 0x7f800000U) {
+    return BFloat16{static_cast<uint16_t>((bits >> 16) | 0x40U)};
+  }
+  bits += 0x7fffU + ((bits >> 16) & 1U);
+  return BFloat16{static_cast<uint16_t>(bits >> 16)};
+}
+
+inline float to_float(BFloat16 value) {
+  uint32_t bits = static_cast<uint32_t>(value.bits) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+// count values at once, with F16C or AVX-512 BF16 on CPUs that have them.
+// Both give the results of the scalar conversions above, except that
+// AVX-512 BF16 flushes subnormals to zero
+void convert(const float* src, Float16* dst, size_t count);
+void convert(const Float16* src, float* dst, size_t count);
+void convert(const float* src, BFloat16* dst, size_t count);
+void convert(const BFloat16* src, float* dst, size_t count);
+
+// count values of a kernel operand in the type the kernel computes in:
+// values of that type as they are, 16-bit ones widened into buffer. Lets
+// kernels keep 16-bit operands and widen them a block at a time
+template <typename ValueType>
+const ValueType* widened(const ValueType* values, size_t count,
+                         ValueType* buffer) {
+  (void)count;
+  (void)buffer;
+  return values;
+}
+inline const float* widened(const Float16* values, size_t count,
+                            float* buffer) {
+  convert(values, buffer, count);
+  return buffer;
+}
+inline const float* widened(const BFloat16* values, size_t count,
+                            float* buffer) {
+  convert(values, buffer, count);
+  return buffer;
+}
+
+// Kernels in translation units built with F16C (and AVX) or AVX-512 BF16,
+// false when the build has no support. Like the activation kernels they
+// only run on CPUs that have the instructions and call nothing shared with
+// the library, which is why they take the bits of the 16-bit values.
+bool float_to_float16_f16c(const float* src, uint16_t* dst, size_t count);
+bool float16_to_float_f16c(const uint16_t* src, float* dst, size_t count);
+bool float_to_bfloat16_avx512(const float* src, uint16_t* dst, size_t count);
+bool bfloat16_to_float_avx512(const uint16_t* src, float* dst, size_t count);
+
+}  // namespace it_lab_ai
@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "layers/AlignedAllocator.hpp"
+#include "layers/Float16.hpp"
+#include "oneapi/tbb.h"
+
+namespace it_lab_ai {
+
+// register tile of the micro-kernel (rows of A x columns of B)
+constexpr size_t kGemmMr = 6;
+constexpr size_t kGemmNr = 8;
+// cache blocks: A block (Mc x Kc) stays in L2, B panel (Kc x Nc) in L3
+constexpr size_t kGemmMc = 96;
+constexpr size_t kGemmKc = 256;
+constexpr size_t kGemmNc = 2048;
+// columns of C in one task of the parallel driver, multiple of kGemmNr
+constexpr size_t kGemmParallelNc = 256;
+
+// epilogue of a gemm without one, see gemm_blocked
+struct GemmNoEpilogue {
+  template <typename ValueType>
+  ValueType operator()(size_t row, size_t col, ValueType value) const {
+    (void)row;
+    (void)col;
+    return value;
+  }
+};
+
+// copies a (mc x kc) block of A into row panels of kGemmMr rows,
+// tails are padded with zeroes
+template <typename ValueType>
+void gemm_pack_a(size_t mc, size_t kc, const ValueType* a, size_t row_stride,
+                 size_t col_stride, ValueType* packed) {
+  for (size_t ir = 0; ir < mc; ir += kGemmMr) {
+    size_t mr = std::min(kGemmMr, mc - ir);
+    for (size_t p = 0; p < kc; ++p) {
+      for (size_t i = 0; i < mr; ++i) {
+        packed[i] = a[(ir + i) * row_stride + p * col_stride];
+      }
+      for (size_t i = mr; i < kGemmMr; ++i) {
+        packed[i] = ValueType(0);
+      }
+      packed += kGemmMr;
+    }
+  }
+}
+
+// copies a (kc x nc) block of B into column panels of kGemmNr columns,
+// tails are padded with zeroes
+template <typename ValueType>
+void gemm_pack_b(size_t kc, size_t nc, const ValueType* b, size_t row_stride,
+                 size_t col_stride, ValueType* packed) {
+  for (size_t jr = 0; jr < nc; jr += kGemmNr) {
+    size_t nr = std::min(kGemmNr, nc - jr);
+    for (size_t p = 0; p < kc; ++p) {
+      for (size_t j = 0; j < nr; ++j) {
+        packed[j] = b[p * row_stride + (jr + j) * col_stride];
+      }
+      for (size_t j = nr; j < kGemmNr; ++j) {
+        packed[j] = ValueType(0);
+      }
+      packed += kGemmNr;
+    }
+  }
+}
+
+// kGemmMr x kGemmNr tile of C computed from packed panels, accumulators are
+// kept in a local array so the compiler can hold them in vector registers.
+// On the last pass over k (epilogue != nullptr) the tile, whose top left
+// element is C(row, col), goes through the epilogue before it is stored
+template <typename ValueType, typename Epilogue>
+void gemm_micro_kernel(size_t kc, const ValueType* a, const ValueType* b,
+                       ValueType* c, size_t ldc, size_t mr, size_t nr,
+                       bool accumulate, const Epilogue* epilogue, size_t row,
+                       size_t col) {
+  ValueType acc[kGemmMr][kGemmNr] = {};
+  for (size_t p = 0; p < kc; ++p) {
+    for (size_t i = 0; i < kGemmMr; ++i) {
+      ValueType a_value = a[i];
+      for (size_t j = 0; j < kGemmNr; ++j) {
+        acc[i][j] += a_value * b[j];
+      }
+    }
+    a += kGemmMr;
+    b += kGemmNr;
+  }
+  for (size_t i = 0; i < mr; ++i) {
+    ValueType* c_row = c + i * ldc;
+    if (accumulate) {
+      for (size_t j = 0; j < nr; ++j) {
+        acc[i][j] += c_row[j];
+      }
+    }
+    if (epilogue != nullptr) {
+      for (size_t j = 0; j < nr; ++j) {
+        acc[i][j] = (*epilogue)(row + i, col + j, acc[i][j]);
+      }
+    }
+    for (size_t j = 0; j < nr; ++j) {
+      c_row[j] = acc[i][j];
+    }
+  }
+}
+
+// number of elements of A (m x k) packed by gemm_pack_a_matrix
+inline size_t gemm_packed_a_size(size_t m, size_t k) {
+  return (m + kGemmMr - 1) / kGemmMr * kGemmMr * k;
+}
+
+// position of A(i, j) inside the result of gemm_pack_a_matrix
+inline size_t gemm_packed_a_index(size_t m, size_t k, size_t i, size_t j) {
+  size_t pc = j / kGemmKc * kGemmKc;
+  size_t kc = std::min(kGemmKc, k - pc);
+  size_t ic = i / kGemmMc * kGemmMc;
+  size_t ir = (i - ic) / kGemmMr * kGemmMr;
+  return pc * gemm_packed_a_size(m, 1) + (ic + ir) * kc +
+         (j - pc) * kGemmMr + (i - ic - ir);
+}
+
+// packs the whole A (m x k) once, block by block in the order gemm reads it,
+// so constant operands (weights) are not repacked on every call
+template <typename ValueType>
+void gemm_pack_a_matrix(size_t m, size_t k, const ValueType* a,
+                        size_t row_stride, size_t col_stride,
+                        ValueType* packed) {
+  size_t padded_m = gemm_packed_a_size(m, 1);
+  for (size_t pc = 0; pc < k; pc += kGemmKc) {
+    size_t kc = std::min(kGemmKc, k - pc);
+    for (size_t ic = 0; ic < m; ic += kGemmMc) {
+      size_t mc = std::min(kGemmMc, m - ic);
+      gemm_pack_a(mc, kc, a + ic * row_stride + pc * col_stride, row_stride,
+                  col_stride, packed + pc * padded_m + ic * kc);
+    }
+  }
+}
+
+// y (m) = A (m x k) * x (k) with A taken from gemm_pack_a_matrix: every
+// task owns kGemmMc rows and streams their panels once, so a single sample
+// needs no row-major copy of the weights
+template <typename ValueType>
+void gemv_prepacked_a(size_t m, size_t k, const ValueType* packed_a,
+                      const ValueType* x, ValueType* y) {
+  size_t padded_m = gemm_packed_a_size(m, 1);
+  size_t row_tiles = (m + kGemmMc - 1) / kGemmMc;
+  oneapi::tbb::parallel_for(size_t(0), row_tiles, [&](size_t t) {
+    size_t ic = t * kGemmMc;
+    size_t mc = std::min(kGemmMc, m - ic);
+    for (size_t ir = 0; ir < mc; ir += kGemmMr) {
+      ValueType sums[kGemmMr] = {};
+      for (size_t pc = 0; pc < k; pc += kGemmKc) {
+        size_t kc = std::min(kGemmKc, k - pc);
+        const ValueType* panel = packed_a + pc * padded_m + (ic + ir) * kc;
+        for (size_t j = 0; j < kc; ++j) {
+          for (size_t r = 0; r < kGemmMr; ++r) {
+            sums[r] += panel[j * kGemmMr + r] * x[pc + j];
+          }
+        }
+      }
+      for (size_t r = 0; r < std::min(kGemmMr, mc - ir); ++r) {
+        y[ic + ir + r] = sums[r];
+      }
+    }
+  });
+}
+
+// blocked gemm driver computing rows [row_begin, row_end) of C, row_begin
+// is a multiple of kGemmMc. packed_a is either nullptr (A is packed block
+// by block here) or the result of gemm_pack_a_matrix, which may be kept in
+// a 16-bit float type: every block is then widened before it is used.
+// Every element of C is stored as epilogue(i, j, value) while its tile is
+// still in registers, which is how bias and activations are fused into the
+// product
+template <typename ValueType, typename PackedType,
+          typename Epilogue = GemmNoEpilogue>
+void gemm_blocked(size_t m, size_t n, size_t k, const ValueType* a,
+                  size_t a_row_stride, size_t a_col_stride,
+                  const PackedType* packed_a, size_t row_begin, size_t row_end,
+                  const ValueType* b, size_t b_row_stride, size_t b_col_stride,
+                  ValueType* c, size_t ldc,
+                  const Epilogue& epilogue = Epilogue()) {
+  if (row_begin >= row_end || n == 0) {
+    return;
+  }
+  if (k == 0) {
+    for (size_t i = row_begin; i < row_end; ++i) {
+      for (size_t j = 0; j < n; ++j) {
+        c[i * ldc + j] = epilogue(i, j, ValueType(0));
+      }
+    }
+    return;
+  }
+  size_t padded_m = gemm_packed_a_size(m, 1);
+  // packed panels are aligned for vector loads in the micro-kernel
+  bool widens = !std::is_same_v<PackedType, ValueType>;
+  AlignedVector<ValueType> a_block(
+      packed_a == nullptr || widens ? kGemmMc * kGemmKc : 0);
+  AlignedVector<ValueType> packed_b(kGemmKc *
+                                    ((std::min(kGemmNc, n) + kGemmNr - 1) /
+                                     kGemmNr * kGemmNr));
+  for (size_t jc = 0; jc < n; jc += kGemmNc) {
+    size_t nc = std::min(kGemmNc, n - jc);
+    for (size_t pc = 0; pc < k; pc += kGemmKc) {
+      size_t kc = std::min(kGemmKc, k - pc);
+      const Epilogue* last_pass = pc + kc == k ? &epilogue : nullptr;
+      gemm_pack_b(kc, nc, b + pc * b_row_stride + jc * b_col_stride,
+                  b_row_stride, b_col_stride, packed_b.data());
+      for (size_t ic = row_begin; ic < row_end; ic += kGemmMc) {
+        size_t mc = std::min(kGemmMc, row_end - ic);
+        const ValueType* a_panels;
+        if (packed_a == nullptr) {
+          gemm_pack_a(mc, kc, a + ic * a_row_stride + pc * a_col_stride,
+                      a_row_stride, a_col_stride, a_block.data());
+          a_panels = a_block.data();
+        } else {
+          a_panels = widened(packed_a + pc * padded_m + ic * kc,
+                             (mc + kGemmMr - 1) / kGemmMr * kGemmMr * kc,
+                             a_block.data());
+        }
+        for (size_t jr = 0; jr < nc; jr += kGemmNr) {
+          for (size_t ir = 0; ir < mc; ir += kGemmMr) {
+            gemm_micro_kernel(kc, a_panels + ir * kc,
+                              packed_b.data() + jr * kc,
+                              c + (ic + ir) * ldc + jc + jr, ldc,
+                              std::min(kGemmMr, mc - ir),
+                              std::min(kGemmNr, nc - jr), pc > 0, last_pass,
+                              ic + ir, jc + jr);
+          }
+        }
+      }
+    }
+  }
+}
+
+// C (m x n, row-major, leading dimension ldc) = A (m x k) * B (k x n).
+// A and B are addressed through row and column strides, so transposed
+// operands are consumed without an explicit copy.
+template <typename ValueType>
+void gemm(size_t m, size_t n, size_t k, const ValueType* a,
+          size_t a_row_stride, size_t a_col_stride, const ValueType* b,
+          size_t b_row_stride, size_t b_col_stride, ValueType* c,
+          size_t ldc) {
+  gemm_blocked(m, n, k, a, a_row_stride, a_col_stride,
+               static_cast<const ValueType*>(nullptr), size_t(0), m, b,
+               b_row_stride, b_col_stride, c, ldc);
+}
+
+// same as gemm with A taken from gemm_pack_a_matrix
+template <typename ValueType, typename PackedType,
+          typename Epilogue = GemmNoEpilogue>
+void gemm_prepacked_a(size_t m, size_t n, size_t k,
+                      const PackedType* packed_a, const ValueType* b,
+                      size_t b_row_stride, size_t b_col_stride, ValueType* c,
+                      size_t ldc, const Epilogue& epilogue = Epilogue()) {
+  gemm_blocked(m, n, k, static_cast<const ValueType*>(nullptr), size_t(0),
+               size_t(0), packed_a, size_t(0), m, b, b_row_stride,
+               b_col_stride, c, ldc, epilogue);
+}
+
+// gemm_prepacked_a with tiles of kGemmMc rows x kGemmParallelNc columns
+// of C computed in parallel, the packed A is shared by all tiles
+template <typename ValueType, typename PackedType,
+          typename Epilogue = GemmNoEpilogue>
+void gemm_prepacked_a_parallel(size_t m, size_t n, size_t k,
+                               const PackedType* packed_a, const ValueType* b,
+                               size_t b_row_stride, size_t b_col_stride,
+                               ValueType* c, size_t ldc,
+                               const Epilogue& epilogue = Epilogue()) {
+  size_t row_tiles = (m + kGemmMc - 1) / kGemmMc;
+  size_t col_tiles = (n + kGemmParallelNc - 1) / kGemmParallelNc;
+  oneapi::tbb::parallel_for(size_t(0), row_tiles * col_tiles, [&](size_t t) {
+    size_t ic = t / col_tiles * kGemmMc;
+    size_t jc = t % col_tiles * kGemmParallelNc;
+    auto tile_epilogue = [&](size_t i, size_t j, ValueType value) {
+      return epilogue(i, jc + j, value);
+    };
+    gemm_blocked(m, std::min(kGemmParallelNc, n - jc), k,
+                 static_cast<const ValueType*>(nullptr), size_t(0), size_t(0),
+                 packed_a, ic, std::min(m, ic + kGemmMc),
+                 b + jc * b_col_stride, b_row_stride, b_col_stride, c + jc,
+                 ldc, tile_epilogue);
+  });
+}
+
+}  // namespace it_lab_ai
@@ -6,11 +6,6 @@
 
 namespace it_lab_ai {
 
-enum LayInOut : uint8_t {
-  kNchw,  // 0
-  kNhwc   // 1
-};
-
 class InputLayer : public Layer {
  private:
   LayInOut layin_;
@@ -27,6 +22,8 @@ class InputLayer : public Layer {
     mean_ = mean;
     std_ = std;
   }  // layout = kNchw(0), kNhwc(1)
+  static std::string get_name() { return "Input layer"; }
+  std::string name() const override { return get_name(); }
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override {
     std::vector<int> v = {0};
@@ -34,10 +31,48 @@ class InputLayer : public Layer {
     return a;
   }
 #endif
+  // only the normalization can be done in place
+  bool supports_inplace() const override { return layin_ == layout_; }
+  void run_inplace(Tensor& tensor) override {
+    if (layin_ != layout_) {
+      Layer::run_inplace(tensor);
+      return;
+    }
+    if (tensor.get_shape().dims() != 4) {
+      throw std::out_of_range(
+          "The size of the shape does not match what is needed for the "
+          "input layer");
+    }
+    if (mean_ == 0 && std_ == 1) {
+      return;
+    }
+    switch (tensor.get_type()) {
+      case Type::kInt: {
+        for (int& re : *tensor.as<int>()) {
+          re = (re - mean_) / std_;
+        }
+        break;
+      }
+      case Type::kFloat: {
+        for (float& re : *tensor.as<float>()) {
+          re = static_cast<float>((re - mean_) / std_);
+        }
+        break;
+      }
+      default: {
+        throw std::runtime_error("No such type");
+      }
+    }
+  }
   void run(const Tensor& input, Tensor& output) override {
+    if (layin_ == layout_) {
+      output = input;
+      run_inplace(output);
+      return;
+    }
     switch (input.get_type()) {
       case Type::kInt: {
-        std::vector<int> in = *input.as<int>();
+        AlignedVector<int> in = *input.as<int>();
         if (input.get_shape().dims() != 4) {
           throw std::out_of_range(
               "The size of the shape does not match what is needed for the "
@@ -105,7 +140,7 @@ class InputLayer : public Layer {
         break;
       }
       case Type::kFloat: {
-        std::vector<float> in = *input.as<float>();
+        AlignedVector<float> in = *input.as<float>();
         if (input.get_shape().dims() != 4) {
           throw std::out_of_range(
               "The size of the shape does not match what is needed for the "
@@ -0,0 +1,48 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "layers/CpuFeatures.hpp"
+#include "layers/Layer.hpp"
+
+namespace it_lab_ai {
+
+// implementation impl of a layer for one data type, it runs on CPUs with
+// isa. Multithreaded ones only pay off with more than one core.
+struct KernelEntry {
+  LayerType layer;
+  Type type;
+  Isa isa;
+  ImplType impl;
+  const char* name;
+  bool multithreaded = false;
+};
+
+// Implementations of the layers ranked fastest first: by instruction set,
+// then in order of registration. Layers built with kAuto take the first
+// one this CPU can run that fits them. The entries named by ITLAB_AI_IMPL
+// (e.g. ITLAB_AI_IMPL=im2col) go first, for A/B benchmarking, and
+// ITLAB_AI_ISA lowers the instruction set (see max_isa()).
+class KernelRegistry {
+ public:
+  // with the built-in implementations
+  static KernelRegistry& instance();
+  // not synchronized, entries are added before layers run
+  void add(const KernelEntry& entry);
+  // replaces ITLAB_AI_IMPL, empty for none
+  void set_preferred(const std::string& name) { preferred_ = name; }
+  // entries this CPU can run, fastest first
+  std::vector<KernelEntry> candidates(LayerType layer, Type type) const;
+  // first candidate accepted by fits, fallback if none is
+  ImplType select(LayerType layer, Type type,
+                  const std::function<bool(ImplType)>& fits = nullptr,
+                  ImplType fallback = kDefault) const;
+
+ private:
+  KernelRegistry();
+  std::vector<KernelEntry> entries_;
+  std::string preferred_;
+};
+
+}  // namespace it_lab_ai
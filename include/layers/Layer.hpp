@@ -3,9 +3,12 @@
 #include <numeric>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "layers/Activation.hpp"
 #include "layers/Shape.hpp"
+#include "layers/Span.hpp"
 #include "layers/Tensor.hpp"
 #include "oneapi/tbb.h"
 
@@ -23,7 +26,13 @@ enum LayerType : uint8_t {
   kOutput,
 };
 
-enum ImplType : uint8_t { kDefault, kTBB, kSTL };
+enum LayInOut : uint8_t {
+  kNchw,  // 0
+  kNhwc   // 1
+};
+
+// kAuto takes the fastest implementation in KernelRegistry
+enum ImplType : uint8_t { kDefault, kTBB, kSTL, kIm2col, kWinograd, kAuto };
 
 class Layer;
 
@@ -42,6 +51,97 @@ class Layer {
   LayerType getName() const { return type_; }
   void setName(LayerType type) { type_ = type; }
   virtual void run(const Tensor& input, Tensor& output) = 0;
+  // entry point of the graph executor, layers with several inputs or
+  // outputs override it, by default the only input is run into one output
+  virtual void run_multi(const std::vector<Tensor>& inputs,
+                         std::vector<Tensor>& outputs) {
+    if (inputs.size() != 1) {
+      throw std::invalid_argument("Layer expects exactly one input");
+    }
+    outputs.resize(1);
+    run(inputs[0], outputs[0]);
+  }
+  // In-place execution of layers whose output has the shape and type of
+  // their input and is computed value by value. run_inplace leaves in
+  // tensor what run() would output, the storage is reused when the tensor
+  // is its only owner (it is copied on write otherwise). The graph moves
+  // inputs nobody else reads into run_multi_inplace.
+  virtual bool supports_inplace() const { return false; }
+  virtual void run_inplace(Tensor& tensor) {
+    Tensor output;
+    run(tensor, output);
+    tensor = std::move(output);
+  }
+  virtual void run_multi_inplace(std::vector<Tensor>& inputs,
+                                 std::vector<Tensor>& outputs) {
+    if (inputs.size() != 1) {
+      run_multi(inputs, outputs);
+      return;
+    }
+    run_inplace(inputs[0]);
+    outputs.resize(1);
+    outputs[0] = std::move(inputs[0]);
+  }
+  // layers reading inputs only through Tensor::get or views may be given
+  // non-contiguous tensors, other layers get them materialized. Layers in
+  // the kNhwc layout take NHWC views as they are
+  virtual bool accepts_strided_input() const {
+    return data_layout_ == kNhwc;
+  }
+  // hooks of Graph::propagate_layouts. Layers that can also compute on 4D
+  // data stored in NHWC order (see Layout.hpp) support kNhwc, the ones
+  // with a faster kernel for it prefer it, element-wise layers only pass
+  // it on. After set_layout(kNhwc) a layer takes 4D inputs in any layout
+  // and produces NHWC views
+  virtual bool supports_layout(LayInOut layout) const {
+    return layout == kNchw;
+  }
+  virtual bool prefers_layout(LayInOut layout) const {
+    (void)layout;
+    return false;
+  }
+  LayInOut layout() const { return data_layout_; }
+  void set_layout(LayInOut layout) {
+    if (!supports_layout(layout)) {
+      throw std::invalid_argument("Layer doesn't support the layout");
+    }
+    data_layout_ = layout;
+  }
+  // hooks of Graph::fuse. A layer that is an element-wise function returns
+  // it as an activation, a layer that can apply such an activation (or add
+  // the second input of a following elementwise add) to its output while
+  // storing it takes the work over and returns true. Fused layers get the
+  // residual as the second input of run_multi.
+  virtual Activation fusable_activation() const { return Activation(); }
+  virtual bool is_elementwise_add() const { return false; }
+  virtual bool fuse_activation(const Activation& activation) {
+    (void)activation;
+    return false;
+  }
+  virtual bool fuse_residual_add() { return false; }
+  // hooks of Graph::quantize. Layers with int8 kernels return true from
+  // start_calibration() and record the range of their float inputs from
+  // then on, quantize() switches them to the int8 kernels for that range
+  // (see Quantization.hpp) and is false if they saw no input
+  virtual bool start_calibration() { return false; }
+  virtual bool quantize() { return false; }
+  // hook of Graph::compress_weights: float weights are stored as kFloat16
+  // or kBFloat16 while the layer keeps computing in float, true if they
+  // were
+  virtual bool compress_weights(Type type) {
+    (void)type;
+    return false;
+  }
+  // for the profiler of Graph (see graph/profiler.hpp): the name of the
+  // layer, an estimate of the arithmetic operations of a run that made
+  // output from input (0 if unknown) and the bytes of weights a run reads
+  virtual std::string name() const { return "Layer"; }
+  virtual uint64_t flops(const Shape& input, const Shape& output) const {
+    (void)input;
+    (void)output;
+    return 0;
+  }
+  virtual size_t weight_bytes() const { return 0; }
 #ifdef ENABLE_STATISTIC_WEIGHTS
   virtual Tensor get_weights() = 0;
 #endif
@@ -49,6 +149,7 @@ class Layer {
  protected:
   int id_ = 0;
   LayerType type_;
+  LayInOut data_layout_ = kNchw;
 };
 
 template <typename ValueType>
@@ -59,8 +160,7 @@ class LayerImpl {
       : inputShape_(inputShape), outputShape_(outputShape) {}
   LayerImpl(const LayerImpl& c) = default;
   LayerImpl& operator=(const LayerImpl& c) = default;
-  virtual std::vector<ValueType> run(
-      const std::vector<ValueType>& input) const = 0;
+  virtual std::vector<ValueType> run(Span<const ValueType> input) const = 0;
   Shape get_input_shape() const { return inputShape_; }
   Shape get_output_shape() const { return outputShape_; }
   // weights width x height
@@ -0,0 +1,29 @@
+#pragma once
+#include "layers/Tensor.hpp"
+
+namespace it_lab_ai {
+
+// Layers in the kNhwc layout (see Graph::propagate_layouts) pass 4D data
+// on as tensors of the usual NCHW shape whose storage is in NHWC order,
+// permuted views of an N x H x W x C tensor. Layers that don't know the
+// layout get them materialized in NCHW order by Tensor::contiguous(),
+// which is the reorder at the boundary of an NHWC region.
+
+// true for such views, contiguous NCHW tensors are not
+inline bool is_nhwc(const Tensor& tensor) {
+  return tensor.get_shape().dims() == 4 && !tensor.is_contiguous() &&
+         tensor.permute({0, 2, 3, 1}).is_contiguous();
+}
+
+// NCHW-shaped view of a contiguous N x H x W x C tensor
+inline Tensor nhwc_view(const Tensor& nhwc) {
+  return nhwc.permute({0, 3, 1, 2});
+}
+
+// contiguous N x H x W x C tensor with the values of a 4D tensor: the
+// storage of an NHWC view, a reordered copy otherwise
+inline Tensor to_nhwc(const Tensor& tensor) {
+  return tensor.permute({0, 2, 3, 1}).contiguous();
+}
+
+}  // namespace it_lab_ai
@@ -14,6 +14,7 @@ class OutputLayer : public Layer {
   OutputLayer() = default;
   OutputLayer(const std::vector<std::string>& labels) : labels_(labels) {}
   static std::string get_name() { return "Output layer"; }
+  std::string name() const override { return get_name(); }
   void run(const Tensor& input, Tensor& output) override { output = input; }
   std::vector<std::string> get_labels() const { return labels_; }
   std::pair<std::vector<std::string>, Tensor> top_k(const Tensor& input,
@@ -30,13 +31,13 @@ class OutputLayer : public Layer {
   std::vector<std::string> labels_;
 };
 
-template <typename ValueType>
-std::vector<ValueType> softmax(const std::vector<ValueType>& vec) {
+template <typename ValueType, typename Alloc = std::allocator<ValueType>>
+std::vector<ValueType> softmax(const std::vector<ValueType, Alloc>& vec) {
   if (vec.empty()) {
     throw std::invalid_argument("Empty vector in softmax");
   }
   ValueType max_elem = *std::max_element(vec.begin(), vec.end());
-  std::vector<ValueType> res = vec;
+  std::vector<ValueType> res(vec.begin(), vec.end());
   for (size_t i = 0; i < res.size(); i++) {
     res[i] = std::exp(res[i] - max_elem);  // <= 1
   }
@@ -47,9 +48,9 @@ std::vector<ValueType> softmax(const std::vector<ValueType>& vec) {
   return res;
 }
 
-template <typename ValueType>
+template <typename ValueType, typename Alloc = std::allocator<ValueType>>
 std::vector<std::vector<ValueType>> softmax(
-    const std::vector<ValueType>& fullvec, size_t c) {
+    const std::vector<ValueType, Alloc>& fullvec, size_t c) {
   if (fullvec.empty()) {
     throw std::invalid_argument("Empty vector in softmax");
   }
@@ -87,10 +88,10 @@ bool compare_pair(std::pair<std::string, ValueType> a,
   return (a.second > b.second);
 }
 
-template <typename ValueType>
+template <typename ValueType, typename Alloc = std::allocator<ValueType>>
 std::pair<std::vector<std::string>, std::vector<ValueType>> top_k_vec(
-    const std::vector<ValueType>& input, const std::vector<std::string>& labels,
-    size_t k) {
+    const std::vector<ValueType, Alloc>& input,
+    const std::vector<std::string>& labels, size_t k) {
   if (input.size() != labels.size()) {
     throw std::invalid_argument("Labels size not equal input size");
   }
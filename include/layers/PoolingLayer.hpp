@@ -4,6 +4,7 @@
 #include <string>
 #include <utility>
 
+#include "layers/KernelRegistry.hpp"
 #include "layers/Layer.hpp"
 
 namespace it_lab_ai {
@@ -19,7 +20,18 @@ class PoolingLayer : public Layer {
         poolingType_(std::move(pooling_type)),
         implType_(implType) {}
   static std::string get_name() { return "Pooling layer"; }
+  std::string name() const override { return get_name(); }
+  // a comparison or an addition per value of every window
+  uint64_t flops(const Shape& input, const Shape& output) const override {
+    (void)input;
+    return output.count() * poolingShape_.count();
+  }
   void run(const Tensor& input, Tensor& output) override;
+  // 2D windows of 4D inputs vectorize over the channels of NHWC data
+  bool supports_layout(LayInOut) const override { return true; }
+  bool prefers_layout(LayInOut layout) const override {
+    return layout == kNhwc && poolingShape_.dims() == 2;
+  }
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override {
     std::vector<int> v = {0};
@@ -66,8 +78,10 @@ class PoolingLayerImpl : public LayerImpl<ValueType> {
                    const std::string& pooling_type = "average");
   PoolingLayerImpl(const PoolingLayerImpl& c) = default;
   PoolingLayerImpl& operator=(const PoolingLayerImpl& c) = default;
-  std::vector<ValueType> run(
-      const std::vector<ValueType>& input) const override;
+  std::vector<ValueType> run(Span<const ValueType> input) const override;
+  // same windows of a 4D input given and returned in NHWC order, with a
+  // 2D pooling shape
+  std::vector<ValueType> run_nhwc(Span<const ValueType> input) const;
 
  protected:
   Shape poolingShape_;
@@ -112,7 +126,7 @@ PoolingLayerImpl<ValueType>::PoolingLayerImpl(const Shape& input_shape,
 
 template <typename ValueType>
 std::vector<ValueType> PoolingLayerImpl<ValueType>::run(
-    const std::vector<ValueType>& input) const {
+    Span<const ValueType> input) const {
   if (input.size() != this->inputShape_.count()) {
     throw std::invalid_argument("Input size doesn't fit pooling layer");
   }
@@ -170,19 +184,68 @@ std::vector<ValueType> PoolingLayerImpl<ValueType>::run(
   return res;
 }
 
+template <typename ValueType>
+std::vector<ValueType> PoolingLayerImpl<ValueType>::run_nhwc(
+    Span<const ValueType> input) const {
+  if (input.size() != this->inputShape_.count() ||
+      this->inputShape_.dims() != 4 || poolingShape_.dims() != 2) {
+    throw std::invalid_argument("Input size doesn't fit pooling layer");
+  }
+  size_t batch = this->inputShape_[0];
+  size_t channels = this->inputShape_[1];
+  size_t in_width = this->inputShape_[3];
+  size_t out_height = this->outputShape_[2];
+  size_t out_width = this->outputShape_[3];
+  size_t window = poolingShape_[0] * poolingShape_[1];
+  std::vector<ValueType> res(this->outputShape_.count());
+  // a task is one output row, channels are the innermost loop
+  oneapi::tbb::parallel_for(size_t(0), batch * out_height, [&](size_t row) {
+    size_t n = row / out_height;
+    size_t i = row % out_height;
+    for (size_t j = 0; j < out_width; j++) {
+      ValueType* out = res.data() + (row * out_width + j) * channels;
+      for (size_t k = 0; k < poolingShape_[0]; k++) {
+        for (size_t l = 0; l < poolingShape_[1]; l++) {
+          size_t y = i * poolingShape_[0] + k;
+          size_t x = j * poolingShape_[1] + l;
+          const ValueType* in =
+              input.data() +
+              ((n * this->inputShape_[2] + y) * in_width + x) * channels;
+          if (k == 0 && l == 0) {
+            std::copy(in, in + channels, out);
+          } else if (poolingType_ == kMax) {
+            for (size_t c = 0; c < channels; c++) {
+              out[c] = std::max(out[c], in[c]);
+            }
+          } else {
+            for (size_t c = 0; c < channels; c++) {
+              out[c] += in[c];
+            }
+          }
+        }
+      }
+      if (poolingType_ == kAverage) {
+        for (size_t c = 0; c < channels; c++) {
+          out[c] /= static_cast<ValueType>(window);
+        }
+      }
+    }
+  });
+  return res;
+}
+
 template <typename ValueType>
 class PoolingLayerImplTBB : public PoolingLayerImpl<ValueType> {
  public:
   PoolingLayerImplTBB(const Shape& input_shape, const Shape& pooling_shape,
                       const std::string& pooling_type = "average")
       : PoolingLayerImpl<ValueType>(input_shape, pooling_shape, pooling_type) {}
-  std::vector<ValueType> run(
-      const std::vector<ValueType>& input) const override;
+  std::vector<ValueType> run(Span<const ValueType> input) const override;
 };
 
 template <typename ValueType>
 std::vector<ValueType> PoolingLayerImplTBB<ValueType>::run(
-    const std::vector<ValueType>& input) const {
+    Span<const ValueType> input) const {
   if (input.size() != this->inputShape_.count()) {
     throw std::invalid_argument("Input size doesn't fit pooling layer");
   }
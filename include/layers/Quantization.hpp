@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "layers/AlignedAllocator.hpp"
+#include "layers/CpuFeatures.hpp"
+#include "layers/Tensor.hpp"
+
+namespace it_lab_ai {
+
+// Post-training int8 quantization (see Graph::quantize). Activations are
+// uint8 with a zero point, weights int8 symmetric per output channel, and
+// products are accumulated in int32:
+//   sum_k x[k] * w[k] = sa * sw * sum_k (qx[k] - za) * qw[k]
+
+// real = scale * (q - zero_point) for q in [0, 255]
+struct QuantParams {
+  float scale = 1.0F;
+  int32_t zero_point = 0;
+
+  // covers [min, max] widened to contain 0, so zero (the padding of
+  // convolutions) is exact
+  static QuantParams from_range(float min, float max);
+  uint8_t quantize(float value) const;
+  float dequantize(uint8_t value) const {
+    return scale * static_cast<float>(static_cast<int32_t>(value) -
+                                      zero_point);
+  }
+};
+
+// smallest and largest float values seen while calibrating
+struct ValueRange {
+  float min = std::numeric_limits<float>::max();
+  float max = std::numeric_limits<float>::lowest();
+
+  bool empty() const { return min > max; }
+  void update(const float* values, size_t count);
+  // float tensors in any layout
+  void update(const Tensor& tensor);
+};
+
+// kUInt8 tensor of the same shape, and back
+Tensor quantize(const Tensor& input, const QuantParams& params);
+Tensor dequantize(const Tensor& input, const QuantParams& params);
+
+// output channels per panel of a QuantizedMatrix, one AVX-512 register of
+// int32 sums
+constexpr size_t kInt8PanelWidth = 16;
+
+// depth of the rows of A given to gemm_u8s8s32, groups of 4 values are
+// multiplied at once
+inline size_t int8_padded_depth(size_t depth) { return (depth + 3) / 4 * 4; }
+
+// depth x cols float matrix B as int8: b(k, n) = scales[n] * q(k, n).
+// Panels of kInt8PanelWidth columns hold, for every group of 4 rows, the
+// 4 values of each column next to each other (the operands of VNNI
+// vpdpbusd), tails are zero
+struct QuantizedMatrix {
+  size_t depth = 0;
+  size_t cols = 0;
+  std::vector<float> scales;
+  // sum_k q(k, n), which the zero point of A is multiplied by
+  std::vector<int32_t> column_sums;
+  AlignedVector<int8_t> packed;
+
+  // b(k, n) = values[k * k_stride + n * n_stride]
+  static QuantizedMatrix quantize(const float* values, size_t depth,
+                                  size_t cols, size_t k_stride,
+                                  size_t n_stride);
+};
+
+// c[i * ldc + n] = sum_k a[i * lda + k] * q(k, n) for the m rows of A,
+// lda >= int8_padded_depth(b.depth) and a row may hold anything after
+// its depth values. The kernel is the VNNI one on CPUs with AVX-512 VNNI,
+// a portable int32 one elsewhere
+void gemm_u8s8s32(size_t m, const uint8_t* a, size_t lda,
+                  const QuantizedMatrix& b, int32_t* c, size_t ldc);
+// same with tiles of rows computed in parallel
+void gemm_u8s8s32_parallel(size_t m, const uint8_t* a, size_t lda,
+                           const QuantizedMatrix& b, int32_t* c, size_t ldc);
+// same with a given kernel on the calling thread: kScalar or kAvx512 (with
+// VNNI), false if the CPU or the build doesn't support it
+bool gemm_u8s8s32(Isa isa, size_t m, const uint8_t* a, size_t lda,
+                  const QuantizedMatrix& b, int32_t* c, size_t ldc);
+// kAvx512 if the VNNI kernel runs here, kScalar otherwise
+Isa int8_gemm_isa();
+
+// Kernel in a translation unit built with AVX-512 VNNI, false when the
+// build has no support. Like the activation kernels it only runs on CPUs
+// that have the instructions and calls nothing shared with the library.
+bool gemm_u8s8s32_vnni(size_t m, const uint8_t* a, size_t lda, size_t depth,
+                       size_t cols, const int8_t* packed, int32_t* c,
+                       size_t ldc);
+
+}  // namespace it_lab_ai
@@ -18,6 +18,11 @@ class ReduceLayer : public Layer {
   void run(const Tensor& input, const Tensor& axes, Tensor& output);
 
   static std::string get_name() { return "ReduceLayer"; }
+  std::string name() const override { return get_name(); }
+  uint64_t flops(const Shape& input, const Shape& output) const override {
+    (void)output;
+    return input.count();
+  }
 
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
@@ -38,6 +38,16 @@ class Shape {
                            std::multiplies<>());
   }
   size_t dims() const noexcept { return dims_.size(); }
+  // row-major strides in elements
+  std::vector<size_t> strides() const {
+    std::vector<size_t> res(dims_.size());
+    size_t stride = 1;
+    for (size_t i = dims_.size(); i-- > 0;) {
+      res[i] = stride;
+      stride *= dims_[i];
+    }
+    return res;
+  }
   size_t get_index(const std::vector<size_t>& coords) const;
   bool operator==(const Shape& other) const {
     if (dims_.size() != other.dims_.size()) return false;
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace it_lab_ai {
+
+// Non-owning view of contiguous elements, std::span of C++20 cut down to
+// what the kernels use. Converts from std::vector with any allocator, so a
+// kernel taking Span<const T> reads both plain vectors and tensor storage
+// (AlignedVector<T>, see Tensor::as) without a copy.
+template <typename T>
+class Span {
+ public:
+  using value_type = std::remove_const_t<T>;
+  using iterator = T*;
+
+  Span() noexcept = default;
+  Span(T* data, size_t size) noexcept : data_(data), size_(size) {}
+  template <typename Alloc>
+  Span(const std::vector<value_type, Alloc>& v) noexcept
+      : data_(v.data()), size_(v.size()) {
+    static_assert(std::is_const_v<T>, "a const vector gives a const span");
+  }
+  template <typename Alloc>
+  Span(std::vector<value_type, Alloc>& v) noexcept
+      : data_(v.data()), size_(v.size()) {}
+
+  T* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  iterator begin() const noexcept { return data_; }
+  iterator end() const noexcept { return data_ + size_; }
+  T& operator[](size_t i) const noexcept { return data_[i]; }
+  T& at(size_t i) const {
+    if (i >= size_) {
+      throw std::out_of_range("Span index out of range");
+    }
+    return data_[i];
+  }
+
+ private:
+  T* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace it_lab_ai
@@ -5,6 +5,7 @@
 
 #include "layers/Layer.hpp"
 #include "layers/Tensor.hpp"
+#include "layers/TensorView.hpp"
 
 namespace it_lab_ai {
 
@@ -17,8 +18,13 @@ class SplitLayer : public Layer {
       : axis_(axis), num_outputs_(num_outputs) {}
   void run(const Tensor& input, Tensor& output) override;
   void run(const Tensor& input, std::vector<Tensor>& outputs);
+  void run_multi(const std::vector<Tensor>& inputs,
+                 std::vector<Tensor>& outputs) override;
+  // parts of input as views of its storage, nothing is copied
+  std::vector<TensorView> split_views(const Tensor& input) const;
 
   static std::string get_name() { return "SplitLayer"; }
+  std::string name() const override { return get_name(); }
 
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
@@ -31,8 +37,6 @@ class SplitLayer : public Layer {
 
   void validate(const Tensor& input) const;
   int get_normalized_axis(int rank) const;
-  template <typename T>
-  void split_impl(const Tensor& input, std::vector<Tensor>& outputs) const;
 };
 
 }  // namespace it_lab_ai
\ No newline at end of file
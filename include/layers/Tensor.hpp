@@ -2,15 +2,32 @@
 
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <type_traits>
 #include <vector>
 
+#include "layers/AlignedAllocator.hpp"
+#include "layers/Float16.hpp"
 #include "layers/Shape.hpp"
 
 namespace it_lab_ai {
 
-enum class Type : uint8_t { kUnknown, kInt, kFloat };
+// kInt8 and kUInt8 hold quantized values, see Quantization.hpp. kFloat16
+// and kBFloat16 store float values in half the memory, see Float16.hpp
+enum class Type : uint8_t {
+  kUnknown,
+  kInt,
+  kFloat,
+  kInt8,
+  kUInt8,
+  kFloat16,
+  kBFloat16
+};
+
+inline bool is_16bit_float(Type type) {
+  return type == Type::kFloat16 || type == Type::kBFloat16;
+}
 
 template <typename T>
 std::vector<uint8_t>* to_byte(std::vector<T>& v) {
@@ -28,61 +45,128 @@ Type GetTypeEnum() {
     return Type::kInt;
   } else if constexpr (std::is_same_v<T, float>) {
     return Type::kFloat;
+  } else if constexpr (std::is_same_v<T, int8_t>) {
+    return Type::kInt8;
+  } else if constexpr (std::is_same_v<T, uint8_t>) {
+    return Type::kUInt8;
+  } else if constexpr (std::is_same_v<T, Float16>) {
+    return Type::kFloat16;
+  } else if constexpr (std::is_same_v<T, BFloat16>) {
+    return Type::kBFloat16;
   } else {
     return Type::kUnknown;
   }
 }
+class TensorView;
+
+// tensor bytes, aligned to kTensorAlignment so kernels can use aligned loads
+using TensorStorage = AlignedVector<uint8_t>;
+
+// Tensor values live in a ref-counted storage: copies, reshapes and views
+// share it and a tensor makes its own copy (copy-on-write) only when it is
+// written through a non-const accessor while the storage is shared.
+// Element (c0, c1, ...) is at sum(ci * strides_[i]) in the storage, which is
+// row-major unless the tensor is a permuted view (see permute()).
+// as<T>() hands out the storage of a contiguous tensor as an
+// AlignedVector<T>, so a resize reallocates through the same aligned
+// allocator that made it.
 class Tensor {
  private:
   Shape shape_;
-  std::vector<uint8_t> values_;
+  std::vector<size_t> strides_;
+  std::shared_ptr<TensorStorage> values_;
   std::vector<float> bias_;
   Type type_;
 
-  std::vector<uint8_t> SetRightTypeValues() {
+  const TensorStorage& values() const {
+    static const TensorStorage kEmpty;
+    return values_ ? *values_ : kEmpty;
+  }
+  // storage that is safe to write: row-major and unshared
+  TensorStorage& mutable_values() {
+    if (!is_contiguous()) {
+      std::vector<float> bias = std::move(bias_);
+      *this = contiguous();
+      bias_ = std::move(bias);
+    }
+    if (!values_) {
+      values_ = std::make_shared<TensorStorage>();
+    } else if (values_.use_count() > 1) {
+      values_ = std::make_shared<TensorStorage>(*values_);
+    }
+    return *values_;
+  }
+  size_t offset_of(const std::vector<size_t>& coords) const {
+    if (coords.size() != shape_.dims()) {
+      throw std::invalid_argument("Invalid index vector");
+    }
+    size_t res = 0;
+    for (size_t i = 0; i < coords.size(); i++) {
+      if (coords[i] >= shape_[i]) {
+        throw std::out_of_range("Out of range");
+      }
+      res += coords[i] * strides_[i];
+    }
+    return res;
+  }
+
+  size_t ByteSize() const {
     if (type_ == Type::kInt) {
-      return std::vector<uint8_t>(shape_.count() * sizeof(int), 0);
+      return shape_.count() * sizeof(int);
     }
     if (type_ == Type::kFloat) {
-      return std::vector<uint8_t>(shape_.count() * sizeof(float), 0);
+      return shape_.count() * sizeof(float);
+    }
+    if (type_ == Type::kInt8 || type_ == Type::kUInt8) {
+      return shape_.count();
+    }
+    if (is_16bit_float(type_)) {
+      return shape_.count() * 2;
     }
-    return std::vector<uint8_t>();
+    return 0;
   }
 
  public:
   Tensor() = default;
 
   Tensor(const std::vector<uint8_t>& a, const Shape& sh, Type type)
-      : shape_(sh), type_(type) {
+      : shape_(sh), strides_(sh.strides()), type_(type) {
     if (type == Type::kUnknown) {
       throw std::invalid_argument("Unknown data type");
     }
 
-    values_ = SetRightTypeValues();
-
-    if (a.size() != values_.size()) {
+    if (a.size() != ByteSize()) {
       throw std::invalid_argument("Incorrect vector size given to Tensor");
     }
 
-    values_ = a;
+    values_ = std::make_shared<TensorStorage>(a.begin(), a.end());
   }
 
-  Tensor(const Shape& sh, Type type) : shape_(sh), type_(type) {
+  Tensor(const Shape& sh, Type type)
+      : shape_(sh), strides_(sh.strides()), type_(type) {
     if (type == Type::kUnknown) {
       throw std::invalid_argument("Unknown data type");
     }
 
-    values_ = SetRightTypeValues();
+    values_ = std::make_shared<TensorStorage>(ByteSize());
+  }
+
+  // empty tensor with capacity bytes of storage from allocator, reset()
+  // writes into them without reallocating while they suffice (Graph puts
+  // its intermediates in an arena so)
+  Tensor(size_t capacity, const AlignedAllocator<uint8_t>& allocator)
+      : values_(std::make_shared<TensorStorage>(allocator)),
+        type_(Type::kUnknown) {
+    values_->reserve(capacity);
   }
 
   Tensor(const std::vector<uint8_t>& a, const Shape& sh,
          const std::vector<float>& bias)
-      : shape_(sh), values_(a), bias_(bias), type_(Type::kFloat) {
-    values_ = SetRightTypeValues();
-    if (a.size() != values_.size()) {
+      : shape_(sh), strides_(sh.strides()), bias_(bias), type_(Type::kFloat) {
+    if (a.size() != ByteSize()) {
       throw std::invalid_argument("Incorrect vector size given to Tensor");
     }
-    values_ = a;
+    values_ = std::make_shared<TensorStorage>(a.begin(), a.end());
   }
 
   Tensor(const Tensor& t) = default;
@@ -91,6 +175,17 @@ class Tensor {
   Tensor& operator=(const Tensor& t) = default;
 
   Shape get_shape() const { return shape_; }
+  const std::vector<size_t>& get_strides() const noexcept { return strides_; }
+  bool is_contiguous() const noexcept {
+    size_t stride = 1;
+    for (size_t i = shape_.dims(); i-- > 0;) {
+      if (shape_[i] != 1 && strides_[i] != stride) {
+        return false;
+      }
+      stride *= shape_[i];
+    }
+    return true;
+  }
   Type get_type() const noexcept { return type_; }
 
   void set_bias(const std::vector<float>& bias) {
@@ -102,25 +197,52 @@ class Tensor {
   }
 
   const std::vector<float>& get_bias() const { return bias_; }
-  const std::vector<uint8_t>& get_values() const { return values_; }
+  // raw storage, in row-major order only for contiguous tensors
+  const TensorStorage& get_values() const { return values(); }
 
-  bool empty() const { return values_.empty(); }
-  auto begin() { return values_.begin(); }
+  bool empty() const { return values().empty(); }
+  auto begin() { return mutable_values().begin(); }
 
-  auto end() { return values_.end(); }
+  auto end() { return mutable_values().end(); }
 
-  auto begin() const { return values_.begin(); }
+  auto begin() const { return values().begin(); }
 
-  auto end() const { return values_.end(); }
+  auto end() const { return values().end(); }
 
+  // Makes this a row-major tensor of shape and type whose values are left
+  // as the storage had them and returns the storage, for a layer to write
+  // all of its output into. The storage is kept when nothing else shares
+  // it, so a layer reuses the buffer its output already has (one of the
+  // arena of Graph, for instance). The tensor must not be an input the
+  // caller still reads.
+  TensorStorage& reset(const Shape& shape, Type type);
   template <typename T>
-  typename std::vector<T>::const_iterator begin() const {
-    return this->as<T>().begin();
+  AlignedVector<T>& reset(const Shape& shape) {
+    return reinterpret_cast<AlignedVector<T>&>(
+        reset(shape, GetTypeEnum<T>()));
+  }
+  // same values with another shape of the same element count, O(1) for
+  // contiguous tensors
+  Tensor reshape(const Shape& sh) const;
+  // axes reordered as in perm (axis i of the result is axis perm[i] of
+  // this tensor), the storage is shared and only strides change
+  Tensor permute(const std::vector<size_t>& perm) const;
+  // row-major tensor with the same values, *this if already contiguous
+  Tensor contiguous() const;
+  // strided read-only view of the whole tensor sharing its storage
+  TensorView view() const;
+  bool shares_storage(const Tensor& other) const {
+    return values_ != nullptr && values_ == other.values_;
   }
 
   template <typename T>
-  typename std::vector<T>::const_iterator end() const {
-    return this->as<T>().end();
+  typename AlignedVector<T>::const_iterator begin() const {
+    return this->as<T>()->begin();
+  }
+
+  template <typename T>
+  typename AlignedVector<T>::const_iterator end() const {
+    return this->as<T>()->end();
   }
 
   template <typename T>
@@ -129,53 +251,77 @@ class Tensor {
   template <typename T>
   T get(const std::vector<size_t>& coords) const;
 
+  // first element, aligned to kTensorAlignment
+  template <typename T>
+  T* data() {
+    return this->as<T>()->data();
+  }
+  template <typename T>
+  const T* data() const {
+    return this->as<T>()->data();
+  }
+
   template <typename T>
-  std::vector<T>* as();
+  AlignedVector<T>* as();
 
   template <typename T>
-  const std::vector<T>* as() const;
+  const AlignedVector<T>* as() const;
 
   friend std::ostream& operator<<(std::ostream& out, const Tensor& t);
+  friend class TensorView;
 };
 
 template <typename T>
 void Tensor::set(const std::vector<size_t>& coords, const T& elem) {
-  size_t s = shape_.get_index(coords);
-  std::vector<T>* res_vector = this->as<T>();
-  if ((*res_vector).size() == 0) {
+  if (GetTypeEnum<T>() != type_) {
+    throw std::invalid_argument("Template type doesn't fit this Tensor");
+  }
+  // makes a permuted tensor row-major first, offset_of needs its strides
+  TensorStorage& res_vector = mutable_values();
+  size_t s = offset_of(coords);
+  if (res_vector.size() == 0) {
     throw std::invalid_argument("Empty tensor");
   }
-  (*res_vector)[s] = elem;
+  reinterpret_cast<T*>(res_vector.data())[s] = elem;
 }
 
 template <typename T>
 T Tensor::get(const std::vector<size_t>& coords) const {
-  size_t s = shape_.get_index(coords);
-  const std::vector<T>* res_vector = this->as<T>();
-  if ((*res_vector).size() == 0) {
+  size_t s = offset_of(coords);
+  if (GetTypeEnum<T>() != type_) {
+    throw std::invalid_argument("Template type doesn't fit this Tensor");
+  }
+  const TensorStorage& res_vector = values();
+  if (res_vector.size() == 0) {
     throw std::invalid_argument("Empty tensor");
   }
-  return (*res_vector)[s];
+  return reinterpret_cast<const T*>(res_vector.data())[s];
 }
 
 template <typename T>
-std::vector<T>* Tensor::as() {
+AlignedVector<T>* Tensor::as() {
   if (GetTypeEnum<T>() != type_) {
     throw std::invalid_argument("Template type doesn't fit this Tensor");
   }
-  return reinterpret_cast<std::vector<T>*>(&values_);
+  if (!is_contiguous()) {
+    throw std::logic_error("Tensor is not contiguous, call contiguous()");
+  }
+  return reinterpret_cast<AlignedVector<T>*>(&mutable_values());
 }
 
 template <typename T>
-const std::vector<T>* Tensor::as() const {
+const AlignedVector<T>* Tensor::as() const {
   if (GetTypeEnum<T>() != type_) {
     throw std::invalid_argument("Template type doesn't fit this Tensor");
   }
-  return reinterpret_cast<const std::vector<T>*>(&values_);
+  if (!is_contiguous()) {
+    throw std::logic_error("Tensor is not contiguous, call contiguous()");
+  }
+  return reinterpret_cast<const AlignedVector<T>*>(&values());
 }
 
-template <typename T>
-Tensor make_tensor(const std::vector<T>& values) {
+template <typename T, typename Alloc = std::allocator<T>>
+Tensor make_tensor(const std::vector<T, Alloc>& values) {
   Type type = GetTypeEnum<T>();
   if (type == Type::kUnknown) {
     throw std::invalid_argument("Unsupported tensor type");
@@ -189,16 +335,16 @@ Tensor make_tensor(const std::vector<T>& values) {
   return Tensor(byte_values, shape, type);
 }
 
-template <typename T>
-Tensor make_tensor(const std::vector<T>& values, const Shape& shape) {
+template <typename T, typename Alloc = std::allocator<T>>
+Tensor make_tensor(const std::vector<T, Alloc>& values, const Shape& shape) {
   std::vector<uint8_t> byte_values(
       reinterpret_cast<const uint8_t*>(values.data()),
       reinterpret_cast<const uint8_t*>(values.data() + values.size()));
   return Tensor(byte_values, shape, GetTypeEnum<T>());
 }
 
-template <typename T>
-Tensor make_tensor(const std::vector<T>& values, const Shape& shape,
+template <typename T, typename Alloc = std::allocator<T>>
+Tensor make_tensor(const std::vector<T, Alloc>& values, const Shape& shape,
                    const std::vector<float>& bias) {
   std::vector<uint8_t> byte_values(
       reinterpret_cast<const uint8_t*>(values.data()),
@@ -207,4 +353,8 @@ Tensor make_tensor(const std::vector<T>& values, const Shape& shape,
 }
 std::ostream& operator<<(std::ostream& out, const Tensor& t);
 
+// row-major tensor of the same shape with the values converted from or to
+// float, for kFloat16 and kBFloat16 (input itself if already of type)
+Tensor convert_precision(const Tensor& input, Type type);
+
 }  // namespace it_lab_ai
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "layers/Shape.hpp"
+#include "layers/Tensor.hpp"
+
+namespace it_lab_ai {
+
+// Read-only window into the storage of a Tensor: shape, strides and offset
+// are counted in elements. Views keep the storage alive, so slicing,
+// narrowing and reshaping never copy values; to_tensor() copies only when
+// the view is not the whole storage in row-major order.
+class TensorView {
+ public:
+  TensorView() = default;
+  explicit TensorView(const Tensor& t);
+  TensorView(const TensorView& c) = default;
+  TensorView& operator=(const TensorView& c) = default;
+
+  const Shape& get_shape() const noexcept { return shape_; }
+  Type get_type() const noexcept { return type_; }
+  const std::vector<size_t>& get_strides() const noexcept { return strides_; }
+  size_t get_offset() const noexcept { return offset_; }
+
+  bool is_contiguous() const;
+  // view of [begin, begin + length) along axis
+  TensorView narrow(size_t axis, size_t begin, size_t length) const;
+  // view of samples [begin, end) along the batch axis
+  TensorView slice(size_t begin, size_t end) const {
+    if (shape_.dims() == 0 || begin > end) {
+      throw std::out_of_range("Invalid slice");
+    }
+    return narrow(0, begin, end - begin);
+  }
+  // contiguous views only, the element count must not change
+  TensorView reshape(const Shape& sh) const;
+  Tensor to_tensor() const;
+
+  // first element of the view, valid while the view is alive
+  template <typename T>
+  const T* data() const;
+  template <typename T>
+  T get(const std::vector<size_t>& coords) const;
+
+ private:
+  std::shared_ptr<TensorStorage> values_;
+  Shape shape_;
+  std::vector<size_t> strides_;
+  size_t offset_ = 0;
+  Type type_ = Type::kUnknown;
+
+  size_t element_size() const;
+};
+
+template <typename T>
+const T* TensorView::data() const {
+  if (GetTypeEnum<T>() != type_) {
+    throw std::invalid_argument("Template type doesn't fit this TensorView");
+  }
+  if (!values_) {
+    return nullptr;
+  }
+  return reinterpret_cast<const T*>(values_->data()) + offset_;
+}
+
+template <typename T>
+T TensorView::get(const std::vector<size_t>& coords) const {
+  if (coords.size() != shape_.dims()) {
+    throw std::invalid_argument("Invalid index vector");
+  }
+  size_t index = 0;
+  for (size_t i = 0; i < coords.size(); i++) {
+    if (coords[i] >= shape_[i]) {
+      throw std::out_of_range("Out of range");
+    }
+    index += coords[i] * strides_[i];
+  }
+  return data<T>()[index];
+}
+
+}  // namespace it_lab_ai
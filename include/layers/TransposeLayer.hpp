@@ -8,19 +8,24 @@ namespace it_lab_ai {
 
 class TransposeLayer : public Layer {
  public:
-  explicit TransposeLayer(std::vector<int64_t> perm = {})
-      : perm_(std::move(perm)) {}
+  // a lazy layer returns a permuted view of its input, which is copied
+  // only by a consumer that needs row-major data
+  explicit TransposeLayer(std::vector<int64_t> perm = {}, bool lazy = false)
+      : perm_(std::move(perm)), lazy_(lazy) {}
 
   void run(const Tensor& input, Tensor& output) override;
+  bool accepts_strided_input() const override { return true; }
 
 #ifdef ENABLE_STATISTIC_WEIGHTS
   Tensor get_weights() override { return Tensor(); }
 #endif
 
   static std::string get_name() { return "TransposeLayer"; }
+  std::string name() const override { return get_name(); }
 
  private:
   std::vector<int64_t> perm_;
+  bool lazy_;
 
   static void validate_perm(const Shape& input_shape,
                             const std::vector<int64_t>& perm);
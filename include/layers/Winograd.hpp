@@ -0,0 +1,229 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "layers/Activation.hpp"
+#include "layers/Gemm.hpp"
+#include "layers/Span.hpp"
+#include "layers/Tensor.hpp"
+
+namespace it_lab_ai {
+
+// ConvolutionalLayer runs 3x3 stride 1 kernels as F(4x4, 3x3)
+constexpr size_t kWinogradTileSize = 4;
+
+// transform matrices of Winograd F(TileSize x TileSize, 3x3):
+// Y = At * [(G * g * Gt) . (Bt * d * B)] * A
+template <size_t TileSize>
+struct WinogradMatrices;
+
+template <>
+struct WinogradMatrices<2> {
+  static constexpr size_t kAlpha = 4;
+  static constexpr float kG[4][3] = {{1.0F, 0.0F, 0.0F},
+                                     {0.5F, 0.5F, 0.5F},
+                                     {0.5F, -0.5F, 0.5F},
+                                     {0.0F, 0.0F, 1.0F}};
+  static constexpr float kBt[4][4] = {{1.0F, 0.0F, -1.0F, 0.0F},
+                                      {0.0F, 1.0F, 1.0F, 0.0F},
+                                      {0.0F, -1.0F, 1.0F, 0.0F},
+                                      {0.0F, 1.0F, 0.0F, -1.0F}};
+  static constexpr float kAt[2][4] = {{1.0F, 1.0F, 1.0F, 0.0F},
+                                      {0.0F, 1.0F, -1.0F, -1.0F}};
+};
+
+template <>
+struct WinogradMatrices<4> {
+  static constexpr size_t kAlpha = 6;
+  static constexpr float kG[6][3] = {
+      {1.0F / 4, 0.0F, 0.0F},
+      {-1.0F / 6, -1.0F / 6, -1.0F / 6},
+      {-1.0F / 6, 1.0F / 6, -1.0F / 6},
+      {1.0F / 24, 1.0F / 12, 1.0F / 6},
+      {1.0F / 24, -1.0F / 12, 1.0F / 6},
+      {0.0F, 0.0F, 1.0F}};
+  static constexpr float kBt[6][6] = {
+      {4.0F, 0.0F, -5.0F, 0.0F, 1.0F, 0.0F},
+      {0.0F, -4.0F, -4.0F, 1.0F, 1.0F, 0.0F},
+      {0.0F, 4.0F, -4.0F, -1.0F, 1.0F, 0.0F},
+      {0.0F, -2.0F, -1.0F, 2.0F, 1.0F, 0.0F},
+      {0.0F, 2.0F, -1.0F, -2.0F, 1.0F, 0.0F},
+      {0.0F, 4.0F, 0.0F, -5.0F, 0.0F, 1.0F}};
+  static constexpr float kAt[4][6] = {{1.0F, 1.0F, 1.0F, 1.0F, 1.0F, 0.0F},
+                                      {0.0F, 1.0F, -1.0F, 2.0F, -2.0F, 0.0F},
+                                      {0.0F, 1.0F, 1.0F, 4.0F, 4.0F, 0.0F},
+                                      {0.0F, 1.0F, -1.0F, 8.0F, -8.0F, 1.0F}};
+};
+
+// HWIO 3x3 kernel -> G * g * Gt for every (oc, ic) pair,
+// stored as [alpha * alpha][out_channels][in_channels] for the batched gemm
+template <size_t TileSize>
+std::vector<float> WinogradKernelTransform(const Tensor& kernel) {
+  using Matrices = WinogradMatrices<TileSize>;
+  constexpr size_t kAlpha = Matrices::kAlpha;
+  const Shape& shape = kernel.get_shape();
+  if (shape.dims() != 4 || shape[0] != 3 || shape[1] != 3) {
+    throw std::invalid_argument("Winograd needs a 3x3 HWIO kernel");
+  }
+  size_t in_channels = shape[2];
+  size_t out_channels = shape[3];
+  const AlignedVector<float>& kernel_data = *kernel.as<float>();
+  std::vector<float> transformed(kAlpha * kAlpha * out_channels *
+                                 in_channels);
+  for (size_t oc = 0; oc < out_channels; ++oc) {
+    for (size_t ic = 0; ic < in_channels; ++ic) {
+      float g[3][3];
+      for (size_t h = 0; h < 3; ++h) {
+        for (size_t w = 0; w < 3; ++w) {
+          g[h][w] = kernel_data[((h * 3 + w) * in_channels + ic) *
+                                    out_channels +
+                                oc];
+        }
+      }
+      float gg[kAlpha][3] = {};
+      for (size_t i = 0; i < kAlpha; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+          for (size_t k = 0; k < 3; ++k) {
+            gg[i][j] += Matrices::kG[i][k] * g[k][j];
+          }
+        }
+      }
+      for (size_t i = 0; i < kAlpha; ++i) {
+        for (size_t j = 0; j < kAlpha; ++j) {
+          float value = 0.0F;
+          for (size_t k = 0; k < 3; ++k) {
+            value += gg[i][k] * Matrices::kG[j][k];
+          }
+          transformed[((i * kAlpha + j) * out_channels + oc) * in_channels +
+                      ic] = value;
+        }
+      }
+    }
+  }
+  return transformed;
+}
+
+// NCHW -> NCHW only, 3x3 kernel, stride 1, no dilation.
+// kernel_transform comes from WinogradKernelTransform<TileSize>
+template <size_t TileSize>
+void Conv4DWinograd(const Tensor& input, Span<const float> kernel_transform,
+                    size_t out_channels, const Tensor& bias_, Tensor& output,
+                    size_t pads_,
+                    const OutputEpilogue<float>& epilogue =
+                        OutputEpilogue<float>()) {
+  using Matrices = WinogradMatrices<TileSize>;
+  constexpr size_t kAlpha = Matrices::kAlpha;
+  constexpr size_t kPositions = kAlpha * kAlpha;
+  size_t batch_size = input.get_shape()[0];
+  size_t in_channels = input.get_shape()[1];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+  if (kernel_transform.size() != kPositions * out_channels * in_channels) {
+    throw std::invalid_argument("Winograd kernel doesn't fit the input");
+  }
+  size_t out_height = in_height + 2 * pads_ - 2;
+  size_t out_width = in_width + 2 * pads_ - 2;
+  size_t tiles_h = (out_height + TileSize - 1) / TileSize;
+  size_t tiles_w = (out_width + TileSize - 1) / TileSize;
+  size_t tiles = tiles_h * tiles_w;
+
+  const AlignedVector<float>& input_data = *input.as<float>();
+  const float* bias_data = bias_.empty() ? nullptr : bias_.as<float>()->data();
+  std::vector<float> input_transform(kPositions * in_channels * tiles);
+  std::vector<float> products(kPositions * out_channels * tiles);
+  AlignedVector<float>& one_d_vector = output.reset<float>(
+      {batch_size, out_channels, out_height, out_width});
+
+  for (size_t b = 0; b < batch_size; ++b) {
+    // V = Bt * d * B for every input tile, scattered as [xi][ic][tile]
+    for (size_t ic = 0; ic < in_channels; ++ic) {
+      const float* channel =
+          input_data.data() + (b * in_channels + ic) * in_height * in_width;
+      for (size_t ty = 0; ty < tiles_h; ++ty) {
+        for (size_t tx = 0; tx < tiles_w; ++tx) {
+          float d[kAlpha][kAlpha];
+          for (size_t i = 0; i < kAlpha; ++i) {
+            size_t row = ty * TileSize + i;
+            for (size_t j = 0; j < kAlpha; ++j) {
+              size_t col = tx * TileSize + j;
+              bool inside = row >= pads_ && row - pads_ < in_height &&
+                            col >= pads_ && col - pads_ < in_width;
+              d[i][j] =
+                  inside ? channel[(row - pads_) * in_width + col - pads_]
+                         : 0.0F;
+            }
+          }
+          float bd[kAlpha][kAlpha] = {};
+          for (size_t i = 0; i < kAlpha; ++i) {
+            for (size_t k = 0; k < kAlpha; ++k) {
+              float bt = Matrices::kBt[i][k];
+              if (bt == 0.0F) continue;
+              for (size_t j = 0; j < kAlpha; ++j) {
+                bd[i][j] += bt * d[k][j];
+              }
+            }
+          }
+          size_t tile = ty * tiles_w + tx;
+          for (size_t i = 0; i < kAlpha; ++i) {
+            for (size_t j = 0; j < kAlpha; ++j) {
+              float value = 0.0F;
+              for (size_t k = 0; k < kAlpha; ++k) {
+                value += bd[i][k] * Matrices::kBt[j][k];
+              }
+              input_transform[((i * kAlpha + j) * in_channels + ic) * tiles +
+                              tile] = value;
+            }
+          }
+        }
+      }
+    }
+    // elementwise products over channels as kPositions independent gemms
+    for (size_t xi = 0; xi < kPositions; ++xi) {
+      gemm(out_channels, tiles, in_channels,
+           kernel_transform.data() + xi * out_channels * in_channels,
+           in_channels, size_t(1),
+           input_transform.data() + xi * in_channels * tiles, tiles,
+           size_t(1), products.data() + xi * out_channels * tiles, tiles);
+    }
+    // Y = At * M * A, cropped to the output borders
+    for (size_t oc = 0; oc < out_channels; ++oc) {
+      size_t channel_offset = (b * out_channels + oc) * out_height * out_width;
+      float* result = one_d_vector.data() + channel_offset;
+      float bias_value = bias_data == nullptr ? 0.0F : bias_data[oc];
+      for (size_t tile = 0; tile < tiles; ++tile) {
+        float am[TileSize][kAlpha] = {};
+        for (size_t i = 0; i < TileSize; ++i) {
+          for (size_t k = 0; k < kAlpha; ++k) {
+            float at = Matrices::kAt[i][k];
+            if (at == 0.0F) continue;
+            const float* row_products =
+                products.data() + (k * kAlpha * out_channels + oc) * tiles;
+            for (size_t j = 0; j < kAlpha; ++j) {
+              am[i][j] += at * row_products[j * out_channels * tiles + tile];
+            }
+          }
+        }
+        size_t ty = tile / tiles_w;
+        size_t tx = tile % tiles_w;
+        for (size_t i = 0; i < TileSize; ++i) {
+          size_t row = ty * TileSize + i;
+          if (row >= out_height) break;
+          for (size_t j = 0; j < TileSize; ++j) {
+            size_t col = tx * TileSize + j;
+            if (col >= out_width) break;
+            float value = bias_value;
+            for (size_t k = 0; k < kAlpha; ++k) {
+              value += am[i][k] * Matrices::kAt[j][k];
+            }
+            size_t index = row * out_width + col;
+            result[index] = epilogue(channel_offset + index, value);
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace it_lab_ai
@@ -5,6 +5,7 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstddef>
 #include <numeric>
 #include <stdexcept>
 #include <vector>
@@ -83,6 +84,116 @@ double throughput_omp_avg(const size_t iters, Function&& func, Args&&... args) {
   return 1 / elapsed_time_omp_avg(iters, func, args...);
 }
 
+// per-iteration times of a benchmark, in the unit of the samples
+struct SampleStats {
+  // kept after the outliers were dropped
+  size_t samples = 0;
+  size_t outliers = 0;
+  double min = 0.0;
+  double median = 0.0;
+  double mean = 0.0;
+  // sample standard deviation, 0 for a single sample
+  double stddev = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+// p in [0, 100] of sorted values, interpolated between the closest ranks
+double percentile(const std::vector<double>& sorted, double p);
+// drops the samples past Tukey's outer fences (3 interquartile ranges
+// beyond the quartiles): preemptions and page faults, not the kernel
+SampleStats sample_stats(std::vector<double> samples,
+                         bool reject_outliers = true);
+
+// evicts the data of the previous run from the caches by writing and
+// reading a buffer of the given size, larger than the last level cache
+void flush_cache(size_t bytes);
+
+// pins the calling thread to a CPU until destroyed and restores its
+// affinity then. pinned() is false for cpu < 0, when the system refused
+// and on systems without an affinity API. TBB and OpenMP workers the
+// benchmarked code spreads over are not pinned
+class CpuPin {
+ public:
+  explicit CpuPin(int cpu);
+  CpuPin(const CpuPin&) = delete;
+  CpuPin& operator=(const CpuPin&) = delete;
+  ~CpuPin();
+  bool pinned() const { return pinned_; }
+
+ private:
+  bool pinned_ = false;
+  // affinity before the pin, as the system stores it
+  std::vector<unsigned char> saved_;
+};
+
+struct BenchmarkOptions {
+  // untimed runs first
+  size_t warmup = 3;
+  // timed runs, 0 runs until min_time_ms of them took place and at least
+  // min_iterations were timed, up to max_iterations
+  size_t iterations = 0;
+  double min_time_ms = 200.0;
+  size_t min_iterations = 5;
+  size_t max_iterations = 100000;
+  // flush_cache before every run, outside of its time
+  bool flush_cache = false;
+  size_t flush_bytes = size_t{64} << 20;
+  // CPU to pin the calling thread to, -1 leaves it free
+  int cpu = -1;
+  bool reject_outliers = true;
+};
+
+struct BenchmarkResult {
+  // ms of every timed run in order
+  std::vector<double> samples;
+  SampleStats stats;
+  bool pinned = false;
+};
+
+template <class Function, typename... Args>
+BenchmarkResult run_benchmark(const BenchmarkOptions& options,
+                              Function&& func, Args&&... args) {
+  CpuPin pin(options.cpu);
+  for (size_t i = 0; i < options.warmup; i++) {
+    if (options.flush_cache) {
+      flush_cache(options.flush_bytes);
+    }
+    func(args...);
+  }
+  BenchmarkResult res;
+  double total = 0.0;
+  while (options.iterations != 0
+             ? res.samples.size() < options.iterations
+             : (res.samples.size() < options.min_iterations ||
+                total < options.min_time_ms) &&
+                   res.samples.size() < options.max_iterations) {
+    if (options.flush_cache) {
+      flush_cache(options.flush_bytes);
+    }
+    res.samples.push_back(elapsed_time<double, std::milli>(func, args...));
+    total += res.samples.back();
+  }
+  res.stats = sample_stats(res.samples, options.reject_outliers);
+  res.pinned = pin.pinned();
+  return res;
+}
+
+// ms of each of iters runs of func after warmup untimed ones
+template <class Function, typename... Args>
+std::vector<double> sample_times(const size_t warmup, const size_t iters,
+                                 Function&& func, Args&&... args) {
+  for (size_t i = 0; i < warmup; i++) {
+    func(args...);
+  }
+  std::vector<double> samples(iters);
+  for (size_t i = 0; i < iters; i++) {
+    samples[i] = elapsed_time<double, std::milli>(func, args...);
+  }
+  return samples;
+}
+
 // as "Manhattan" norm of error-vector
 template <typename T>
 T accuracy(T* test, T* ref, const size_t size) {
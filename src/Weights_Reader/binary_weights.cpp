@@ -0,0 +1,316 @@
+#include "Weights_Reader/binary_weights.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace it_lab_ai {
+
+namespace {
+
+constexpr size_t kBinaryHeaderSize =
+    sizeof(kBinaryWeightsMagic) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+size_t align_blob(size_t offset) {
+  return (offset + kTensorAlignment - 1) / kTensorAlignment *
+         kTensorAlignment;
+}
+
+// buffered reads of a weights file: the records are read into memory and
+// parsed, every blob is read straight into the storage of its tensor
+class WeightsFile {
+ public:
+  explicit WeightsFile(const std::string& filename)
+      : in_(filename, std::ios::binary) {
+    if (!in_.is_open()) {
+      throw std::runtime_error("Failed to open weights file: " + filename);
+    }
+    in_.seekg(0, std::ios::end);
+    size_ = static_cast<uint64_t>(in_.tellg());
+  }
+
+  std::vector<uint8_t> read_bytes(uint64_t offset, uint64_t bytes) {
+    std::vector<uint8_t> result(static_cast<size_t>(bytes));
+    read(offset, bytes, result.data());
+    return result;
+  }
+  void read_floats(uint64_t offset, uint64_t count, float* values) {
+    if (count > size_ / sizeof(float)) {
+      throw std::runtime_error("Corrupted binary weights file");
+    }
+    read(offset, count * sizeof(float), values);
+  }
+
+ private:
+  std::ifstream in_;
+  uint64_t size_ = 0;
+
+  void read(uint64_t offset, uint64_t bytes, void* data) {
+    if (offset > size_ || bytes > size_ - offset) {
+      throw std::runtime_error("Corrupted binary weights file");
+    }
+    if (bytes == 0) {
+      return;
+    }
+    in_.seekg(static_cast<std::streamoff>(offset));
+    in_.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes));
+    if (!in_) {
+      throw std::runtime_error("Failed to read weights file");
+    }
+  }
+};
+
+class ByteWriter {
+ public:
+  template <typename T>
+  void put(T value) {
+    const auto* p = reinterpret_cast<const uint8_t*>(&value);
+    bytes_.insert(bytes_.end(), p, p + sizeof(T));
+  }
+  void put_string(const std::string& s) {
+    put(static_cast<uint32_t>(s.size()));
+    bytes_.insert(bytes_.end(), s.begin(), s.end());
+  }
+  const std::vector<uint8_t>& bytes() const { return bytes_; }
+
+ private:
+  std::vector<uint8_t> bytes_;
+};
+
+class ByteReader {
+ public:
+  ByteReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+  template <typename T>
+  T get() {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+  std::string get_string() {
+    auto length = get<uint32_t>();
+    const auto* p = reinterpret_cast<const char*>(take(length));
+    return std::string(p, length);
+  }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_ = 0;
+
+  const uint8_t* take(size_t bytes) {
+    if (bytes > size_ - pos_) {
+      throw std::runtime_error("Corrupted binary weights file");
+    }
+    const uint8_t* p = data_ + pos_;
+    pos_ += bytes;
+    return p;
+  }
+};
+
+struct PendingLayer {
+  LayerRecord record;
+  std::vector<size_t> shape;
+  std::vector<float> weights;
+  std::vector<float> bias;
+  uint64_t weights_offset = 0;
+  uint64_t bias_offset = 0;
+};
+
+// metadata of a layer and, with values set, its weights and bias
+PendingLayer parse_layer(const json& layer_data, bool values) {
+  PendingLayer layer;
+  if (!layer_data.is_object()) {
+    return layer;
+  }
+  for (const auto& item : layer_data.items()) {
+    const std::string& key = item.key();
+    const json& value = item.value();
+    if (key == "weights") {
+      if (values) {
+        extract_values_from_json(value, layer.weights);
+        parse_json_shape(value, layer.shape, 0);
+      }
+    } else if (key == "bias") {
+      if (values) {
+        extract_values_from_json(value, layer.bias);
+      }
+    } else if (key == "index" && value.is_number_integer()) {
+      layer.record.index = value.get<int64_t>();
+    } else if (key == "name" && value.is_string()) {
+      layer.record.name = value.get<std::string>();
+    } else if (key == "type" && value.is_string()) {
+      layer.record.type = value.get<std::string>();
+    } else {
+      layer.record.attributes[key] =
+          value.is_string() ? value.get<std::string>() : value.dump();
+    }
+  }
+  return layer;
+}
+
+void write_records(ByteWriter& writer,
+                   const std::vector<PendingLayer>& layers) {
+  for (const PendingLayer& layer : layers) {
+    writer.put(layer.record.index);
+    writer.put_string(layer.record.name);
+    writer.put_string(layer.record.type);
+    writer.put(static_cast<uint32_t>(layer.record.attributes.size()));
+    for (const auto& attribute : layer.record.attributes) {
+      writer.put_string(attribute.first);
+      writer.put_string(attribute.second);
+    }
+    writer.put(static_cast<uint32_t>(layer.shape.size()));
+    for (size_t dim : layer.shape) {
+      writer.put(static_cast<uint64_t>(dim));
+    }
+    writer.put(static_cast<uint64_t>(layer.weights.size()));
+    writer.put(layer.weights_offset);
+    writer.put(static_cast<uint64_t>(layer.bias.size()));
+    writer.put(layer.bias_offset);
+  }
+}
+
+}  // namespace
+
+std::vector<LayerRecord> read_layers_from_json(const json& model_data) {
+  std::vector<LayerRecord> layers;
+  for (const auto& layer_data : model_data) {
+    LayerRecord record = parse_layer(layer_data, false).record;
+    if (layer_data.contains("weights")) {
+      record.tensor = create_tensor_from_json(layer_data, Type::kFloat);
+    }
+    layers.push_back(std::move(record));
+  }
+  return layers;
+}
+
+void write_binary_weights(const json& model_data,
+                          const std::string& filename) {
+  std::vector<PendingLayer> layers;
+  for (const auto& layer_data : model_data) {
+    layers.push_back(parse_layer(layer_data, true));
+  }
+  // records have a fixed size whatever the offsets are, so blobs are
+  // placed after measuring them once
+  ByteWriter measure;
+  write_records(measure, layers);
+  uint64_t data_offset =
+      align_blob(kBinaryHeaderSize + measure.bytes().size());
+  uint64_t offset = data_offset;
+  for (PendingLayer& layer : layers) {
+    layer.weights_offset = offset;
+    offset = align_blob(offset + layer.weights.size() * sizeof(float));
+    layer.bias_offset = offset;
+    offset = align_blob(offset + layer.bias.size() * sizeof(float));
+  }
+
+  ByteWriter writer;
+  for (char c : kBinaryWeightsMagic) {
+    writer.put(c);
+  }
+  writer.put(kBinaryWeightsVersion);
+  writer.put(static_cast<uint32_t>(layers.size()));
+  writer.put(data_offset);
+  write_records(writer, layers);
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out.is_open()) {
+    throw std::runtime_error("Failed to create weights file: " + filename);
+  }
+  std::vector<char> padding(kTensorAlignment, 0);
+  auto write_padded = [&](const void* data, size_t bytes, uint64_t at) {
+    auto pos = static_cast<uint64_t>(out.tellp());
+    out.write(padding.data(), static_cast<std::streamsize>(at - pos));
+    out.write(static_cast<const char*>(data),
+              static_cast<std::streamsize>(bytes));
+  };
+  out.write(reinterpret_cast<const char*>(writer.bytes().data()),
+            static_cast<std::streamsize>(writer.bytes().size()));
+  for (const PendingLayer& layer : layers) {
+    write_padded(layer.weights.data(), layer.weights.size() * sizeof(float),
+                 layer.weights_offset);
+    write_padded(layer.bias.data(), layer.bias.size() * sizeof(float),
+                 layer.bias_offset);
+  }
+  if (!out) {
+    throw std::runtime_error("Failed to write weights file: " + filename);
+  }
+}
+
+std::vector<LayerRecord> read_binary_weights(const std::string& filename) {
+  WeightsFile file(filename);
+  std::vector<uint8_t> header = file.read_bytes(0, kBinaryHeaderSize);
+  ByteReader header_reader(header.data(), header.size());
+  char magic[sizeof(kBinaryWeightsMagic)];
+  for (char& c : magic) {
+    c = header_reader.get<char>();
+  }
+  if (std::memcmp(magic, kBinaryWeightsMagic, sizeof(magic)) != 0) {
+    throw std::runtime_error("Not a binary weights file: " + filename);
+  }
+  if (header_reader.get<uint32_t>() != kBinaryWeightsVersion) {
+    throw std::runtime_error("Unsupported binary weights version");
+  }
+  auto layer_count = header_reader.get<uint32_t>();
+  // the records end before the data offset, blobs are addressed directly
+  auto data_offset = header_reader.get<uint64_t>();
+  if (data_offset < kBinaryHeaderSize) {
+    throw std::runtime_error("Corrupted binary weights file");
+  }
+  std::vector<uint8_t> records =
+      file.read_bytes(kBinaryHeaderSize, data_offset - kBinaryHeaderSize);
+  ByteReader reader(records.data(), records.size());
+
+  std::vector<LayerRecord> layers(layer_count);
+  for (LayerRecord& layer : layers) {
+    layer.index = reader.get<int64_t>();
+    layer.name = reader.get_string();
+    layer.type = reader.get_string();
+    auto attribute_count = reader.get<uint32_t>();
+    for (uint32_t i = 0; i < attribute_count; i++) {
+      std::string key = reader.get_string();
+      layer.attributes[key] = reader.get_string();
+    }
+    std::vector<size_t> dims(reader.get<uint32_t>());
+    for (size_t& dim : dims) {
+      dim = static_cast<size_t>(reader.get<uint64_t>());
+    }
+    auto weights_count = reader.get<uint64_t>();
+    auto weights_offset = reader.get<uint64_t>();
+    auto bias_count = reader.get<uint64_t>();
+    auto bias_offset = reader.get<uint64_t>();
+
+    if (dims.empty() && weights_count == 0 && bias_count == 0) {
+      continue;  // layer without weights
+    }
+    Shape shape(dims);
+    if (weights_count != shape.count()) {
+      throw std::runtime_error("Corrupted binary weights file");
+    }
+    if (bias_count > 0 && dims.empty()) {
+      throw std::runtime_error("Corrupted binary weights file");
+    }
+    layer.tensor = Tensor(shape, Type::kFloat);
+    file.read_floats(weights_offset, weights_count,
+                     layer.tensor.data<float>());
+    if (bias_count > 0) {
+      std::vector<float> bias(static_cast<size_t>(bias_count));
+      file.read_floats(bias_offset, bias_count, bias.data());
+      layer.tensor.set_bias(bias);
+    }
+  }
+  return layers;
+}
+
+std::string binary_weights_path(const std::string& json_filename) {
+  size_t dot = json_filename.find_last_of('.');
+  size_t slash = json_filename.find_last_of("/\\");
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return json_filename + ".bin";
+  }
+  return json_filename.substr(0, dot) + ".bin";
+}
+
+}  // namespace it_lab_ai
@@ -0,0 +1,91 @@
+#include "layers/Activation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "layers/ActivationSimd.hpp"
+#include "layers/KernelRegistry.hpp"
+#include "oneapi/tbb/parallel_for.h"
+
+namespace it_lab_ai {
+
+namespace {
+
+// the kernel units report whether they were built with the instruction
+// set, they are probed once
+bool isa_available(Isa isa) {
+  static const bool kAvx2 = [] {
+    float value = 0.0F;
+    return isa_supported(Isa::kAvx2) &&
+           activation_avx2(ActivationType::kNone, 0.0F, 0.0F, &value, &value,
+                           1);
+  }();
+  static const bool kAvx512 = [] {
+    float value = 0.0F;
+    return isa_supported(Isa::kAvx512) &&
+           activation_avx512(ActivationType::kNone, 0.0F, 0.0F, &value,
+                             &value, 1);
+  }();
+  switch (isa) {
+    case Isa::kScalar:
+      return true;
+    case Isa::kAvx2:
+      return kAvx2;
+    case Isa::kAvx512:
+      return kAvx512;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+float activation_scalar_sin(float value) { return std::sin(value); }
+
+Isa best_activation_isa() {
+  static const Isa kBest = [] {
+    for (const KernelEntry& entry :
+         KernelRegistry::instance().candidates(kElementWise, Type::kFloat)) {
+      if (isa_available(entry.isa)) {
+        return entry.isa;
+      }
+    }
+    return Isa::kScalar;
+  }();
+  return kBest;
+}
+
+bool Activation::apply(Isa isa, const float* input, float* output,
+                       size_t count) const {
+  switch (isa) {
+    case Isa::kScalar:
+      std::transform(input, input + count, output,
+                     [this](float value) { return (*this)(value); });
+      return true;
+    case Isa::kAvx2:
+      return isa_available(isa) &&
+             activation_avx2(type, alpha, beta, input, output, count);
+    case Isa::kAvx512:
+      return isa_available(isa) &&
+             activation_avx512(type, alpha, beta, input, output, count);
+    default:
+      return false;
+  }
+}
+
+void Activation::apply(const float* input, float* output,
+                       size_t count) const {
+  Isa isa = best_activation_isa();
+  if (count <= kActivationParallelGrain) {
+    apply(isa, input, output, count);
+    return;
+  }
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range<size_t>(0, count, kActivationParallelGrain),
+      [&](const oneapi::tbb::blocked_range<size_t>& range) {
+        apply(isa, input + range.begin(), output + range.begin(),
+              range.size());
+      });
+}
+
+}  // namespace it_lab_ai
@@ -0,0 +1,74 @@
+#include "layers/ActivationSimd.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace it_lab_ai {
+
+#if defined(__AVX2__)
+
+namespace {
+
+struct Avx2Ops {
+  using Reg = __m256;
+  using Mask = __m256;
+  static constexpr size_t kWidth = 8;
+
+  static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+  static void store(float* p, Reg v) { _mm256_storeu_ps(p, v); }
+  static Reg set1(float v) { return _mm256_set1_ps(v); }
+  static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+  static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+  static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+  static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+  // a * b + c
+  static Reg fmadd(Reg a, Reg b, Reg c) { return _mm256_fmadd_ps(a, b, c); }
+  static Reg round(Reg a) {
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  static Reg abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0F), a); }
+  static Reg negate(Reg a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0F)); }
+  // magnitude >= 0 with the sign of sign
+  static Reg copysign(Reg magnitude, Reg sign) {
+    return _mm256_or_ps(magnitude,
+                        _mm256_and_ps(sign, _mm256_set1_ps(-0.0F)));
+  }
+  static Mask less(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static Reg select(Mask m, Reg if_true, Reg if_false) {
+    return _mm256_blendv_ps(if_false, if_true, m);
+  }
+  static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+  // 2^n for integral n in [-126, 127]
+  static Reg pow2(Reg n) {
+    __m256i bits = _mm256_add_epi32(_mm256_cvtps_epi32(n),
+                                    _mm256_set1_epi32(127));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+  }
+  // -a where the integral k is odd
+  static Reg flip_sign_if_odd(Reg a, Reg k) {
+    __m256i sign = _mm256_slli_epi32(_mm256_cvtps_epi32(k), 31);
+    return _mm256_xor_ps(a, _mm256_castsi256_ps(sign));
+  }
+};
+
+}  // namespace
+
+bool activation_avx2(ActivationType type, float alpha, float beta,
+                     const float* input, float* output, size_t count) {
+  simd_activation<Avx2Ops>(type, alpha, beta, input, output, count);
+  return true;
+}
+
+#else
+
+bool activation_avx2(ActivationType, float, float, const float*, float*,
+                     size_t) {
+  return false;
+}
+
+#endif
+
+}  // namespace it_lab_ai
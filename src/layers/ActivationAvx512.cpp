@@ -0,0 +1,91 @@
+#include "layers/ActivationSimd.hpp"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+// GCC 12 warns about the self-initialized _mm512_undefined_ps() of its own
+// intrinsics once they are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#endif
+
+namespace it_lab_ai {
+
+#if defined(__AVX512F__)
+
+namespace {
+
+struct Avx512Ops {
+  using Reg = __m512;
+  using Mask = __mmask16;
+  static constexpr size_t kWidth = 16;
+
+  static Reg load(const float* p) { return _mm512_loadu_ps(p); }
+  static void store(float* p, Reg v) { _mm512_storeu_ps(p, v); }
+  static Reg set1(float v) { return _mm512_set1_ps(v); }
+  static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+  static Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+  static Reg min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+  static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+  // a * b + c
+  static Reg fmadd(Reg a, Reg b, Reg c) { return _mm512_fmadd_ps(a, b, c); }
+  static Reg round(Reg a) {
+    return _mm512_roundscale_ps(a,
+                                _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  // float bit operations of AVX-512F go through the integer unit
+  static Reg bits_and(Reg a, int mask) {
+    return _mm512_castsi512_ps(
+        _mm512_and_epi32(_mm512_castps_si512(a), _mm512_set1_epi32(mask)));
+  }
+  static Reg bits_xor(Reg a, Reg b) {
+    return _mm512_castsi512_ps(
+        _mm512_xor_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)));
+  }
+  static Reg abs(Reg a) { return bits_and(a, 0x7fffffff); }
+  static Reg negate(Reg a) { return bits_xor(a, _mm512_set1_ps(-0.0F)); }
+  // magnitude >= 0 with the sign of sign
+  static Reg copysign(Reg magnitude, Reg sign) {
+    return bits_xor(magnitude, bits_and(sign, static_cast<int>(0x80000000U)));
+  }
+  static Mask less(Reg a, Reg b) {
+    return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+  }
+  static Reg select(Mask m, Reg if_true, Reg if_false) {
+    return _mm512_mask_blend_ps(m, if_false, if_true);
+  }
+  static bool any(Mask m) { return m != 0; }
+  // 2^n for integral n in [-126, 127]
+  static Reg pow2(Reg n) {
+    __m512i bits = _mm512_add_epi32(_mm512_cvtps_epi32(n),
+                                    _mm512_set1_epi32(127));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(bits, 23));
+  }
+  // -a where the integral k is odd
+  static Reg flip_sign_if_odd(Reg a, Reg k) {
+    __m512i sign = _mm512_slli_epi32(_mm512_cvtps_epi32(k), 31);
+    return bits_xor(a, _mm512_castsi512_ps(sign));
+  }
+};
+
+}  // namespace
+
+bool activation_avx512(ActivationType type, float alpha, float beta,
+                       const float* input, float* output, size_t count) {
+  simd_activation<Avx512Ops>(type, alpha, beta, input, output, count);
+  return true;
+}
+
+#else
+
+bool activation_avx512(ActivationType, float, float, const float*, float*,
+                       size_t) {
+  return false;
+}
+
+#endif
+
+}  // namespace it_lab_ai
@@ -29,6 +29,43 @@ void BinaryOpLayer::run(const Tensor& input, Tensor& output) {
       "operations");
 }
 
+void BinaryOpLayer::run_multi(const std::vector<Tensor>& inputs,
+                              std::vector<Tensor>& outputs) {
+  if (inputs.size() != 2) {
+    throw std::runtime_error("BinaryOpLayer expects exactly two inputs");
+  }
+  outputs.resize(1);
+  run(inputs[0], inputs[1], outputs[0]);
+}
+
+void BinaryOpLayer::run_multi_inplace(std::vector<Tensor>& inputs,
+                                      std::vector<Tensor>& outputs) {
+  if (inputs.size() != 2 || inputs[0].get_type() != inputs[1].get_type()) {
+    run_multi(inputs, outputs);
+    return;
+  }
+  // same operand order as run()
+  size_t target = is_scalar_tensor(inputs[1]) ? 0 : 1;
+  if (!is_scalar_tensor(inputs[1 - target])) {
+    run_multi(inputs, outputs);
+    return;
+  }
+  const Tensor& scalar = inputs[1 - target];
+  outputs.resize(1);
+  outputs[0] = std::move(inputs[target]);
+  switch (scalar.get_type()) {
+    case Type::kFloat:
+      run_with_scalar(outputs[0], scalar.as<float>()->at(0), outputs[0]);
+      break;
+    case Type::kInt:
+      run_with_scalar(outputs[0], static_cast<float>(scalar.as<int>()->at(0)),
+                      outputs[0]);
+      break;
+    default:
+      throw std::runtime_error("BinaryOpLayer: Unsupported scalar type");
+  }
+}
+
 void BinaryOpLayer::run(const Tensor& A, const Tensor& B, Tensor& output) {
   if (A.get_type() != B.get_type()) {
     throw std::runtime_error(
@@ -101,15 +138,14 @@ void BinaryOpLayer::run_with_scalar(const Tensor& input, float scalar,
 template <typename ValueType>
 void BinaryOpLayer::run_with_scalar_impl(const Tensor& input, ValueType scalar,
                                          Tensor& output) const {
-  const auto& input_data = *input.as<ValueType>();
-  std::vector<ValueType> result;
-  result.reserve(input_data.size());
-
-  for (const auto& val : input_data) {
-    result.push_back(apply_binary_op(val, scalar, op_));
+  // written over a copy of input, which shares its storage until then:
+  // the values are copied only if the input has other owners
+  if (&output != &input) {
+    output = input;
+  }
+  for (auto& val : *output.as<ValueType>()) {
+    val = apply_binary_op(val, scalar, op_);
   }
-
-  output = make_tensor(result, input.get_shape());
 }
 
 template <typename ValueType>
@@ -23,6 +23,12 @@ void ConcatLayer::run(const std::vector<Tensor>& inputs, Tensor& output) {
   }
 }
 
+void ConcatLayer::run_multi(const std::vector<Tensor>& inputs,
+                            std::vector<Tensor>& outputs) {
+  outputs.resize(1);
+  run(inputs, outputs[0]);
+}
+
 void ConcatLayer::validate_inputs(const std::vector<Tensor>& inputs) const {
   if (inputs.empty()) return;
 
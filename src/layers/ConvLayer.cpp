@@ -1,11 +1,448 @@
 #include "layers/ConvLayer.hpp"
 
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "layers/BinaryOpLayer.hpp"
+
 namespace it_lab_ai {
 
+namespace {
+
+// output pixels per TBB task of Conv4DInt8 and values per task of its
+// input quantization
+constexpr size_t kInt8ConvTile = 64;
+constexpr size_t kInt8ConvGrain = size_t(1) << 14;
+
+template <typename ValueType>
+OutputEpilogue<ValueType> MakeEpilogue(const Activation& activation,
+                                       const Tensor* residual) {
+  OutputEpilogue<ValueType> epilogue;
+  epilogue.activation = activation;
+  if (residual != nullptr) {
+    epilogue.residual = residual->as<ValueType>()->data();
+  }
+  return epilogue;
+}
+
+template <typename ValueType>
+void ApplyActivation(const Activation& activation, Tensor& tensor) {
+  for (ValueType& value : *tensor.as<ValueType>()) {
+    value = activation(value);
+  }
+}
+
+}  // namespace
+
+// kDefault also takes Winograd where it fits, kWinograd falls back to the
+// direct loops elsewhere. Grouped and pointwise convolutions run
+// ConvDepthwise or the gemm of Conv4DIm2col whatever the implementation.
+// The direct kDefault, kSTL and kTBB loops don't have the usual stride
+// semantics (they leave gaps in strided outputs), so they only fit
+// stride 1: a choice of the registry never changes the results. 16-bit
+// kernels only fit the gemm of kIm2col: the direct loops read float
+// kernels, and the transformed Winograd kernel loses too much precision
+// in 16 bits
+bool ConvolutionalLayer::fits(ImplType impl) const {
+  switch (impl) {
+    case kAuto:
+      return false;
+    case kIm2col:
+      return true;
+    case kWinograd:
+      return group_ == 1 && kernel_.get_type() == Type::kFloat &&
+             kernel_.get_shape().dims() == 4 && kernel_.get_shape()[0] == 3 &&
+             kernel_.get_shape()[1] == 3 && stride_ == 1 && dilations_ == 1;
+    default:
+      return stride_ == 1 && !is_16bit_float(kernel_.get_type());
+  }
+}
+
+bool ConvolutionalLayer::uses_winograd(ImplType impl) const {
+  return (impl == kDefault || impl == kWinograd) && fits(kWinograd);
+}
+
+// one input channel per group
+bool ConvolutionalLayer::depthwise() const {
+  return group_ > 1 && kernel_.get_shape()[2] == 1;
+}
+
+// 1x1 kernels with stride 1 and no padding, a gemm over the channels of
+// the input buffer whatever the implementation
+bool ConvolutionalLayer::pointwise() const {
+  return kernel_.get_shape().dims() == 4 && kernel_.get_shape()[0] == 1 &&
+         kernel_.get_shape()[1] == 1 && stride_ == 1 && pads_ == 0;
+}
+
+// depthwise and ungrouped 4D int and float kernels. Their NHWC kernels
+// have the usual stride semantics, which the NCHW kDefault and kSTL loops
+// don't, and Winograd layers are faster in NCHW
+bool ConvolutionalLayer::supports_layout(LayInOut layout) const {
+  if (layout == kNchw) {
+    return true;
+  }
+  return kernel_.get_shape().dims() == 4 && (group_ == 1 || depthwise()) &&
+         (kernel_.get_type() == Type::kInt ||
+          kernel_.get_type() == Type::kFloat) &&
+         (stride_ == 1 || implType_ == kIm2col || group_ > 1) &&
+         !uses_winograd(implType_);
+}
+
+bool ConvolutionalLayer::start_calibration() {
+  if (kernel_.get_type() != Type::kFloat || kernel_.get_shape().dims() != 4 ||
+      group_ != 1 || (stride_ != 1 && implType_ != kIm2col)) {
+    return false;
+  }
+  calibrating_ = true;
+  input_range_ = ValueRange();
+  return true;
+}
+
+bool ConvolutionalLayer::quantize() {
+  calibrating_ = false;
+  if (input_range_.empty()) {
+    return false;
+  }
+  input_params_ = QuantParams::from_range(input_range_.min, input_range_.max);
+  const Shape& shape = kernel_.get_shape();
+  int8_kernel_ = std::make_shared<const QuantizedMatrix>(
+      QuantizedMatrix::quantize(kernel_.as<float>()->data(),
+                                shape[0] * shape[1] * shape[2], shape[3],
+                                shape[3], 1));
+  return true;
+}
+
+// a multiply-add per output value and kernel tap of its group
+uint64_t ConvolutionalLayer::flops(const Shape& input,
+                                   const Shape& output) const {
+  (void)input;
+  const Shape& kernel = kernel_.get_shape();
+  if (kernel.dims() != 4) {
+    return 0;
+  }
+  return 2 * output.count() * kernel[0] * kernel[1] * kernel[2];
+}
+
+// the form of the kernel a run reads and the bias
+size_t ConvolutionalLayer::weight_bytes() const {
+  size_t bias = bias_.get_values().size();
+  if (int8_kernel_) {
+    return int8_kernel_->packed.size() + bias;
+  }
+  return kernel_form(choice_.impl).get_values().size() + bias;
+}
+
+// depthwise and kNhwc layers read kernel_ as is, so they keep it in float
+bool ConvolutionalLayer::compress_weights(Type type) {
+  if (!is_16bit_float(type) || kernel_.get_type() != Type::kFloat ||
+      kernel_.get_shape().dims() != 4 || depthwise() ||
+      data_layout_ == kNhwc || calibrating_ || int8_kernel_) {
+    return false;
+  }
+  kernel_ = convert_precision(kernel_, type);
+  if (!fits(implType_)) {
+    implType_ = kIm2col;
+  }
+  if (!fits(choice_.impl)) {
+    choice_ = {implType_, 0};
+    choice_shape_ = Shape();
+  }
+  drop_prepared_kernels();
+  prepare_kernel(implType_);
+  prepare_kernel(choice_.impl);
+  return true;
+}
+
+void ConvolutionalLayer::drop_prepared_kernels(const Tensor* keep) {
+  for (Tensor* form : {&winograd_kernel_, &im2col_kernel_, &dilated_kernel_}) {
+    if (form != keep) {
+      *form = Tensor();
+    }
+  }
+}
+
+const Tensor& ConvolutionalLayer::kernel_form(ImplType impl) const {
+  if (kernel_.get_shape().dims() != 4 || depthwise() ||
+      data_layout_ == kNhwc) {
+    return kernel_;
+  }
+  if (group_ > 1 || pointwise() || impl == kIm2col) {
+    return im2col_kernel_;
+  }
+  return uses_winograd(impl) ? winograd_kernel_ : dilated_kernel_;
+}
+
+// a form is built once and kept. A 16-bit kernel is widened into a
+// temporary for it and the form is stored in the 16-bit type again, so no
+// float copy outlives the packing
+void ConvolutionalLayer::prepare_kernel(ImplType impl) {
+  if (compute_type() != Type::kInt && compute_type() != Type::kFloat) {
+    throw std::runtime_error("Unsupported tensor type");
+  }
+  bool is_int = compute_type() == Type::kInt;
+  Type type = kernel_.get_type();
+  Tensor widened;
+  auto source = [&]() -> const Tensor& {
+    if (!is_16bit_float(type)) {
+      return kernel_;
+    }
+    if (widened.empty()) {
+      widened = convert_precision(kernel_, Type::kFloat);
+    }
+    return widened;
+  };
+  auto stored = [type](const Tensor& form) {
+    return is_16bit_float(type) ? convert_precision(form, type) : form;
+  };
+  if (group_ > 1 || pointwise()) {
+    if (!depthwise() && im2col_kernel_.empty()) {
+      im2col_kernel_ =
+          is_int ? make_tensor(Im2colPackKernel<int>(source(), group_))
+                 : stored(make_tensor(
+                       Im2colPackKernel<float>(source(), group_)));
+    }
+  } else if (uses_winograd(impl)) {
+    if (winograd_kernel_.empty()) {
+      winograd_kernel_ =
+          make_tensor(WinogradKernelTransform<kWinogradTileSize>(kernel_));
+    }
+  } else if (impl == kIm2col) {
+    if (im2col_kernel_.empty()) {
+      im2col_kernel_ =
+          is_int ? make_tensor(Im2colPackKernel<int>(source()))
+                 : stored(make_tensor(Im2colPackKernel<float>(source())));
+    }
+  } else if (dilated_kernel_.empty()) {
+    dilated_kernel_ =
+        is_int ? make_tensor(DilateKernel<int>(source(), dilations_))
+               : make_tensor(DilateKernel<float>(source(), dilations_));
+  }
+}
+
+Shape ConvolutionalLayer::output_shape(const Shape& input_shape) const {
+  size_t dil_height = kernel_.get_shape()[0] * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_.get_shape()[1] * dilations_ + 1 - dilations_;
+  return Shape({input_shape[0], kernel_.get_shape()[3],
+                (input_shape[2] + 2 * pads_ - dil_height + stride_) / stride_,
+                (input_shape[3] + 2 * pads_ - dil_width + stride_) / stride_});
+}
+
+std::string ConvolutionalLayer::tuning_key(const Shape& input_shape) const {
+  std::string key = kernel_.get_type() == Type::kInt ? "int" : "float";
+  auto append = [&key](const char* name, const Shape& shape) {
+    key += ' ';
+    key += name;
+    for (size_t i = 0; i < shape.dims(); ++i) {
+      key += (i == 0 ? ' ' : 'x') + std::to_string(shape[i]);
+    }
+  };
+  append("input", input_shape);
+  append("kernel", kernel_.get_shape());
+  key += " stride " + std::to_string(stride_) + " pads " +
+         std::to_string(pads_) + " dilations " + std::to_string(dilations_) +
+         " bias " + (bias_.empty() ? "0" : "1") + " isa " +
+         isa_name(max_isa());
+  return key;
+}
+
+void ConvolutionalLayer::tune(const Tensor& input) {
+  if (!auto_tune_ || group_ > 1 || pointwise() ||
+      kernel_.get_shape().dims() != 4) {
+    return;
+  }
+  if (input.get_shape().dims() != 4) {
+    throw std::out_of_range("Input must be 4-dimensional");
+  }
+  // im2col also tries tiles of about 512 and 2048 output positions, the
+  // columns of a tile then take (in_channels * kh * kw) * 2 or 8 KB
+  size_t out_height = output_shape(input.get_shape())[2];
+  size_t out_width = output_shape(input.get_shape())[3];
+  std::vector<ConvChoice> candidates;
+  for (const KernelEntry& entry :
+       KernelRegistry::instance().candidates(kConvolution,
+                                             compute_type())) {
+    bool duplicate = entry.impl == kDefault && fits(kWinograd);
+    if (!fits(entry.impl) || duplicate) {
+      continue;
+    }
+    candidates.push_back({entry.impl, 0});
+    if (entry.impl != kIm2col) {
+      continue;
+    }
+    for (size_t values : {size_t(512), size_t(2048)}) {
+      size_t rows = std::max<size_t>(1, values / out_width);
+      if (rows < out_height && rows != candidates.back().row_tile) {
+        candidates.push_back({kIm2col, rows});
+      }
+    }
+  }
+  if (candidates.empty()) {
+    candidates.push_back({implType_, 0});
+  }
+  Tensor output;
+  choice_ = ConvTuner::instance().tune(
+      tuning_key(input.get_shape()), candidates,
+      [&](const ConvChoice& candidate) {
+        prepare_kernel(candidate.impl);
+        if (input.get_type() == Type::kInt) {
+          run_conv4d<int>(input, candidate, OutputEpilogue<int>(), output);
+        } else {
+          run_conv4d<float>(input, candidate, OutputEpilogue<float>(), output);
+        }
+      });
+  choice_shape_ = input.get_shape();
+  // the losers' forms were only built for timing
+  prepare_kernel(choice_.impl);
+  drop_prepared_kernels(&kernel_form(choice_.impl));
+}
+
+const ConvChoice& ConvolutionalLayer::choose(const Tensor& input) {
+  if (!auto_tune_ || group_ > 1 || pointwise() || data_layout_ == kNhwc ||
+      input.get_shape() == choice_shape_) {
+    return choice_;
+  }
+  ConvTuner& tuner = ConvTuner::instance();
+  ConvChoice stored;
+  // files written before an algorithm stopped fitting may still name it
+  if (tuner.find(tuning_key(input.get_shape()), stored) &&
+      fits(stored.impl)) {
+    choice_ = stored;
+    choice_shape_ = input.get_shape();
+    prepare_kernel(choice_.impl);
+  } else if (tuner.enabled()) {
+    tune(input);
+  } else {
+    choice_ = {implType_, 0};
+    choice_shape_ = input.get_shape();
+    prepare_kernel(choice_.impl);
+  }
+  return choice_;
+}
+
+template <typename ValueType>
+void ConvolutionalLayer::run_conv4d(const Tensor& input,
+                                    const ConvChoice& choice,
+                                    const OutputEpilogue<ValueType>& epilogue,
+                                    Tensor& output) {
+  if (depthwise()) {
+    if (input.get_shape()[1] != group_) {
+      throw std::invalid_argument("Kernel and input channels don't match");
+    }
+    ConvDepthwise<ValueType>(input, kernel_.get_shape(),
+                             *kernel_.as<ValueType>(), bias_, output, stride_,
+                             pads_, dilations_, epilogue, data_layout_);
+    return;
+  }
+  if (data_layout_ == kNhwc) {
+    Conv4DNHWC<ValueType>(input, kernel_.get_shape(),
+                          *kernel_.as<ValueType>(), bias_, output, stride_,
+                          pads_, dilations_, epilogue);
+    return;
+  }
+  if (group_ > 1 || pointwise() || choice.impl == kIm2col) {
+    size_t row_tile = group_ > 1 || pointwise() ? 0 : choice.row_tile;
+    if constexpr (std::is_same_v<ValueType, float>) {
+      if (kernel_.get_type() == Type::kFloat16) {
+        run_im2col<float, Float16>(input, row_tile, epilogue, output);
+        return;
+      }
+      if (kernel_.get_type() == Type::kBFloat16) {
+        run_im2col<float, BFloat16>(input, row_tile, epilogue, output);
+        return;
+      }
+    }
+    run_im2col<ValueType, ValueType>(input, row_tile, epilogue, output);
+    return;
+  }
+  switch (choice.impl) {
+    case kSTL: {
+      Conv4DSTL<ValueType>(input, kernel_.get_shape(),
+                           *dilated_kernel_.as<ValueType>(), bias_, output,
+                           stride_, pads_, dilations_, epilogue);
+      break;
+    }
+    default: {
+      if constexpr (std::is_same_v<ValueType, float>) {
+        if (uses_winograd(choice.impl)) {
+          Conv4DWinograd<kWinogradTileSize>(
+              input, *winograd_kernel_.as<float>(), kernel_.get_shape()[3],
+              bias_, output, pads_, epilogue);
+          break;
+        }
+      }
+      Conv4D<ValueType>(input, kernel_.get_shape(),
+                        *dilated_kernel_.as<ValueType>(), bias_, output,
+                        stride_, pads_, dilations_, epilogue);
+      break;
+    }
+  }
+}
+
+template <typename ValueType, typename KernelType>
+void ConvolutionalLayer::run_im2col(const Tensor& input, size_t row_tile,
+                                    const OutputEpilogue<ValueType>& epilogue,
+                                    Tensor& output) const {
+  Conv4DIm2col<ValueType, KernelType>(
+      input, kernel_.get_shape(), *im2col_kernel_.as<KernelType>(), bias_,
+      output, stride_, pads_, dilations_, epilogue, row_tile, group_);
+}
+
 void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
+  run_fused(input, nullptr, output);
+}
+
+void ConvolutionalLayer::run_multi(const std::vector<Tensor>& inputs,
+                                   std::vector<Tensor>& outputs) {
+  if (!residual_add_) {
+    Layer::run_multi(inputs, outputs);
+    return;
+  }
+  if (inputs.size() != 2) {
+    throw std::invalid_argument(
+        "Convolution with a fused add expects the input and the residual");
+  }
+  outputs.resize(1);
+  run_fused(inputs[0], &inputs[1], outputs[0]);
+}
+
+void ConvolutionalLayer::run_fused(const Tensor& input, const Tensor* residual,
+                                   Tensor& output) {
   if (input.get_shape().dims() != 4) {
     throw std::out_of_range("Input must be 4-dimensional");
   }
+  // the output is written while the inputs are read
+  if (&input == &output || residual == &output) {
+    Tensor copy = output;
+    run_fused(&input == &output ? copy : input,
+              residual == &output ? &copy : residual, output);
+    return;
+  }
+  if (!input.is_contiguous() && (data_layout_ == kNchw || !is_nhwc(input))) {
+    run_fused(input.contiguous(), residual, output);
+    return;
+  }
+  if (is_16bit_float(kernel_.get_type())) {
+    if (input.get_type() != Type::kFloat) {
+      throw std::invalid_argument("16-bit kernels take float inputs");
+    }
+  }
+  // 4D kernels apply the epilogue to every value they store. The legacy 2D
+  // kernel and residuals that need broadcasting take separate passes
+  bool in_kernel =
+      kernel_.get_shape().dims() == 4 &&
+      (residual == nullptr ||
+       (residual->get_type() == input.get_type() &&
+        residual->get_shape() == output_shape(input.get_shape())));
+  const Tensor* kernel_residual = in_kernel ? residual : nullptr;
+  // residuals are read with the index of the output storage
+  Tensor nhwc_residual;
+  if (kernel_residual != nullptr && data_layout_ == kNhwc) {
+    nhwc_residual = to_nhwc(*kernel_residual);
+    kernel_residual = &nhwc_residual;
+  }
+  Activation kernel_activation = in_kernel ? activation_ : Activation();
   switch (input.get_type()) {
     case Type::kInt: {
       if (kernel_.get_shape().dims() == 2) {
@@ -19,7 +456,9 @@ void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
             static_cast<int>(input.get_shape()[input.get_shape().dims() - 3]),
             input.get_shape()[input.get_shape().dims() - 1] *
                 input.get_shape()[input.get_shape().dims() - 2],
-            bias_.empty() ? std::vector<int>() : *bias_.as<int>());
+            bias_.empty()
+                ? std::vector<int>()
+                : std::vector<int>(bias_.begin<int>(), bias_.end<int>()));
         auto sizeforshape = static_cast<size_t>(
             ((static_cast<int>(
                   input.get_shape()[input.get_shape().dims() - 1]) -
@@ -53,18 +492,9 @@ void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
                     2)),
             sh);
       } else {
-        switch (implType_) {
-          case kSTL: {
-            Conv4DSTL<int>(input, kernel_, bias_, output, stride_, pads_,
-                           dilations_);
-            break;
-          }
-          default: {
-            Conv4D<int>(input, kernel_, bias_, output, stride_, pads_,
-                        dilations_);
-            break;
-          }
-        }
+        run_conv4d<int>(input, choose(input),
+                        MakeEpilogue<int>(kernel_activation, kernel_residual),
+                        output);
       }
       break;
     }
@@ -80,7 +510,9 @@ void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
             static_cast<int>(input.get_shape()[input.get_shape().dims() - 3]),
             input.get_shape()[input.get_shape().dims() - 1] *
                 input.get_shape()[input.get_shape().dims() - 2],
-            bias_.empty() ? std::vector<float>() : *bias_.as<float>());
+            bias_.empty()
+                ? std::vector<float>()
+                : std::vector<float>(bias_.begin<float>(), bias_.end<float>()));
         auto sizeforshape = static_cast<size_t>(
             ((static_cast<int>(
                   input.get_shape()[input.get_shape().dims() - 1]) -
@@ -114,17 +546,17 @@ void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
                     2)),
             sh);
       } else {
-        switch (implType_) {
-          case kSTL: {
-            Conv4DSTL<float>(input, kernel_, bias_, output, stride_, pads_,
-                             dilations_);
-            break;
-          }
-          default: {
-            Conv4D<float>(input, kernel_, bias_, output, stride_, pads_,
-                          dilations_);
-            break;
-          }
+        if (calibrating_) {
+          input_range_.update(input);
+        }
+        OutputEpilogue<float> epilogue =
+            MakeEpilogue<float>(kernel_activation, kernel_residual);
+        if (int8_kernel_) {
+          Conv4DInt8(input, kernel_.get_shape(), *int8_kernel_, input_params_,
+                     bias_, output, stride_, pads_, dilations_, epilogue,
+                     data_layout_);
+        } else {
+          run_conv4d<float>(input, choose(input), epilogue, output);
         }
       }
       break;
@@ -133,6 +565,116 @@ void ConvolutionalLayer::run(const Tensor& input, Tensor& output) {
       throw std::runtime_error("Unsupported tensor type");
     }
   }
+  if (in_kernel) {
+    return;
+  }
+  output = output.contiguous();
+  if (residual != nullptr) {
+    Tensor sum;
+    BinaryOpLayer(BinaryOpLayer::Operation::kAdd).run(output, *residual, sum);
+    output = std::move(sum);
+  }
+  if (!activation_.empty()) {
+    if (output.get_type() == Type::kInt) {
+      ApplyActivation<int>(activation_, output);
+    } else {
+      ApplyActivation<float>(activation_, output);
+    }
+  }
+}
+
+void Conv4DInt8(const Tensor& input, const Shape& kernel_shape,
+                const QuantizedMatrix& kernel, const QuantParams& input_params,
+                const Tensor& bias_, Tensor& output, size_t stride_,
+                size_t pads_, size_t dilations_,
+                const OutputEpilogue<float>& epilogue, LayInOut layout) {
+  size_t batch_size = input.get_shape()[0];
+  size_t channels = input.get_shape()[1];
+  size_t in_height = input.get_shape()[2];
+  size_t in_width = input.get_shape()[3];
+  size_t kernel_height = kernel_shape[0];
+  size_t kernel_width = kernel_shape[1];
+  size_t out_channels = kernel_shape[3];
+  if (kernel_shape[2] != channels) {
+    throw std::invalid_argument("Kernel and input channels don't match");
+  }
+  size_t dil_height = kernel_height * dilations_ + 1 - dilations_;
+  size_t dil_width = kernel_width * dilations_ + 1 - dilations_;
+  size_t out_height = (in_height + 2 * pads_ - dil_height + stride_) / stride_;
+  size_t out_width = (in_width + 2 * pads_ - dil_width + stride_) / stride_;
+  size_t padded_height = in_height + 2 * pads_;
+  size_t padded_width = in_width + 2 * pads_;
+  size_t pixels = batch_size * out_height * out_width;
+  size_t depth = kernel_height * kernel_width * channels;
+  size_t lda = int8_padded_depth(depth);
+
+  std::vector<float> padded = PadToNHWC<float>(input, pads_);
+  std::vector<uint8_t> quantized(padded.size());
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range<size_t>(0, padded.size(), kInt8ConvGrain),
+      [&](const oneapi::tbb::blocked_range<size_t>& range) {
+        for (size_t i = range.begin(); i < range.end(); ++i) {
+          quantized[i] = input_params.quantize(padded[i]);
+        }
+      });
+
+  const float* bias_data = bias_.empty() ? nullptr : bias_.as<float>()->data();
+  AlignedVector<float>& one_d_vector = output.reset<float>(
+      layout == kNhwc
+          ? Shape({batch_size, out_height, out_width, out_channels})
+          : Shape({batch_size, out_channels, out_height, out_width}));
+  size_t tiles = (pixels + kInt8ConvTile - 1) / kInt8ConvTile;
+  oneapi::tbb::parallel_for(size_t(0), tiles, [&](size_t tile) {
+    size_t first = tile * kInt8ConvTile;
+    size_t rows = std::min(kInt8ConvTile, pixels - first);
+    std::vector<uint8_t> columns(rows * lda, 0);
+    for (size_t r = 0; r < rows; ++r) {
+      size_t p = first + r;
+      size_t b = p / (out_height * out_width);
+      size_t i = p / out_width % out_height;
+      size_t j = p % out_width;
+      for (size_t h = 0; h < kernel_height; ++h) {
+        for (size_t w = 0; w < kernel_width; ++w) {
+          const uint8_t* pixel =
+              quantized.data() +
+              ((b * padded_height + i * stride_ + h * dilations_) *
+                   padded_width +
+               j * stride_ + w * dilations_) *
+                  channels;
+          std::copy(pixel, pixel + channels,
+                    columns.data() + r * lda +
+                        (h * kernel_width + w) * channels);
+        }
+      }
+    }
+    std::vector<int32_t> sums(rows * out_channels);
+    gemm_u8s8s32(rows, columns.data(), lda, kernel, sums.data(),
+                 out_channels);
+    for (size_t r = 0; r < rows; ++r) {
+      size_t p = first + r;
+      size_t b = p / (out_height * out_width);
+      size_t ij = p % (out_height * out_width);
+      for (size_t oc = 0; oc < out_channels; ++oc) {
+        int32_t sum = sums[r * out_channels + oc] -
+                      input_params.zero_point * kernel.column_sums[oc];
+        float value = input_params.scale * kernel.scales[oc] *
+                      static_cast<float>(sum);
+        if (bias_data != nullptr) {
+          value += bias_data[oc];
+        }
+        size_t index = layout == kNhwc
+                           ? p * out_channels + oc
+                           : (b * out_channels + oc) * out_height *
+                                     out_width +
+                                 ij;
+        one_d_vector[index] = epilogue(index, value);
+      }
+    }
+  });
+
+  if (layout == kNhwc) {
+    output = nhwc_view(output);
+  }
 }
 
 }  // namespace it_lab_ai
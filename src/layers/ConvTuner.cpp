@@ -0,0 +1,137 @@
+#include "layers/ConvTuner.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+namespace it_lab_ai {
+
+namespace {
+
+const std::pair<const char*, ImplType> kAlgorithms[] = {
+    {"default", kDefault},
+    {"tbb", kTBB},
+    {"stl", kSTL},
+    {"im2col", kIm2col},
+    {"winograd", kWinograd}};
+
+const char* algorithm_name(ImplType impl) {
+  for (const auto& algorithm : kAlgorithms) {
+    if (algorithm.second == impl) {
+      return algorithm.first;
+    }
+  }
+  return "default";
+}
+
+bool parse_algorithm(const std::string& name, ImplType& impl) {
+  for (const auto& algorithm : kAlgorithms) {
+    if (name == algorithm.first) {
+      impl = algorithm.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+ConvTuner::ConvTuner() {
+  const char* tune = std::getenv("ITLAB_AI_TUNE");
+  enabled_ = tune != nullptr && std::string(tune) == "1";
+  const char* file = std::getenv("ITLAB_AI_TUNING_FILE");
+  if (file != nullptr) {
+    file_ = file;
+    load(file_);
+  }
+}
+
+ConvTuner& ConvTuner::instance() {
+  static ConvTuner tuner;
+  return tuner;
+}
+
+bool ConvTuner::find(const std::string& key, ConvChoice& choice) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = choices_.find(key);
+  if (found == choices_.end()) {
+    return false;
+  }
+  choice = found->second;
+  return true;
+}
+
+ConvChoice ConvTuner::tune(const std::string& key,
+                           const std::vector<ConvChoice>& candidates,
+                           const std::function<void(const ConvChoice&)>& run,
+                           int repeats) {
+  ConvChoice best;
+  double best_time = std::numeric_limits<double>::max();
+  for (const ConvChoice& candidate : candidates) {
+    double time = std::numeric_limits<double>::max();
+    for (int i = 0; i < repeats; i++) {
+      auto start = std::chrono::steady_clock::now();
+      run(candidate);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      time = std::min(time, elapsed.count());
+    }
+    if (time < best_time) {
+      best_time = time;
+      best = candidate;
+    }
+  }
+  set(key, best);
+  if (!file_.empty()) {
+    save(file_);
+  }
+  return best;
+}
+
+void ConvTuner::set(const std::string& key, const ConvChoice& choice) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  choices_[key] = choice;
+}
+
+void ConvTuner::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  choices_.clear();
+}
+
+bool ConvTuner::load(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    std::string algorithm;
+    ConvChoice choice;
+    if (std::getline(fields, key, '\t') &&
+        std::getline(fields, algorithm, '\t') && fields >> choice.row_tile &&
+        parse_algorithm(algorithm, choice.impl)) {
+      set(key, choice);
+    }
+  }
+  return true;
+}
+
+bool ConvTuner::save(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& [key, choice] : choices_) {
+    file << key << '\t' << algorithm_name(choice.impl) << '\t'
+         << choice.row_tile << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+}  // namespace it_lab_ai
@@ -0,0 +1,113 @@
+#include "layers/CpuFeatures.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace it_lab_ai {
+
+namespace {
+
+const std::pair<const char*, Isa> kIsaNames[] = {{"scalar", Isa::kScalar},
+                                                 {"sse4", Isa::kSse4},
+                                                 {"avx2", Isa::kAvx2},
+                                                 {"avx512", Isa::kAvx512}};
+
+CpuFeatures detect() {
+  CpuFeatures features;
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  features.sse4_2 = __builtin_cpu_supports("sse4.2") != 0;
+  features.avx = __builtin_cpu_supports("avx") != 0;
+  features.avx2 = __builtin_cpu_supports("avx2") != 0;
+  features.fma = __builtin_cpu_supports("fma") != 0;
+  features.avx512f = __builtin_cpu_supports("avx512f") != 0;
+  features.avx512vnni = __builtin_cpu_supports("avx512vnni") != 0;
+  features.f16c = __builtin_cpu_supports("f16c") != 0;
+  features.avx512bf16 = __builtin_cpu_supports("avx512bf16") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  // cpuid feature bits, the OS must also save the registers (xgetbv)
+  int info[4];
+  __cpuid(info, 1);
+  features.sse4_2 = (info[2] & (1 << 20)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+  bool ymm = (xcr0 & 0x6) == 0x6;
+  bool zmm = (xcr0 & 0xe6) == 0xe6;
+  features.avx = ymm && (info[2] & (1 << 28)) != 0;
+  features.fma = ymm && (info[2] & (1 << 12)) != 0;
+  features.f16c = ymm && (info[2] & (1 << 29)) != 0;
+  __cpuidex(info, 7, 0);
+  features.avx2 = ymm && (info[1] & (1 << 5)) != 0;
+  features.avx512f = zmm && (info[1] & (1 << 16)) != 0;
+  features.avx512vnni = zmm && (info[2] & (1 << 11)) != 0;
+  __cpuidex(info, 7, 1);
+  features.avx512bf16 = zmm && (info[0] & (1 << 5)) != 0;
+#endif
+  return features;
+}
+
+Isa detect_max_isa() {
+  const CpuFeatures& features = cpu_features();
+  Isa isa = Isa::kScalar;
+  if (features.sse4_2) {
+    isa = Isa::kSse4;
+  }
+  if (isa == Isa::kSse4 && features.avx2 && features.fma) {
+    isa = Isa::kAvx2;
+  }
+  if (isa == Isa::kAvx2 && features.avx512f) {
+    isa = Isa::kAvx512;
+  }
+  Isa cap;
+  const char* env = std::getenv("ITLAB_AI_ISA");
+  if (env != nullptr && parse_isa(env, cap)) {
+    isa = std::min(isa, cap);
+  }
+  return isa;
+}
+
+}  // namespace
+
+const CpuFeatures& cpu_features() {
+  static const CpuFeatures kFeatures = detect();
+  return kFeatures;
+}
+
+Isa max_isa() {
+  static const Isa kMaxIsa = detect_max_isa();
+  return kMaxIsa;
+}
+
+bool isa_supported(Isa isa) { return isa <= max_isa(); }
+
+const char* isa_name(Isa isa) {
+  for (const auto& name : kIsaNames) {
+    if (name.second == isa) {
+      return name.first;
+    }
+  }
+  return "unknown";
+}
+
+bool parse_isa(const std::string& name, Isa& isa) {
+  auto found = std::find_if(
+      std::begin(kIsaNames), std::end(kIsaNames),
+      [&](const std::pair<const char*, Isa>& entry) {
+        return name == entry.first;
+      });
+  if (found == std::end(kIsaNames)) {
+    return false;
+  }
+  isa = found->second;
+  return true;
+}
+
+}  // namespace it_lab_ai
@@ -4,29 +4,42 @@
 #include <functional>
 #include <random>
 
+#include "layers/Layout.hpp"
+
 namespace it_lab_ai {
 
 void DropOutLayer::run(const Tensor &input, Tensor &output) {
+  output = input;
+  run_inplace(output);
+}
+
+void DropOutLayer::run_inplace(Tensor &tensor) {
+  if (drop_rate_ == 0.0) {
+    return;
+  }
+  if (is_nhwc(tensor)) {
+    Tensor nhwc = to_nhwc(tensor);
+    tensor = Tensor();
+    run_inplace(nhwc);
+    tensor = nhwc_view(nhwc);
+    return;
+  }
   const double lower_bound = 0;
   const double upper_bound = 100;
   std::uniform_real_distribution<double> unif(lower_bound, upper_bound);
   std::random_device rand_dev;
   std::mt19937 rand_engine(rand_dev());
-  switch (input.get_type()) {
+  switch (tensor.get_type()) {
     case Type::kInt: {
-      std::vector<int> vec = *input.as<int>();
-      for (int &i : vec) {
+      for (int &i : *tensor.as<int>()) {
         if (unif(rand_engine) < static_cast<float>(drop_rate_) * 100) i = 0;
       }
-      output = make_tensor(vec, input.get_shape());
       break;
     }
     case Type::kFloat: {
-      std::vector<float> vec = *input.as<float>();
-      for (float &i : vec) {
+      for (float &i : *tensor.as<float>()) {
         if (unif(rand_engine) < static_cast<float>(drop_rate_) * 100) i = 0;
       }
-      output = make_tensor(vec, input.get_shape());
       break;
     }
     default: {
@@ -1,18 +1,38 @@
 #include "layers/EWLayer.hpp"
 
+#include "layers/Layout.hpp"
+
 namespace it_lab_ai {
 
 void EWLayer::run(const Tensor &input, Tensor &output) {
+  if (activation_.empty()) {
+    throw std::invalid_argument("No such function for EWLayer");
+  }
+  if (is_nhwc(input)) {
+    Tensor nhwc;
+    run(to_nhwc(input), nhwc);
+    output = nhwc_view(nhwc);
+    return;
+  }
+  if (!input.is_contiguous()) {
+    run(input.contiguous(), output);
+    return;
+  }
   switch (input.get_type()) {
+    // values are read before they are written, so output may be input
     case Type::kInt: {
-      EWLayerImpl<int> used_impl(input.get_shape(), func_, alpha_, beta_);
-      output = make_tensor(used_impl.run(*input.as<int>()), input.get_shape());
+      const int *values = input.data<int>();
+      size_t count = input.get_shape().count();
+      AlignedVector<int> &res = output.reset<int>(input.get_shape());
+      std::transform(values, values + count, res.begin(),
+                     [this](int value) { return activation_(value); });
       break;
     }
     case Type::kFloat: {
-      EWLayerImpl<float> used_impl(input.get_shape(), func_, alpha_, beta_);
-      output =
-          make_tensor(used_impl.run(*input.as<float>()), input.get_shape());
+      const float *values = input.data<float>();
+      size_t count = input.get_shape().count();
+      activation_.apply(values, output.reset<float>(input.get_shape()).data(),
+                        count);
       break;
     }
     default: {
@@ -21,4 +41,36 @@ void EWLayer::run(const Tensor &input, Tensor &output) {
   }
 }
 
+void EWLayer::run_inplace(Tensor &tensor) {
+  if (activation_.empty()) {
+    throw std::invalid_argument("No such function for EWLayer");
+  }
+  if (is_nhwc(tensor)) {
+    // the view is dropped first, so the storage keeps a single owner
+    Tensor nhwc = to_nhwc(tensor);
+    tensor = Tensor();
+    run_inplace(nhwc);
+    tensor = nhwc_view(nhwc);
+    return;
+  }
+  switch (tensor.get_type()) {
+    case Type::kInt: {
+      for (int &value : *tensor.as<int>()) {
+        value = activation_(value);
+      }
+      break;
+    }
+    case Type::kFloat: {
+      float *values = tensor.data<float>();
+      activation_.apply(values, values, tensor.get_shape().count());
+      break;
+    }
+    default: {
+      throw std::runtime_error("No such type");
+    }
+  }
+}
+
+Activation EWLayer::fusable_activation() const { return activation_; }
+
 }  // namespace it_lab_ai
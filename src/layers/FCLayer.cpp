@@ -1,29 +1,274 @@
 #include "layers/FCLayer.hpp"
 
+#include "oneapi/tbb/parallel_for.h"
+
 namespace it_lab_ai {
 
+namespace {
+
+// lanes of the dot products of a single sample, enough independent sums
+// for the compiler to keep them in a vector register
+constexpr size_t kDotLanes = 8;
+
+float Dot(const float* a, const float* b, size_t count) {
+  float lanes[kDotLanes] = {};
+  size_t k = 0;
+  for (; k + kDotLanes <= count; k += kDotLanes) {
+    for (size_t l = 0; l < kDotLanes; ++l) {
+      lanes[l] += a[k + l] * b[k + l];
+    }
+  }
+  float sum = 0.0F;
+  for (; k < count; ++k) {
+    sum += a[k] * b[k];
+  }
+  for (float lane : lanes) {
+    sum += lane;
+  }
+  return sum;
+}
+
+// activation(weights * input + bias) with out x in weights of a 16-bit
+// type. Tasks take tiles of kGemmMc neurons x kGemmParallelNc samples and
+// widen the rows of their neurons into a float block the gemm reads from
+// cache, so the weights are read from memory in 16 bits
+template <typename Half>
+std::vector<float> RunCompressed(const AlignedVector<Half>& weights,
+                                 size_t out_size, size_t in_size,
+                                 const AlignedVector<float>& input,
+                                 const AlignedVector<float>& bias,
+                                 const Activation& activation) {
+  size_t batch = input.size() / in_size;
+  std::vector<float> output(batch * out_size);
+  size_t row_tiles = (out_size + kGemmMc - 1) / kGemmMc;
+  size_t col_tiles = (batch + kGemmParallelNc - 1) / kGemmParallelNc;
+  oneapi::tbb::parallel_for(size_t(0), row_tiles * col_tiles, [&](size_t t) {
+    size_t ic = t / col_tiles * kGemmMc;
+    size_t jc = t % col_tiles * kGemmParallelNc;
+    size_t rows = std::min(kGemmMc, out_size - ic);
+    size_t cols = std::min(kGemmParallelNc, batch - jc);
+    if (cols == 1) {
+      // a single sample reads every weight once, a row at a time
+      std::vector<float> row(in_size);
+      for (size_t i = 0; i < rows; ++i) {
+        convert(weights.data() + (ic + i) * in_size, row.data(), in_size);
+        float sum = Dot(row.data(), input.data() + jc * in_size, in_size);
+        output[jc * out_size + ic + i] = activation(sum + bias[ic + i]);
+      }
+      return;
+    }
+    AlignedVector<float> widened(rows * in_size);
+    convert(weights.data() + ic * in_size, widened.data(), rows * in_size);
+    // rows x cols of weights * input^T, stored back per sample
+    std::vector<float> tile(rows * cols);
+    auto epilogue = [&](size_t i, size_t, float value) {
+      return activation(value + bias[ic + i]);
+    };
+    gemm_blocked(rows, cols, in_size, widened.data(), in_size, size_t(1),
+                 static_cast<const float*>(nullptr), size_t(0), rows,
+                 input.data() + jc * in_size, size_t(1), in_size,
+                 tile.data(), cols, epilogue);
+    for (size_t p = 0; p < cols; ++p) {
+      for (size_t i = 0; i < rows; ++i) {
+        output[(jc + p) * out_size + ic + i] = tile[i * cols + p];
+      }
+    }
+  });
+  return output;
+}
+
+}  // namespace
+
+void FCLayer::prepare_impl() {
+  weights_shape_ = weights_.get_shape();
+  weights_type_ = weights_.get_type();
+  if (is_16bit_float(weights_.get_type())) {
+    if (weights_.get_shape().dims() != 2 || bias_.get_type() != Type::kFloat ||
+        bias_.get_shape().count() != weights_.get_shape()[0]) {
+      throw std::invalid_argument("Invalid weights shape");
+    }
+    return;
+  }
+  if (weights_.empty() || bias_.get_type() != weights_.get_type()) {
+    return;
+  }
+  switch (weights_.get_type()) {
+    case Type::kInt: {
+      int_impl_ = std::make_shared<const FCLayerImpl<int>>(
+          *weights_.as<int>(), weights_.get_shape(), *bias_.as<int>());
+      break;
+    }
+    case Type::kFloat: {
+      float_impl_ = std::make_shared<const FCLayerImpl<float>>(
+          *weights_.as<float>(), weights_.get_shape(), *bias_.as<float>());
+      break;
+    }
+    default: {
+      throw std::runtime_error("No such type");
+    }
+  }
+  // the impl holds the only copy
+  weights_ = Tensor();
+}
+
+bool FCLayer::start_calibration() {
+  if (weights_type_ != Type::kFloat || !float_impl_) {
+    return false;
+  }
+  calibrating_ = true;
+  input_range_ = ValueRange();
+  return true;
+}
+
+bool FCLayer::quantize() {
+  calibrating_ = false;
+  if (input_range_.empty() || !float_impl_) {
+    return false;
+  }
+  input_params_ = QuantParams::from_range(input_range_.min, input_range_.max);
+  std::vector<float> weights = float_impl_->get_weights();
+  int8_weights_ = std::make_shared<const QuantizedMatrix>(
+      QuantizedMatrix::quantize(weights.data(), weights_shape_[1],
+                                weights_shape_[0], 1, weights_shape_[1]));
+  return true;
+}
+
+// a multiply-add per output value and input of its sample
+uint64_t FCLayer::flops(const Shape& input, const Shape& output) const {
+  (void)input;
+  if (weights_shape_.dims() != 2) {
+    return 0;
+  }
+  return 2 * output.count() * weights_shape_[1];
+}
+
+size_t FCLayer::weight_bytes() const {
+  size_t bias = bias_.get_values().size();
+  if (int8_weights_) {
+    return int8_weights_->packed.size() + bias;
+  }
+  if (float_impl_) {
+    return float_impl_->weight_bytes() + bias;
+  }
+  if (int_impl_) {
+    return int_impl_->weight_bytes() + bias;
+  }
+  return weights_.get_values().size() + bias;
+}
+
+bool FCLayer::compress_weights(Type type) {
+  if (!is_16bit_float(type) || weights_type_ != Type::kFloat ||
+      !float_impl_ || calibrating_ || int8_weights_) {
+    return false;
+  }
+  weights_ = convert_precision(
+      make_tensor(float_impl_->get_weights(), weights_shape_), type);
+  weights_type_ = type;
+  float_impl_.reset();
+  return true;
+}
+
+#ifdef ENABLE_STATISTIC_WEIGHTS
+Tensor FCLayer::get_weights() {
+  if (float_impl_) {
+    return make_tensor(float_impl_->get_weights(), weights_shape_);
+  }
+  if (int_impl_) {
+    return make_tensor(int_impl_->get_weights(), weights_shape_);
+  }
+  return weights_;
+}
+#endif
+
+void FCLayer::run_compressed(const Tensor& input, Tensor& output) const {
+  if (input.get_type() != Type::kFloat) {
+    throw std::invalid_argument("16-bit weights take float inputs");
+  }
+  size_t out_size = weights_shape_[0];
+  size_t in_size = weights_shape_[1];
+  const AlignedVector<float>& values = *input.as<float>();
+  const AlignedVector<float>& bias = *bias_.as<float>();
+  std::vector<float> result =
+      weights_type_ == Type::kFloat16
+          ? RunCompressed(*weights_.as<Float16>(), out_size, in_size, values,
+                          bias, activation_)
+          : RunCompressed(*weights_.as<BFloat16>(), out_size, in_size,
+                          values, bias, activation_);
+  std::copy(result.begin(), result.end(),
+            output.reset<float>({result.size()}).begin());
+}
+
+// every sample is a row of A: batch x in times the in x out weights
+void FCLayer::run_int8(const Tensor& input, Tensor& output) const {
+  size_t in_size = weights_shape_[1];
+  size_t out_size = weights_shape_[0];
+  const AlignedVector<float>& values = *input.as<float>();
+  size_t batch = values.size() / in_size;
+  size_t lda = int8_padded_depth(in_size);
+  std::vector<uint8_t> rows(batch * lda, 0);
+  for (size_t p = 0; p < batch; ++p) {
+    for (size_t k = 0; k < in_size; ++k) {
+      rows[p * lda + k] = input_params_.quantize(values[p * in_size + k]);
+    }
+  }
+  std::vector<int32_t> sums(batch * out_size);
+  gemm_u8s8s32_parallel(batch, rows.data(), lda, *int8_weights_, sums.data(),
+                        out_size);
+  const AlignedVector<float>& bias = *bias_.as<float>();
+  AlignedVector<float>& result = output.reset<float>({batch * out_size});
+  for (size_t p = 0; p < batch; ++p) {
+    for (size_t i = 0; i < out_size; ++i) {
+      int32_t sum = sums[p * out_size + i] -
+                    input_params_.zero_point * int8_weights_->column_sums[i];
+      float scale = input_params_.scale * int8_weights_->scales[i];
+      result[p * out_size + i] =
+          activation_(scale * static_cast<float>(sum) + bias[i]);
+    }
+  }
+}
+
 void FCLayer::run(const Tensor& input, Tensor& output) {
-  if (input.get_type() != weights_.get_type()) {
+  // the output is written while the input is read
+  if (&input == &output) {
+    run(Tensor(input), output);
+    return;
+  }
+  if (is_16bit_float(weights_type_)) {
+    run_compressed(input, output);
+    return;
+  }
+  if (input.get_type() != weights_type_) {
     throw std::invalid_argument("Input and weights data type aren't same");
   }
-  if (bias_.get_type() != weights_.get_type()) {
+  if (bias_.get_type() != weights_type_) {
     throw std::invalid_argument("Bias and weights data type aren't same");
   }
   switch (input.get_type()) {
     case Type::kInt: {
-      FCLayerImpl<int> used_impl(*weights_.as<int>(), weights_.get_shape(),
-                                 *bias_.as<int>());
-      output = make_tensor(used_impl.run(*input.as<int>()),
-                           {(*input.as<int>()).size() /
-                            weights_.get_shape()[1] * weights_.get_shape()[0]});
+      if (!int_impl_) {
+        throw std::invalid_argument("Empty weights for FCLayer");
+      }
+      const AlignedVector<int>& values = *input.as<int>();
+      Shape shape(
+          {values.size() / weights_shape_[1] * weights_shape_[0]});
+      int_impl_->run(values, activation_, output.reset<int>(shape).data());
       break;
     }
     case Type::kFloat: {
-      FCLayerImpl<float> used_impl(*weights_.as<float>(), weights_.get_shape(),
-                                   *bias_.as<float>());
-      output = make_tensor(used_impl.run(*input.as<float>()),
-                           {(*input.as<float>()).size() /
-                            weights_.get_shape()[1] * weights_.get_shape()[0]});
+      if (!float_impl_) {
+        throw std::invalid_argument("Empty weights for FCLayer");
+      }
+      if (calibrating_) {
+        input_range_.update(input);
+      }
+      if (int8_weights_) {
+        run_int8(input, output);
+        break;
+      }
+      const AlignedVector<float>& values = *input.as<float>();
+      Shape shape(
+          {values.size() / weights_shape_[1] * weights_shape_[0]});
+      float_impl_->run(values, activation_, output.reset<float>(shape).data());
       break;
     }
     default: {
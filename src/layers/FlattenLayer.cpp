@@ -25,8 +25,7 @@ void FlattenLayer::run(const Tensor &input, Tensor &output) {
       if (input.get_shape().dims() == 4) {
         Flatten4D<int>(input, output, order_);
       } else {
-        output =
-            make_tensor(*input.as<int>(), Shape({input.get_shape().count()}));
+        output = input.reshape(Shape({input.get_shape().count()}));
       }
       break;
     }
@@ -34,8 +33,7 @@ void FlattenLayer::run(const Tensor &input, Tensor &output) {
       if (input.get_shape().dims() == 4) {
         Flatten4D<float>(input, output, order_);
       } else {
-        output =
-            make_tensor(*input.as<float>(), Shape({input.get_shape().count()}));
+        output = input.reshape(Shape({input.get_shape().count()}));
       }
       break;
     }
@@ -0,0 +1,67 @@
+#include "layers/Float16.hpp"
+
+#include "layers/CpuFeatures.hpp"
+
+namespace it_lab_ai {
+
+namespace {
+
+// F16C comes with AVX2 CPUs, ITLAB_AI_ISA below avx2 turns it off
+bool use_f16c() {
+  static const bool kUse =
+      cpu_features().f16c && isa_supported(Isa::kAvx2) &&
+      float16_to_float_f16c(nullptr, nullptr, 0);
+  return kUse;
+}
+
+bool use_avx512_bf16() {
+  static const bool kUse =
+      cpu_features().avx512bf16 && isa_supported(Isa::kAvx512) &&
+      bfloat16_to_float_avx512(nullptr, nullptr, 0);
+  return kUse;
+}
+
+}  // namespace
+
+void convert(const float* src, Float16* dst, size_t count) {
+  if (use_f16c()) {
+    float_to_float16_f16c(src, reinterpret_cast<uint16_t*>(dst), count);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = to_float16(src[i]);
+  }
+}
+
+void convert(const Float16* src, float* dst, size_t count) {
+  if (use_f16c()) {
+    float16_to_float_f16c(reinterpret_cast<const uint16_t*>(src), dst, count);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = to_float(src[i]);
+  }
+}
+
+void convert(const float* src, BFloat16* dst, size_t count) {
+  if (use_avx512_bf16()) {
+    float_to_bfloat16_avx512(src, reinterpret_cast<uint16_t*>(dst), count);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = to_bfloat16(src[i]);
+  }
+}
+
+void convert(const BFloat16* src, float* dst, size_t count) {
+  if (use_avx512_bf16()) {
+    bfloat16_to_float_avx512(reinterpret_cast<const uint16_t*>(src), dst,
+                             count);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    dst[i] = to_float(src[i]);
+  }
+}
+
+}  // namespace it_lab_ai
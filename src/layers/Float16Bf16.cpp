@@ -0,0 +1,81 @@
+#include "layers/Float16.hpp"
+
+#include <cstring>
+
+#if defined(__AVX512F__) && defined(__AVX512BF16__)
+#include <immintrin.h>
+#endif
+
+namespace it_lab_ai {
+
+#if defined(__AVX512F__) && defined(__AVX512BF16__)
+
+namespace {
+
+constexpr size_t kLanes = 16;
+
+__m256i narrow(__m512 values) {
+  __m256bh result = _mm512_cvtneps_pbh(values);
+  __m256i bits;
+  std::memcpy(&bits, &result, sizeof(bits));
+  return bits;
+}
+
+// bfloat16 is the upper half of the float. The zero-masking forms keep GCC
+// from warning about the undefined sources of the plain ones
+__m512 widen(__m256i bits) {
+  const __mmask16 all = 0xffff;
+  return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(
+      all, _mm512_maskz_cvtepu16_epi32(all, bits), 16));
+}
+
+}  // namespace
+
+// the tail goes through a zeroed block of a full register
+bool float_to_bfloat16_avx512(const float* src, uint16_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        narrow(_mm512_loadu_ps(src + i)));
+  }
+  if (i < count) {
+    float block[kLanes] = {};
+    uint16_t result[kLanes];
+    std::memcpy(block, src + i, (count - i) * sizeof(float));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(result),
+                        narrow(_mm512_loadu_ps(block)));
+    std::memcpy(dst + i, result, (count - i) * sizeof(uint16_t));
+  }
+  return true;
+}
+
+bool bfloat16_to_float_avx512(const uint16_t* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    _mm512_storeu_ps(dst + i, widen(_mm256_loadu_si256(
+                                  reinterpret_cast<const __m256i*>(src + i))));
+  }
+  if (i < count) {
+    uint16_t block[kLanes] = {};
+    float result[kLanes];
+    std::memcpy(block, src + i, (count - i) * sizeof(uint16_t));
+    _mm512_storeu_ps(result, widen(_mm256_loadu_si256(
+                                 reinterpret_cast<const __m256i*>(block))));
+    std::memcpy(dst + i, result, (count - i) * sizeof(float));
+  }
+  return true;
+}
+
+#else
+
+bool float_to_bfloat16_avx512(const float*, uint16_t*, size_t) {
+  return false;
+}
+
+bool bfloat16_to_float_avx512(const uint16_t*, float*, size_t) {
+  return false;
+}
+
+#endif
+
+}  // namespace it_lab_ai
@@ -0,0 +1,70 @@
+#include "layers/Float16.hpp"
+
+#include <cstring>
+
+// MSVC has no __F16C__, its /arch:AVX2 implies F16C
+#if (defined(__F16C__) && defined(__AVX__)) || \
+    (defined(_MSC_VER) && defined(__AVX2__))
+#define ITLAB_AI_F16C
+#endif
+
+#ifdef ITLAB_AI_F16C
+#include <immintrin.h>
+#endif
+
+namespace it_lab_ai {
+
+#ifdef ITLAB_AI_F16C
+
+namespace {
+
+constexpr size_t kLanes = 8;
+
+}  // namespace
+
+// the tail goes through a zeroed block of a full register
+bool float_to_float16_f16c(const float* src, uint16_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                   _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), half);
+  }
+  if (i < count) {
+    float block[kLanes] = {};
+    uint16_t result[kLanes];
+    std::memcpy(block, src + i, (count - i) * sizeof(float));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(result),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(block),
+                                     _MM_FROUND_TO_NEAREST_INT));
+    std::memcpy(dst + i, result, (count - i) * sizeof(uint16_t));
+  }
+  return true;
+}
+
+bool float16_to_float_f16c(const uint16_t* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + kLanes <= count; i += kLanes) {
+    __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+  }
+  if (i < count) {
+    uint16_t block[kLanes] = {};
+    float result[kLanes];
+    std::memcpy(block, src + i, (count - i) * sizeof(uint16_t));
+    _mm256_storeu_ps(result, _mm256_cvtph_ps(_mm_loadu_si128(
+                                 reinterpret_cast<const __m128i*>(block))));
+    std::memcpy(dst + i, result, (count - i) * sizeof(float));
+  }
+  return true;
+}
+
+#else
+
+bool float_to_float16_f16c(const float*, uint16_t*, size_t) { return false; }
+
+bool float16_to_float_f16c(const uint16_t*, float*, size_t) { return false; }
+
+#endif
+
+}  // namespace it_lab_ai
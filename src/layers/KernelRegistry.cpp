@@ -0,0 +1,76 @@
+#include "layers/KernelRegistry.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+namespace it_lab_ai {
+
+KernelRegistry::KernelRegistry() {
+  const char* preferred = std::getenv("ITLAB_AI_IMPL");
+  if (preferred != nullptr) {
+    preferred_ = preferred;
+  }
+  // Winograd only fits 3x3 stride 1 float kernels, the gemm based im2col
+  // beats the direct loops everywhere else. The threaded direct loops of
+  // kSTL come last: only tuning or ITLAB_AI_IMPL=stl picks them
+  add({kConvolution, Type::kFloat, Isa::kScalar, kWinograd, "winograd"});
+  add({kConvolution, Type::kFloat, Isa::kScalar, kIm2col, "im2col"});
+  add({kConvolution, Type::kFloat, Isa::kScalar, kDefault, "default"});
+  add({kConvolution, Type::kFloat, Isa::kScalar, kSTL, "stl"});
+  add({kConvolution, Type::kInt, Isa::kScalar, kIm2col, "im2col"});
+  add({kConvolution, Type::kInt, Isa::kScalar, kDefault, "default"});
+  add({kConvolution, Type::kInt, Isa::kScalar, kSTL, "stl"});
+  for (Type type : {Type::kFloat, Type::kInt}) {
+    add({kPooling, type, Isa::kScalar, kTBB, "tbb", true});
+    add({kPooling, type, Isa::kScalar, kDefault, "default"});
+  }
+  // kernels of Activation::apply
+  add({kElementWise, Type::kFloat, Isa::kAvx512, kDefault, "avx512"});
+  add({kElementWise, Type::kFloat, Isa::kAvx2, kDefault, "avx2"});
+  add({kElementWise, Type::kFloat, Isa::kScalar, kDefault, "scalar"});
+}
+
+KernelRegistry& KernelRegistry::instance() {
+  static KernelRegistry registry;
+  return registry;
+}
+
+void KernelRegistry::add(const KernelEntry& entry) {
+  entries_.push_back(entry);
+}
+
+std::vector<KernelEntry> KernelRegistry::candidates(LayerType layer,
+                                                    Type type) const {
+  bool multicore = std::thread::hardware_concurrency() > 1;
+  std::vector<KernelEntry> res;
+  for (const KernelEntry& entry : entries_) {
+    if (entry.layer == layer && entry.type == type &&
+        isa_supported(entry.isa) && (multicore || !entry.multithreaded)) {
+      res.push_back(entry);
+    }
+  }
+  std::stable_sort(res.begin(), res.end(),
+                   [this](const KernelEntry& a, const KernelEntry& b) {
+                     bool a_preferred = preferred_ == a.name;
+                     bool b_preferred = preferred_ == b.name;
+                     if (a_preferred != b_preferred) {
+                       return a_preferred;
+                     }
+                     return a.isa > b.isa;
+                   });
+  return res;
+}
+
+ImplType KernelRegistry::select(LayerType layer, Type type,
+                                const std::function<bool(ImplType)>& fits,
+                                ImplType fallback) const {
+  for (const KernelEntry& entry : candidates(layer, type)) {
+    if (!fits || fits(entry.impl)) {
+      return entry.impl;
+    }
+  }
+  return fallback;
+}
+
+}  // namespace it_lab_ai
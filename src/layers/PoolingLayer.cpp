@@ -1,11 +1,49 @@
 #include "layers/PoolingLayer.hpp"
 
+#include "layers/Layout.hpp"
+
 namespace it_lab_ai {
 
+namespace {
+
+template <typename ValueType>
+Tensor RunPoolingNHWC(const Tensor& input, const Shape& pooling_shape,
+                      const std::string& pooling_type) {
+  PoolingLayerImpl<ValueType> used_impl(input.get_shape(), pooling_shape,
+                                        pooling_type);
+  const Shape& out = used_impl.get_output_shape();
+  const Tensor nhwc = to_nhwc(input);
+  return nhwc_view(make_tensor(used_impl.run_nhwc(*nhwc.as<ValueType>()),
+                               Shape({out[0], out[2], out[3], out[1]})));
+}
+
+}  // namespace
+
 void PoolingLayer::run(const Tensor& input, Tensor& output) {
+  if (data_layout_ == kNhwc && input.get_shape().dims() == 4 &&
+      poolingShape_.dims() == 2) {
+    switch (input.get_type()) {
+      case Type::kInt:
+        output = RunPoolingNHWC<int>(input, poolingShape_, poolingType_);
+        return;
+      case Type::kFloat:
+        output = RunPoolingNHWC<float>(input, poolingShape_, poolingType_);
+        return;
+      default:
+        throw std::runtime_error("No such type");
+    }
+  }
+  if (!input.is_contiguous()) {
+    run(input.contiguous(), output);
+    return;
+  }
+  ImplType impl = implType_;
+  if (impl == kAuto) {
+    impl = KernelRegistry::instance().select(kPooling, input.get_type());
+  }
   switch (input.get_type()) {
     case Type::kInt: {
-      switch (implType_) {
+      switch (impl) {
         case kTBB: {
           PoolingLayerImplTBB<int> used_impl(input.get_shape(), poolingShape_,
                                              poolingType_);
@@ -24,7 +62,7 @@ void PoolingLayer::run(const Tensor& input, Tensor& output) {
       break;
     }
     case Type::kFloat: {
-      switch (implType_) {
+      switch (impl) {
         case kTBB: {
           PoolingLayerImplTBB<float> used_impl(input.get_shape(), poolingShape_,
                                                poolingType_);
@@ -0,0 +1,176 @@
+#include "layers/Quantization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "oneapi/tbb/parallel_for.h"
+
+namespace it_lab_ai {
+
+namespace {
+
+// rows of A per TBB task of gemm_u8s8s32_parallel
+constexpr size_t kInt8ParallelRows = 64;
+
+void gemm_u8s8s32_scalar(size_t m, const uint8_t* a, size_t lda,
+                         const QuantizedMatrix& b, int32_t* c, size_t ldc) {
+  size_t groups = int8_padded_depth(b.depth) / 4;
+  size_t panels = (b.cols + kInt8PanelWidth - 1) / kInt8PanelWidth;
+  for (size_t p = 0; p < panels; ++p) {
+    const int8_t* panel = b.packed.data() + p * groups * kInt8PanelWidth * 4;
+    size_t width = std::min(kInt8PanelWidth, b.cols - p * kInt8PanelWidth);
+    for (size_t i = 0; i < m; ++i) {
+      const uint8_t* row = a + i * lda;
+      int32_t acc[kInt8PanelWidth] = {};
+      for (size_t g = 0; g < groups; ++g) {
+        const int8_t* taps = panel + g * kInt8PanelWidth * 4;
+        for (size_t j = 0; j < kInt8PanelWidth; ++j) {
+          for (size_t r = 0; r < 4; ++r) {
+            acc[j] += static_cast<int32_t>(row[g * 4 + r]) *
+                      static_cast<int32_t>(taps[j * 4 + r]);
+          }
+        }
+      }
+      std::copy(acc, acc + width, c + i * ldc + p * kInt8PanelWidth);
+    }
+  }
+}
+
+}  // namespace
+
+QuantParams QuantParams::from_range(float min, float max) {
+  min = std::min(min, 0.0F);
+  max = std::max(max, 0.0F);
+  QuantParams params;
+  if (max > min) {
+    params.scale = (max - min) / 255.0F;
+    params.zero_point = static_cast<int32_t>(
+        std::min(255.0F, std::max(0.0F, std::round(-min / params.scale))));
+  }
+  return params;
+}
+
+uint8_t QuantParams::quantize(float value) const {
+  float q = std::round(value / scale) + static_cast<float>(zero_point);
+  return static_cast<uint8_t>(std::min(255.0F, std::max(0.0F, q)));
+}
+
+void ValueRange::update(const float* values, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    min = std::min(min, values[i]);
+    max = std::max(max, values[i]);
+  }
+}
+
+void ValueRange::update(const Tensor& tensor) {
+  if (tensor.get_type() != Type::kFloat) {
+    throw std::invalid_argument("Only float values are calibrated");
+  }
+  // a permuted view holds the same values as its storage
+  const Tensor values = tensor.contiguous();
+  update(values.as<float>()->data(), values.get_shape().count());
+}
+
+Tensor quantize(const Tensor& input, const QuantParams& params) {
+  if (input.get_type() != Type::kFloat) {
+    throw std::invalid_argument("Only float tensors are quantized");
+  }
+  const Tensor values = input.contiguous();
+  const AlignedVector<float>& source = *values.as<float>();
+  std::vector<uint8_t> result(source.size());
+  for (size_t i = 0; i < source.size(); ++i) {
+    result[i] = params.quantize(source[i]);
+  }
+  return make_tensor(result, input.get_shape());
+}
+
+Tensor dequantize(const Tensor& input, const QuantParams& params) {
+  if (input.get_type() != Type::kUInt8) {
+    throw std::invalid_argument("Only uint8 tensors are dequantized");
+  }
+  const Tensor values = input.contiguous();
+  const AlignedVector<uint8_t>& source = *values.as<uint8_t>();
+  std::vector<float> result(source.size());
+  for (size_t i = 0; i < source.size(); ++i) {
+    result[i] = params.dequantize(source[i]);
+  }
+  return make_tensor(result, input.get_shape());
+}
+
+QuantizedMatrix QuantizedMatrix::quantize(const float* values, size_t depth,
+                                          size_t cols, size_t k_stride,
+                                          size_t n_stride) {
+  QuantizedMatrix b;
+  b.depth = depth;
+  b.cols = cols;
+  b.scales.assign(cols, 1.0F);
+  b.column_sums.assign(cols, 0);
+  size_t groups = int8_padded_depth(depth) / 4;
+  size_t panels = (cols + kInt8PanelWidth - 1) / kInt8PanelWidth;
+  b.packed.assign(panels * groups * kInt8PanelWidth * 4, 0);
+  for (size_t n = 0; n < cols; ++n) {
+    float amax = 0.0F;
+    for (size_t k = 0; k < depth; ++k) {
+      amax = std::max(amax, std::fabs(values[k * k_stride + n * n_stride]));
+    }
+    if (amax > 0.0F) {
+      b.scales[n] = amax / 127.0F;
+    }
+    size_t p = n / kInt8PanelWidth;
+    size_t j = n % kInt8PanelWidth;
+    for (size_t k = 0; k < depth; ++k) {
+      float q = std::round(values[k * k_stride + n * n_stride] / b.scales[n]);
+      auto value = static_cast<int8_t>(std::min(127.0F, std::max(-127.0F, q)));
+      b.packed[((p * groups + k / 4) * kInt8PanelWidth + j) * 4 + k % 4] =
+          value;
+      b.column_sums[n] += value;
+    }
+  }
+  return b;
+}
+
+Isa int8_gemm_isa() {
+  static const Isa kIsa = [] {
+    bool vnni = cpu_features().avx512vnni && isa_supported(Isa::kAvx512) &&
+                gemm_u8s8s32_vnni(0, nullptr, 0, 0, 0, nullptr, nullptr, 0);
+    return vnni ? Isa::kAvx512 : Isa::kScalar;
+  }();
+  return kIsa;
+}
+
+bool gemm_u8s8s32(Isa isa, size_t m, const uint8_t* a, size_t lda,
+                  const QuantizedMatrix& b, int32_t* c, size_t ldc) {
+  if (lda < int8_padded_depth(b.depth)) {
+    throw std::invalid_argument("Rows of A must hold the padded depth");
+  }
+  switch (isa) {
+    case Isa::kScalar:
+      gemm_u8s8s32_scalar(m, a, lda, b, c, ldc);
+      return true;
+    case Isa::kAvx512:
+      return int8_gemm_isa() == Isa::kAvx512 &&
+             gemm_u8s8s32_vnni(m, a, lda, b.depth, b.cols, b.packed.data(), c,
+                               ldc);
+    default:
+      return false;
+  }
+}
+
+void gemm_u8s8s32(size_t m, const uint8_t* a, size_t lda,
+                  const QuantizedMatrix& b, int32_t* c, size_t ldc) {
+  gemm_u8s8s32(int8_gemm_isa(), m, a, lda, b, c, ldc);
+}
+
+void gemm_u8s8s32_parallel(size_t m, const uint8_t* a, size_t lda,
+                           const QuantizedMatrix& b, int32_t* c,
+                           size_t ldc) {
+  oneapi::tbb::parallel_for(
+      oneapi::tbb::blocked_range<size_t>(0, m, kInt8ParallelRows),
+      [&](const oneapi::tbb::blocked_range<size_t>& range) {
+        gemm_u8s8s32(range.size(), a + range.begin() * lda, lda, b,
+                     c + range.begin() * ldc, ldc);
+      });
+}
+
+}  // namespace it_lab_ai
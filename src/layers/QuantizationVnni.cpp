@@ -0,0 +1,82 @@
+#include "layers/Quantization.hpp"
+
+#include <cstring>
+
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+#include <immintrin.h>
+#endif
+
+namespace it_lab_ai {
+
+#if defined(__AVX512F__) && defined(__AVX512VNNI__)
+
+namespace {
+
+constexpr size_t kPanel = 16;
+constexpr size_t kGroupBytes = kPanel * 4;
+
+__m512i broadcast4(const uint8_t* values) {
+  int32_t word;
+  std::memcpy(&word, values, sizeof(word));
+  return _mm512_set1_epi32(word);
+}
+
+}  // namespace
+
+// rows of A in fours against one panel at a time, so the panel stays in
+// L1 while the rows stream by. vpdpbusd multiplies 4 uint8 of a row by 4
+// int8 of each of the 16 columns and adds them to their int32 sums
+bool gemm_u8s8s32_vnni(size_t m, const uint8_t* a, size_t lda, size_t depth,
+                       size_t cols, const int8_t* packed, int32_t* c,
+                       size_t ldc) {
+  size_t groups = (depth + 3) / 4;
+  size_t panels = (cols + kPanel - 1) / kPanel;
+  for (size_t p = 0; p < panels; ++p) {
+    const int8_t* panel = packed + p * groups * kGroupBytes;
+    size_t width = cols - p * kPanel < kPanel ? cols - p * kPanel : kPanel;
+    auto mask = static_cast<__mmask16>((1U << width) - 1);
+    int32_t* out = c + p * kPanel;
+    size_t i = 0;
+    for (; i + 4 <= m; i += 4) {
+      const uint8_t* row = a + i * lda;
+      __m512i acc0 = _mm512_setzero_si512();
+      __m512i acc1 = _mm512_setzero_si512();
+      __m512i acc2 = _mm512_setzero_si512();
+      __m512i acc3 = _mm512_setzero_si512();
+      for (size_t g = 0; g < groups; ++g) {
+        __m512i taps = _mm512_loadu_si512(panel + g * kGroupBytes);
+        acc0 = _mm512_dpbusd_epi32(acc0, broadcast4(row + g * 4), taps);
+        acc1 = _mm512_dpbusd_epi32(acc1, broadcast4(row + lda + g * 4), taps);
+        acc2 =
+            _mm512_dpbusd_epi32(acc2, broadcast4(row + 2 * lda + g * 4), taps);
+        acc3 =
+            _mm512_dpbusd_epi32(acc3, broadcast4(row + 3 * lda + g * 4), taps);
+      }
+      _mm512_mask_storeu_epi32(out + i * ldc, mask, acc0);
+      _mm512_mask_storeu_epi32(out + (i + 1) * ldc, mask, acc1);
+      _mm512_mask_storeu_epi32(out + (i + 2) * ldc, mask, acc2);
+      _mm512_mask_storeu_epi32(out + (i + 3) * ldc, mask, acc3);
+    }
+    for (; i < m; ++i) {
+      const uint8_t* row = a + i * lda;
+      __m512i acc = _mm512_setzero_si512();
+      for (size_t g = 0; g < groups; ++g) {
+        acc = _mm512_dpbusd_epi32(acc, broadcast4(row + g * 4),
+                                  _mm512_loadu_si512(panel + g * kGroupBytes));
+      }
+      _mm512_mask_storeu_epi32(out + i * ldc, mask, acc);
+    }
+  }
+  return true;
+}
+
+#else
+
+bool gemm_u8s8s32_vnni(size_t, const uint8_t*, size_t, size_t, size_t,
+                       const int8_t*, int32_t*, size_t) {
+  return false;
+}
+
+#endif
+
+}  // namespace it_lab_ai
@@ -7,15 +7,14 @@ size_t Shape::get_index(const std::vector<size_t>& coords) const {
     throw std::invalid_argument("Invalid index vector");
   }
   size_t res = 0;
-  size_t mulbuf;
-  for (size_t i = 0; i < coords.size(); i++) {
-    // to get to the i line
-    mulbuf = std::accumulate(dims_.begin() + (i + 1), dims_.end(), size_t(1),
-                             std::multiplies<>());
+  // stride of the i line, accumulated from the innermost dimension
+  size_t stride = 1;
+  for (size_t i = coords.size(); i-- > 0;) {
     if (coords[i] >= dims_[i]) {
       throw std::out_of_range("Out of range");
     }
-    res += coords[i] * mulbuf;
+    res += coords[i] * stride;
+    stride *= dims_[i];
   }
   return res;
 }
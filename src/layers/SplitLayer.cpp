@@ -1,31 +1,33 @@
 #include "layers/SplitLayer.hpp"
 
 #include <algorithm>
-#include <cstring>
 
 namespace it_lab_ai {
 
 void SplitLayer::run(const Tensor& input, Tensor& output) { output = input; }
 
 void SplitLayer::run(const Tensor& input, std::vector<Tensor>& outputs) {
-  validate(input);
+  std::vector<TensorView> views = split_views(input);
+  outputs.clear();
+  outputs.reserve(views.size());
+  for (const TensorView& view : views) {
+    outputs.push_back(view.to_tensor());
+  }
+}
 
-  switch (input.get_type()) {
-    case Type::kFloat:
-      split_impl<float>(input, outputs);
-      break;
-    case Type::kInt:
-      split_impl<int>(input, outputs);
-      break;
-    default:
-      throw std::runtime_error("Unsupported tensor data type");
+void SplitLayer::run_multi(const std::vector<Tensor>& inputs,
+                           std::vector<Tensor>& outputs) {
+  if (inputs.size() != 1) {
+    throw std::runtime_error("SplitLayer expects exactly one input");
   }
+  run(inputs[0], outputs);
 }
 
-template <typename T>
-void SplitLayer::split_impl(const Tensor& input,
-                            std::vector<Tensor>& outputs) const {
-  const auto& input_data = *input.as<T>();
+std::vector<TensorView> SplitLayer::split_views(const Tensor& input) const {
+  validate(input);
+  if (input.get_type() != Type::kFloat && input.get_type() != Type::kInt) {
+    throw std::runtime_error("Unsupported tensor data type");
+  }
   const Shape& shape = input.get_shape();
   const int axis = get_normalized_axis(static_cast<int>(shape.dims()));
 
@@ -43,47 +45,16 @@ void SplitLayer::split_impl(const Tensor& input,
     }
   }
 
-  size_t outer_size = 1;
-  for (int i = 0; i < axis; ++i) {
-    outer_size *= shape[i];
-  }
-
-  size_t inner_size = 1;
-  for (size_t i = axis + 1; i < shape.dims(); ++i) {
-    inner_size *= shape[i];
-  }
-
-  const size_t input_axis_stride = shape[axis] * inner_size;
-
-  outputs.clear();
-  outputs.reserve(part_sizes.size());
-
+  TensorView whole = input.view();
+  std::vector<TensorView> views;
+  views.reserve(part_sizes.size());
   size_t input_offset = 0;
   for (const auto part_size : part_sizes) {
-    const auto output_axis_size = static_cast<size_t>(part_size);
-
-    std::vector<size_t> output_shape_vec(shape.dims());
-    for (size_t i = 0; i < shape.dims(); ++i) {
-      output_shape_vec[i] =
-          (static_cast<int>(i) == axis) ? output_axis_size : shape[i];
-    }
-    Shape output_shape(output_shape_vec);
-
-    outputs.emplace_back(output_shape, input.get_type());
-    auto& output_data = *outputs.back().as<T>();
-
-    const size_t output_part_size = output_axis_size * inner_size;
-
-    for (size_t outer = 0; outer < outer_size; ++outer) {
-      const T* input_start =
-          &input_data[outer * input_axis_stride + input_offset * inner_size];
-      T* output_start = &output_data[outer * output_part_size];
-
-      std::copy_n(input_start, output_part_size, output_start);
-    }
-
-    input_offset += output_axis_size;
+    views.push_back(whole.narrow(static_cast<size_t>(axis), input_offset,
+                                 static_cast<size_t>(part_size)));
+    input_offset += static_cast<size_t>(part_size);
   }
+  return views;
 }
 
 void SplitLayer::validate(const Tensor& input) const {
@@ -123,9 +94,4 @@ int SplitLayer::get_normalized_axis(int rank) const {
   return (axis_ < 0) ? axis_ + rank : axis_;
 }
 
-template void SplitLayer::split_impl<float>(const Tensor&,
-                                            std::vector<Tensor>&) const;
-template void SplitLayer::split_impl<int>(const Tensor&,
-                                          std::vector<Tensor>&) const;
-
 }  // namespace it_lab_ai
\ No newline at end of file
@@ -1,14 +1,78 @@
 #include "layers/Tensor.hpp"
 
+#include "layers/TensorView.hpp"
+
 namespace it_lab_ai {
 
-std::ostream& operator<<(std::ostream& out, const Tensor& t) {
+TensorStorage& Tensor::reset(const Shape& shape, Type type) {
+  if (type == Type::kUnknown) {
+    throw std::invalid_argument("Unknown data type");
+  }
+  shape_ = shape;
+  strides_ = shape.strides();
+  bias_.clear();
+  type_ = type;
+  if (!values_ || values_.use_count() > 1) {
+    values_ = std::make_shared<TensorStorage>();
+  }
+  values_->resize(ByteSize());
+  return *values_;
+}
+
+Tensor Tensor::reshape(const Shape& sh) const {
+  if (sh.count() != shape_.count()) {
+    throw std::invalid_argument("Reshape can't change the element count");
+  }
+  Tensor res = contiguous();
+  res.shape_ = sh;
+  res.strides_ = sh.strides();
+  return res;
+}
+
+Tensor Tensor::permute(const std::vector<size_t>& perm) const {
+  if (perm.size() != shape_.dims()) {
+    throw std::invalid_argument("Permutation size must match tensor dims");
+  }
+  std::vector<bool> used(perm.size(), false);
+  Tensor res(*this);
+  for (size_t i = 0; i < perm.size(); i++) {
+    if (perm[i] >= perm.size() || used[perm[i]]) {
+      throw std::invalid_argument("Invalid permutation");
+    }
+    used[perm[i]] = true;
+    res.shape_[i] = shape_[perm[i]];
+    res.strides_[i] = strides_[perm[i]];
+  }
+  return res;
+}
+
+Tensor Tensor::contiguous() const {
+  if (is_contiguous()) {
+    return *this;
+  }
+  Tensor res = view().to_tensor();
+  res.bias_ = bias_;
+  return res;
+}
+
+TensorView Tensor::view() const { return TensorView(*this); }
+
+std::ostream& operator<<(std::ostream& out, const Tensor& tensor) {
+  const Tensor t = tensor.contiguous();
   for (size_t i = 0; i < t.get_shape().count(); i++) {
     out.width(5);
     if (t.get_type() == Type::kInt) {
       out << (*t.as<int>())[i] << " ";
     } else if (t.get_type() == Type::kFloat) {
       out << (*t.as<float>())[i] << " ";
+    } else if (t.get_type() == Type::kInt8) {
+      out << static_cast<int>((*t.as<int8_t>())[i]) << " ";
+    } else if (t.get_type() == Type::kUInt8) {
+      out << static_cast<int>((*t.as<uint8_t>())[i]) << " ";
+    } else if (t.get_type() == Type::kFloat16) {
+      out << to_float((*t.as<Float16>())[i]) << " ";
+    } else if (t.get_type() == Type::kBFloat16) {
+      out << to_float((*t.as<BFloat16>())[i]) << " ";
     }
     if (t.get_shape().dims() > 1) {
       if ((i + 1) % t.get_shape()[1] == 0) out << std::endl;
@@ -17,4 +81,36 @@ std::ostream& operator<<(std::ostream& out, const Tensor& t) {
   return out;
 }
 
+namespace {
+
+template <typename From, typename To>
+Tensor ConvertValues(const Tensor& input) {
+  const Tensor values = input.contiguous();
+  const AlignedVector<From>& source = *values.as<From>();
+  std::vector<To> result(source.size());
+  convert(source.data(), result.data(), source.size());
+  return make_tensor(result, input.get_shape());
+}
+
+}  // namespace
+
+Tensor convert_precision(const Tensor& input, Type type) {
+  if (input.get_type() == type) {
+    return input;
+  }
+  if (input.get_type() == Type::kFloat && type == Type::kFloat16) {
+    return ConvertValues<float, Float16>(input);
+  }
+  if (input.get_type() == Type::kFloat && type == Type::kBFloat16) {
+    return ConvertValues<float, BFloat16>(input);
+  }
+  if (input.get_type() == Type::kFloat16 && type == Type::kFloat) {
+    return ConvertValues<Float16, float>(input);
+  }
+  if (input.get_type() == Type::kBFloat16 && type == Type::kFloat) {
+    return ConvertValues<BFloat16, float>(input);
+  }
+  throw std::invalid_argument("Only float values change precision");
+}
+
 }  // namespace it_lab_ai
@@ -0,0 +1,117 @@
+#include "layers/TensorView.hpp"
+
+#include <cstring>
+
+namespace it_lab_ai {
+
+TensorView::TensorView(const Tensor& t)
+    : values_(t.values_),
+      shape_(t.shape_),
+      strides_(t.strides_),
+      type_(t.type_) {}
+
+size_t TensorView::element_size() const {
+  switch (type_) {
+    case Type::kInt:
+      return sizeof(int);
+    case Type::kFloat:
+      return sizeof(float);
+    case Type::kInt8:
+    case Type::kUInt8:
+      return 1;
+    case Type::kFloat16:
+    case Type::kBFloat16:
+      return 2;
+    default:
+      throw std::runtime_error("No such type");
+  }
+}
+
+bool TensorView::is_contiguous() const {
+  size_t stride = 1;
+  for (size_t i = shape_.dims(); i-- > 0;) {
+    if (shape_[i] != 1 && strides_[i] != stride) {
+      return false;
+    }
+    stride *= shape_[i];
+  }
+  return true;
+}
+
+TensorView TensorView::narrow(size_t axis, size_t begin,
+                              size_t length) const {
+  if (axis >= shape_.dims()) {
+    throw std::out_of_range("Invalid axis");
+  }
+  if (begin > shape_[axis] || length > shape_[axis] - begin) {
+    throw std::out_of_range("Invalid slice");
+  }
+  TensorView res(*this);
+  res.offset_ += begin * strides_[axis];
+  res.shape_[axis] = length;
+  return res;
+}
+
+TensorView TensorView::reshape(const Shape& sh) const {
+  if (sh.count() != shape_.count()) {
+    throw std::invalid_argument("Reshape can't change the element count");
+  }
+  if (!is_contiguous()) {
+    throw std::invalid_argument("Reshape of a non-contiguous view");
+  }
+  TensorView res(*this);
+  res.shape_ = sh;
+  res.strides_ = sh.strides();
+  return res;
+}
+
+Tensor TensorView::to_tensor() const {
+  if (type_ == Type::kUnknown || !values_) {
+    return Tensor();
+  }
+  size_t elem = element_size();
+  size_t count = shape_.count();
+  Tensor res;
+  res.shape_ = shape_;
+  res.strides_ = shape_.strides();
+  res.type_ = type_;
+  bool contiguous = is_contiguous();
+  if (contiguous && offset_ == 0 && values_->size() == count * elem) {
+    res.values_ = values_;
+    return res;
+  }
+  auto values = std::make_shared<TensorStorage>(count * elem);
+  if (contiguous) {
+    std::memcpy(values->data(), values_->data() + offset_ * elem,
+                count * elem);
+    res.values_ = std::move(values);
+    return res;
+  }
+  // copy the longest row-major tail of the view with one memcpy per block
+  size_t inner_dims = 0;
+  size_t block = 1;
+  for (size_t i = shape_.dims(); i-- > 0 && strides_[i] == block;) {
+    block *= shape_[i];
+    inner_dims++;
+  }
+  size_t outer_dims = shape_.dims() - inner_dims;
+  std::vector<size_t> coords(outer_dims, 0);
+  for (size_t i = 0; i < count; i += block) {
+    size_t index = offset_;
+    for (size_t d = 0; d < outer_dims; d++) {
+      index += coords[d] * strides_[d];
+    }
+    std::memcpy(values->data() + i * elem, values_->data() + index * elem,
+                block * elem);
+    for (size_t d = outer_dims; d-- > 0;) {
+      if (++coords[d] < shape_[d]) {
+        break;
+      }
+      coords[d] = 0;
+    }
+  }
+  res.values_ = std::move(values);
+  return res;
+}
+
+}  // namespace it_lab_ai
@@ -16,6 +16,18 @@ void TransposeLayer::run(const Tensor& input, Tensor& output) {
 
   validate_perm(shape, perm);
 
+  if (lazy_ || !input.is_contiguous()) {
+    if (input.empty()) {
+      throw std::runtime_error("Input tensor is empty or invalid");
+    }
+    std::vector<size_t> axes(perm.begin(), perm.end());
+    output = input.permute(axes);
+    if (!lazy_) {
+      output = output.contiguous();
+    }
+    return;
+  }
+
   switch (input.get_type()) {
     case Type::kFloat:
       transpose_impl<float>(input, output, perm);
@@ -1 +1,138 @@
 #include "perf/benchmarking.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace it_lab_ai {
+
+namespace {
+
+// flush_cache stores its sum so the reads are not optimized away
+volatile unsigned char flush_sink = 0;
+
+}  // namespace
+
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    throw std::invalid_argument("No samples");
+  }
+  double rank = p / 100.0 * static_cast<double>(sorted.size() - 1);
+  auto lower = static_cast<size_t>(std::floor(rank));
+  size_t upper = std::min(lower + 1, sorted.size() - 1);
+  double fraction = rank - static_cast<double>(lower);
+  return sorted[lower] + (sorted[upper] - sorted[lower]) * fraction;
+}
+
+SampleStats sample_stats(std::vector<double> samples, bool reject_outliers) {
+  if (samples.empty()) {
+    throw std::invalid_argument("No samples");
+  }
+  std::sort(samples.begin(), samples.end());
+  std::vector<double> kept;
+  if (reject_outliers) {
+    double q1 = percentile(samples, 25.0);
+    double q3 = percentile(samples, 75.0);
+    double low = q1 - 3.0 * (q3 - q1);
+    double high = q3 + 3.0 * (q3 - q1);
+    for (double sample : samples) {
+      if (sample >= low && sample <= high) {
+        kept.push_back(sample);
+      }
+    }
+  } else {
+    kept = samples;
+  }
+  SampleStats res;
+  res.samples = kept.size();
+  res.outliers = samples.size() - kept.size();
+  res.min = kept.front();
+  res.median = percentile(kept, 50.0);
+  res.p90 = percentile(kept, 90.0);
+  res.p99 = percentile(kept, 99.0);
+  res.max = kept.back();
+  double n = static_cast<double>(kept.size());
+  res.mean = std::accumulate(kept.begin(), kept.end(), 0.0) / n;
+  if (kept.size() > 1) {
+    double squares = 0.0;
+    for (double sample : kept) {
+      squares += (sample - res.mean) * (sample - res.mean);
+    }
+    res.stddev = std::sqrt(squares / (n - 1.0));
+  }
+  return res;
+}
+
+void flush_cache(size_t bytes) {
+  static std::vector<unsigned char> buffer;
+  if (buffer.size() < bytes) {
+    buffer.resize(bytes);
+  }
+  // a write and a read per cache line
+  constexpr size_t kLine = 64;
+  unsigned char sum = 0;
+  for (size_t i = 0; i < bytes; i += kLine) {
+    buffer[i] = static_cast<unsigned char>(buffer[i] + 1);
+    sum = static_cast<unsigned char>(sum + buffer[i]);
+  }
+  flush_sink = sum;
+}
+
+CpuPin::CpuPin(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+#ifdef _WIN32
+  if (cpu >= static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+    return;
+  }
+  DWORD_PTR previous = SetThreadAffinityMask(
+      GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+  if (previous != 0) {
+    saved_.resize(sizeof(previous));
+    std::memcpy(saved_.data(), &previous, sizeof(previous));
+    pinned_ = true;
+  }
+#elif defined(__linux__)
+  if (cpu >= CPU_SETSIZE) {
+    return;
+  }
+  cpu_set_t previous;
+  if (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) !=
+      0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+    saved_.resize(sizeof(previous));
+    std::memcpy(saved_.data(), &previous, sizeof(previous));
+    pinned_ = true;
+  }
+#endif
+}
+
+CpuPin::~CpuPin() {
+  if (!pinned_) {
+    return;
+  }
+#ifdef _WIN32
+  DWORD_PTR previous;
+  std::memcpy(&previous, saved_.data(), sizeof(previous));
+  SetThreadAffinityMask(GetCurrentThread(), previous);
+#elif defined(__linux__)
+  cpu_set_t previous;
+  std::memcpy(&previous, saved_.data(), sizeof(previous));
+  pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#endif
+}
+
+}  // namespace it_lab_ai
@@ -60,3 +60,85 @@ TEST(conv_test, is_conv_stl_ok) {
       elapsed_time<double, std::milli>(test_func, p2, input, output);
   std::cout << count1 << " vs. " << count2 << " (parallel)\n";
 }
+
+// convolutions of the MNIST model built in app/Graph/build.cpp
+TEST(conv_test, is_conv_im2col_faster_on_mnist) {
+  std::vector<std::pair<Shape, Shape>> mnist_convs = {
+      {Shape({1, 1, 28, 28}), Shape({5, 5, 1, 16})},
+      {Shape({1, 16, 14, 14}), Shape({5, 5, 16, 36})}};
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  for (const auto& conv : mnist_convs) {
+    std::vector<float> a1(conv.first.count());
+    std::vector<float> a2(conv.second.count());
+    for (auto& v : a1) v = dist(gen);
+    for (auto& v : a2) v = dist(gen);
+    Tensor input = make_tensor(a1, conv.first);
+    Tensor kernel = make_tensor(a2, conv.second);
+    Tensor output;
+    ConvolutionalLayer p1(1, 2, 1, kernel, Tensor(), kDefault);
+    ConvolutionalLayer p2(1, 2, 1, kernel, Tensor(), kIm2col);
+    double count1 =
+        elapsed_time_avg<double, std::milli>(10, test_func, p1, input, output);
+    double count2 =
+        elapsed_time_avg<double, std::milli>(10, test_func, p2, input, output);
+    std::cout << conv.first << " * " << conv.second << ": " << count1
+              << " vs. " << count2 << " (im2col), speedup " << count1 / count2
+              << "\n";
+  }
+}
+
+TEST(conv_test, is_conv_winograd_faster) {
+  Shape input_shape({1, 32, 56, 56});
+  Shape kernel_shape({3, 3, 32, 32});
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> a1(input_shape.count());
+  std::vector<float> a2(kernel_shape.count());
+  for (auto& v : a1) v = dist(gen);
+  for (auto& v : a2) v = dist(gen);
+  Tensor input = make_tensor(a1, input_shape);
+  Tensor kernel = make_tensor(a2, kernel_shape);
+  Tensor output;
+  ConvolutionalLayer p1(1, 1, 1, kernel, Tensor(), kIm2col);
+  ConvolutionalLayer p2(1, 1, 1, kernel, Tensor(), kDefault);
+  double count1 =
+      elapsed_time_avg<double, std::milli>(10, test_func, p1, input, output);
+  double count2 =
+      elapsed_time_avg<double, std::milli>(10, test_func, p2, input, output);
+  std::cout << count1 << " (im2col) vs. " << count2 << " (winograd)\n";
+}
+
+void fc_matvec_func(const std::vector<float>& weights, const Shape& wshape,
+                    const std::vector<float>& input) {
+  mat_vec_mul(weights, wshape, input);
+}
+
+// dense layers of the MNIST model, per-sample mat_vec_mul vs batched gemm
+TEST(fc_test, is_fc_batched_gemm_faster_on_mnist) {
+  std::vector<Shape> mnist_fcs = {Shape({128, 1764}), Shape({10, 128})};
+  std::vector<size_t> batches = {1, 8, 64, 1000};
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  for (const auto& wshape : mnist_fcs) {
+    std::vector<float> weights(wshape.count());
+    std::vector<float> bias(wshape[0]);
+    for (auto& v : weights) v = dist(gen);
+    for (auto& v : bias) v = dist(gen);
+    FCLayer layer(make_tensor(weights, wshape), make_tensor(bias));
+    for (size_t batch : batches) {
+      std::vector<float> a1(batch * wshape[1]);
+      for (auto& v : a1) v = dist(gen);
+      Tensor input = make_tensor(a1, Shape({batch, wshape[1]}));
+      Tensor output;
+      double count1 = elapsed_time_avg<double, std::milli>(
+          10, fc_matvec_func, weights, wshape, a1);
+      double count2 = elapsed_time_avg<double, std::milli>(
+          10, test_func, layer, input, output);
+      std::cout << wshape << " batch " << batch << ": " << count1 << " vs. "
+                << count2 << " (gemm), "
+                << static_cast<double>(batch) * 1000.0 / count2
+                << " samples/s\n";
+    }
+  }
+}
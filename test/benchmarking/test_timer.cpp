@@ -73,3 +73,89 @@ TEST(timer, is_elapsed_time_omp_avg_returns_nearly_correct_time) {
   EXPECT_GE(res_time, 0.15);
   EXPECT_LE(res_time, 1.25);
 }
+
+TEST(timer, percentile_interpolates_between_ranks) {
+  std::vector<double> sorted = {1.0, 2.0, 3.0, 4.0, 5.0};
+  EXPECT_DOUBLE_EQ(percentile(sorted, 0.0), 1.0);
+  EXPECT_DOUBLE_EQ(percentile(sorted, 50.0), 3.0);
+  EXPECT_DOUBLE_EQ(percentile(sorted, 90.0), 4.6);
+  EXPECT_DOUBLE_EQ(percentile(sorted, 100.0), 5.0);
+  EXPECT_THROW(percentile({}, 50.0), std::invalid_argument);
+}
+
+TEST(timer, sample_stats_drops_far_outliers) {
+  std::vector<double> samples = {10.0, 11.0, 10.5, 10.2, 10.8,
+                                 10.4, 10.6, 10.1, 250.0, 10.3};
+  SampleStats stats = sample_stats(samples);
+  EXPECT_EQ(stats.outliers, 1);
+  EXPECT_EQ(stats.samples, 9);
+  EXPECT_DOUBLE_EQ(stats.min, 10.0);
+  EXPECT_DOUBLE_EQ(stats.max, 11.0);
+  EXPECT_DOUBLE_EQ(stats.median, 10.4);
+  EXPECT_LE(stats.p99, 11.0);
+}
+
+TEST(timer, sample_times_runs_warmup_untimed) {
+  size_t calls = 0;
+  std::vector<double> samples =
+      sample_times(3, 5, [&calls]() { calls++; });
+  EXPECT_EQ(calls, 8);
+  ASSERT_EQ(samples.size(), 5);
+  for (double sample : samples) {
+    EXPECT_GE(sample, 0.0);
+  }
+}
+
+TEST(timer, sample_stats_gives_moments_and_percentiles) {
+  std::vector<double> samples = {2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0};
+  SampleStats stats = sample_stats(samples, false);
+  EXPECT_EQ(stats.samples, 8);
+  EXPECT_DOUBLE_EQ(stats.mean, 5.0);
+  EXPECT_NEAR(stats.stddev, std::sqrt(32.0 / 7.0), 1e-12);
+  EXPECT_DOUBLE_EQ(stats.median, 4.5);
+  EXPECT_DOUBLE_EQ(stats.p90, 7.6);
+  EXPECT_DOUBLE_EQ(sample_stats({3.0}).stddev, 0.0);
+}
+
+TEST(timer, run_benchmark_runs_fixed_iterations_after_warmup) {
+  size_t calls = 0;
+  BenchmarkOptions options;
+  options.warmup = 2;
+  options.iterations = 7;
+  options.flush_cache = true;
+  options.flush_bytes = 1 << 20;
+  BenchmarkResult result = run_benchmark(options, [&calls]() { calls++; });
+  EXPECT_EQ(calls, 9);
+  EXPECT_EQ(result.samples.size(), 7);
+  EXPECT_LE(result.stats.min, result.stats.median);
+  EXPECT_LE(result.stats.p90, result.stats.p99);
+  EXPECT_LE(result.stats.p99, result.stats.max);
+}
+
+TEST(timer, run_benchmark_runs_for_min_time) {
+  BenchmarkOptions options;
+  options.warmup = 0;
+  options.min_time_ms = 20.0;
+  options.min_iterations = 3;
+  BenchmarkResult result = run_benchmark(options, waitfor_function, 2);
+  EXPECT_GE(result.samples.size(), 3);
+  double total = 0.0;
+  for (double sample : result.samples) {
+    total += sample;
+  }
+  EXPECT_GE(total, 20.0);
+  // the last run is the one that crossed the minimum time
+  EXPECT_LT(total - result.samples.back(), 20.0);
+}
+
+TEST(timer, cpu_pin_is_optional) {
+  CpuPin none(-1);
+  EXPECT_FALSE(none.pinned());
+#ifdef __linux__
+  CpuPin pin(0);
+  BenchmarkOptions options;
+  options.iterations = 1;
+  options.cpu = 0;
+  EXPECT_EQ(run_benchmark(options, []() {}).pinned, pin.pinned());
+#endif
+}
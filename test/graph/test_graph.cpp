@@ -1,10 +1,19 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
 #include <vector>
 
 #include "graph/graph.hpp"
+#include "graph/memory_planner.hpp"
 #include "gtest/gtest.h"
+#include "layers/BinaryOpLayer.hpp"
+#include "layers/ConcatLayer.hpp"
+#include "layers/ConvLayer.hpp"
 #include "layers/EWLayer.hpp"
 #include "layers/FCLayer.hpp"
 #include "layers/InputLayer.hpp"
+#include "layers/SplitLayer.hpp"
+#include "layers/TransposeLayer.hpp"
 
 using namespace it_lab_ai;
 
@@ -116,3 +125,666 @@ TEST(graph, check_connection_when_not_connection2) {
 
   ASSERT_EQ(graph.areLayerNext(fcLayer2, fcLayer4), 0);
 }
+
+TEST(memory_planner, reuses_buffers_of_dead_tensors) {
+  std::vector<TensorLifetime> tensors = {
+      {100, 0, 1}, {200, 1, 2}, {50, 2, 3}, {150, 3, 4}};
+  MemoryPlan plan = plan_memory(tensors);
+  ASSERT_EQ(plan.buffer_sizes.size(), 2);
+  EXPECT_NE(plan.buffers[0], plan.buffers[1]);
+  EXPECT_NE(plan.buffers[1], plan.buffers[2]);
+  EXPECT_NE(plan.buffers[2], plan.buffers[3]);
+  EXPECT_EQ(plan.buffers[0], plan.buffers[2]);
+  EXPECT_EQ(plan.total_size, 128 + 256 + 64 + 192);
+  EXPECT_EQ(plan.arena_size, 128 + 256);
+  EXPECT_EQ(plan.buffer_offsets[plan.buffers[0]] % kArenaAlignment, 0);
+  EXPECT_EQ(plan.buffer_offsets[plan.buffers[1]] % kArenaAlignment, 0);
+}
+
+TEST(memory_planner, keeps_overlapping_tensors_apart) {
+  std::vector<TensorLifetime> tensors = {{64, 0, 3}, {64, 1, 2}, {64, 2, 3}};
+  MemoryPlan plan = plan_memory(tensors);
+  EXPECT_EQ(plan.buffer_sizes.size(), 3);
+  EXPECT_EQ(plan.arena_size, 3 * 64);
+}
+
+TEST(memory_planner, skips_buffers_refused_by_may_reuse) {
+  std::vector<TensorLifetime> tensors = {{64, 0, 1}, {64, 1, 2}, {64, 2, 3}};
+  MemoryPlan plan = plan_memory(
+      tensors, [](size_t previous, size_t) { return previous != 0; });
+  EXPECT_EQ(plan.buffer_sizes.size(), 3);
+  plan = plan_memory(tensors);
+  EXPECT_EQ(plan.buffer_sizes.size(), 2);
+  EXPECT_EQ(plan.buffers[0], plan.buffers[2]);
+}
+
+TEST(memory_planner, throws_when_read_before_produced) {
+  std::vector<TensorLifetime> tensors = {{64, 2, 1}};
+  ASSERT_ANY_THROW(plan_memory(tensors));
+}
+
+TEST(graph, inference_reports_peak_memory) {
+  const std::vector<float> vec1 = {2.0F, 1.5F, 0.1F, 1.9F, 0.0F, 5.5F};
+  const std::vector<float> vec2 = {1.0F, 0.0F, 0.0F, 0.0F, 1.0F, 0.0F};
+  Tensor weights = make_tensor<float>(vec1, {3, 2});
+  Tensor weights2 = make_tensor<float>(vec2, {2, 3});
+  Tensor bias = make_tensor<float>({0.5F, 0.5F, 1.0F});
+  Tensor bias2 = make_tensor<float>({0.0F, 0.0F});
+  Tensor input = make_tensor<float>({1.0F, 2.0F}, {2});
+  Tensor output;
+
+  Graph graph(5);
+  FCLayer fcLayer(weights, bias);
+  FCLayer fcLayer2(weights2, bias2);
+  FCLayer fcLayer3(weights, bias);
+  graph.setInput(fcLayer, input);
+  graph.makeConnection(fcLayer, fcLayer2);
+  graph.makeConnection(fcLayer2, fcLayer3);
+  graph.setOutput(fcLayer3, output);
+  for (int run = 0; run < 2; ++run) {
+    graph.inference();
+    std::vector<float> expected = {18.1F, 9.41F, 25.2F};
+    AlignedVector<float> tmp = *output.as<float>();
+    ASSERT_EQ(tmp.size(), expected.size());
+    for (size_t i = 0; i < tmp.size(); i++) {
+      EXPECT_NEAR(tmp[i], expected[i], 1e-4);
+    }
+  }
+  const MemoryPlan& plan = graph.getMemoryPlan();
+  EXPECT_EQ(plan.buffers.size(), 2);
+  EXPECT_EQ(plan.buffer_sizes.size(), 2);
+  EXPECT_EQ(graph.getPeakMemory(), 2 * kArenaAlignment);
+}
+
+TEST(graph, inference_runs_elementwise_layers_in_place) {
+  const std::vector<float> vec1 = {2.0F, 1.5F, 0.1F, 1.9F, 0.0F, 5.5F};
+  Tensor weights = make_tensor<float>(vec1, {3, 2});
+  Tensor bias = make_tensor<float>({0.5F, 0.5F, 1.0F});
+  Tensor input = make_tensor<float>({1.0F, -0.5F}, {2});
+  Tensor output;
+
+  Graph graph(4);
+  FCLayer fcLayer(weights, bias);
+  EWLayer activation("relu");
+  EWLayer shifted("linear", 1.0F, 1.0F);
+  graph.setInput(fcLayer, input);
+  graph.makeConnection(fcLayer, activation);
+  graph.makeConnection(activation, shifted);
+  graph.setOutput(shifted, output);
+  for (int run = 0; run < 2; ++run) {
+    graph.inference();
+    std::vector<float> expected = {2.75F, 1.0F, 1.0F};
+    AlignedVector<float> tmp = *output.as<float>();
+    ASSERT_EQ(tmp.size(), expected.size());
+    for (size_t i = 0; i < tmp.size(); i++) {
+      EXPECT_NEAR(tmp[i], expected[i], 1e-5);
+    }
+  }
+  // the FC output is the only intermediate, relu reuses its storage
+  EXPECT_EQ(graph.getPeakMemory(), kArenaAlignment);
+  std::vector<float> unchanged = {1.0F, -0.5F};
+  EXPECT_EQ(*input.as<float>(), unchanged);
+}
+
+TEST(graph, inference_writes_intermediates_into_the_arena) {
+  const std::vector<float> vec1 = {2.0F, 1.5F, 0.1F, 1.9F, 0.0F, 5.5F};
+  const std::vector<float> vec2 = {1.0F, 0.0F, 0.0F, 0.0F, 1.0F, 0.0F};
+  Tensor weights = make_tensor<float>(vec1, {3, 2});
+  Tensor weights2 = make_tensor<float>(vec2, {2, 3});
+  Tensor bias = make_tensor<float>({0.5F, 0.5F, 1.0F});
+  Tensor bias2 = make_tensor<float>({0.0F, 0.0F});
+  Tensor input = make_tensor<float>({1.0F, 2.0F}, {2});
+  Tensor output;
+
+  Graph graph(4);
+  FCLayer fcLayer(weights, bias);
+  FCLayer fcLayer2(weights2, bias2);
+  EWLayer relu("relu");
+  graph.setInput(fcLayer, input);
+  graph.makeConnection(fcLayer, fcLayer2);
+  graph.makeConnection(fcLayer2, relu);
+  graph.setOutput(relu, output);
+  // the first inference measures the outputs the arena is planned for
+  graph.inference();
+  for (int run = 0; run < 3; ++run) {
+    graph.inference();
+    std::vector<float> expected = {5.5F, 4.4F};
+    AlignedVector<float> tmp = *output.as<float>();
+    ASSERT_EQ(tmp.size(), expected.size());
+    for (size_t i = 0; i < tmp.size(); i++) {
+      EXPECT_NEAR(tmp[i], expected[i], 1e-5);
+    }
+    // relu runs in place in the buffer of fcLayer2, the output is a copy
+    output.set<float>({0}, -1.0F);
+  }
+  EXPECT_EQ(graph.getPeakMemory(), graph.getMemoryPlan().arena_size);
+  EXPECT_EQ(graph.getPeakMemory(), 2 * kArenaAlignment);
+}
+
+TEST(graph, inference_runs_residual_branches) {
+  Tensor input = make_tensor<float>({-1.0F, 2.0F, 3.0F, -4.0F}, {4});
+  Tensor output;
+  Graph graph(5);
+  EWLayer relu("relu");
+  EWLayer twice("linear", 2.0F, 0.0F);
+  EWLayer shifted("linear", 1.0F, 1.0F);
+  BinaryOpLayer add(BinaryOpLayer::Operation::kAdd);
+  graph.setInput(relu, input);
+  graph.makeConnection(relu, twice);
+  graph.makeConnection(relu, shifted);
+  graph.makeConnection(twice, add);
+  graph.makeConnection(shifted, add);
+  graph.setOutput(add, output);
+  for (int run = 0; run < 2; ++run) {
+    graph.inference();
+    std::vector<float> expected = {1.0F, 7.0F, 10.0F, 1.0F};
+    ASSERT_EQ(*output.as<float>(), expected);
+  }
+  EXPECT_EQ(graph.getMemoryPlan().buffers.size(), 3);
+}
+
+// relu feeds both branches, so the long branch can't take its buffer until
+// the short one has read it, and gets a buffer of its own instead
+TEST(graph, inference_keeps_parallel_branches_in_separate_buffers) {
+  Tensor input = make_tensor<float>({-1.0F, 2.0F, 3.0F, -4.0F}, {4});
+  Tensor output;
+  Graph graph(6);
+  EWLayer relu("relu");
+  EWLayer twice("linear", 2.0F, 0.0F);
+  EWLayer plus_one("linear", 1.0F, 1.0F);
+  EWLayer twice_again("linear", 2.0F, 0.0F);
+  EWLayer shifted("linear", 1.0F, 1.0F);
+  BinaryOpLayer add(BinaryOpLayer::Operation::kAdd);
+  graph.setInput(relu, input);
+  graph.makeConnection(relu, twice);
+  graph.makeConnection(relu, shifted);
+  graph.makeConnection(twice, plus_one);
+  graph.makeConnection(plus_one, twice_again);
+  graph.makeConnection(twice_again, add);
+  graph.makeConnection(shifted, add);
+  graph.setOutput(add, output);
+  for (int run = 0; run < 2; ++run) {
+    graph.inference();
+    std::vector<float> expected = {3.0F, 13.0F, 18.0F, 3.0F};
+    ASSERT_EQ(*output.as<float>(), expected);
+  }
+  // order relu, twice, shifted, plus_one, twice_again
+  const MemoryPlan& plan = graph.getMemoryPlan();
+  ASSERT_EQ(plan.buffers.size(), 5);
+  EXPECT_NE(plan.buffers[3], plan.buffers[0]);
+  EXPECT_NE(plan.buffers[4], plan.buffers[0]);
+}
+
+TEST(graph, inference_feeds_split_outputs_in_connection_order) {
+  Tensor input = make_tensor<float>({1.0F, 2.0F, 3.0F, 4.0F}, {4});
+  Tensor output;
+  Graph graph(6);
+  EWLayer relu("relu");
+  SplitLayer split(0, 2);
+  EWLayer twice("linear", 2.0F, 0.0F);
+  EWLayer shifted("linear", 1.0F, 10.0F);
+  ConcatLayer concat(0);
+  graph.setInput(relu, input);
+  graph.makeConnection(relu, split);
+  graph.makeConnection(split, twice);
+  graph.makeConnection(split, shifted);
+  graph.makeConnection(twice, concat);
+  graph.makeConnection(shifted, concat);
+  graph.setOutput(concat, output);
+  graph.inference();
+  std::vector<float> expected = {2.0F, 4.0F, 13.0F, 14.0F};
+  ASSERT_EQ(*output.as<float>(), expected);
+  ASSERT_EQ(output.get_shape(), Shape({4}));
+}
+
+TEST(graph, inference_materializes_lazy_transpose_for_consumer) {
+  Tensor input =
+      make_tensor<float>({1.0F, 2.0F, 3.0F, 4.0F, 5.0F, 6.0F}, {2, 3});
+  Tensor output;
+  Graph graph(3);
+  EWLayer relu("relu");
+  TransposeLayer transpose({1, 0}, true);
+  EWLayer twice("linear", 2.0F, 0.0F);
+  graph.setInput(relu, input);
+  graph.makeConnection(relu, transpose);
+  graph.makeConnection(transpose, twice);
+  graph.setOutput(twice, output);
+  graph.inference();
+  std::vector<float> expected = {2.0F, 8.0F, 4.0F, 10.0F, 6.0F, 12.0F};
+  ASSERT_EQ(*output.as<float>(), expected);
+  ASSERT_EQ(output.get_shape(), Shape({3, 2}));
+}
+
+TEST(graph, inference_throws_on_cycle) {
+  Tensor input = make_tensor<float>({1.0F, 2.0F}, {2});
+  Tensor output;
+  Graph graph(3);
+  EWLayer relu("relu");
+  EWLayer twice("linear", 2.0F, 0.0F);
+  EWLayer shifted("linear", 1.0F, 1.0F);
+  graph.setInput(relu, input);
+  graph.makeConnection(relu, twice);
+  graph.makeConnection(twice, shifted);
+  graph.makeConnection(twice, relu);
+  graph.setOutput(shifted, output);
+  ASSERT_ANY_THROW(graph.inference());
+}
+
+TEST(graph, fuse_folds_activations_into_fc) {
+  const std::vector<float> vec1 = {2.0F, -1.5F, 0.1F, 1.9F, 0.0F, -5.5F};
+  Tensor weights = make_tensor<float>(vec1, {3, 2});
+  Tensor bias = make_tensor<float>({0.5F, 0.5F, 1.0F});
+  Tensor input = make_tensor<float>({1.0F, 2.0F}, {2});
+  Tensor output;
+  Graph graph(4);
+  EWLayer start("relu");
+  FCLayer fc(weights, bias);
+  EWLayer relu("relu");
+  EWLayer twice("linear", 2.0F, 0.0F);
+  graph.setInput(start, input);
+  graph.makeConnection(start, fc);
+  graph.makeConnection(fc, relu);
+  graph.makeConnection(relu, twice);
+  graph.setOutput(twice, output);
+  graph.fuse();
+  for (int run = 0; run < 2; ++run) {
+    graph.inference();
+    std::vector<float> expected = {0.0F, 8.8F, 0.0F};
+    AlignedVector<float> tmp = *output.as<float>();
+    ASSERT_EQ(tmp.size(), expected.size());
+    for (size_t i = 0; i < tmp.size(); i++) {
+      EXPECT_NEAR(tmp[i], expected[i], 1e-4);
+    }
+  }
+  // relu is applied by the FC layer itself now, the linear layer is not
+  // fused as FC already has an activation
+  Tensor direct;
+  fc.run(input, direct);
+  std::vector<float> expected_direct = {0.0F, 4.4F, 0.0F};
+  for (size_t i = 0; i < expected_direct.size(); i++) {
+    EXPECT_NEAR((*direct.as<float>())[i], expected_direct[i], 1e-4);
+  }
+}
+
+TEST(graph, fuse_moves_postops_into_layer) {
+  const std::vector<float> vec1 = {-2.0F, 1.0F, 1.0F, 1.0F};
+  Tensor weights = make_tensor<float>(vec1, {2, 2});
+  Tensor bias = make_tensor<float>({0.0F, 0.0F});
+  Tensor input = make_tensor<float>({1.0F, 1.0F}, {2});
+  Tensor output;
+  Graph graph(3);
+  EWLayer start("relu");
+  FCLayer fc(weights, bias);
+  EWLayer relu("relu");
+  EWLayer shifted("linear", 1.0F, 1.0F);
+  fc.postops.layers.push_back(&relu);
+  fc.postops.count++;
+  graph.setInput(start, input);
+  graph.makeConnection(start, fc);
+  graph.makeConnection(fc, shifted);
+  graph.setOutput(shifted, output);
+  graph.fuse();
+  EXPECT_EQ(fc.postops.count, 0);
+  graph.inference();
+  std::vector<float> expected = {1.0F, 3.0F};
+  ASSERT_EQ(*output.as<float>(), expected);
+}
+
+TEST(graph, fuse_keeps_activation_read_by_other_layers) {
+  const std::vector<float> vec1 = {-2.0F, 1.0F, 1.0F, 1.0F};
+  Tensor weights = make_tensor<float>(vec1, {2, 2});
+  Tensor bias = make_tensor<float>({0.0F, 0.0F});
+  Tensor input = make_tensor<float>({1.0F, 1.0F}, {2});
+  Tensor output;
+  Graph graph(4);
+  EWLayer start("relu");
+  FCLayer fc(weights, bias);
+  EWLayer relu("relu");
+  BinaryOpLayer add(BinaryOpLayer::Operation::kAdd);
+  graph.setInput(start, input);
+  graph.makeConnection(start, fc);
+  graph.makeConnection(fc, relu);
+  graph.makeConnection(fc, add);
+  graph.makeConnection(relu, add);
+  graph.setOutput(add, output);
+  graph.fuse();
+  graph.inference();
+  // fc + relu(fc), the raw FC output is still needed
+  std::vector<float> expected = {-1.0F, 4.0F};
+  ASSERT_EQ(*output.as<float>(), expected);
+}
+
+TEST(graph, fuse_folds_residual_add_and_relu_into_conv) {
+  std::vector<float> image(2 * 4 * 4);
+  for (size_t i = 0; i < image.size(); i++) {
+    image[i] = static_cast<float>(i % 7) - 3.0F;
+  }
+  std::vector<float> kernelvec(3 * 3 * 2 * 2);
+  for (size_t i = 0; i < kernelvec.size(); i++) {
+    kernelvec[i] = static_cast<float>(i % 5) * 0.25F - 0.5F;
+  }
+  Tensor input = make_tensor(image, Shape({1, 2, 4, 4}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 2, 2}));
+  Tensor bias = make_tensor<float>({0.5F, -0.5F});
+  for (ImplType impl : {kDefault, kIm2col}) {
+    Tensor output;
+    Graph graph(5);
+    EWLayer start("linear", 1.0F, 0.0F);
+    EWLayer twice("linear", 2.0F, 0.0F);
+    ConvolutionalLayer conv(1, 1, 1, kernel, bias, impl);
+    BinaryOpLayer add(BinaryOpLayer::Operation::kAdd);
+    EWLayer activation("relu");
+    graph.setInput(start, input);
+    graph.makeConnection(start, twice);
+    graph.makeConnection(twice, conv);
+    graph.makeConnection(conv, add);
+    graph.makeConnection(start, add);
+    graph.makeConnection(add, activation);
+    graph.setOutput(activation, output);
+    graph.fuse();
+    graph.inference();
+
+    Tensor doubled;
+    Tensor conv_out;
+    twice.run(input, doubled);
+    ConvolutionalLayer(1, 1, 1, kernel, bias, impl).run(doubled, conv_out);
+    ASSERT_EQ(output.get_shape(), conv_out.get_shape());
+    for (size_t i = 0; i < image.size(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i],
+                  relu((*conv_out.as<float>())[i] + image[i]), 1e-4);
+    }
+    // the conv layer now takes the residual as its second input
+    std::vector<Tensor> outputs;
+    conv.run_multi({doubled, input}, outputs);
+    EXPECT_EQ(*outputs[0].as<float>(), *output.as<float>());
+  }
+}
+
+TEST(graph, propagate_layouts_keeps_depthwise_chain_in_nhwc) {
+  std::vector<float> image(4 * 8 * 8);
+  for (size_t i = 0; i < image.size(); i++) {
+    image[i] = static_cast<float>(i % 9) * 0.25F - 1.0F;
+  }
+  std::vector<float> dw_values(3 * 3 * 4);
+  for (size_t i = 0; i < dw_values.size(); i++) {
+    dw_values[i] = static_cast<float>(i % 5) * 0.2F - 0.4F;
+  }
+  std::vector<float> pw_values(4 * 4);
+  for (size_t i = 0; i < pw_values.size(); i++) {
+    pw_values[i] = static_cast<float>(i % 3) * 0.5F - 0.5F;
+  }
+  Tensor input = make_tensor(image, Shape({1, 4, 8, 8}));
+  Tensor dw_kernel = make_tensor(dw_values, Shape({3, 3, 1, 4}));
+  Tensor pw_kernel = make_tensor(pw_values, Shape({1, 1, 4, 4}));
+  Tensor bias = make_tensor<float>({0.5F, -0.5F, 0.25F, 0.0F});
+  std::vector<Tensor> outputs(2);
+  for (bool propagate : {false, true}) {
+    Graph graph(6);
+    InputLayer start(kNchw, kNchw);
+    ConvolutionalLayer dw1(1, 1, 1, dw_kernel, bias, kDefault, 4);
+    EWLayer relu("relu");
+    ConvolutionalLayer pw(1, 0, 1, pw_kernel, bias);
+    ConvolutionalLayer dw2(1, 1, 1, dw_kernel, Tensor(), kDefault, 4);
+    BinaryOpLayer add(BinaryOpLayer::Operation::kAdd);
+    graph.setInput(start, input);
+    graph.makeConnection(start, dw1);
+    graph.makeConnection(dw1, relu);
+    graph.makeConnection(relu, pw);
+    graph.makeConnection(pw, dw2);
+    graph.makeConnection(dw2, add);
+    graph.makeConnection(relu, add);
+    graph.setOutput(add, outputs[propagate ? 1 : 0]);
+    graph.fuse();
+    if (propagate) {
+      LayoutStats stats = graph.propagate_layouts();
+      // the convolutions, the folded relu and add go with them
+      EXPECT_EQ(stats.nhwc_layers, 3);
+      // in before dw1 and out after dw2, instead of around each
+      // depthwise layer
+      EXPECT_EQ(stats.reorders, 2);
+      EXPECT_EQ(stats.reorders_eliminated, 2);
+      EXPECT_EQ(start.layout(), kNchw);
+      EXPECT_EQ(pw.layout(), kNhwc);
+    }
+    for (int run = 0; run < 2; ++run) {
+      graph.inference();
+    }
+    EXPECT_TRUE(outputs[propagate ? 1 : 0].is_contiguous());
+  }
+  ASSERT_EQ(outputs[0].get_shape(), outputs[1].get_shape());
+  for (size_t i = 0; i < image.size(); i++) {
+    EXPECT_NEAR((*outputs[1].as<float>())[i], (*outputs[0].as<float>())[i],
+                1e-4);
+  }
+}
+
+TEST(graph, quantize_runs_convolutions_in_int8) {
+  std::vector<float> image(3 * 10 * 10);
+  for (size_t i = 0; i < image.size(); i++) {
+    image[i] = static_cast<float>(i % 11) * 0.2F - 1.0F;
+  }
+  std::vector<float> calibration_image(image.rbegin(), image.rend());
+  std::vector<float> kernel_values(3 * 3 * 3 * 4);
+  for (size_t i = 0; i < kernel_values.size(); i++) {
+    kernel_values[i] = static_cast<float>(i % 7) * 0.1F - 0.3F;
+  }
+  std::vector<float> pw_values(4 * 4);
+  for (size_t i = 0; i < pw_values.size(); i++) {
+    pw_values[i] = static_cast<float>(i % 3) * 0.5F - 0.5F;
+  }
+  Tensor input = make_tensor(image, Shape({1, 3, 10, 10}));
+  Tensor kernel = make_tensor(kernel_values, Shape({3, 3, 3, 4}));
+  Tensor pw_kernel = make_tensor(pw_values, Shape({1, 1, 4, 4}));
+  Tensor dw_kernel =
+      make_tensor(std::vector<float>(3 * 3 * 4, 0.1F), Shape({3, 3, 1, 4}));
+  Tensor bias = make_tensor<float>({0.5F, -0.5F, 0.25F, 0.0F});
+  std::vector<Tensor> outputs(2);
+  for (bool int8 : {false, true}) {
+    Graph graph(5);
+    InputLayer start(kNchw, kNchw);
+    ConvolutionalLayer conv(1, 1, 1, kernel, bias, kIm2col);
+    EWLayer relu("relu");
+    ConvolutionalLayer pw(1, 0, 1, pw_kernel, bias);
+    ConvolutionalLayer dw(1, 1, 1, dw_kernel, Tensor(), kDefault, 4);
+    graph.setInput(start, input);
+    graph.makeConnection(start, conv);
+    graph.makeConnection(conv, relu);
+    graph.makeConnection(relu, pw);
+    graph.makeConnection(pw, dw);
+    graph.setOutput(dw, outputs[int8 ? 1 : 0]);
+    graph.fuse();
+    if (int8) {
+      Tensor calibration = make_tensor(calibration_image, input.get_shape());
+      // the depthwise layer stays in float
+      EXPECT_EQ(graph.quantize({calibration, input}), 2);
+      EXPECT_TRUE(conv.quantized());
+      EXPECT_FALSE(dw.quantized());
+    }
+    graph.inference();
+  }
+  ASSERT_EQ(outputs[0].get_shape(), outputs[1].get_shape());
+  const AlignedVector<float>& expected = *outputs[0].as<float>();
+  const AlignedVector<float>& actual = *outputs[1].as<float>();
+  float magnitude = 0.0F;
+  for (float value : expected) {
+    magnitude = std::max(magnitude, std::fabs(value));
+  }
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(actual[i], expected[i], 0.02F * magnitude);
+  }
+}
+
+TEST(graph, compress_weights_keeps_float_outputs_close) {
+  std::vector<float> image(2 * 6 * 6);
+  for (size_t i = 0; i < image.size(); i++) {
+    image[i] = static_cast<float>(i % 13) * 0.15F - 0.9F;
+  }
+  std::vector<float> kernel_values(3 * 3 * 2 * 3);
+  for (size_t i = 0; i < kernel_values.size(); i++) {
+    kernel_values[i] = static_cast<float>(i % 7) * 0.1F - 0.3F;
+  }
+  std::vector<float> fc_values(4 * 108);
+  for (size_t i = 0; i < fc_values.size(); i++) {
+    fc_values[i] = static_cast<float>(i % 5) * 0.05F - 0.1F;
+  }
+  Tensor input = make_tensor(image, Shape({1, 2, 6, 6}));
+  Tensor kernel = make_tensor(kernel_values, Shape({3, 3, 2, 3}));
+  Tensor fc_weights = make_tensor(fc_values, Shape({4, 108}));
+  Tensor bias = make_tensor<float>({0.1F, -0.2F, 0.3F});
+  Tensor fc_bias = make_tensor<float>({0.0F, 0.5F, -0.5F, 1.0F});
+  std::vector<Tensor> outputs(2);
+  for (bool compress : {false, true}) {
+    Graph graph(4);
+    InputLayer start(kNchw, kNchw);
+    ConvolutionalLayer conv(1, 1, 1, kernel, bias);
+    EWLayer relu("relu");
+    FCLayer fc(fc_weights, fc_bias);
+    graph.setInput(start, input);
+    graph.makeConnection(start, conv);
+    graph.makeConnection(conv, relu);
+    graph.makeConnection(relu, fc);
+    graph.setOutput(fc, outputs[compress ? 1 : 0]);
+    graph.fuse();
+    if (compress) {
+      EXPECT_EQ(graph.compress_weights(Type::kFloat16), 2);
+    }
+    graph.inference();
+  }
+  ASSERT_EQ(outputs[0].get_shape(), outputs[1].get_shape());
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_NEAR((*outputs[1].as<float>())[i], (*outputs[0].as<float>())[i],
+                1e-2);
+  }
+}
+
+TEST(graph, profiler_records_layers_and_postops) {
+  std::vector<float> image(2 * 6 * 6, 0.5F);
+  Tensor input = make_tensor(image, Shape({1, 2, 6, 6}));
+  Tensor kernel =
+      make_tensor(std::vector<float>(3 * 3 * 2 * 3, 0.1F), Shape({3, 3, 2, 3}));
+  Tensor fc_weights =
+      make_tensor(std::vector<float>(4 * 108, 0.01F), Shape({4, 108}));
+  Tensor bias = make_tensor<float>({0.1F, -0.2F, 0.3F});
+  Tensor fc_bias = make_tensor<float>({0.0F, 0.5F, -0.5F, 1.0F});
+  Tensor output;
+  Graph graph(4);
+  InputLayer start(kNchw, kNchw);
+  ConvolutionalLayer conv(1, 1, 1, kernel, bias);
+  EWLayer relu("relu");
+  FCLayer fc(fc_weights, fc_bias);
+  EWLayer tanh_postop("tanh");
+  fc.postops.layers.push_back(&tanh_postop);
+  fc.postops.count++;
+  graph.setInput(start, input);
+  graph.makeConnection(start, conv);
+  graph.makeConnection(conv, relu);
+  graph.makeConnection(relu, fc);
+  graph.setOutput(fc, output);
+  graph.profiler().enable(false);
+  graph.inference();
+  EXPECT_TRUE(graph.profiler().records().empty());
+
+  graph.profiler().enable(true);
+  graph.inference();
+  graph.inference();
+  const std::vector<LayerProfile>& records = graph.profiler().records();
+  // input, conv, relu, fc and its postop
+  ASSERT_EQ(records.size(), 10);
+  EXPECT_EQ(graph.profiler().iterations(), 2);
+  EXPECT_EQ(records[0].name, "Input layer");
+  EXPECT_EQ(records[1].name, "Convolutional layer");
+  EXPECT_EQ(records[1].postop, -1);
+  EXPECT_EQ(records[1].flops, 2 * 108 * 3 * 3 * 2);
+  EXPECT_EQ(records[1].bytes_written, 108 * sizeof(float));
+  EXPECT_GE(records[1].bytes_read, (72 + 54 + 3) * sizeof(float));
+  EXPECT_EQ(records[2].name, "Element-wise layer");
+  EXPECT_EQ(records[2].flops, 108);
+  EXPECT_EQ(records[3].name, "Fully-connected layer");
+  EXPECT_EQ(records[3].flops, 2 * 4 * 108);
+  EXPECT_EQ(records[4].name, "Element-wise layer");
+  EXPECT_EQ(records[4].postop, 0);
+  EXPECT_EQ(records[4].vertex, records[3].vertex);
+  EXPECT_EQ(records[4].bytes_written, 4 * sizeof(float));
+  EXPECT_EQ(records[5].iteration, 1);
+  for (const LayerProfile& record : records) {
+    EXPECT_GE(record.duration_ns, 0);
+    EXPECT_GE(record.threads, 1);
+  }
+
+  std::ostringstream trace;
+  graph.profiler().write_chrome_trace(trace);
+  EXPECT_EQ(trace.str().rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_NE(trace.str().find("\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(trace.str().find("Element-wise layer #3 postop 0"),
+            std::string::npos);
+  std::ostringstream summary;
+  graph.profiler().write_summary(summary);
+  EXPECT_NE(summary.str().find("over 2 inference(s)"), std::string::npos);
+
+  graph.profiler().clear();
+  EXPECT_TRUE(graph.profiler().records().empty());
+}
+
+TEST(graph, profiler_counts_hardware_events_when_available) {
+  Tensor input =
+      make_tensor<float>({1.0F, -2.0F, 3.0F, -4.0F}, Shape({1, 1, 2, 2}));
+  Tensor output;
+  Graph graph(2);
+  InputLayer start(kNchw, kNchw);
+  EWLayer relu("relu");
+  graph.setInput(start, input);
+  graph.makeConnection(start, relu);
+  graph.setOutput(relu, output);
+  graph.profiler().enable(true);
+  // counters may be missing (virtual machines, perf_event_paranoid), the
+  // run must not depend on them
+  bool counting = graph.profiler().count_hardware(true);
+  graph.inference();
+  EXPECT_EQ(*output.as<float>(), std::vector<float>({1.0F, 0.0F, 3.0F, 0.0F}));
+  unsigned mask = graph.profiler().counter_mask();
+  EXPECT_EQ(counting, mask != 0);
+  for (const LayerProfile& record : graph.profiler().records()) {
+    EXPECT_EQ(record.counted, mask);
+  }
+  EXPECT_FALSE(graph.profiler().count_hardware(false));
+
+  Profiler profiler;
+  LayerProfile record;
+  record.name = "Convolutional layer";
+  record.duration_ns = 1000;
+  record.counted = 1U << PerfCounters::kCycles |
+                   1U << PerfCounters::kInstructions |
+                   1U << PerfCounters::kLlcMisses;
+  record.counters.cycles = 2000;
+  record.counters.instructions = 4000;
+  record.counters.llc_misses = 8;
+  profiler.add_iteration({record});
+  std::ostringstream summary;
+  profiler.write_summary(summary);
+  // IPC 2.00, 2 LLC misses per thousand instructions, no branch misses
+  EXPECT_NE(summary.str().find("IPC"), std::string::npos);
+  EXPECT_NE(summary.str().find("2.00      2.00         -"),
+            std::string::npos);
+  EXPECT_NE(summary.str().find("process-wide"), std::string::npos);
+  EXPECT_EQ(summary.str().find("multiplexed"), std::string::npos);
+  std::ostringstream trace;
+  profiler.write_chrome_trace(trace);
+  EXPECT_NE(trace.str().find("\"instructions\":4000"), std::string::npos);
+  EXPECT_EQ(trace.str().find("branch_misses"), std::string::npos);
+
+  CounterValues before;
+  CounterValues after;
+  after.cycles = 100;
+  after.multiplexed = true;
+  record.counters = after - before;
+  EXPECT_TRUE(record.counters.multiplexed);
+  profiler.add_iteration({record});
+  std::ostringstream multiplexed;
+  profiler.write_summary(multiplexed);
+  EXPECT_NE(multiplexed.str().find("counters were multiplexed"),
+            std::string::npos);
+  std::ostringstream multiplexed_trace;
+  profiler.write_chrome_trace(multiplexed_trace);
+  EXPECT_NE(multiplexed_trace.str().find("\"multiplexed\":true"),
+            std::string::npos);
+}
@@ -39,12 +39,12 @@ TEST(bfs, check_result_vec) {
   graph.makeConnection(a2, a4);
   graph.setOutput(a4, output);
   graph.inference();
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {81, 81, 81};
 #ifdef ENABLE_STATISTIC_TENSORS
   std::vector<Tensor> tensors = graph.getTensors();
   for (size_t i = 0; i < tensors.size(); i++) {
-    std::vector<int> ten = *tensors[i].as<int>();
+    AlignedVector<int> ten = *tensors[i].as<int>();
     for (size_t j = 0; j < ten.size(); j++) {
       std::cout << ten[j] << ' ';
     }
@@ -63,7 +63,7 @@ TEST(bfs, check_result_vec) {
   for (size_t i = 0; i < weights.size(); i++) {
     switch (weights[i].get_type()) {
       case Type::kInt: {
-        std::vector<int> ten = *weights[i].as<int>();
+        AlignedVector<int> ten = *weights[i].as<int>();
         for (size_t j = 0; j < ten.size(); j++) {
           std::cout << ten[j] << ' ';
         }
@@ -71,7 +71,7 @@ TEST(bfs, check_result_vec) {
         break;
       }
       case Type::kFloat: {
-        std::vector<float> ten = *weights[i].as<float>();
+        AlignedVector<float> ten = *weights[i].as<float>();
         for (size_t j = 0; j < ten.size(); j++) {
           std::cout << ten[j] << ' ';
         }
@@ -121,7 +121,7 @@ TEST(bfs, check_end_to_end) {
   for (size_t i = 0; i < weights.size(); i++) {
     switch (weights[i].get_type()) {
       case Type::kInt: {
-        std::vector<int> ten = *weights[i].as<int>();
+        AlignedVector<int> ten = *weights[i].as<int>();
         for (size_t j = 0; j < ten.size(); j++) {
           std::cout << ten[j] << ' ';
         }
@@ -129,7 +129,7 @@ TEST(bfs, check_end_to_end) {
         break;
       }
       case Type::kFloat: {
-        std::vector<float> ten = *weights[i].as<float>();
+        AlignedVector<float> ten = *weights[i].as<float>();
         for (size_t j = 0; j < ten.size(); j++) {
           std::cout << ten[j] << ' ';
         }
@@ -144,7 +144,7 @@ TEST(bfs, check_end_to_end) {
     }
   }
 #endif
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> tmp_output = softmax<float>(*output.as<float>());
   std::vector<float> res(3, 21);
   ASSERT_EQ(tmp, res);
@@ -178,7 +178,7 @@ TEST(bfs, check_struct_layer) {
   graph.makeConnection(a2, a3);
   graph.setOutput(a3, output);
   graph.inference();
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {81, 81, 81};
   ASSERT_EQ(tmp, res);
 }
@@ -211,7 +211,7 @@ TEST(bfs, check_struct_layer_added) {
   graph.makeConnection(a2, a3);
   graph.setOutput(a3, output);
   graph.inference();
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {189, 189, 189};
   ASSERT_EQ(tmp, res);
 }
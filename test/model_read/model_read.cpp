@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 
+#include "Weights_Reader/binary_weights.hpp"
 #include "Weights_Reader/reader_weights.hpp"
 
 using namespace it_lab_ai;
@@ -160,3 +164,97 @@ TEST(ParseJsonShapeTests, HandlesNonArrayJson) {
   std::vector<size_t> expected = {0};
   EXPECT_EQ(shape, expected);
 }
+
+json make_binary_test_model() {
+  return json::array(
+      {{{"index", 0},
+        {"name", "conv2d"},
+        {"type", "Conv2D"},
+        {"padding", "valid"},
+        {"weights",
+         {{{{1.0, 2.0}}, {{3.0, 4.0}}}, {{{5.0, 6.0}}, {{7.0, 8.0}}}}},
+        {"bias", {0.5, -0.5}}},
+       {{"index", 1},
+        {"name", "relu"},
+        {"type", "relu"},
+        {"weights", json::array()}},
+       {{"index", 2},
+        {"name", "dense"},
+        {"type", "Dense"},
+        {"weights", {{1.5, 2.5, 3.5}, {4.5, 5.5, 6.5}}},
+        {"bias", {1.0, 2.0, 3.0}}}});
+}
+
+TEST(BinaryWeightsTest, RoundTripMatchesJson) {
+  json model = make_binary_test_model();
+  std::string filename =
+      (std::filesystem::temp_directory_path() / "itlab_weights_test.bin")
+          .string();
+  write_binary_weights(model, filename);
+  std::vector<LayerRecord> binary = read_binary_weights(filename);
+  std::vector<LayerRecord> expected = read_layers_from_json(model);
+  std::remove(filename.c_str());
+
+  ASSERT_EQ(binary.size(), expected.size());
+  for (size_t i = 0; i < binary.size(); i++) {
+    EXPECT_EQ(binary[i].index, expected[i].index);
+    EXPECT_EQ(binary[i].name, expected[i].name);
+    EXPECT_EQ(binary[i].type, expected[i].type);
+    EXPECT_EQ(binary[i].attributes, expected[i].attributes);
+    EXPECT_EQ(binary[i].tensor.get_shape(), expected[i].tensor.get_shape());
+    EXPECT_EQ(binary[i].tensor.get_bias(), expected[i].tensor.get_bias());
+    EXPECT_EQ(binary[i].tensor.get_values(), expected[i].tensor.get_values());
+  }
+  EXPECT_EQ(binary[0].attributes.at("padding"), "valid");
+  EXPECT_EQ(binary[0].tensor.get_shape(), Shape({2, 2, 1, 2}));
+  EXPECT_FLOAT_EQ(binary[2].tensor.get<float>({1, 2}), 6.5F);
+}
+
+TEST(BinaryWeightsTest, BlobsAreAlignedInFile) {
+  json model = make_binary_test_model();
+  std::string filename =
+      (std::filesystem::temp_directory_path() / "itlab_weights_align.bin")
+          .string();
+  write_binary_weights(model, filename);
+  std::ifstream in(filename, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  in.close();
+  std::remove(filename.c_str());
+  ASSERT_GE(bytes.size(), kTensorAlignment);
+  std::vector<float> first(8);
+  size_t data_offset = 0;
+  std::memcpy(&data_offset, bytes.data() + 16, sizeof(uint64_t));
+  EXPECT_EQ(data_offset % kTensorAlignment, 0);
+  std::memcpy(first.data(), bytes.data() + data_offset,
+              first.size() * sizeof(float));
+  EXPECT_EQ(first, std::vector<float>({1, 2, 3, 4, 5, 6, 7, 8}));
+}
+
+TEST(BinaryWeightsTest, ThrowsOnWrongFile) {
+  EXPECT_THROW(read_binary_weights(get_test_data_path("valid.json")),
+               std::runtime_error);
+  EXPECT_THROW(read_binary_weights(get_test_data_path("missing.bin")),
+               std::runtime_error);
+}
+
+TEST(BinaryWeightsTest, ThrowsOnTruncatedFile) {
+  json model = make_binary_test_model();
+  std::string filename =
+      (std::filesystem::temp_directory_path() / "itlab_weights_cut.bin")
+          .string();
+  write_binary_weights(model, filename);
+  // the bias of the last layer is cut off
+  std::filesystem::resize_file(filename,
+                               std::filesystem::file_size(filename) - 4);
+  EXPECT_THROW(read_binary_weights(filename), std::runtime_error);
+  std::filesystem::resize_file(filename, 20);
+  EXPECT_THROW(read_binary_weights(filename), std::runtime_error);
+  std::remove(filename.c_str());
+}
+
+TEST(BinaryWeightsTest, BinaryPathReplacesExtension) {
+  EXPECT_EQ(binary_weights_path("docs/jsons/model.json"),
+            "docs/jsons/model.bin");
+  EXPECT_EQ(binary_weights_path("dir.v1/model"), "dir.v1/model.bin");
+}
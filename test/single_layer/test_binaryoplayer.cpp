@@ -216,4 +216,26 @@ TEST_F(BinaryOpLayerTests, BroadcastingTestSubGooglNet) {
   EXPECT_FLOAT_EQ((*result)[5], 4.0f);
   EXPECT_FLOAT_EQ((*result)[12], 11.0f);
   EXPECT_FLOAT_EQ((*result)[17], 16.0f);
-}
\ No newline at end of file
+}
+TEST(BinaryOpLayerInplace, scalar_operand_is_applied_in_place) {
+  BinaryOpLayer layer(BinaryOpLayer::Operation::kMul);
+  std::vector<Tensor> inputs = {make_tensor<float>({2.0F}, {1}),
+                                make_tensor<float>({1.0F, 2.0F, 3.0F}, {3})};
+  const float* storage = inputs[1].data<float>();
+  std::vector<Tensor> outputs;
+  layer.run_multi_inplace(inputs, outputs);
+  ASSERT_EQ(outputs.size(), 1);
+  std::vector<float> expected = {2.0F, 4.0F, 6.0F};
+  EXPECT_EQ(*outputs[0].as<float>(), expected);
+  EXPECT_EQ(outputs[0].data<float>(), storage);
+}
+
+TEST(BinaryOpLayerInplace, broadcasting_falls_back_to_new_output) {
+  BinaryOpLayer layer(BinaryOpLayer::Operation::kAdd);
+  std::vector<Tensor> inputs = {make_tensor<int>({1, 2, 3, 4}, {2, 2}),
+                                make_tensor<int>({10, 20}, {2})};
+  std::vector<Tensor> outputs;
+  layer.run_multi_inplace(inputs, outputs);
+  std::vector<int> expected = {11, 22, 13, 24};
+  EXPECT_EQ(*outputs[0].as<int>(), expected);
+}
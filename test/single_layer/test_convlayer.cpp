@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <random>
+
 #include "layers/ConvLayer.hpp"
 
 using namespace it_lab_ai;
@@ -22,7 +24,7 @@ TEST(ConvolutionalLayerTest, FStep2) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 0, 1, kernel);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   ASSERT_EQ(tmp.size(), expected_output.size());
   for (size_t i = 0; i < tmp.size(); ++i) {
     ASSERT_FLOAT_EQ(tmp[i], expected_output[i]);
@@ -46,7 +48,7 @@ TEST(ConvolutionalLayerTest, FStep1) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 0, 1, kernel);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   ASSERT_EQ(tmp.size(), expected_output.size());
   for (size_t i = 0; i < tmp.size(); ++i) {
     ASSERT_FLOAT_EQ(tmp[i], expected_output[i]);
@@ -70,7 +72,7 @@ TEST(ConvolutionalLayerTest, IntStep2) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 0, 1, kernel);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   ASSERT_EQ(tmp.size(), expected_output.size());
   for (size_t i = 0; i < tmp.size(); ++i) {
     ASSERT_EQ(tmp[i], expected_output[i]);
@@ -94,7 +96,7 @@ TEST(ConvolutionalLayerTest, IntStep1) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 0, 1, kernel);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   ASSERT_EQ(tmp.size(), expected_output.size());
   for (size_t i = 0; i < tmp.size(); ++i) {
     ASSERT_EQ(tmp[i], expected_output[i]);
@@ -121,7 +123,7 @@ TEST(ConvolutionalLayerTest, FloatWithBias) {
   ConvolutionalLayer layer(1, 0, 1, kernel, bias);
   layer.run(input, output);
 
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   ASSERT_EQ(tmp.size(), expected_output.size());
 
   for (size_t i = 0; i < tmp.size(); ++i) {
@@ -175,7 +177,7 @@ TEST(ConvolutionalLayerTest, Conv4DKern) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 1, 1, kernel);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   ASSERT_EQ(tmp.size(), expected_output.size());
 }
 TEST(ConvolutionalLayerTest, Conv4DKern_int) {
@@ -200,7 +202,7 @@ TEST(ConvolutionalLayerTest, Conv4DKern_int) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, 0, 2, kernel);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   ASSERT_EQ(tmp, expected_output);
 }
 TEST(ConvolutionalLayerTest, Conv4DKern_int_36) {
@@ -225,6 +227,583 @@ TEST(ConvolutionalLayerTest, Conv4DKern_int_36) {
   Tensor kernel = make_tensor(kernelvec, sh2);
   ConvolutionalLayer layer(step, (kernel.get_shape()[0] - 1) / 2, 1, kernel);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   ASSERT_EQ(tmp.size(), expected_output.size());
 }
+
+class ConvIm2colTestsParameterized
+    : public ::testing::TestWithParam<
+          std::tuple<Shape, Shape, size_t, size_t, bool> > {};
+// 1) input shape; 2) kernel shape; 3) pads; 4) dilations; 5) with bias.
+
+TEST_P(ConvIm2colTestsParameterized, im2col_matches_conv4d) {
+  auto data = GetParam();
+  Shape input_shape = std::get<0>(data);
+  Shape kernel_shape = std::get<1>(data);
+  size_t pads = std::get<2>(data);
+  size_t dilations = std::get<3>(data);
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(input_shape.count());
+  std::vector<float> kernelvec(kernel_shape.count());
+  std::vector<float> biasvec(kernel_shape[3]);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  for (auto& v : biasvec) v = dist(gen);
+  Tensor input = make_tensor(image, input_shape);
+  Tensor kernel = make_tensor(kernelvec, kernel_shape);
+  Tensor bias = std::get<4>(data) ? make_tensor(biasvec) : Tensor();
+  Tensor expected;
+  Tensor output;
+  ConvolutionalLayer reference(1, pads, dilations, kernel, bias, kDefault);
+  ConvolutionalLayer layer(1, pads, dilations, kernel, bias, kIm2col);
+  reference.run(input, expected);
+  layer.run(input, output);
+  ASSERT_EQ(output.get_shape(), expected.get_shape());
+  AlignedVector<float> tmp = *output.as<float>();
+  AlignedVector<float> ref = *expected.as<float>();
+  for (size_t i = 0; i < tmp.size(); ++i) {
+    EXPECT_NEAR(tmp[i], ref[i], 1e-4);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    conv_im2col_tests, ConvIm2colTestsParameterized,
+    ::testing::Values(
+        std::make_tuple(Shape({1, 1, 28, 28}), Shape({5, 5, 1, 16}), 2, 1,
+                        true),
+        std::make_tuple(Shape({1, 16, 14, 14}), Shape({5, 5, 16, 36}), 2, 1,
+                        true),
+        std::make_tuple(Shape({2, 3, 9, 7}), Shape({3, 3, 3, 4}), 1, 2,
+                        false),
+        std::make_tuple(Shape({3, 5, 11, 13}), Shape({3, 2, 5, 7}), 0, 1,
+                        true),
+        std::make_tuple(Shape({1, 300, 4, 4}), Shape({1, 1, 300, 100}), 0, 1,
+                        false)));
+
+TEST(ConvolutionalLayerTest, Im2colIntMatchesConv4D) {
+  std::vector<int> image(2 * 3 * 10 * 10);
+  std::vector<int> kernelvec(3 * 3 * 3 * 8);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<int>(i % 7) - 3;
+  }
+  for (size_t i = 0; i < kernelvec.size(); ++i) {
+    kernelvec[i] = static_cast<int>(i % 5) - 2;
+  }
+  Tensor input = make_tensor(image, Shape({2, 3, 10, 10}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 3, 8}));
+  Tensor bias = make_tensor(std::vector<int>({1, 2, 3, 4, 5, 6, 7, 8}));
+  Tensor expected;
+  Tensor output;
+  ConvolutionalLayer reference(1, 1, 1, kernel, bias, kDefault);
+  ConvolutionalLayer layer(1, 1, 1, kernel, bias, kIm2col);
+  reference.run(input, expected);
+  layer.run(input, output);
+  ASSERT_EQ(output.get_shape(), expected.get_shape());
+  ASSERT_EQ(*output.as<int>(), *expected.as<int>());
+}
+
+TEST(ConvolutionalLayerTest, Im2colStride2) {
+  std::vector<float> image(1 * 1 * 5 * 5);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<float>(i);
+  }
+  Tensor input = make_tensor(image, Shape({1, 1, 5, 5}));
+  Tensor kernel = make_tensor(std::vector<float>(9, 1.0F), Shape({3, 3, 1, 1}));
+  Tensor output;
+  ConvolutionalLayer layer(2, 0, 1, kernel, Tensor(), kIm2col);
+  layer.run(input, output);
+  std::vector<float> expected_output = {54, 72, 144, 162};
+  ASSERT_EQ(output.get_shape(), Shape({1, 1, 2, 2}));
+  ASSERT_EQ(*output.as<float>(), expected_output);
+}
+
+class ConvWinogradTestsParameterized
+    : public ::testing::TestWithParam<std::tuple<Shape, size_t, size_t> > {
+ protected:
+  void SetUp() override {
+    Shape input_shape = std::get<0>(GetParam());
+    Shape kernel_shape({3, 3, input_shape[1], std::get<1>(GetParam())});
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+    std::vector<float> image(input_shape.count());
+    std::vector<float> kernelvec(kernel_shape.count());
+    std::vector<float> biasvec(kernel_shape[3]);
+    for (auto& v : image) v = dist(gen);
+    for (auto& v : kernelvec) v = dist(gen);
+    for (auto& v : biasvec) v = dist(gen);
+    input = make_tensor(image, input_shape);
+    kernel = make_tensor(kernelvec, kernel_shape);
+    bias = make_tensor(biasvec);
+    Conv4D<float>(input, kernel, bias, expected, 1, std::get<2>(GetParam()),
+                  1);
+  }
+  void check(const Tensor& output) const {
+    ASSERT_EQ(output.get_shape(), expected.get_shape());
+    AlignedVector<float> tmp = *output.as<float>();
+    AlignedVector<float> ref = *expected.as<float>();
+    for (size_t i = 0; i < tmp.size(); ++i) {
+      EXPECT_NEAR(tmp[i], ref[i], 1e-3);
+    }
+  }
+  Tensor input;
+  Tensor kernel;
+  Tensor bias;
+  Tensor expected;
+};
+// 1) input shape; 2) output channels; 3) pads.
+
+TEST_P(ConvWinogradTestsParameterized, f2x2_matches_conv4d) {
+  Tensor output;
+  Conv4DWinograd<2>(input, WinogradKernelTransform<2>(kernel),
+                    kernel.get_shape()[3], bias, output,
+                    std::get<2>(GetParam()));
+  check(output);
+}
+
+TEST_P(ConvWinogradTestsParameterized, f4x4_matches_conv4d) {
+  Tensor output;
+  Conv4DWinograd<4>(input, WinogradKernelTransform<4>(kernel),
+                    kernel.get_shape()[3], bias, output,
+                    std::get<2>(GetParam()));
+  check(output);
+}
+
+TEST_P(ConvWinogradTestsParameterized, layer_selects_winograd) {
+  Tensor output;
+  ConvolutionalLayer layer(1, std::get<2>(GetParam()), 1, kernel, bias);
+  layer.run(input, output);
+  check(output);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    conv_winograd_tests, ConvWinogradTestsParameterized,
+    ::testing::Values(std::make_tuple(Shape({1, 3, 8, 8}), 4, 1),
+                      std::make_tuple(Shape({2, 16, 13, 11}), 8, 0),
+                      std::make_tuple(Shape({1, 1, 28, 28}), 16, 1),
+                      std::make_tuple(Shape({1, 32, 5, 5}), 7, 2),
+                      std::make_tuple(Shape({1, 4, 3, 3}), 3, 0)));
+
+TEST(ConvolutionalLayerTest, WinogradThrowsOnChannelMismatch) {
+  Tensor input = make_tensor(std::vector<float>(2 * 25), Shape({1, 2, 5, 5}));
+  Tensor kernel =
+      make_tensor(std::vector<float>(9 * 3 * 4), Shape({3, 3, 3, 4}));
+  Tensor output;
+  ConvolutionalLayer layer(1, 0, 1, kernel);
+  EXPECT_THROW(layer.run(input, output), std::invalid_argument);
+}
+
+TEST(ConvolutionalLayerTest, DilateKernelPlacesTaps) {
+  Tensor kernel =
+      make_tensor(std::vector<int>({1, 2, 3, 4}), Shape({2, 2, 1, 1}));
+  std::vector<int> expected = {1, 0, 2, 0, 0, 0, 3, 0, 4};
+  ASSERT_EQ(DilateKernel<int>(kernel, 2), expected);
+}
+
+TEST(ConvolutionalLayerTest, PreparedKernelIsReusedAcrossRuns) {
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(2 * 3 * 9 * 9);
+  std::vector<float> kernelvec(3 * 3 * 3 * 5);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  Tensor input = make_tensor(image, Shape({2, 3, 9, 9}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 3, 5}));
+  Tensor expected;
+  Conv4D<float>(input, kernel, Tensor(), expected, 1, 1, 2);
+  for (ImplType impl : {kDefault, kSTL, kIm2col}) {
+    ConvolutionalLayer layer(1, 1, 2, kernel, Tensor(), impl);
+    for (int run = 0; run < 2; ++run) {
+      Tensor output;
+      layer.run(input, output);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      AlignedVector<float> tmp = *output.as<float>();
+      AlignedVector<float> ref = *expected.as<float>();
+      for (size_t i = 0; i < tmp.size(); ++i) {
+        EXPECT_NEAR(tmp[i], ref[i], 1e-4);
+      }
+    }
+  }
+}
+
+TEST(ConvolutionalLayerTest, STLSplitsOneImageAndMatchesConv4D) {
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(1 * 6 * 17 * 13);
+  std::vector<float> kernelvec(3 * 2 * 6 * 9);
+  std::vector<float> biasvec(9);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  for (auto& v : biasvec) v = dist(gen);
+  Tensor input = make_tensor(image, Shape({1, 6, 17, 13}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 2, 6, 9}));
+  Tensor bias = make_tensor(biasvec);
+  for (size_t stride : {1, 2, 3}) {
+    for (size_t dilations : {1, 2}) {
+      std::vector<float> dil_kernel = DilateKernel<float>(kernel, dilations);
+      Tensor expected;
+      Tensor output;
+      Conv4D<float>(input, kernel.get_shape(), dil_kernel, bias, expected,
+                    stride, 1, dilations);
+      Conv4DSTL<float>(input, kernel.get_shape(), dil_kernel, bias, output,
+                       stride, 1, dilations);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      EXPECT_EQ(*output.as<float>(), *expected.as<float>());
+    }
+  }
+  std::vector<int> int_image(2 * 3 * 8 * 8);
+  for (size_t i = 0; i < int_image.size(); ++i) {
+    int_image[i] = static_cast<int>(i % 9) - 4;
+  }
+  Tensor int_input = make_tensor(int_image, Shape({2, 3, 8, 8}));
+  Tensor int_kernel =
+      make_tensor(std::vector<int>(3 * 3 * 3 * 4, 2), Shape({3, 3, 3, 4}));
+  Tensor expected;
+  Tensor output;
+  Conv4D<int>(int_input, int_kernel, Tensor(), expected, 1, 1, 1);
+  Conv4DSTL<int>(int_input, int_kernel, Tensor(), output, 1, 1, 1);
+  EXPECT_EQ(*output.as<int>(), *expected.as<int>());
+}
+
+TEST(ConvolutionalLayerTest, FusedResidualAndActivationMatchSeparatePasses) {
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(2 * 3 * 9 * 9);
+  std::vector<float> kernelvec(3 * 3 * 3 * 4);
+  std::vector<float> biasvec(4);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  for (auto& v : biasvec) v = dist(gen);
+  Tensor input = make_tensor(image, Shape({2, 3, 9, 9}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 3, 4}));
+  Tensor bias = make_tensor(biasvec);
+  // dilation 1 selects Winograd for kDefault, dilation 2 selects Conv4D
+  for (size_t dilations : {1, 2}) {
+    for (ImplType impl : {kDefault, kSTL, kIm2col}) {
+      ConvolutionalLayer plain(1, 1, dilations, kernel, bias, impl);
+      Tensor conv;
+      plain.run(input, conv);
+      std::vector<float> residual_values(conv.get_shape().count());
+      for (auto& v : residual_values) v = dist(gen);
+      Tensor residual = make_tensor(residual_values, conv.get_shape());
+
+      ConvolutionalLayer fused(1, 1, dilations, kernel, bias, impl);
+      ASSERT_TRUE(fused.fuse_residual_add());
+      ASSERT_TRUE(fused.fuse_activation(Activation("relu")));
+      ASSERT_FALSE(fused.fuse_activation(Activation("sigmoid")));
+      std::vector<Tensor> outputs;
+      fused.run_multi({input, residual}, outputs);
+      ASSERT_EQ(outputs.size(), 1);
+      ASSERT_EQ(outputs[0].get_shape(), conv.get_shape());
+      const AlignedVector<float>& tmp = *outputs[0].as<float>();
+      const AlignedVector<float>& ref = *conv.as<float>();
+      for (size_t i = 0; i < tmp.size(); ++i) {
+        EXPECT_NEAR(tmp[i], relu(ref[i] + residual_values[i]), 1e-4);
+      }
+    }
+  }
+}
+
+TEST(ConvolutionalLayerTest, ResidualAddIsNotFusedAfterActivation) {
+  Tensor kernel =
+      make_tensor(std::vector<float>(3 * 3 * 2 * 2), Shape({3, 3, 2, 2}));
+  ConvolutionalLayer layer(1, 0, 1, kernel);
+  ASSERT_TRUE(layer.fuse_activation(Activation("relu")));
+  ASSERT_FALSE(layer.fuse_residual_add());
+}
+
+namespace {
+
+// direct grouped convolution of NCHW input with an HWIO kernel
+std::vector<float> NaiveGroupedConv(const std::vector<float>& image,
+                                    const Shape& input_shape,
+                                    const std::vector<float>& kernel,
+                                    const Shape& kernel_shape,
+                                    const std::vector<float>& bias,
+                                    size_t stride, size_t pads,
+                                    size_t dilations, size_t group,
+                                    Shape& output_shape) {
+  size_t batch = input_shape[0];
+  size_t in_height = input_shape[2];
+  size_t in_width = input_shape[3];
+  size_t kh = kernel_shape[0];
+  size_t kw = kernel_shape[1];
+  size_t group_in = kernel_shape[2];
+  size_t out_channels = kernel_shape[3];
+  size_t group_out = out_channels / group;
+  size_t out_height =
+      (in_height + 2 * pads - (kh - 1) * dilations - 1) / stride + 1;
+  size_t out_width =
+      (in_width + 2 * pads - (kw - 1) * dilations - 1) / stride + 1;
+  output_shape = Shape({batch, out_channels, out_height, out_width});
+  std::vector<float> result(output_shape.count());
+  for (size_t b = 0; b < batch; ++b) {
+    for (size_t oc = 0; oc < out_channels; ++oc) {
+      size_t g = oc / group_out;
+      for (size_t i = 0; i < out_height; ++i) {
+        for (size_t j = 0; j < out_width; ++j) {
+          float value = bias.empty() ? 0.0F : bias[oc];
+          for (size_t ic = 0; ic < group_in; ++ic) {
+            size_t c = g * group_in + ic;
+            for (size_t h = 0; h < kh; ++h) {
+              for (size_t w = 0; w < kw; ++w) {
+                // coordinates in the padded image
+                size_t y = i * stride + h * dilations;
+                size_t x = j * stride + w * dilations;
+                if (y < pads || x < pads || y - pads >= in_height ||
+                    x - pads >= in_width) {
+                  continue;
+                }
+                value += image[((b * input_shape[1] + c) * in_height + y -
+                                pads) *
+                                   in_width +
+                               x - pads] *
+                         kernel[((h * kw + w) * group_in + ic) * out_channels +
+                                oc];
+              }
+            }
+          }
+          result[((b * out_channels + oc) * out_height + i) * out_width + j] =
+              value;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+class ConvGroupedTestsParameterized
+    : public ::testing::TestWithParam<
+          std::tuple<Shape, Shape, size_t, size_t, size_t, size_t> > {};
+
+TEST_P(ConvGroupedTestsParameterized, MatchesDirectGroupedConvolution) {
+  auto [input_shape, kernel_shape, group, stride, pads, dilations] =
+      GetParam();
+  std::mt19937 gen(23);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(input_shape.count());
+  std::vector<float> kernelvec(kernel_shape.count());
+  std::vector<float> biasvec(kernel_shape[3]);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  for (auto& v : biasvec) v = dist(gen);
+  Shape expected_shape;
+  std::vector<float> expected =
+      NaiveGroupedConv(image, input_shape, kernelvec, kernel_shape, biasvec,
+                       stride, pads, dilations, group, expected_shape);
+  Tensor input = make_tensor(image, input_shape);
+  Tensor kernel = make_tensor(kernelvec, kernel_shape);
+  Tensor bias = make_tensor(biasvec);
+  for (ImplType impl : {kDefault, kSTL, kIm2col, kAuto}) {
+    ConvolutionalLayer layer(stride, pads, dilations, kernel, bias, impl,
+                             group);
+    ASSERT_TRUE(layer.fuse_activation(Activation("relu")));
+    Tensor output;
+    layer.run(input, output);
+    ASSERT_EQ(output.get_shape(), expected_shape);
+    const AlignedVector<float>& tmp = *output.as<float>();
+    for (size_t i = 0; i < tmp.size(); ++i) {
+      EXPECT_NEAR(tmp[i], relu(expected[i]), 1e-4);
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    conv_grouped_tests, ConvGroupedTestsParameterized,
+    ::testing::Values(
+        // depthwise
+        std::make_tuple(Shape({2, 8, 9, 7}), Shape({3, 3, 1, 8}), 8, 1, 1, 1),
+        std::make_tuple(Shape({1, 5, 12, 12}), Shape({3, 3, 1, 5}), 5, 2, 1,
+                        1),
+        std::make_tuple(Shape({1, 4, 10, 11}), Shape({5, 3, 1, 4}), 4, 1, 2,
+                        2),
+        // depthwise with a channel multiplier
+        std::make_tuple(Shape({1, 3, 8, 8}), Shape({3, 3, 1, 6}), 3, 1, 1, 1),
+        // grouped
+        std::make_tuple(Shape({2, 4, 8, 9}), Shape({3, 3, 2, 6}), 2, 1, 1, 1),
+        std::make_tuple(Shape({1, 6, 11, 11}), Shape({3, 3, 2, 9}), 3, 2, 0,
+                        1)));
+
+TEST(ConvolutionalLayerTest, DepthwiseIntMatchesGroupedIm2col) {
+  std::vector<int> image(1 * 4 * 6 * 6);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<int>(i % 7) - 3;
+  }
+  std::vector<int> kernelvec(3 * 3 * 1 * 4);
+  for (size_t i = 0; i < kernelvec.size(); ++i) {
+    kernelvec[i] = static_cast<int>(i % 5) - 2;
+  }
+  Tensor input = make_tensor(image, Shape({1, 4, 6, 6}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 1, 4}));
+  Tensor bias = make_tensor(std::vector<int>({1, -1, 2, -2}));
+  Tensor depthwise;
+  Tensor grouped;
+  ConvolutionalLayer(1, 1, 1, kernel, bias, kDefault, 4).run(input, depthwise);
+  Conv4DIm2col<int>(input, kernel.get_shape(),
+                    Im2colPackKernel<int>(kernel, 4), bias, grouped, 1, 1, 1,
+                    OutputEpilogue<int>(), 0, 4);
+  ASSERT_EQ(depthwise.get_shape(), grouped.get_shape());
+  EXPECT_EQ(*depthwise.as<int>(), *grouped.as<int>());
+}
+
+TEST(ConvolutionalLayerTest, GroupsMustSplitChannels) {
+  Tensor kernel =
+      make_tensor(std::vector<float>(3 * 3 * 1 * 6), Shape({3, 3, 1, 6}));
+  EXPECT_THROW(ConvolutionalLayer(1, 1, 1, kernel, Tensor(), kDefault, 4),
+               std::invalid_argument);
+  EXPECT_THROW(ConvolutionalLayer(1, 1, 1, kernel, Tensor(), kDefault, 0),
+               std::invalid_argument);
+  ConvolutionalLayer layer(1, 1, 1, kernel, Tensor(), kDefault, 3);
+  Tensor input =
+      make_tensor(std::vector<float>(1 * 6 * 4 * 4), Shape({1, 6, 4, 4}));
+  Tensor output;
+  EXPECT_THROW(layer.run(input, output), std::invalid_argument);
+}
+
+TEST(ConvolutionalLayerTest, PointwiseIsAGemmOverChannels) {
+  std::mt19937 gen(31);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  Shape input_shape({2, 12, 7, 9});
+  std::vector<float> image(input_shape.count());
+  std::vector<float> kernelvec(12 * 10);
+  std::vector<float> biasvec(10);
+  for (auto& v : image) v = dist(gen);
+  for (auto& v : kernelvec) v = dist(gen);
+  for (auto& v : biasvec) v = dist(gen);
+  Tensor input = make_tensor(image, input_shape);
+  Tensor kernel = make_tensor(kernelvec, Shape({1, 1, 12, 10}));
+  Tensor bias = make_tensor(biasvec);
+  Shape expected_shape;
+  std::vector<float> expected =
+      NaiveGroupedConv(image, input_shape, kernelvec, kernel.get_shape(),
+                       biasvec, 1, 0, 1, 1, expected_shape);
+  std::vector<float> residual_values(expected_shape.count());
+  for (auto& v : residual_values) v = dist(gen);
+  Tensor residual = make_tensor(residual_values, expected_shape);
+  for (ImplType impl : {kDefault, kSTL, kIm2col, kAuto}) {
+    ConvolutionalLayer layer(1, 0, 1, kernel, bias, impl);
+    Tensor output;
+    layer.run(input, output);
+    ASSERT_EQ(output.get_shape(), expected_shape);
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_NEAR((*output.as<float>())[i], expected[i], 1e-4);
+    }
+    ConvolutionalLayer fused(1, 0, 1, kernel, bias, impl);
+    ASSERT_TRUE(fused.fuse_residual_add());
+    ASSERT_TRUE(fused.fuse_activation(Activation("relu")));
+    std::vector<Tensor> outputs;
+    fused.run_multi({input, residual}, outputs);
+    for (size_t i = 0; i < expected.size(); ++i) {
+      EXPECT_NEAR((*outputs[0].as<float>())[i],
+                  relu(expected[i] + residual_values[i]), 1e-4);
+    }
+  }
+  // grouped 1x1 layers read every group of channels in place too
+  std::vector<float> grouped_values(kernelvec.begin(), kernelvec.begin() + 36);
+  Tensor grouped_kernel = make_tensor(grouped_values, Shape({1, 1, 4, 9}));
+  std::vector<float> grouped_expected =
+      NaiveGroupedConv(image, input_shape, grouped_values,
+                       grouped_kernel.get_shape(), {}, 1, 0, 1, 3,
+                       expected_shape);
+  ConvolutionalLayer grouped(1, 0, 1, grouped_kernel, Tensor(), kDefault, 3);
+  Tensor output;
+  grouped.run(input, output);
+  ASSERT_EQ(output.get_shape(), expected_shape);
+  for (size_t i = 0; i < grouped_expected.size(); ++i) {
+    EXPECT_NEAR((*output.as<float>())[i], grouped_expected[i], 1e-4);
+  }
+}
+
+TEST(ConvolutionalLayerTest, NhwcLayoutMatchesNchw) {
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  Shape input_shape({2, 4, 7, 6});
+  std::vector<float> image(input_shape.count());
+  for (auto& v : image) v = dist(gen);
+  Tensor input = make_tensor(image, input_shape);
+  Tensor nhwc_input = nhwc_view(to_nhwc(input));
+  ASSERT_TRUE(is_nhwc(nhwc_input));
+  struct Case {
+    Shape kernel_shape;
+    size_t stride;
+    size_t pads;
+    size_t dilations;
+    ImplType impl;
+    size_t group;
+  };
+  for (const Case& c : {Case{Shape({3, 3, 4, 5}), 2, 1, 1, kIm2col, 1},
+                        Case{Shape({3, 3, 4, 5}), 1, 2, 2, kDefault, 1},
+                        Case{Shape({1, 1, 4, 6}), 1, 0, 1, kDefault, 1},
+                        Case{Shape({3, 3, 1, 8}), 2, 1, 1, kDefault, 4}}) {
+    std::vector<float> kernelvec(c.kernel_shape.count());
+    for (auto& v : kernelvec) v = dist(gen);
+    std::vector<float> biasvec(c.kernel_shape[3]);
+    for (auto& v : biasvec) v = dist(gen);
+    Tensor kernel = make_tensor(kernelvec, c.kernel_shape);
+    Tensor bias = make_tensor(biasvec);
+    ConvolutionalLayer nchw(c.stride, c.pads, c.dilations, kernel, bias,
+                            c.impl, c.group);
+    ConvolutionalLayer nhwc(c.stride, c.pads, c.dilations, kernel, bias,
+                            c.impl, c.group);
+    ASSERT_TRUE(nhwc.supports_layout(kNhwc));
+    EXPECT_EQ(nhwc.prefers_layout(kNhwc), c.group > 1);
+    nhwc.set_layout(kNhwc);
+    EXPECT_TRUE(nhwc.accepts_strided_input());
+    Tensor expected;
+    nchw.run(input, expected);
+    for (const Tensor& in : {input, nhwc_input}) {
+      Tensor output;
+      nhwc.run(in, output);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      EXPECT_TRUE(is_nhwc(output) || output.is_contiguous());
+      Tensor values = output.contiguous();
+      for (size_t i = 0; i < expected.get_shape().count(); ++i) {
+        EXPECT_NEAR((*values.as<float>())[i], (*expected.as<float>())[i],
+                    1e-4);
+      }
+    }
+    // a fused residual is read in the layout of the output
+    std::vector<float> residual_values(expected.get_shape().count());
+    for (auto& v : residual_values) v = dist(gen);
+    Tensor residual = make_tensor(residual_values, expected.get_shape());
+    ASSERT_TRUE(nhwc.fuse_residual_add());
+    std::vector<Tensor> outputs;
+    nhwc.run_multi({nhwc_input, residual}, outputs);
+    Tensor values = outputs[0].contiguous();
+    for (size_t i = 0; i < residual_values.size(); ++i) {
+      EXPECT_NEAR((*values.as<float>())[i],
+                  (*expected.as<float>())[i] + residual_values[i], 1e-4);
+    }
+  }
+  // Winograd layers stay in NCHW
+  Tensor kernel3 = make_tensor(std::vector<float>(3 * 3 * 4 * 4, 0.5F),
+                               Shape({3, 3, 4, 4}));
+  ConvolutionalLayer winograd(1, 1, 1, kernel3, Tensor(), kWinograd);
+  EXPECT_FALSE(winograd.supports_layout(kNhwc));
+  EXPECT_THROW(winograd.set_layout(kNhwc), std::invalid_argument);
+}
+
+TEST(ConvolutionalLayerTest, NhwcLayoutMatchesNchwInt) {
+  std::vector<int> image(1 * 3 * 5 * 5);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<int>(i % 7) - 3;
+  }
+  std::vector<int> kernelvec(3 * 3 * 3 * 2);
+  for (size_t i = 0; i < kernelvec.size(); ++i) {
+    kernelvec[i] = static_cast<int>(i % 5) - 2;
+  }
+  Tensor input = make_tensor(image, Shape({1, 3, 5, 5}));
+  Tensor kernel = make_tensor(kernelvec, Shape({3, 3, 3, 2}));
+  Tensor bias = make_tensor(std::vector<int>{1, -1});
+  ConvolutionalLayer nchw(1, 1, 1, kernel, bias, kIm2col);
+  ConvolutionalLayer nhwc(1, 1, 1, kernel, bias, kIm2col);
+  nhwc.set_layout(kNhwc);
+  Tensor expected;
+  Tensor output;
+  nchw.run(input, expected);
+  nhwc.run(input, output);
+  EXPECT_TRUE(is_nhwc(output));
+  EXPECT_EQ(*output.contiguous().as<int>(), *expected.as<int>());
+}
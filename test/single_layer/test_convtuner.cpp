@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "layers/ConvLayer.hpp"
+#include "layers/ConvTuner.hpp"
+
+using namespace it_lab_ai;
+
+namespace {
+
+Tensor make_values(const Shape& shape, int period) {
+  std::vector<float> values(shape.count());
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<float>(static_cast<int>(i % period) - period / 2) /
+                static_cast<float>(period);
+  }
+  return make_tensor(values, shape);
+}
+
+// NCHW input, HWIO kernel, no bias
+std::vector<float> reference_conv(const Tensor& input, const Tensor& kernel,
+                                  size_t stride, size_t pads) {
+  const Shape& in = input.get_shape();
+  const Shape& k = kernel.get_shape();
+  size_t out_height = (in[2] + 2 * pads - k[0]) / stride + 1;
+  size_t out_width = (in[3] + 2 * pads - k[1]) / stride + 1;
+  const AlignedVector<float>& x = *input.as<float>();
+  const AlignedVector<float>& w = *kernel.as<float>();
+  std::vector<float> res(in[0] * k[3] * out_height * out_width, 0.0F);
+  for (size_t n = 0; n < in[0]; n++) {
+    for (size_t o = 0; o < k[3]; o++) {
+      for (size_t y = 0; y < out_height; y++) {
+        for (size_t x_out = 0; x_out < out_width; x_out++) {
+          float sum = 0.0F;
+          for (size_t c = 0; c < in[1]; c++) {
+            for (size_t ky = 0; ky < k[0]; ky++) {
+              for (size_t kx = 0; kx < k[1]; kx++) {
+                // padded coordinates, the padding reads as zeroes
+                size_t iy = y * stride + ky;
+                size_t ix = x_out * stride + kx;
+                if (iy < pads || ix < pads || iy >= in[2] + pads ||
+                    ix >= in[3] + pads) {
+                  continue;
+                }
+                sum += x[((n * in[1] + c) * in[2] + iy - pads) * in[3] + ix -
+                         pads] *
+                       w[((ky * k[1] + kx) * k[2] + c) * k[3] + o];
+              }
+            }
+          }
+          res[((n * k[3] + o) * out_height + y) * out_width + x_out] = sum;
+        }
+      }
+    }
+  }
+  return res;
+}
+
+}  // namespace
+
+TEST(ConvTuner, im2col_row_tiles_match_whole_image) {
+  Tensor input = make_values({2, 3, 11, 9}, 7);
+  Tensor kernel = make_values({3, 3, 3, 4}, 5);
+  Tensor bias = make_tensor(std::vector<float>({1, 2, 3, 4}));
+  std::vector<float> packed = Im2colPackKernel<float>(kernel);
+  OutputEpilogue<float> epilogue;
+  epilogue.activation = Activation("relu");
+  Tensor expected;
+  Conv4DIm2col<float>(input, kernel.get_shape(), packed, bias, expected, 1, 1,
+                      1, epilogue);
+  for (size_t row_tile : {1, 3, 4, 11, 20}) {
+    Tensor output;
+    Conv4DIm2col<float>(input, kernel.get_shape(), packed, bias, output, 1, 1,
+                        1, epilogue, row_tile);
+    ASSERT_EQ(output.get_shape(), expected.get_shape());
+    EXPECT_EQ(*output.as<float>(), *expected.as<float>()) << row_tile;
+  }
+}
+
+TEST(ConvTuner, keeps_the_fastest_candidate) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  std::vector<ConvChoice> candidates = {
+      {kSTL, 0}, {kIm2col, 4}, {kDefault, 0}};
+  std::vector<ImplType> runs;
+  ConvChoice best = tuner.tune("shape", candidates,
+                               [&](const ConvChoice& candidate) {
+                                 runs.push_back(candidate.impl);
+                                 if (candidate.impl != kIm2col) {
+                                   std::this_thread::sleep_for(
+                                       std::chrono::milliseconds(5));
+                                 }
+                               });
+  EXPECT_EQ(best.impl, kIm2col);
+  EXPECT_EQ(best.row_tile, 4U);
+  EXPECT_EQ(runs.size(), 6U);
+  ConvChoice found;
+  ASSERT_TRUE(tuner.find("shape", found));
+  EXPECT_EQ(found.impl, kIm2col);
+  EXPECT_FALSE(tuner.find("other shape", found));
+  tuner.clear();
+}
+
+TEST(ConvTuner, choices_round_trip_through_a_file) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  tuner.set("float input 1x2x3x4", {kWinograd, 0});
+  tuner.set("int input 5x6x7x8", {kIm2col, 16});
+  std::string path = ::testing::TempDir() + "conv_tuning.txt";
+  ASSERT_TRUE(tuner.save(path));
+  tuner.clear();
+  ASSERT_TRUE(tuner.load(path));
+  std::remove(path.c_str());
+  ConvChoice choice;
+  ASSERT_TRUE(tuner.find("float input 1x2x3x4", choice));
+  EXPECT_EQ(choice.impl, kWinograd);
+  ASSERT_TRUE(tuner.find("int input 5x6x7x8", choice));
+  EXPECT_EQ(choice.impl, kIm2col);
+  EXPECT_EQ(choice.row_tile, 16U);
+  EXPECT_FALSE(tuner.load(path));
+  tuner.clear();
+}
+
+TEST(ConvTuner, tuning_is_opt_in) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  ASSERT_FALSE(tuner.enabled());
+  Tensor input = make_values({1, 4, 20, 20}, 9);
+  Tensor kernel = make_values({3, 3, 4, 8}, 5);
+  ConvolutionalLayer automatic(1, 1, 1, kernel, Tensor(), kAuto);
+  Tensor output;
+  automatic.run(input, output);
+  EXPECT_EQ(automatic.choice().impl, automatic.impl_type());
+  // nothing was timed, so nothing was stored
+  std::string path = ::testing::TempDir() + "conv_tuning_off.txt";
+  ASSERT_TRUE(tuner.save(path));
+  std::ifstream file(path);
+  std::string line;
+  EXPECT_FALSE(std::getline(file, line));
+  file.close();
+  std::remove(path.c_str());
+}
+
+TEST(ConvTuner, auto_layer_is_tuned_on_first_run) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  tuner.set_enabled(true);
+  Tensor input = make_values({1, 4, 20, 20}, 9);
+  for (const Shape& kernel_shape : {Shape({3, 3, 4, 8}), Shape({1, 1, 4, 8})}) {
+    Tensor kernel = make_values(kernel_shape, 5);
+    ConvolutionalLayer automatic(1, 0, 1, kernel, Tensor(), kAuto);
+    ConvolutionalLayer direct(1, 0, 1, kernel, Tensor(), kSTL);
+    Tensor expected;
+    Tensor output;
+    direct.run(input, expected);
+    automatic.run(input, output);
+    ASSERT_EQ(output.get_shape(), expected.get_shape());
+    for (size_t i = 0; i < expected.get_shape().count(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i], (*expected.as<float>())[i], 1e-4);
+    }
+  }
+  tuner.set_enabled(false);
+  tuner.clear();
+}
+
+// only candidates with the usual stride semantics are timed, whichever
+// wins gives the same output
+TEST(ConvTuner, auto_layer_with_stride_2_is_deterministic) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.set_enabled(true);
+  Tensor input = make_values({1, 3, 9, 9}, 11);
+  Tensor kernel = make_values({3, 3, 3, 4}, 7);
+  std::vector<float> expected = reference_conv(input, kernel, 2, 1);
+  for (int run = 0; run < 5; run++) {
+    tuner.clear();
+    ConvolutionalLayer automatic(2, 1, 1, kernel, Tensor(), kAuto);
+    Tensor output;
+    automatic.run(input, output);
+    EXPECT_EQ(automatic.choice().impl, kIm2col);
+    ASSERT_EQ(output.get_shape(), Shape({1, 4, 5, 5}));
+    for (size_t i = 0; i < expected.size(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i], expected[i], 1e-4);
+    }
+  }
+  tuner.set_enabled(false);
+
+  // a tuning file that cached the direct loops for this shape
+  ConvolutionalLayer first(2, 1, 1, kernel, Tensor(), kAuto);
+  first.tune(input);
+  std::string path = ::testing::TempDir() + "conv_tuning_stride.txt";
+  ASSERT_TRUE(tuner.save(path));
+  std::string key;
+  {
+    std::ifstream file(path);
+    ASSERT_TRUE(std::getline(file, key, '\t'));
+  }
+  {
+    std::ofstream file(path);
+    file << key << "\tdefault\t0\n";
+  }
+  tuner.clear();
+  ASSERT_TRUE(tuner.load(path));
+  std::remove(path.c_str());
+  ConvolutionalLayer stale(2, 1, 1, kernel, Tensor(), kAuto);
+  Tensor output;
+  stale.run(input, output);
+  EXPECT_EQ(stale.choice().impl, kIm2col);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR((*output.as<float>())[i], expected[i], 1e-4);
+  }
+  tuner.clear();
+}
+
+TEST(ConvTuner, auto_layer_reuses_a_stored_choice) {
+  ConvTuner& tuner = ConvTuner::instance();
+  tuner.clear();
+  Tensor input = make_values({1, 4, 20, 20}, 9);
+  Tensor kernel = make_values({3, 3, 4, 8}, 5);
+  ConvolutionalLayer first(1, 1, 1, kernel, Tensor(), kAuto);
+  first.tune(input);
+  std::string path = ::testing::TempDir() + "conv_tuning_layer.txt";
+  ASSERT_TRUE(tuner.save(path));
+  // the file of another process that picked 3-row im2col tiles
+  std::string key;
+  {
+    std::ifstream file(path);
+    ASSERT_TRUE(std::getline(file, key, '\t'));
+  }
+  {
+    std::ofstream file(path);
+    file << key << "\tim2col\t3\n";
+  }
+  tuner.clear();
+
+  tuner.set_enabled(false);
+  ConvolutionalLayer untuned(1, 1, 1, kernel, Tensor(), kAuto);
+  Tensor expected;
+  untuned.run(input, expected);
+  EXPECT_EQ(untuned.choice().impl, untuned.impl_type());
+
+  ASSERT_TRUE(tuner.load(path));
+  std::remove(path.c_str());
+  ConvolutionalLayer second(1, 1, 1, kernel, Tensor(), kAuto);
+  Tensor output;
+  second.run(input, output);
+  EXPECT_EQ(second.choice().impl, kIm2col);
+  EXPECT_EQ(second.choice().row_tile, 3U);
+  ASSERT_EQ(output.get_shape(), expected.get_shape());
+  for (size_t i = 0; i < expected.get_shape().count(); i++) {
+    EXPECT_NEAR((*output.as<float>())[i], (*expected.as<float>())[i], 1e-4);
+  }
+  tuner.clear();
+}
@@ -12,7 +12,7 @@ TEST(DropOutLayer, dropoutlayer_int) {
   Tensor input = make_tensor<int>({1, -1, 2, -2}, sh);
   Tensor output;
   layer.run(input, output);
-  std::vector<int> vec = *output.as<int>();
+  AlignedVector<int> vec = *output.as<int>();
   EXPECT_EQ(vec[0], 0);
   EXPECT_EQ(vec[1], 0);
   EXPECT_EQ(vec[2], 0);
@@ -25,7 +25,7 @@ TEST(DropOutLayer, dropoutlayer_float) {
   Tensor input = make_tensor<float>({1.0F, -1.0F, 2.0F, -2.0F}, sh);
   Tensor output;
   layer.run(input, output);
-  std::vector<float> vec = *output.as<float>();
+  AlignedVector<float> vec = *output.as<float>();
   EXPECT_NEAR(vec[0], 1, 1e-5);
   EXPECT_NEAR(vec[1], -1, 1e-5);
   EXPECT_NEAR(vec[2], 2, 1e-5);
@@ -39,7 +39,7 @@ TEST(DropOutLayer, dropoutlayer_float_50proc) {
   Tensor input = make_tensor<float>(a, sh);
   Tensor output;
   layer.run(input, output);
-  std::vector<float> vec = *output.as<float>();
+  AlignedVector<float> vec = *output.as<float>();
   EXPECT_NEAR(std::accumulate(vec.begin(), vec.end(), 0.0F), 0.5, 0.2);
 }
 
@@ -50,7 +50,7 @@ TEST(DropOutLayer, dropoutlayer_float_30proc) {
   Tensor input = make_tensor<float>(a, sh);
   Tensor output;
   layer.run(input, output);
-  std::vector<float> vec = *output.as<float>();
+  AlignedVector<float> vec = *output.as<float>();
   EXPECT_NEAR(std::accumulate(vec.begin(), vec.end(), 0.0F), 0.7, 0.2);
 }
 
@@ -61,10 +61,18 @@ TEST(DropOutLayer, dropoutlayer_float_70proc) {
   Tensor input = make_tensor<float>(a, sh);
   Tensor output;
   layer.run(input, output);
-  std::vector<float> vec = *output.as<float>();
+  AlignedVector<float> vec = *output.as<float>();
   EXPECT_NEAR(std::accumulate(vec.begin(), vec.end(), 0.0F), 0.3, 0.2);
 }
 
 TEST(DropOutLayer, get_layer_name) {
   EXPECT_EQ(DropOutLayer::get_name(), "DropOut layer");
-}
\ No newline at end of file
+}
+TEST(DropOutLayer, run_inplace_drops_in_the_given_storage) {
+  DropOutLayer layer(1.0);
+  Tensor tensor = make_tensor<float>(std::vector<float>(16, 1.0F), {4, 4});
+  const float* storage = tensor.data<float>();
+  layer.run_inplace(tensor);
+  EXPECT_EQ(*tensor.as<float>(), std::vector<float>(16, 0.0F));
+  EXPECT_EQ(tensor.data<float>(), storage);
+}
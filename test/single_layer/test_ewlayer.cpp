@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <cmath>
+#include <tuple>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "layers/EWLayer.hpp"
+#include "layers/Layout.hpp"
 
 using namespace it_lab_ai;
 
@@ -169,3 +171,203 @@ TEST(ewlayer, new_ewlayer_can_sigmoid_float_extreme_values) {
     EXPECT_NEAR((*output.as<float>())[i], expected_output[i], 1e-5F);
   }
 }
+
+namespace {
+
+double reference(ActivationType type, double x, double alpha, double beta) {
+  switch (type) {
+    case ActivationType::kTanh:
+      return std::tanh(x);
+    case ActivationType::kSin:
+      return std::sin(x);
+    case ActivationType::kSigmoid:
+      return 1.0 / (1.0 + std::exp(-x));
+    case ActivationType::kGelu:
+      return 0.5 * x * (1.0 + std::erf(x / std::sqrt(2.0)));
+    case ActivationType::kSilu:
+      return x / (1.0 + std::exp(-x));
+    case ActivationType::kLeakyRelu:
+      return x > 0 ? x : alpha * x;
+    case ActivationType::kHardSigmoid:
+      return std::min(std::max(alpha * x + beta, 0.0), 1.0);
+    case ActivationType::kClip:
+      return std::min(std::max(x, alpha), beta);
+    default:
+      return x;
+  }
+}
+
+std::vector<float> sweep(float from, float to, size_t count) {
+  std::vector<float> values(count);
+  for (size_t i = 0; i < count; i++) {
+    values[i] = from + (to - from) * static_cast<float>(i) /
+                           static_cast<float>(count - 1);
+  }
+  return values;
+}
+
+// largest |result - reference| / max(floor, |reference|) of a kernel
+double max_error(const Activation& activation, Isa isa,
+                 const std::vector<float>& input, double floor) {
+  std::vector<float> output(input.size());
+  EXPECT_TRUE(
+      activation.apply(isa, input.data(), output.data(), input.size()));
+  double error = 0.0;
+  for (size_t i = 0; i < input.size(); i++) {
+    double expected =
+        reference(activation.type, input[i], activation.alpha, activation.beta);
+    double scale = std::max(floor, std::abs(expected));
+    error = std::max(error, std::abs(output[i] - expected) / scale);
+  }
+  return error;
+}
+
+std::vector<Isa> available_isas() {
+  std::vector<Isa> isas;
+  float value = 0.0F;
+  for (Isa isa : {Isa::kScalar, Isa::kAvx2, Isa::kAvx512}) {
+    if (Activation("relu").apply(isa, &value, &value, 1)) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+}  // namespace
+
+TEST(ewlayer, activation_kernels_stay_within_documented_errors) {
+  std::vector<float> wide = sweep(-100.0F, 100.0F, 100003);
+  std::vector<float> narrow = sweep(-4.0F, 4.0F, 100003);
+  for (Isa isa : available_isas()) {
+    SCOPED_TRACE(static_cast<int>(isa));
+    // 1e-36 absolute below 1e-30 is 2e-7 of 5e-30
+    EXPECT_LE(max_error(Activation("sigmoid"), isa, narrow, 5e-30), 2e-7);
+    EXPECT_LE(max_error(Activation("sigmoid"), isa, wide, 5e-30), 2e-7);
+    EXPECT_LE(max_error(Activation("silu"), isa, wide, 5e-30), 2e-7);
+    EXPECT_LE(max_error(Activation("tanh"), isa, narrow, 1e-30), 2e-7);
+    EXPECT_LE(max_error(Activation("tanh"), isa, wide, 1e-30), 2e-7);
+    EXPECT_LE(max_error(Activation("sin"), isa, wide, 1.0), 2e-7);
+    EXPECT_LE(max_error(Activation("gelu"), isa, narrow, 1.0), 3e-7);
+    EXPECT_LE(max_error(Activation("gelu"), isa, wide, 1.0), 3e-7);
+    EXPECT_LE(max_error(Activation("leaky_relu", 0.1F), isa, wide, 1e-30),
+              6e-8);
+    EXPECT_LE(max_error(Activation("hard_sigmoid", 0.2F, 0.5F), isa, narrow,
+                        1.0),
+              6e-8);
+    EXPECT_EQ(max_error(Activation("clip", -1.0F, 2.0F), isa, narrow, 1e-30),
+              0.0);
+  }
+}
+
+TEST(ewlayer, activation_kernels_handle_large_sin_arguments) {
+  std::vector<float> input = {1e5F, -2e5F, 3.5e7F, -1e30F, 12345.678F};
+  for (Isa isa : available_isas()) {
+    std::vector<float> output(input.size());
+    ASSERT_TRUE(Activation("sin").apply(isa, input.data(), output.data(),
+                                        input.size()));
+    for (size_t i = 0; i < input.size(); i++) {
+      EXPECT_NEAR(output[i], std::sin(input[i]), 1e-6);
+    }
+  }
+}
+
+TEST(ewlayer, activation_kernels_handle_every_tail_length) {
+  for (Isa isa : available_isas()) {
+    for (size_t count = 0; count <= 33; count++) {
+      std::vector<float> input = sweep(-3.0F, 3.0F, count + 2);
+      input.resize(count);
+      std::vector<float> output(count + 1, 42.0F);
+      ASSERT_TRUE(Activation("relu").apply(isa, input.data(), output.data(),
+                                           count));
+      for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(output[i], std::max(input[i], 0.0F));
+      }
+      EXPECT_EQ(output[count], 42.0F);
+    }
+  }
+}
+
+TEST(ewlayer, new_ewlayer_can_run_new_functions_float) {
+  std::vector<float> values = {-2.0F, -0.5F, 0.0F, 0.5F, 3.0F};
+  Tensor input = make_tensor<float>(values);
+  std::vector<std::tuple<EWLayer, ActivationType, double, double>> layers = {
+      {EWLayer("leaky_relu", 0.01F), ActivationType::kLeakyRelu, 0.01, 0.0},
+      {EWLayer("gelu"), ActivationType::kGelu, 0.0, 0.0},
+      {EWLayer("swish"), ActivationType::kSilu, 0.0, 0.0},
+      {EWLayer("hard_sigmoid", 0.2F, 0.5F), ActivationType::kHardSigmoid, 0.2,
+       0.5},
+      {EWLayer("clip", -1.0F, 1.0F), ActivationType::kClip, -1.0, 1.0}};
+  for (auto& [layer, type, alpha, beta] : layers) {
+    Tensor output;
+    layer.run(input, output);
+    for (size_t i = 0; i < values.size(); i++) {
+      EXPECT_NEAR(output.get<float>({i}),
+                  reference(type, values[i], alpha, beta), 1e-6);
+    }
+  }
+}
+
+TEST(ewlayer, new_ewlayer_can_clip_int) {
+  EWLayer layer("clip", -1.0F, 2.0F);
+  Tensor input = make_tensor<int>({-5, -1, 0, 2, 7});
+  Tensor output;
+  layer.run(input, output);
+  std::vector<int> expected = {-1, -1, 0, 2, 2};
+  EXPECT_EQ(*output.as<int>(), expected);
+}
+
+TEST(ewlayer, new_ewlayer_splits_large_tensors_between_threads) {
+  size_t count = 5 * kActivationParallelGrain + 7;
+  std::vector<float> values = sweep(-10.0F, 10.0F, count);
+  Tensor input = make_tensor<float>(values, {count});
+  Tensor output;
+  EWLayer("tanh").run(input, output);
+  const float* result = output.data<float>();
+  for (size_t i = 0; i < count; i++) {
+    ASSERT_NEAR(result[i], std::tanh(values[i]), 1e-6) << i;
+  }
+}
+
+TEST(ewlayer, run_inplace_reuses_unshared_storage) {
+  EWLayer layer("relu");
+  Tensor tensor = make_tensor<float>({1.0F, -1.0F, 2.0F, -2.0F});
+  const float* storage = tensor.data<float>();
+  layer.run_inplace(tensor);
+  std::vector<float> expected = {1.0F, 0.0F, 2.0F, 0.0F};
+  EXPECT_EQ(*tensor.as<float>(), expected);
+  EXPECT_EQ(tensor.data<float>(), storage);
+}
+
+TEST(ewlayer, run_inplace_keeps_shared_input) {
+  EWLayer layer("minus");
+  Tensor input = make_tensor<int>({1, -1, 2});
+  Tensor tensor = input;
+  layer.run_inplace(tensor);
+  std::vector<int> expected = {-1, 1, -2};
+  EXPECT_EQ(*tensor.as<int>(), expected);
+  std::vector<int> unchanged = {1, -1, 2};
+  EXPECT_EQ(*input.as<int>(), unchanged);
+}
+
+TEST(ewlayer, nhwc_views_stay_nhwc) {
+  std::vector<float> values(1 * 3 * 2 * 2);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<float>(i) - 6.0F;
+  }
+  Tensor input = make_tensor(values, {1, 3, 2, 2});
+  EWLayer layer("relu");
+  layer.set_layout(kNhwc);
+  Tensor expected;
+  layer.run(input, expected);
+  Tensor output;
+  layer.run(nhwc_view(to_nhwc(input)), output);
+  EXPECT_TRUE(is_nhwc(output));
+  EXPECT_EQ(*output.contiguous().as<float>(), *expected.as<float>());
+
+  Tensor tensor = nhwc_view(to_nhwc(input));
+  const uint8_t* storage = tensor.get_values().data();
+  layer.run_inplace(tensor);
+  EXPECT_TRUE(is_nhwc(tensor));
+  EXPECT_EQ(tensor.get_values().data(), storage);
+  EXPECT_EQ(*tensor.contiguous().as<float>(), *expected.as<float>());
+}
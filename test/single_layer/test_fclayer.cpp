@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "layers/EWLayer.hpp"
 #include "layers/FCLayer.hpp"
 
 using namespace it_lab_ai;
@@ -197,3 +198,123 @@ TEST(fclayer, new_fc_layer_throws_with_incorrect_input_type) {
 TEST(fclayer, get_layer_name) {
   EXPECT_EQ(FCLayer::get_name(), "Fully-connected layer");
 }
+
+TEST(fclayer, new_fc_layer_reuses_weights_across_runs) {
+  const std::vector<float> a1 = {2.0F, 1.5F, 0.1F, 1.9F, 0.0F, 5.5F};
+  const std::vector<float> a2 = {9.0F, 6.4F, 17.5F};
+  Tensor weights = make_tensor<float>(a1, {3, 2});
+  Tensor bias = make_tensor<float>({0.5F, 0.5F, 1.0F});
+  FCLayer layer(weights, bias);
+  for (int run = 0; run < 3; ++run) {
+    Tensor output;
+    layer.run(make_tensor<float>({2.0F, 3.0F}), output);
+    for (size_t i = 0; i < a2.size(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i], a2[i], 1e-5);
+    }
+  }
+}
+
+TEST(fclayer, batched_run_matches_matvecmul) {
+  const size_t in = 300;
+  const size_t out = 100;
+  const size_t batch = 37;
+  std::vector<float> weights(in * out);
+  std::vector<float> input(in * batch);
+  std::vector<float> bias(out);
+  for (size_t i = 0; i < weights.size(); i++) {
+    weights[i] = static_cast<float>(i % 7) - 3.0F;
+  }
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<float>(i % 5) * 0.5F;
+  }
+  for (size_t i = 0; i < out; i++) {
+    bias[i] = static_cast<float>(i);
+  }
+  FCLayerImpl<float> layer(weights, Shape({out, in}), bias);
+  layer.set_weight(99, 299, 10.0F);
+  weights[99 * in + 299] = 10.0F;
+  std::vector<float> output = layer.run(input);
+  std::vector<float> expected = mat_vec_mul(weights, Shape({out, in}), input);
+  ASSERT_EQ(output.size(), out * batch);
+  for (size_t i = 0; i < output.size(); i++) {
+    EXPECT_NEAR(output[i], expected[i] + bias[i % out], 1e-3);
+  }
+}
+
+// the panels are the only copy of the weights a layer keeps
+TEST(fclayer, weights_are_read_back_from_the_panels) {
+  const size_t in = 300;
+  const size_t out = 100;
+  std::vector<float> weights(in * out);
+  for (size_t i = 0; i < weights.size(); i++) {
+    weights[i] = static_cast<float>(i % 11) - 5.0F;
+  }
+  std::vector<float> bias(out, 1.0F);
+  FCLayerImpl<float> impl(weights, Shape({out, in}), bias);
+  EXPECT_EQ(impl.get_weights(), weights);
+  EXPECT_EQ(impl.weight_bytes(), gemm_packed_a_size(out, in) * sizeof(float));
+  FCLayer layer(make_tensor(weights, {out, in}), make_tensor(bias));
+  EXPECT_EQ(layer.weight_bytes(),
+            impl.weight_bytes() + bias.size() * sizeof(float));
+}
+
+// one sample reads the packed weights directly, over several depth blocks
+// and a partial panel of rows
+TEST(fclayer, single_sample_run_matches_matvecmul) {
+  const size_t in = 300;
+  const size_t out = 100;
+  std::vector<float> weights(in * out);
+  std::vector<float> input(in);
+  std::vector<float> bias(out);
+  for (size_t i = 0; i < weights.size(); i++) {
+    weights[i] = static_cast<float>(i % 7) - 3.0F;
+  }
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<float>(i % 5) * 0.5F;
+  }
+  for (size_t i = 0; i < out; i++) {
+    bias[i] = static_cast<float>(i);
+  }
+  FCLayerImpl<float> layer(weights, Shape({out, in}), bias);
+  std::vector<float> output = layer.run(input);
+  std::vector<float> expected = mat_vec_mul(weights, Shape({out, in}), input);
+  ASSERT_EQ(output.size(), out);
+  for (size_t i = 0; i < out; i++) {
+    EXPECT_NEAR(output[i], expected[i] + bias[i], 1e-3);
+  }
+}
+
+TEST(fclayer, fused_activation_is_applied_with_bias) {
+  const size_t in = 20;
+  const size_t out = 9;
+  std::vector<float> weights(in * out);
+  std::vector<float> bias(out);
+  for (size_t i = 0; i < weights.size(); i++) {
+    weights[i] = static_cast<float>(i % 5) - 2.0F;
+  }
+  for (size_t i = 0; i < out; i++) {
+    bias[i] = static_cast<float>(i) - 4.0F;
+  }
+  FCLayer plain(make_tensor(weights, {out, in}), make_tensor(bias));
+  FCLayer fused(make_tensor(weights, {out, in}), make_tensor(bias));
+  ASSERT_TRUE(fused.fuse_activation(Activation("sigmoid")));
+  ASSERT_FALSE(fused.fuse_activation(Activation("relu")));
+  EWLayer sigmoid("sigmoid");
+  // one sample takes the mat-vec path, several the gemm epilogue
+  for (size_t batch : {1, 6}) {
+    std::vector<float> input(in * batch);
+    for (size_t i = 0; i < input.size(); i++) {
+      input[i] = static_cast<float>(i % 3) * 0.25F - 0.2F;
+    }
+    Tensor separate;
+    Tensor expected;
+    Tensor output;
+    plain.run(make_tensor(input), separate);
+    sigmoid.run(separate, expected);
+    fused.run(make_tensor(input), output);
+    ASSERT_EQ(output.get_shape(), expected.get_shape());
+    for (size_t i = 0; i < output.get_shape().count(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i], (*expected.as<float>())[i], 1e-5);
+    }
+  }
+}
@@ -79,3 +79,13 @@ TEST(flattenlayer, new_flattenlayer_can_flatten_int_reorder) {
 TEST(flattenlayer, get_layer_name) {
   EXPECT_EQ(FlattenLayer::get_name(), "Flatten layer");
 }
+
+TEST(flattenlayer, flatten_of_not_4d_input_shares_storage) {
+  FlattenLayer layer;
+  Tensor input = make_tensor<float>({1.0F, 2.0F, 3.0F, 4.0F, 5.0F, 6.0F},
+                                    {2, 3});
+  Tensor output;
+  layer.run(input, output);
+  EXPECT_EQ(output.get_shape(), Shape({6}));
+  EXPECT_TRUE(output.shares_storage(input));
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "layers/ConvLayer.hpp"
+#include "layers/FCLayer.hpp"
+#include "layers/Float16.hpp"
+#include "layers/Gemm.hpp"
+#include "test_utils.hpp"
+
+using namespace it_lab_ai;
+
+namespace {
+
+uint32_t float_bits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+std::vector<float> random_values(size_t count, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> values(count);
+  for (auto& v : values) v = dist(gen);
+  return values;
+}
+
+}  // namespace
+
+TEST(Float16, converts_and_rounds_to_nearest_even) {
+  EXPECT_EQ(to_float16(1.0F).bits, 0x3c00);
+  EXPECT_EQ(to_float16(-2.5F).bits, 0xc100);
+  EXPECT_EQ(to_float16(65504.0F).bits, 0x7bff);
+  EXPECT_EQ(to_float16(70000.0F).bits, 0x7c00);
+  EXPECT_EQ(to_float16(-std::numeric_limits<float>::infinity()).bits,
+            0xfc00);
+  EXPECT_TRUE(std::isnan(
+      to_float(to_float16(std::numeric_limits<float>::quiet_NaN()))));
+  // smallest normal and subnormal
+  EXPECT_EQ(to_float16(std::ldexp(1.0F, -14)).bits, 0x0400);
+  EXPECT_EQ(to_float16(std::ldexp(1.0F, -24)).bits, 0x0001);
+  EXPECT_EQ(to_float16(std::ldexp(1.0F, -26)).bits, 0x0000);
+  // ties go to the even mantissa
+  EXPECT_EQ(to_float16(1.0F + std::ldexp(1.0F, -11)).bits, 0x3c00);
+  EXPECT_EQ(to_float16(1.0F + 3 * std::ldexp(1.0F, -11)).bits, 0x3c02);
+  EXPECT_EQ(to_float(Float16{0x3555}), 0.333251953125F);
+  EXPECT_EQ(to_float(Float16{0x0001}), std::ldexp(1.0F, -24));
+  EXPECT_EQ(to_float(Float16{0x7c00}), std::numeric_limits<float>::infinity());
+}
+
+TEST(Float16, bfloat16_keeps_the_float_range) {
+  EXPECT_EQ(to_bfloat16(1.0F).bits, 0x3f80);
+  EXPECT_NEAR(to_float(to_bfloat16(3.0e38F)), 3.0e38F, 3.0e38F / 256);
+  EXPECT_EQ(to_bfloat16(1.0F + std::ldexp(1.0F, -8)).bits, 0x3f80);
+  EXPECT_EQ(to_bfloat16(1.0F + 3 * std::ldexp(1.0F, -8)).bits, 0x3f82);
+  EXPECT_TRUE(std::isnan(
+      to_float(to_bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+  EXPECT_EQ(to_float(BFloat16{0xc040}), -3.0F);
+}
+
+TEST(Float16, bulk_conversions_match_scalar_ones) {
+  std::vector<Float16> halves(1 << 16);
+  for (size_t i = 0; i < halves.size(); i++) {
+    halves[i].bits = static_cast<uint16_t>(i);
+  }
+  std::vector<float> widened(halves.size());
+  convert(halves.data(), widened.data(), halves.size());
+  for (size_t i = 0; i < halves.size(); i++) {
+    float expected = to_float(halves[i]);
+    if (std::isnan(expected)) {
+      EXPECT_TRUE(std::isnan(widened[i]));
+    } else {
+      EXPECT_EQ(float_bits(widened[i]), float_bits(expected)) << i;
+    }
+  }
+  // normal values, and a count that leaves a tail
+  std::vector<float> values = random_values(1003, 3);
+  for (float& value : values) {
+    value *= 1000.0F;
+  }
+  std::vector<Float16> narrowed(values.size());
+  convert(values.data(), narrowed.data(), values.size());
+  std::vector<BFloat16> brain(values.size());
+  convert(values.data(), brain.data(), values.size());
+  std::vector<float> brain_widened(values.size());
+  convert(brain.data(), brain_widened.data(), brain.size());
+  for (size_t i = 0; i < values.size(); i++) {
+    EXPECT_EQ(narrowed[i].bits, to_float16(values[i]).bits);
+    EXPECT_EQ(brain[i].bits, to_bfloat16(values[i]).bits);
+    EXPECT_EQ(brain_widened[i], to_float(brain[i]));
+  }
+}
+
+TEST(Float16, tensors_convert_precision) {
+  Tensor input = make_tensor<float>({1.0F, -0.5F, 3.0F, 0.1F, 2.0F, 7.0F},
+                                    {2, 3});
+  for (Type type : {Type::kFloat16, Type::kBFloat16}) {
+    Tensor half = convert_precision(input, type);
+    EXPECT_EQ(half.get_type(), type);
+    EXPECT_EQ(half.get_shape(), input.get_shape());
+    EXPECT_EQ(half.get_values().size(), 12);
+    // views of 16-bit tensors materialize like any other
+    Tensor transposed = convert_precision(half.permute({1, 0}), Type::kFloat);
+    EXPECT_EQ(transposed.get<float>({2, 1}), 7.0F);
+    Tensor restored = convert_precision(half, Type::kFloat);
+    for (size_t i = 0; i < 6; i++) {
+      EXPECT_NEAR((*restored.as<float>())[i], (*input.as<float>())[i],
+                  0.01F * std::fabs((*input.as<float>())[i]));
+    }
+  }
+  Tensor made = make_tensor(std::vector<Float16>{to_float16(1.5F)});
+  EXPECT_EQ(made.get_type(), Type::kFloat16);
+  EXPECT_THROW(convert_precision(made, Type::kInt), std::invalid_argument);
+}
+
+TEST(Float16, fc_with_16bit_weights_is_close_to_float) {
+  size_t in_size = 37;
+  size_t out_size = 100;
+  Tensor weights =
+      make_tensor(random_values(out_size * in_size, 5), {out_size, in_size});
+  Tensor bias = make_tensor(random_values(out_size, 6));
+  for (size_t batch : {size_t(1), size_t(300)}) {
+    Tensor input = make_tensor(random_values(batch * in_size, 7),
+                               {batch, in_size});
+    FCLayer reference(weights, bias);
+    ASSERT_TRUE(reference.fuse_activation(Activation("relu")));
+    Tensor expected;
+    reference.run(input, expected);
+    for (Type type : {Type::kFloat16, Type::kBFloat16}) {
+      FCLayer layer(weights, bias);
+      ASSERT_TRUE(layer.fuse_activation(Activation("relu")));
+      ASSERT_TRUE(layer.compress_weights(type));
+      EXPECT_FALSE(layer.compress_weights(type));
+      EXPECT_FALSE(layer.start_calibration());
+      Tensor output;
+      layer.run(input, output);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      EXPECT_LT(relative_error(*output.as<float>(), *expected.as<float>()),
+                type == Type::kFloat16 ? 2e-3F : 2e-2F);
+      // the same with weights given in 16 bits
+      FCLayer given(convert_precision(weights, type), bias);
+      ASSERT_TRUE(given.fuse_activation(Activation("relu")));
+      Tensor given_output;
+      given.run(input, given_output);
+      EXPECT_EQ(*given_output.as<float>(), *output.as<float>());
+    }
+  }
+  FCLayer quantized(weights, bias);
+  ASSERT_TRUE(quantized.start_calibration());
+  EXPECT_FALSE(quantized.compress_weights(Type::kFloat16));
+  EXPECT_FALSE(quantized.compress_weights(Type::kInt));
+}
+
+// blocks of more than one kGemmMc x kGemmKc tile are widened one by one
+TEST(Float16, gemm_widens_16bit_packed_panels) {
+  size_t m = kGemmMc + 5;
+  size_t k = kGemmKc + 7;
+  size_t n = 19;
+  std::vector<float> a = random_values(m * k, 15);
+  std::vector<float> b = random_values(k * n, 16);
+  std::vector<float> packed(gemm_packed_a_size(m, k));
+  gemm_pack_a_matrix(m, k, a.data(), k, size_t(1), packed.data());
+  std::vector<Float16> narrow(packed.size());
+  convert(packed.data(), narrow.data(), packed.size());
+  convert(narrow.data(), packed.data(), packed.size());
+  std::vector<float> expected(m * n);
+  gemm_prepacked_a(m, n, k, packed.data(), b.data(), n, size_t(1),
+                   expected.data(), n);
+  std::vector<float> result(m * n);
+  gemm_prepacked_a(m, n, k, narrow.data(), b.data(), n, size_t(1),
+                   result.data(), n);
+  EXPECT_EQ(result, expected);
+  std::vector<float> parallel(m * n);
+  gemm_prepacked_a_parallel(m, n, k, narrow.data(), b.data(), n, size_t(1),
+                            parallel.data(), n);
+  EXPECT_EQ(parallel, expected);
+}
+
+TEST(Float16, conv_with_16bit_kernels_is_close_to_float) {
+  Tensor input = make_tensor(random_values(2 * 4 * 9 * 10, 8), {2, 4, 9, 10});
+  Tensor kernel = make_tensor(random_values(3 * 3 * 4 * 6, 9), {3, 3, 4, 6});
+  Tensor grouped_kernel =
+      make_tensor(random_values(3 * 3 * 2 * 6, 10), {3, 3, 2, 6});
+  Tensor bias = make_tensor(random_values(6, 11));
+  struct Case {
+    Tensor kernel;
+    ImplType impl;
+    size_t group;
+  };
+  // all of them run kIm2col with 16-bit kernels
+  std::vector<Case> cases = {{kernel, kDefault, 1},
+                             {kernel, kIm2col, 1},
+                             {kernel, kSTL, 1},
+                             {grouped_kernel, kDefault, 2}};
+  for (const Case& c : cases) {
+    ConvolutionalLayer reference(1, 1, 1, c.kernel, bias, c.impl, c.group);
+    Tensor expected;
+    reference.run(input, expected);
+    size_t bias_bytes = bias.get_values().size();
+    ConvolutionalLayer im2col(1, 1, 1, c.kernel, bias, kIm2col, c.group);
+    for (Type type : {Type::kFloat16, Type::kBFloat16}) {
+      ConvolutionalLayer layer(1, 1, 1, c.kernel, bias, c.impl, c.group);
+      ASSERT_TRUE(layer.compress_weights(type));
+      // only the 16-bit packed kernel is read
+      EXPECT_EQ(layer.weight_bytes() - bias_bytes,
+                (im2col.weight_bytes() - bias_bytes) / 2);
+      EXPECT_THROW(layer.set_layout(kNhwc), std::invalid_argument);
+      Tensor output;
+      for (int run = 0; run < 2; run++) {
+        layer.run(input, output);
+      }
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      AlignedVector<float> values = *output.contiguous().as<float>();
+      EXPECT_LT(relative_error(values, *expected.as<float>()),
+                type == Type::kFloat16 ? 2e-3F : 2e-2F)
+          << c.impl;
+      // kernels given in 16 bits run the same
+      ConvolutionalLayer given(1, 1, 1, convert_precision(c.kernel, type),
+                               bias, c.impl, c.group);
+      Tensor given_output;
+      given.run(input, given_output);
+      EXPECT_EQ(*given_output.contiguous().as<float>(), values);
+    }
+  }
+  ConvolutionalLayer int_layer(1, 1, 1, make_tensor<int>({1}, {1, 1, 1, 1}));
+  EXPECT_FALSE(int_layer.compress_weights(Type::kFloat16));
+  Tensor dw_kernel = make_tensor(random_values(3 * 3 * 4, 12), {3, 3, 1, 4});
+  ConvolutionalLayer depthwise(1, 1, 1, dw_kernel, Tensor(), kDefault, 4);
+  EXPECT_FALSE(depthwise.compress_weights(Type::kFloat16));
+  ConvolutionalLayer nhwc(1, 1, 1, kernel, bias, kIm2col);
+  nhwc.set_layout(kNhwc);
+  EXPECT_FALSE(nhwc.compress_weights(Type::kFloat16));
+  ConvolutionalLayer compressed(1, 1, 1, kernel, bias);
+  ASSERT_TRUE(compressed.compress_weights(Type::kBFloat16));
+  Tensor int_input = make_tensor(std::vector<int>(4 * 9 * 10, 1),
+                                 {1, 4, 9, 10});
+  Tensor output;
+  EXPECT_THROW(compressed.run(int_input, output), std::invalid_argument);
+}
+
+// compress_weights builds the 16-bit forms, so runs only read the layer
+// and may overlap
+TEST(Float16, conv_with_16bit_kernel_runs_concurrently) {
+  Tensor input = make_tensor(random_values(4 * 9 * 10, 12), {1, 4, 9, 10});
+  Tensor kernel = make_tensor(random_values(3 * 3 * 4 * 6, 13), {3, 3, 4, 6});
+  Tensor grouped_kernel =
+      make_tensor(random_values(3 * 3 * 2 * 6, 14), {3, 3, 2, 6});
+  struct Case {
+    Tensor kernel;
+    ImplType impl;
+    size_t group;
+  };
+  std::vector<Case> cases = {{kernel, kDefault, 1},
+                             {kernel, kIm2col, 1},
+                             {grouped_kernel, kDefault, 2}};
+  for (const Case& c : cases) {
+    ConvolutionalLayer layer(1, 1, 1, c.kernel, Tensor(), c.impl, c.group);
+    ASSERT_TRUE(layer.compress_weights(Type::kFloat16));
+    Tensor output;
+    layer.run(input, output);
+    AlignedVector<float> expected = *output.contiguous().as<float>();
+    std::vector<Tensor> outputs(3);
+    std::vector<std::thread> threads;
+    for (Tensor& output : outputs) {
+      threads.emplace_back([&layer, &input, &output] {
+        for (int run = 0; run < 5; run++) {
+          layer.run(input, output);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    for (const Tensor& given : outputs) {
+      EXPECT_EQ(*given.contiguous().as<float>(), expected) << c.impl;
+    }
+  }
+}
@@ -13,7 +13,7 @@ TEST(input, check_basic) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNhwc, 1, 2);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   ASSERT_EQ(tmp.size(), 4);
 }
 TEST(input, run_int) {
@@ -23,7 +23,7 @@ TEST(input, run_int) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNhwc, 1, 2);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -34,7 +34,7 @@ TEST(input, run_float) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNhwc, 1, 2);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -45,7 +45,7 @@ TEST(input, run_int_NCHW_NHWC) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNchw, kNhwc, 1, 2);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -56,7 +56,7 @@ TEST(input, run_float_NCHW_NHWC) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNchw, kNhwc, 1, 2);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -67,7 +67,7 @@ TEST(input, run_int_NHWC_NCHW) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNchw, 1, 2);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -78,7 +78,7 @@ TEST(input, run_float_NHWC_NCHW) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNchw, 1, 2);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> res = {1, 2, 3, 4};
   ASSERT_EQ(tmp, res);
 }
@@ -89,7 +89,7 @@ TEST(input, run_int_NHWC_NCHW_C3) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNchw, 1, 2);
   layer.run(input, output);
-  std::vector<int> tmp = *output.as<int>();
+  AlignedVector<int> tmp = *output.as<int>();
   std::vector<int> res = {1, 4, 7, 10, 2, 5, 8, 11, 3, 6, 9, 12};
   ASSERT_EQ(tmp, res);
 }
@@ -100,7 +100,26 @@ TEST(input, run_float_NHWC_NCHW_C3) {
   Tensor output = make_tensor(vec, sh1);
   InputLayer layer(kNhwc, kNchw, 1, 2);
   layer.run(input, output);
-  std::vector<float> tmp = *output.as<float>();
+  AlignedVector<float> tmp = *output.as<float>();
   std::vector<float> res = {1, 4, 7, 10, 2, 5, 8, 11, 3, 6, 9, 12};
   ASSERT_EQ(tmp, res);
 }
+TEST(input, run_inplace_normalizes_in_the_given_storage) {
+  Tensor tensor = make_tensor<float>({3, 5, 7, 9}, {1, 1, 2, 2});
+  const float* storage = tensor.data<float>();
+  InputLayer layer(kNchw, kNchw, 1, 2);
+  ASSERT_TRUE(layer.supports_inplace());
+  layer.run_inplace(tensor);
+  std::vector<float> res = {1, 2, 3, 4};
+  ASSERT_EQ(*tensor.as<float>(), res);
+  EXPECT_EQ(tensor.data<float>(), storage);
+}
+TEST(input, run_inplace_transposes_into_new_storage) {
+  Tensor tensor = make_tensor<int>({3, 5, 7, 9, 11, 13}, {1, 1, 2, 3});
+  InputLayer layer(kNchw, kNhwc, 1, 2);
+  EXPECT_FALSE(layer.supports_inplace());
+  layer.run_inplace(tensor);
+  std::vector<int> res = {1, 2, 3, 4, 5, 6};
+  ASSERT_EQ(*tensor.as<int>(), res);
+  ASSERT_EQ(tensor.get_shape(), Shape({1, 2, 3, 1}));
+}
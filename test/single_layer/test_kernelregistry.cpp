@@ -0,0 +1,158 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "layers/ConvLayer.hpp"
+#include "layers/CpuFeatures.hpp"
+#include "layers/KernelRegistry.hpp"
+#include "layers/PoolingLayer.hpp"
+
+using namespace it_lab_ai;
+
+TEST(CpuFeatures, max_isa_matches_detected_features) {
+  const CpuFeatures& features = cpu_features();
+  if (max_isa() >= Isa::kSse4) {
+    EXPECT_TRUE(features.sse4_2);
+  }
+  if (max_isa() >= Isa::kAvx2) {
+    EXPECT_TRUE(features.avx2 && features.fma);
+  }
+  if (max_isa() >= Isa::kAvx512) {
+    EXPECT_TRUE(features.avx512f);
+  }
+  EXPECT_TRUE(isa_supported(Isa::kScalar));
+}
+
+TEST(CpuFeatures, isa_names_round_trip) {
+  for (Isa isa : {Isa::kScalar, Isa::kSse4, Isa::kAvx2, Isa::kAvx512}) {
+    Isa parsed;
+    ASSERT_TRUE(parse_isa(isa_name(isa), parsed));
+    EXPECT_EQ(parsed, isa);
+  }
+  Isa parsed;
+  EXPECT_FALSE(parse_isa("neon", parsed));
+}
+
+TEST(KernelRegistry, candidates_are_ranked_by_isa) {
+  KernelRegistry& registry = KernelRegistry::instance();
+  registry.add({kFlatten, Type::kFloat, Isa::kScalar, kDefault, "first"});
+  registry.add({kFlatten, Type::kFloat, max_isa(), kTBB, "second"});
+  registry.add({kFlatten, Type::kFloat, Isa::kScalar, kSTL, "third"});
+  std::vector<KernelEntry> candidates =
+      registry.candidates(kFlatten, Type::kFloat);
+  ASSERT_EQ(candidates.size(), 3);
+  if (max_isa() > Isa::kScalar) {
+    EXPECT_EQ(std::string(candidates[0].name), "second");
+    EXPECT_EQ(std::string(candidates[1].name), "first");
+  } else {
+    EXPECT_EQ(std::string(candidates[0].name), "first");
+    EXPECT_EQ(std::string(candidates[1].name), "second");
+  }
+  EXPECT_EQ(std::string(candidates[2].name), "third");
+  EXPECT_TRUE(registry.candidates(kFlatten, Type::kInt).empty());
+  EXPECT_EQ(registry.select(kFlatten, Type::kInt), kDefault);
+}
+
+TEST(KernelRegistry, activation_kernel_is_the_best_supported) {
+  std::vector<KernelEntry> candidates =
+      KernelRegistry::instance().candidates(kElementWise, Type::kFloat);
+  ASSERT_FALSE(candidates.empty());
+  EXPECT_LE(best_activation_isa(), max_isa());
+  EXPECT_LE(best_activation_isa(), candidates[0].isa);
+}
+
+TEST(KernelRegistry, preferred_implementation_goes_first) {
+  KernelRegistry& registry = KernelRegistry::instance();
+  registry.set_preferred("default");
+  EXPECT_EQ(registry.select(kConvolution, Type::kFloat), kDefault);
+  registry.set_preferred("");
+  EXPECT_EQ(registry.select(kConvolution, Type::kFloat), kWinograd);
+}
+
+TEST(KernelRegistry, direct_loops_only_fit_stride_1) {
+  KernelRegistry& registry = KernelRegistry::instance();
+  Tensor kernel = make_tensor(std::vector<float>(3 * 3 * 2 * 2, 0.5F),
+                              {3, 3, 2, 2});
+  registry.set_preferred("default");
+  EXPECT_EQ(ConvolutionalLayer(1, 1, 1, kernel, Tensor(), kAuto).impl_type(),
+            kDefault);
+  EXPECT_EQ(ConvolutionalLayer(2, 1, 1, kernel, Tensor(), kAuto).impl_type(),
+            kIm2col);
+  registry.set_preferred("");
+}
+
+TEST(KernelRegistry, auto_convolution_can_pick_stl) {
+  KernelRegistry& registry = KernelRegistry::instance();
+  std::vector<float> values(2 * 6 * 6);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<float>(i % 5) - 2.0F;
+  }
+  Tensor input = make_tensor(values, {1, 2, 6, 6});
+  Tensor kernel = make_tensor(std::vector<float>(3 * 3 * 2 * 2, 0.5F),
+                              {3, 3, 2, 2});
+  Tensor kernel_int = make_tensor(std::vector<int>(3 * 3 * 2 * 2, 1),
+                                  {3, 3, 2, 2});
+  registry.set_preferred("stl");
+  ConvolutionalLayer automatic(1, 1, 1, kernel, Tensor(), kAuto);
+  EXPECT_EQ(automatic.impl_type(), kSTL);
+  EXPECT_EQ(
+      ConvolutionalLayer(1, 1, 1, kernel_int, Tensor(), kAuto).impl_type(),
+      kSTL);
+  EXPECT_EQ(ConvolutionalLayer(2, 1, 1, kernel, Tensor(), kAuto).impl_type(),
+            kIm2col);
+  registry.set_preferred("");
+  Tensor expected;
+  Tensor output;
+  ConvolutionalLayer(1, 1, 1, kernel, Tensor(), kSTL).run(input, expected);
+  automatic.run(input, output);
+  EXPECT_EQ(automatic.choice().impl, kSTL);
+  EXPECT_EQ(*output.as<float>(), *expected.as<float>());
+}
+
+TEST(KernelRegistry, auto_convolution_picks_an_implementation_that_fits) {
+  Tensor kernel3 = make_tensor(std::vector<float>(3 * 3 * 2 * 2, 0.5F),
+                               {3, 3, 2, 2});
+  Tensor kernel1 = make_tensor(std::vector<float>(2 * 2, 0.5F), {1, 1, 2, 2});
+  Tensor kernel_int = make_tensor(std::vector<int>(3 * 3 * 2 * 2, 1),
+                                  {3, 3, 2, 2});
+  EXPECT_EQ(ConvolutionalLayer(1, 1, 1, kernel3, Tensor(), kAuto).impl_type(),
+            kWinograd);
+  EXPECT_EQ(ConvolutionalLayer(2, 1, 1, kernel3, Tensor(), kAuto).impl_type(),
+            kIm2col);
+  EXPECT_EQ(ConvolutionalLayer(1, 0, 1, kernel1, Tensor(), kAuto).impl_type(),
+            kIm2col);
+  EXPECT_EQ(
+      ConvolutionalLayer(1, 1, 1, kernel_int, Tensor(), kAuto).impl_type(),
+      kIm2col);
+
+  std::vector<float> values(2 * 6 * 6);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<float>(i % 7) - 3.0F;
+  }
+  Tensor input = make_tensor(values, {1, 2, 6, 6});
+  for (const Tensor& kernel : {kernel3, kernel1}) {
+    ConvolutionalLayer automatic(1, 0, 1, kernel, Tensor(), kAuto);
+    ConvolutionalLayer direct(1, 0, 1, kernel, Tensor(), kSTL);
+    Tensor expected;
+    Tensor output;
+    direct.run(input, expected);
+    automatic.run(input, output);
+    ASSERT_EQ(output.get_shape(), expected.get_shape());
+    for (size_t i = 0; i < expected.get_shape().count(); i++) {
+      EXPECT_NEAR((*output.as<float>())[i], (*expected.as<float>())[i], 1e-4);
+    }
+  }
+}
+
+TEST(KernelRegistry, auto_pooling_matches_default) {
+  std::vector<int> values(16);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<int>(i * 3 % 5);
+  }
+  Tensor input = make_tensor(values, {1, 1, 4, 4});
+  Tensor expected;
+  Tensor output;
+  PoolingLayer({2, 2}, "max", kDefault).run(input, expected);
+  PoolingLayer({2, 2}, "max", kAuto).run(input, output);
+  EXPECT_EQ(*output.as<int>(), *expected.as<int>());
+}
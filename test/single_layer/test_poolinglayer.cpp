@@ -1,6 +1,7 @@
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "layers/Layout.hpp"
 #include "layers/PoolingLayer.hpp"
 
 using namespace it_lab_ai;
@@ -213,3 +214,27 @@ TEST(poolinglayer, new_pooling_layer_tbb_can_run_1d_pooling_float) {
     EXPECT_NEAR((*output.as<float>())[i], true_output[i], 1e-5);
   }
 }
+
+TEST(poolinglayer, nhwc_layout_matches_nchw) {
+  std::vector<float> values(2 * 3 * 6 * 5);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = static_cast<float>(i * 7 % 11) - 5.0F;
+  }
+  Tensor input = make_tensor(values, {2, 3, 6, 5});
+  Tensor nhwc_input = nhwc_view(to_nhwc(input));
+  for (const char* type : {"average", "max"}) {
+    PoolingLayer nchw({2, 2}, type);
+    PoolingLayer nhwc({2, 2}, type);
+    EXPECT_TRUE(nhwc.prefers_layout(kNhwc));
+    nhwc.set_layout(kNhwc);
+    Tensor expected;
+    nchw.run(input, expected);
+    for (const Tensor& in : {input, nhwc_input}) {
+      Tensor output;
+      nhwc.run(in, output);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      EXPECT_TRUE(is_nhwc(output));
+      EXPECT_EQ(*output.contiguous().as<float>(), *expected.as<float>());
+    }
+  }
+}
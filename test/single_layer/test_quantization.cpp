@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "layers/ConvLayer.hpp"
+#include "layers/FCLayer.hpp"
+#include "layers/Quantization.hpp"
+#include "test_utils.hpp"
+
+using namespace it_lab_ai;
+
+TEST(Quantization, params_keep_zero_exact) {
+  QuantParams params = QuantParams::from_range(0.5F, 3.0F);
+  EXPECT_EQ(params.zero_point, 0);
+  EXPECT_FLOAT_EQ(params.dequantize(params.quantize(0.0F)), 0.0F);
+  params = QuantParams::from_range(-1.0F, 3.0F);
+  EXPECT_FLOAT_EQ(params.dequantize(params.quantize(0.0F)), 0.0F);
+  for (float value : {-1.0F, -0.3F, 0.7F, 2.9F}) {
+    EXPECT_NEAR(params.dequantize(params.quantize(value)), value,
+                params.scale / 2 + 1e-6F);
+  }
+  EXPECT_EQ(params.quantize(100.0F), 255);
+  EXPECT_EQ(params.quantize(-100.0F), 0);
+}
+
+TEST(Quantization, tensors_round_trip) {
+  Tensor input = make_tensor<float>({-1.0F, 0.0F, 0.5F, 2.0F}, {2, 2});
+  ValueRange range;
+  range.update(input);
+  EXPECT_FLOAT_EQ(range.min, -1.0F);
+  EXPECT_FLOAT_EQ(range.max, 2.0F);
+  QuantParams params = QuantParams::from_range(range.min, range.max);
+  Tensor quantized = quantize(input, params);
+  EXPECT_EQ(quantized.get_type(), Type::kUInt8);
+  EXPECT_EQ(quantized.get_shape(), input.get_shape());
+  Tensor restored = dequantize(quantized, params);
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_NEAR((*restored.as<float>())[i], (*input.as<float>())[i],
+                params.scale / 2 + 1e-6F);
+  }
+  Tensor weights = make_tensor(std::vector<int8_t>{-127, 0, 5}, {3});
+  EXPECT_EQ(weights.get_type(), Type::kInt8);
+  EXPECT_EQ((*weights.as<int8_t>())[0], -127);
+}
+
+TEST(Quantization, int8_gemm_kernels_match_reference) {
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::uniform_int_distribution<int> bytes(0, 255);
+  for (size_t m : {size_t(1), size_t(7)}) {
+    size_t depth = 13;
+    size_t cols = 21;
+    std::vector<float> b_values(depth * cols);
+    for (auto& v : b_values) v = dist(gen);
+    QuantizedMatrix b =
+        QuantizedMatrix::quantize(b_values.data(), depth, cols, cols, 1);
+    size_t lda = int8_padded_depth(depth);
+    std::vector<uint8_t> a(m * lda);
+    for (auto& v : a) v = static_cast<uint8_t>(bytes(gen));
+    std::vector<int32_t> expected(m * cols, 0);
+    for (size_t n = 0; n < cols; n++) {
+      int32_t column_sum = 0;
+      for (size_t k = 0; k < depth; k++) {
+        auto q = static_cast<int32_t>(
+            std::round(b_values[k * cols + n] / b.scales[n]));
+        column_sum += q;
+        for (size_t i = 0; i < m; i++) {
+          expected[i * cols + n] += static_cast<int32_t>(a[i * lda + k]) * q;
+        }
+      }
+      EXPECT_EQ(b.column_sums[n], column_sum);
+    }
+    for (Isa isa : {Isa::kScalar, Isa::kAvx512}) {
+      std::vector<int32_t> c(m * cols, -1);
+      if (!gemm_u8s8s32(isa, m, a.data(), lda, b, c.data(), cols)) {
+        continue;
+      }
+      EXPECT_EQ(c, expected) << isa_name(isa);
+    }
+    std::vector<int32_t> c(m * cols);
+    gemm_u8s8s32_parallel(m, a.data(), lda, b, c.data(), cols);
+    EXPECT_EQ(c, expected);
+  }
+}
+
+TEST(Quantization, fc_int8_is_close_to_float) {
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  size_t in_size = 50;
+  size_t out_size = 20;
+  std::vector<float> weights(out_size * in_size);
+  for (auto& v : weights) v = dist(gen);
+  std::vector<float> bias(out_size);
+  for (auto& v : bias) v = dist(gen);
+  std::vector<float> values(3 * in_size);
+  for (auto& v : values) v = dist(gen);
+  Tensor input = make_tensor(values, {3, in_size});
+  FCLayer layer(make_tensor(weights, {out_size, in_size}), make_tensor(bias));
+  Tensor expected;
+  layer.run(input, expected);
+  EXPECT_FALSE(layer.quantize());
+  ASSERT_TRUE(layer.start_calibration());
+  Tensor output;
+  layer.run(input, output);
+  EXPECT_EQ(*output.as<float>(), *expected.as<float>());
+  ASSERT_TRUE(layer.quantize());
+  EXPECT_TRUE(layer.quantized());
+  layer.run(input, output);
+  ASSERT_EQ(output.get_shape(), expected.get_shape());
+  EXPECT_LT(relative_error(*output.as<float>(), *expected.as<float>()),
+            0.02F);
+}
+
+TEST(Quantization, conv_int8_is_close_to_float) {
+  std::mt19937 gen(9);
+  std::uniform_real_distribution<float> dist(-1.0F, 1.0F);
+  std::vector<float> image(2 * 5 * 9 * 8);
+  for (auto& v : image) v = dist(gen);
+  Tensor input = make_tensor(image, {2, 5, 9, 8});
+  std::vector<float> kernelvec(3 * 3 * 5 * 6);
+  for (auto& v : kernelvec) v = dist(gen);
+  Tensor kernel = make_tensor(kernelvec, {3, 3, 5, 6});
+  Tensor bias = make_tensor<float>({0.1F, -0.2F, 0.3F, 0.0F, 0.5F, -0.5F});
+  for (LayInOut layout : {kNchw, kNhwc}) {
+    for (size_t stride : {size_t(1), size_t(2)}) {
+      ConvolutionalLayer reference(stride, 1, 1, kernel, bias, kIm2col);
+      ConvolutionalLayer layer(stride, 1, 1, kernel, bias, kIm2col);
+      ASSERT_TRUE(reference.fuse_activation(Activation("relu")));
+      ASSERT_TRUE(layer.fuse_activation(Activation("relu")));
+      layer.set_layout(layout);
+      Tensor expected;
+      reference.run(input, expected);
+      ASSERT_TRUE(layer.start_calibration());
+      Tensor output;
+      layer.run(input, output);
+      ASSERT_TRUE(layer.quantize());
+      layer.run(input, output);
+      ASSERT_EQ(output.get_shape(), expected.get_shape());
+      EXPECT_EQ(is_nhwc(output), layout == kNhwc);
+      AlignedVector<float> values = *output.contiguous().as<float>();
+      EXPECT_LT(relative_error(values, *expected.as<float>()), 0.02F);
+      for (float value : values) {
+        EXPECT_GE(value, 0.0F);
+      }
+    }
+  }
+  // grouped layers keep their float kernels
+  Tensor grouped_kernel = make_tensor(std::vector<float>(3 * 3 * 1 * 5, 0.5F),
+                                      {3, 3, 1, 5});
+  ConvolutionalLayer depthwise(1, 1, 1, grouped_kernel, Tensor(), kDefault, 5);
+  EXPECT_FALSE(depthwise.start_calibration());
+}
@@ -212,4 +212,17 @@ TEST(SplitLayerTests, LargeAxisValue) {
   SplitLayer splitter(10, {1, 1});
   std::vector<Tensor> outputs;
   EXPECT_THROW(splitter.run(input, outputs), std::runtime_error);
-}
\ No newline at end of file
+}
+TEST(SplitLayerTests, SplitViewsShareInputStorage) {
+  std::vector<float> data(4 * 3);
+  std::iota(data.begin(), data.end(), 0.0f);
+  const Tensor input = make_tensor<float>(data, {4, 3});
+
+  SplitLayer splitter(0, {1, 3});
+  std::vector<TensorView> views = splitter.split_views(input);
+
+  ASSERT_EQ(views.size(), 2);
+  EXPECT_EQ(views[1].get_shape(), Shape({3, 3}));
+  EXPECT_EQ(views[1].data<float>(), input.as<float>()->data() + 3);
+  EXPECT_FLOAT_EQ(views[1].get<float>({2, 2}), 11.0f);
+}
@@ -143,7 +143,7 @@ TEST(Tensor, can_interpret_as_test) {
   Shape sh({2, 3});
   std::vector<float> vals_tensor = {4.5F, -0.2F, 2.1F, -1.7F, -6.9F, 3.0F};
   const Tensor t = make_tensor<float>(vals_tensor, sh);
-  std::vector<float> tmp_tensor = *t.as<float>();
+  AlignedVector<float> tmp_tensor = *t.as<float>();
   for (size_t i = 0; i < sh.count(); i++) {
     EXPECT_NEAR(tmp_tensor[i], vals_tensor[i], 1e-5);
   }
@@ -257,3 +257,108 @@ TEST(TensorTest, IncorrectBiasSize) {
   std::vector<float> incorrect_bias = {1.0f, 2.0f};
   ASSERT_NO_THROW(Tensor tensor = make_tensor(values, shape, incorrect_bias));
 }
+
+TEST(Tensor, tensor_has_row_major_strides) {
+  Tensor t = make_tensor<int>(std::vector<int>(24, 0), {2, 3, 4});
+  EXPECT_EQ(t.get_strides(), std::vector<size_t>({12, 4, 1}));
+  EXPECT_TRUE(t.is_contiguous());
+  EXPECT_EQ(Shape({2, 3, 4}).get_index({1, 2, 3}), 23);
+}
+
+TEST(Tensor, permute_shares_storage_and_reads_through_strides) {
+  Tensor t = make_tensor<int>({1, 2, 3, 4, 5, 6}, {2, 3});
+  Tensor p = t.permute({1, 0});
+  EXPECT_TRUE(p.shares_storage(t));
+  EXPECT_FALSE(p.is_contiguous());
+  EXPECT_EQ(p.get_shape(), Shape({3, 2}));
+  EXPECT_EQ(p.get_strides(), std::vector<size_t>({1, 3}));
+  EXPECT_EQ(p.get<int>({2, 1}), 6);
+  EXPECT_EQ(p.get<int>({0, 1}), 4);
+  EXPECT_THROW(t.permute({0, 0}), std::invalid_argument);
+}
+
+TEST(Tensor, const_as_throws_on_permuted_tensor) {
+  const Tensor p = make_tensor<int>({1, 2, 3, 4, 5, 6}, {2, 3}).permute({1, 0});
+  EXPECT_THROW(p.as<int>(), std::logic_error);
+  EXPECT_EQ(*p.contiguous().as<int>(), std::vector<int>({1, 4, 2, 5, 3, 6}));
+}
+
+TEST(Tensor, as_throws_on_permuted_tensor) {
+  Tensor p = make_tensor<int>({1, 2, 3, 4, 5, 6}, {2, 3}).permute({1, 0});
+  EXPECT_THROW(p.as<int>(), std::logic_error);
+  EXPECT_FALSE(p.is_contiguous());
+}
+
+TEST(Tensor, writing_permuted_tensor_materializes_it) {
+  Tensor t = make_tensor<int>({1, 2, 3, 4, 5, 6}, {2, 3});
+  Tensor p = t.permute({1, 0});
+  p.set<int>({2, 0}, 9);
+  EXPECT_TRUE(p.is_contiguous());
+  EXPECT_FALSE(p.shares_storage(t));
+  EXPECT_EQ(*p.as<int>(), std::vector<int>({1, 4, 2, 5, 9, 6}));
+  EXPECT_EQ(t.get<int>({0, 2}), 3);
+}
+
+TEST(Tensor, storage_is_aligned) {
+  for (size_t n : {1, 3, 17, 1000}) {
+    Tensor t = make_tensor<float>(std::vector<float>(n, 1.0F), {n});
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(t.data<float>()) % kTensorAlignment,
+              0);
+    Tensor copy = t;
+    copy.set<float>({0}, 2.0F);
+    EXPECT_EQ(
+        reinterpret_cast<uintptr_t>(copy.data<float>()) % kTensorAlignment, 0);
+  }
+}
+
+TEST(Tensor, resized_storage_stays_aligned) {
+  Tensor t = make_tensor<float>({1.0F, 2.0F, 3.0F});
+  AlignedVector<float>* values = t.as<float>();
+  values->resize(1000, 4.0F);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(values->data()) % kTensorAlignment, 0);
+  EXPECT_EQ((*values)[2], 3.0F);
+  EXPECT_EQ((*values)[999], 4.0F);
+}
+
+TEST(Tensor, big_storage_is_aligned_to_huge_pages) {
+  set_huge_pages(true);
+  Tensor t(Shape({kHugePageThreshold / sizeof(float)}), Type::kFloat);
+  set_huge_pages(false);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(t.data<float>()) % kHugePageSize, 0);
+  EXPECT_EQ(t.get<float>({0}), 0.0F);
+}
+
+TEST(Tensor, reset_keeps_unshared_storage) {
+  Tensor t = make_tensor<float>({1.0F, 2.0F, 3.0F, 4.0F});
+  const uint8_t* storage = t.get_values().data();
+  AlignedVector<int>& values = t.reset<int>({2});
+  EXPECT_EQ(t.get_values().data(), storage);
+  EXPECT_EQ(t.get_type(), Type::kInt);
+  EXPECT_EQ(t.get_shape(), Shape({2}));
+  EXPECT_EQ(values.size(), 2);
+
+  Tensor copy = t;
+  copy.reset<float>({2});
+  EXPECT_FALSE(copy.shares_storage(t));
+  EXPECT_EQ(t.get_values().data(), storage);
+}
+
+TEST(Tensor, reset_writes_into_allocation_region) {
+  auto region = std::make_shared<AllocationRegion>();
+  std::vector<float> memory(16);
+  region->data = memory.data();
+  region->bytes = memory.size() * sizeof(float);
+  Tensor t(region->bytes, AlignedAllocator<uint8_t>(region));
+  EXPECT_TRUE(region->in_use);
+  t.reset<float>({4})[3] = 5.0F;
+  EXPECT_EQ(memory[3], 5.0F);
+  // a copy written to gets storage of its own
+  Tensor copy = t;
+  copy.set<float>({3}, 6.0F);
+  EXPECT_EQ(memory[3], 5.0F);
+  // and so does a tensor outgrowing the region, which is then free
+  t.reset<float>({32});
+  EXPECT_NE(t.get_values().data(),
+            reinterpret_cast<const uint8_t*>(memory.data()));
+  EXPECT_FALSE(region->in_use);
+}
@@ -0,0 +1,77 @@
+#include <numeric>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "layers/Tensor.hpp"
+#include "layers/TensorView.hpp"
+
+using namespace it_lab_ai;
+
+TEST(TensorView, copy_shares_storage_until_write) {
+  Tensor a = make_tensor<int>({1, 2, 3, 4}, {2, 2});
+  Tensor b = a;
+  EXPECT_TRUE(a.shares_storage(b));
+  b.set<int>({0, 1}, 7);
+  EXPECT_FALSE(a.shares_storage(b));
+  EXPECT_EQ(a.get<int>({0, 1}), 2);
+  EXPECT_EQ(b.get<int>({0, 1}), 7);
+}
+
+TEST(TensorView, reshape_does_not_copy) {
+  Tensor a = make_tensor<float>({1.0F, 2.0F, 3.0F, 4.0F, 5.0F, 6.0F}, {2, 3});
+  Tensor b = a.reshape(Shape({3, 2}));
+  EXPECT_TRUE(a.shares_storage(b));
+  EXPECT_EQ(b.get_shape(), Shape({3, 2}));
+  EXPECT_FLOAT_EQ(b.get<float>({2, 1}), 6.0F);
+  EXPECT_THROW(a.reshape(Shape({4, 2})), std::invalid_argument);
+}
+
+TEST(TensorView, view_reads_through_strides) {
+  std::vector<int> data(2 * 3 * 4);
+  std::iota(data.begin(), data.end(), 0);
+  Tensor t = make_tensor<int>(data, {2, 3, 4});
+  TensorView view = t.view();
+  EXPECT_TRUE(view.is_contiguous());
+  EXPECT_EQ(view.get_strides(), std::vector<size_t>({12, 4, 1}));
+  EXPECT_EQ(view.get<int>({1, 2, 3}), 23);
+  TensorView part = view.narrow(2, 1, 2);
+  EXPECT_FALSE(part.is_contiguous());
+  EXPECT_EQ(part.get_shape(), Shape({2, 3, 2}));
+  EXPECT_EQ(part.get<int>({1, 0, 1}), 14);
+  EXPECT_THROW(part.reshape(Shape({12})), std::invalid_argument);
+  EXPECT_THROW(view.narrow(1, 2, 2), std::out_of_range);
+}
+
+TEST(TensorView, batch_slice_is_zero_copy) {
+  std::vector<float> data(4 * 3);
+  std::iota(data.begin(), data.end(), 0.0F);
+  const Tensor t = make_tensor<float>(data, {4, 3});
+  TensorView batch = t.view().slice(1, 3);
+  EXPECT_EQ(batch.get_shape(), Shape({2, 3}));
+  EXPECT_EQ(batch.get_offset(), 3);
+  EXPECT_EQ(batch.data<float>(), t.as<float>()->data() + 3);
+  Tensor copy = batch.to_tensor();
+  EXPECT_EQ(*copy.as<float>(),
+            std::vector<float>({3.0F, 4.0F, 5.0F, 6.0F, 7.0F, 8.0F}));
+}
+
+TEST(TensorView, to_tensor_shares_whole_storage) {
+  Tensor t = make_tensor<int>({1, 2, 3, 4}, {2, 2});
+  Tensor back = t.view().reshape(Shape({4})).to_tensor();
+  EXPECT_TRUE(t.shares_storage(back));
+  EXPECT_EQ(back.get_shape(), Shape({4}));
+}
+
+TEST(TensorView, to_tensor_gathers_strided_view) {
+  std::vector<int> data(2 * 3 * 4);
+  std::iota(data.begin(), data.end(), 0);
+  Tensor t = make_tensor<int>(data, {2, 3, 4});
+  Tensor part = t.view().narrow(1, 1, 1).to_tensor();
+  EXPECT_EQ(part.get_shape(), Shape({2, 1, 4}));
+  EXPECT_EQ(*part.as<int>(), std::vector<int>({4, 5, 6, 7, 16, 17, 18, 19}));
+}
+
+TEST(TensorView, data_throws_on_wrong_type) {
+  Tensor t = make_tensor<int>({1, 2});
+  EXPECT_THROW(t.view().data<float>(), std::invalid_argument);
+}
@@ -196,4 +196,37 @@ TEST(TransposeLayerTest, ExplicitPermutationWithDifferentRanks) {
   Tensor input3D = make_tensor<float>({1, 2, 3, 4, 5, 6, 7, 8}, {2, 2, 2});
   Tensor output3D;
   EXPECT_THROW(layer.run(input3D, output3D), std::invalid_argument);
-}
\ No newline at end of file
+}
+TEST(TransposeLayerTest, LazyTransposeReturnsView) {
+  Tensor input = make_tensor<float>({1, 2, 3, 4, 5, 6}, {2, 3});
+  TransposeLayer layer({1, 0}, true);
+  Tensor output;
+
+  layer.run(input, output);
+
+  ASSERT_EQ(output.get_shape(), Shape({3, 2}));
+  EXPECT_TRUE(output.shares_storage(input));
+  EXPECT_FALSE(output.is_contiguous());
+  EXPECT_FLOAT_EQ(output.get<float>({2, 0}), 3.0f);
+  EXPECT_EQ(*output.contiguous().as<float>(),
+            std::vector<float>({1, 4, 2, 5, 3, 6}));
+}
+
+TEST(TransposeLayerTest, EagerTransposeOfViewComposesPermutations) {
+  std::vector<float> data(24);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<float>(i);
+  }
+  Tensor input = make_tensor<float>(data, {2, 3, 4});
+  TransposeLayer lazy({2, 0, 1}, true);
+  TransposeLayer eager({1, 2, 0});
+  Tensor view;
+  Tensor output;
+
+  lazy.run(input, view);
+  eager.run(view, output);
+
+  ASSERT_EQ(output.get_shape(), Shape({2, 3, 4}));
+  EXPECT_TRUE(output.is_contiguous());
+  EXPECT_EQ(*output.as<float>(), data);
+}
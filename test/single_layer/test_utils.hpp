@@ -0,0 +1,28 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "gtest/gtest.h"
+#include "layers/Span.hpp"
+
+namespace it_lab_ai {
+
+// largest difference relative to the largest expected magnitude, infinity
+// (after a failed check) when the sizes differ
+inline float relative_error(Span<const float> actual,
+                            Span<const float> expected) {
+  EXPECT_EQ(actual.size(), expected.size());
+  if (actual.size() != expected.size()) {
+    return std::numeric_limits<float>::infinity();
+  }
+  float error = 0.0F;
+  float magnitude = 0.0F;
+  for (size_t i = 0; i < expected.size(); i++) {
+    error = std::max(error, std::fabs(actual[i] - expected[i]));
+    magnitude = std::max(magnitude, std::fabs(expected[i]));
+  }
+  return error / magnitude;
+}
+
+}  // namespace it_lab_ai